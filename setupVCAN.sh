@@ -0,0 +1,14 @@
+#!/bin/sh
+sudo modprobe can
+sudo modprobe can_raw
+sudo modprobe vcan
+sudo ip link add dev vcan0 type vcan
+sudo ip link set up vcan0
+sudo ifconfig vcan0 txqueuelen 1000
+echo "Done"
+#
+# A virtual bus for running tfr_can's can_simulator instead of the rover.
+# Start the simulator with:
+#     roslaunch tfr_can can_simulator.launch
+# and the bridge with busname set to vcan0 in can.launch.
+# candump -t a vcan0 shows the heartbeats from the simulated devices.
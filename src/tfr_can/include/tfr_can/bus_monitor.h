@@ -0,0 +1,124 @@
+/****************************************************************************************
+ * File:            bus_monitor.h
+ *
+ * Purpose:         Instrumentation for the CAN bridge.
+ *
+ *                  Every polled entry gets an EntryStats, which the publisher
+ *                  polling it fills with request->response latencies, errors
+ *                  and retries, and how often it was actually polled. An
+ *                  entry polled at less than its configured rate, because
+ *                  the bus can't keep up, is warned about. Separately, the monitor listens to the bus on
+ *                  its own raw socket (which also sees the frames the bridge
+ *                  sends) to count frames and error frames and estimate how
+ *                  much of the bitrate is in use.
+ *
+ *                  Once a second all of it is published as a compact
+ *                  tfr_msgs/CanBusStats and the latency windows are reset.
+ *
+ * Publishes To:    ~diagnostics (tfr_msgs/CanBusStats)
+ ***************************************************************************************/
+#ifndef BUS_MONITOR_H
+#define BUS_MONITOR_H
+
+#include "socket_can.h"
+
+#include <ros/ros.h>
+#include <tfr_msgs/CanBusStats.h>
+#include <tfr_utilities/latency_histogram.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tfr_can
+{
+    /*
+     * Counters for one polled entry. Written by the polling thread, read and
+     * reset by the diagnostics timer.
+     * */
+    struct EntryStats
+    {
+        EntryStats(uint8_t id, const std::string& name, double configured_rate) :
+            node_id{id}, entry{name}, rate{configured_rate}, polls{0}, errors{0}, retries{0}
+        {}
+
+        const uint8_t node_id;
+        const std::string entry;
+        const double rate; // Hz, configured
+        tfr_utilities::LatencyHistogram latency; // nanoseconds
+        std::atomic<uint32_t> polls;
+        std::atomic<uint32_t> errors;
+        std::atomic<uint32_t> retries;
+    };
+
+    /*
+     * Converts a kacanopen baudrate such as "250K" or "1M" to bits/second.
+     * */
+    uint32_t parseBaudrate(const std::string& baudrate);
+
+    class BusMonitor
+    {
+    public:
+        BusMonitor(ros::NodeHandle& n, const std::string& busname, uint32_t bitrate);
+        ~BusMonitor();
+        BusMonitor(const BusMonitor&) = delete;
+        BusMonitor& operator=(const BusMonitor&) = delete;
+        BusMonitor(BusMonitor&&) = delete;
+        BusMonitor& operator=(BusMonitor&&) = delete;
+
+        /*
+         * Creates the counters for an entry polled at rate Hz.
+         * */
+        std::shared_ptr<EntryStats> addEntry(uint8_t node_id, const std::string& entry,
+                double rate);
+
+        /*
+         * Percent of the bitrate the configured polling takes, every
+         * expedited SDO upload being a request and a response frame.
+         * */
+        double pollingLoad();
+
+        /*
+         * Opens the raw socket and starts counting frames. Entry stats are
+         * published even if this fails.
+         * */
+        bool start();
+
+        void stop();
+
+    private:
+        const std::string busname;
+        const uint32_t bitrate;
+
+        ros::Publisher diagnostics_publisher;
+        ros::Timer diagnostics_timer;
+        tfr_msgs::CanBusStats stats_msg;
+        ros::Time window_start;
+        // the first window is cut short by the bridge starting up
+        bool first_window;
+
+        std::mutex entries_mutex;
+        std::vector<std::shared_ptr<EntryStats>> entries;
+
+        SocketCan socket;
+        std::thread receive_thread;
+        std::atomic<bool> running;
+        std::atomic<uint64_t> frames;
+        std::atomic<uint64_t> error_frames;
+        std::atomic<uint64_t> bits;
+
+        void receive();
+        void publishDiagnostics(const ros::TimerEvent& event);
+    };
+
+    /*
+     * Worst case number of bits a standard (11 bit id) frame with the given
+     * payload occupies on the wire, including stuff bits.
+     * */
+    uint32_t frameBits(uint8_t length);
+}
+
+#endif // BUS_MONITOR_H
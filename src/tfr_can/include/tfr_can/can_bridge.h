@@ -0,0 +1,83 @@
+/****************************************************************************************
+ * File:            can_bridge.h
+ *
+ * Purpose:         The CAN bridge as a library, so it can either run as its own
+ *                  node (create_ros_topics_for_can_nodes) or be started inside
+ *                  of the control node.
+ *
+ *                  Every value read from a device is written to the shared
+ *                  tfr_utilities::CanSnapshot as soon as it arrives, which is
+ *                  how RobotInterface gets it without going through ROS. The
+ *                  "deviceN/get_<entry>" topics are a mirror for everything
+ *                  else and can be turned off with ~publish_topics.
+ *
+ *                  The IMU's readings are the exception: with an "imu" in its
+ *                  device description they are published together, one
+ *                  sensor_msgs/Imu per sample, see imu_assembler.h.
+ *
+ *                  Each bus in ~buses is run by its own CanBus, see can_bus.h.
+ *                  Without ~buses there is one, ~busname.
+ *
+ *                  The set_<entry> subscribers are serviced by each bus, but
+ *                  whoever owns the bridge must spin the global callback
+ *                  queue for the diagnostics timers.
+ *
+ * Parameters:      ~buses (list of {name, baudrate}, optional)
+ *                  ~busname (string, default can1), ~baudrate (string, default 250K)
+ *                  ~eds_files_path, ~devices, ~default_rate (see can_topology.h)
+ *                  ~eds_cache_directory (string, default ~/.ros/tfr_can_eds)
+ *                  ~discovery_timeout (double, default 2.0) how long to wait
+ *                  for every device before starting with the ones found
+ *                  ~sdo_retries, ~use_pdo_telemetry, ~pdo_sync_period_ms
+ *                  ~publish_topics (bool, default true)
+ *                  ~record_directory (string, default none) where to log
+ *                  the raw traffic, see frame_recorder.h
+ *                  ~coalesce_commands (bool, default false) send motor
+ *                  commands only when they change, see command_coalescer.h
+ *                  ~command_period_ms (default 10), ~command_keep_alive_ms
+ *                  (default 200)
+ ***************************************************************************************/
+#ifndef CAN_BRIDGE_H
+#define CAN_BRIDGE_H
+
+#include "can_bus.h"
+
+#include <ros/ros.h>
+#include <tfr_utilities/can_snapshot.h>
+#include <memory>
+#include <vector>
+
+namespace tfr_can
+{
+    class CanBridge
+    {
+    public:
+        /*
+         * private_n is where the bridge reads its parameters and publishes
+         * its diagnostics.
+         * */
+        CanBridge(ros::NodeHandle& n, ros::NodeHandle& private_n);
+        ~CanBridge();
+        CanBridge(const CanBridge&) = delete;
+        CanBridge& operator=(const CanBridge&) = delete;
+
+        /*
+         * Starts every bus, waits for the devices, exposes the configured
+         * entries and starts polling. Returns false if a bus could not be
+         * started or the topology is missing.
+         * */
+        bool start();
+
+        void stop();
+
+    private:
+        ros::NodeHandle& node;
+        ros::NodeHandle& private_node;
+
+        tfr_utilities::CanSnapshot snapshot;
+        std::vector<DeviceConfig> topology;
+        std::vector<std::unique_ptr<CanBus>> buses;
+    };
+}
+
+#endif // CAN_BRIDGE_H
@@ -0,0 +1,115 @@
+/****************************************************************************************
+ * File:            can_bus.h
+ *
+ * Purpose:         Everything the bridge runs for one SocketCAN interface: a
+ *                  kacanopen master, the poll scheduler, PDO telemetry, the
+ *                  bus monitor and recorder, and the write subscribers or
+ *                  command coalescer.
+ *
+ *                  Buses share nothing but the snapshot, so each has its own
+ *                  receive thread (the master's), polling thread, SYNC and
+ *                  callback queue for writes. Traffic on one bus can't delay
+ *                  reads or writes on another.
+ ***************************************************************************************/
+#ifndef CAN_BUS_H
+#define CAN_BUS_H
+
+#include "master.h"
+#include "subscriber.h"
+#include "bus_monitor.h"
+#include "can_topology.h"
+#include "command_coalescer.h"
+#include "eds_cache.h"
+#include "frame_recorder.h"
+#include "imu_assembler.h"
+#include "pdo_telemetry.h"
+#include "poll_scheduler.h"
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <tfr_utilities/can_snapshot.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tfr_can
+{
+    /*
+     * How every bus is run, from the bridge's parameters.
+     * */
+    struct BusOptions
+    {
+        int sdo_retries;
+        bool publish_topics;
+        bool use_pdo_telemetry;
+        std::chrono::milliseconds pdo_sync_period;
+        std::chrono::duration<double> discovery_timeout;
+        std::string record_directory;
+        bool coalesce_commands;
+        std::chrono::milliseconds command_period;
+        std::chrono::milliseconds command_keep_alive;
+    };
+
+    class CanBus
+    {
+    public:
+        /*
+         * devices are the ones configured on this bus. snapshot may be null.
+         * */
+        CanBus(ros::NodeHandle& n, ros::NodeHandle& private_n, const BusConfig& config,
+                const std::vector<DeviceConfig>& devices, tfr_utilities::CanSnapshot* snapshot);
+        ~CanBus();
+        CanBus(const CanBus&) = delete;
+        CanBus& operator=(const CanBus&) = delete;
+
+        /*
+         * Starts the master, waits for the devices, exposes their entries
+         * and starts polling. dictionaries are by node id. Returns false if
+         * the bus could not be started.
+         * */
+        bool start(const BusOptions& options,
+                const std::map<int, std::shared_ptr<const EdsDictionary>>& dictionaries);
+
+        void stop();
+
+        const std::string& name() const;
+
+    private:
+        ros::NodeHandle& node;
+        ros::NodeHandle& private_node;
+        const BusConfig bus_config;
+        const std::vector<DeviceConfig> topology;
+        tfr_utilities::CanSnapshot* const snapshot;
+
+        ros::CallbackQueue write_queue;
+        ros::NodeHandle write_node;
+        ros::AsyncSpinner write_spinner;
+
+        // before master, which calls back into them until it is destroyed
+        std::mutex discovery_mutex;
+        std::condition_variable device_alive;
+
+        kaco::Master master;
+        PollScheduler scheduler;
+        std::unique_ptr<BusMonitor> monitor;
+        std::unique_ptr<FrameRecorder> recorder;
+        std::unique_ptr<PdoTelemetry> telemetry;
+        std::unique_ptr<CommandCoalescer> coalescer;
+        // one for each IMU, fed by telemetry and the scheduler's publishers
+        std::vector<std::unique_ptr<ImuAssembler>> imus;
+        std::vector<std::shared_ptr<kaco::Subscriber>> subscribers;
+
+        int sdo_retries;
+        bool publish_topics;
+        bool started;
+
+        void waitForDevices(std::chrono::duration<double> timeout);
+        void addEntryPublishers(kaco::Device& device, const DeviceConfig& config);
+        void addEntrySubscribers(kaco::Device& device, const DeviceConfig& config);
+    };
+}
+
+#endif // CAN_BUS_H
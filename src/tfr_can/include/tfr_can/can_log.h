@@ -0,0 +1,89 @@
+/****************************************************************************************
+ * File:            can_log.h
+ *
+ * Purpose:         The binary log of raw CAN traffic written by FrameRecorder
+ *                  and played back by can_replay.
+ *
+ *                  A log is a CanLogHeader followed by fixed size
+ *                  CanLogRecords in the order the frames were seen. Records
+ *                  are stamped with CLOCK_MONOTONIC, the header also holds
+ *                  the wall clock time recording started at so a log can be
+ *                  lined up with rosbags and ROS logs. The header's record
+ *                  count is updated after every record, so a log is readable
+ *                  up to the last frame even if the bridge died mid run.
+ *
+ *                  Everything is stored in host byte order, logs are meant to
+ *                  be read on the machine that wrote them or one like it.
+ ***************************************************************************************/
+#ifndef CAN_LOG_H
+#define CAN_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tfr_can
+{
+    const char CAN_LOG_MAGIC[8] = {'T', 'F', 'R', 'C', 'A', 'N', 'L', 'G'};
+    const uint32_t CAN_LOG_VERSION = 1;
+
+    struct CanLogHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint64_t start_realtime;    // [ns] since the epoch
+        uint64_t start_monotonic;   // [ns] CLOCK_MONOTONIC at the same instant
+        uint64_t records;
+        char bus[24];
+    };
+    static_assert(sizeof(CanLogHeader) == 64, "CanLogHeader must stay 64 bytes");
+
+    struct CanLogRecord
+    {
+        // set on frames sent from this machine (the bridge) rather than
+        // received from the devices
+        static const uint8_t SENT = 0x01;
+
+        uint64_t stamp;     // [ns] CLOCK_MONOTONIC
+        uint32_t can_id;    // with the CAN_EFF/RTR/ERR flags of linux/can.h
+        uint8_t length;
+        uint8_t flags;
+        uint16_t reserved;
+        uint8_t data[8];
+    };
+    static_assert(sizeof(CanLogRecord) == 24, "CanLogRecord must stay 24 bytes");
+
+    /*
+     * A log mapped read only.
+     * */
+    class CanLog
+    {
+    public:
+        CanLog();
+        ~CanLog();
+        CanLog(const CanLog&) = delete;
+        CanLog& operator=(const CanLog&) = delete;
+
+        /*
+         * Maps the log at path. Returns false, with a reason in error, if it
+         * can't be read or isn't a log this version understands.
+         * */
+        bool open(const std::string& path, std::string& error);
+
+        void close();
+
+        const CanLogHeader& header() const;
+
+        size_t size() const;
+
+        const CanLogRecord& operator[](size_t i) const;
+
+    private:
+        void* mapping;
+        size_t mapping_size;
+        size_t records;
+    };
+}
+
+#endif // CAN_LOG_H
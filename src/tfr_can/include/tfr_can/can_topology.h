@@ -0,0 +1,117 @@
+/****************************************************************************************
+ * File:            can_topology.h
+ *
+ * Purpose:         Describes which devices live on the CAN bus, which EDS file
+ *                  describes each of them, and which of their entries the
+ *                  bridge exposes to ROS and how often. The description is
+ *                  loaded from the parameter server (see
+ *                  config/can_topology.yaml) so that rewiring the robot does
+ *                  not need a rebuild.
+ ***************************************************************************************/
+#ifndef CAN_TOPOLOGY_H
+#define CAN_TOPOLOGY_H
+
+#include <ros/ros.h>
+#include <string>
+#include <vector>
+
+namespace tfr_can
+{
+    /*
+     * Whether an entry is read from the device and published, or subscribed
+     * to and written to the device.
+     * */
+    enum class EntryDirection
+    {
+        READ,
+        WRITE
+    };
+
+    /*
+     * Which lookup table is used to find an entry's dictionary location when
+     * it gets mapped into a PDO.
+     * */
+    enum class DeviceProfile
+    {
+        ROBOTEQ,
+        LPMS
+    };
+
+    struct EntryConfig
+    {
+        std::string name;
+        EntryDirection direction;
+        double rate; // [Hz], only used for READ entries
+    };
+
+    /*
+     * An IMU's readings assembled into one sensor_msgs/Imu per sample, see
+     * imu_assembler.h. Standard deviations are the sensor's noise in ROS
+     * units, and become the diagonals of the message's covariances.
+     * */
+    struct ImuConfig
+    {
+        bool enabled;
+        std::string topic;
+        std::string frame_id;
+        double orientation_stddev;          // [rad]
+        double angular_velocity_stddev;     // [rad/s]
+        double linear_acceleration_stddev;  // [m/s^2]
+    };
+
+    struct DeviceConfig
+    {
+        int node_id;
+        // empty for the first bus
+        std::string bus;
+        std::string eds_file;
+        DeviceProfile profile;
+        // true if the vendor owns the PDO mapping and we should only decode it
+        bool fixed_pdo_mapping;
+        // only for the LPMS profile, from the device's "imu" member
+        ImuConfig imu;
+        std::vector<EntryConfig> entries;
+    };
+
+    /*
+     * A SocketCAN interface and its bitrate in kacanopen's notation ("250K").
+     * */
+    struct BusConfig
+    {
+        std::string name;
+        std::string baudrate;
+    };
+
+    /*
+     * Reads the list of buses stored under the given parameter. Returns
+     * false, and logs why, if it is there but malformed, and leaves buses
+     * empty if it isn't there at all.
+     * */
+    bool loadBuses(ros::NodeHandle& n, const std::string& param, std::vector<BusConfig>& buses);
+
+    /*
+     * Reads the list of devices stored under the given parameter. Returns
+     * false, and logs why, if the description is missing or malformed.
+     * */
+    bool loadTopology(ros::NodeHandle& n, const std::string& param,
+            std::vector<DeviceConfig>& devices);
+
+    /*
+     * Finds the description of a node id, or nullptr if it isn't described.
+     * */
+    const DeviceConfig* findDevice(const std::vector<DeviceConfig>& devices, int node_id);
+
+    /*
+     * Name of the topic a read entry is published on, without the leading
+     * slash. Matches the one kaco::EntryPublisher would have used, and is also
+     * the entry's name in the shared tfr_utilities::CanSnapshot.
+     * */
+    std::string topicName(int node_id, const std::string& entry_name);
+
+    /*
+     * Name of the topic a write entry is subscribed to, "deviceN/set_<entry>".
+     * */
+    std::string commandTopicName(int node_id, const std::string& entry_name);
+}
+
+#endif // CAN_TOPOLOGY_H
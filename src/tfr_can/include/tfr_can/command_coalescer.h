@@ -0,0 +1,118 @@
+/****************************************************************************************
+ * File:            command_coalescer.h
+ *
+ * Purpose:         Motor commands with less bus traffic, for ~coalesce_commands.
+ *
+ *                  RobotInterface publishes every cmd_cango channel on every
+ *                  control cycle, and an EntrySubscriber turns each message
+ *                  into its own SDO write (two frames, and a wait for the
+ *                  reply). Instead the coalescer keeps the latest command of
+ *                  every channel and sends them on a fixed period, only when
+ *                  one of them changed, or every keep_alive while commands
+ *                  keep arriving, so the Roboteq watchdog stays fed. When
+ *                  the commands stop arriving so do the writes and the
+ *                  watchdog still stops the motors.
+ *
+ *                  A Roboteq's channels are written together in one receive
+ *                  PDO frame, two channels (2 x int32) per frame, using
+ *                  RPDO3 and RPDO4 so the user variable mappings of RPDO1
+ *                  and RPDO2 are left alone. If a device won't take the
+ *                  mapping its channels fall back to SDO writes, still only
+ *                  when something changed.
+ *
+ * Subscribes To:   /deviceN/set_cmd_cango/cmd_cango_<channel>
+ ***************************************************************************************/
+#ifndef COMMAND_COALESCER_H
+#define COMMAND_COALESCER_H
+
+#include "core.h"
+#include "device.h"
+#include "can_topology.h"
+
+#include <ros/ros.h>
+#include <std_msgs/Int32.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <thread>
+#include <vector>
+
+namespace tfr_can
+{
+    class CommandCoalescer
+    {
+    public:
+        /*
+         * Subscribes through n, which should be on the bus's write queue.
+         * */
+        CommandCoalescer(kaco::Core& core, ros::NodeHandle& n,
+                std::chrono::milliseconds period, std::chrono::milliseconds keep_alive);
+        ~CommandCoalescer();
+        CommandCoalescer(const CommandCoalescer&) = delete;
+        CommandCoalescer& operator=(const CommandCoalescer&) = delete;
+
+        /*
+         * Takes over the cmd_cango entries among the given write entries of
+         * a Roboteq, and maps its receive PDOs to carry them. Returns the
+         * entries it doesn't handle, which need their own EntryWriter.
+         * */
+        std::vector<EntryConfig> addDevice(kaco::Device& device,
+                const std::vector<EntryConfig>& entries);
+
+        /*
+         * Starts sending. Call once all devices are added.
+         * */
+        void start();
+
+        void stop();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Channel
+        {
+            Channel(const std::string& entry, uint8_t number) :
+                entry_name{entry}, channel{number}, value{0}, received{false}, sent{0}
+            {}
+
+            const std::string entry_name;
+            const uint8_t channel;
+            // written by the subscriber, read by the sending thread
+            std::atomic<int32_t> value;
+            std::atomic<bool> received;
+            int32_t sent;
+            ros::Subscriber subscriber;
+        };
+
+        // the channels that go out together
+        struct Frame
+        {
+            kaco::Device* device;
+            uint16_t cob_id;
+            bool mapped;
+            std::vector<Channel*> channels;
+            Clock::time_point last_sent;
+        };
+
+        kaco::Core& core;
+        ros::NodeHandle& node;
+        const Clock::duration period;
+        const Clock::duration keep_alive;
+
+        // std::list so the pointers in frames and the subscriber callbacks stay valid
+        std::list<Channel> channels;
+        std::vector<Frame> frames;
+
+        std::thread send_thread;
+        std::atomic<bool> running;
+
+        uint16_t mapReceivePdo(uint8_t node_id, uint8_t pdo_number,
+                const std::vector<Channel*>& mapped);
+        void receive(Channel* channel, const std_msgs::Int32::ConstPtr& msg);
+        void send();
+        void sendFrame(Frame& frame, Clock::time_point now);
+    };
+}
+
+#endif // COMMAND_COALESCER_H
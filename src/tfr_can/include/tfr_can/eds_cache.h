@@ -0,0 +1,93 @@
+/****************************************************************************************
+ * File:            eds_cache.h
+ *
+ * Purpose:         Object dictionaries read from EDS files once and shared.
+ *
+ *                  kaco::Device::load_dictionary_from_eds parses the whole
+ *                  INI file for every device, and three of our devices share
+ *                  the 68K Roboteq EDS. The cache parses each file at most
+ *                  once per run, keyed by a hash of its contents, and keeps a
+ *                  compact binary copy on disk so later runs don't parse at
+ *                  all. A changed EDS hashes differently and is parsed again.
+ *
+ *                  Entries are named the way kacanopen names them (lower
+ *                  case, spaces and dashes as underscores, "array/element"
+ *                  for array and record members), so topics and
+ *                  can_topology.yaml are unaffected.
+ ***************************************************************************************/
+#ifndef EDS_CACHE_H
+#define EDS_CACHE_H
+
+#include "device.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tfr_can
+{
+    struct EdsEntry
+    {
+        enum Access : uint8_t
+        {
+            READ_ONLY,
+            WRITE_ONLY,
+            READ_WRITE,
+            CONSTANT
+        };
+
+        uint16_t index;
+        uint8_t subindex;
+        uint16_t data_type;     // CiA 301 data type code, e.g. 0x0007 for UNSIGNED32
+        Access access;
+        std::string name;
+    };
+
+    using EdsDictionary = std::vector<EdsEntry>;
+
+    class EdsCache
+    {
+    public:
+        /*
+         * Binary copies are kept in directory, which is created if needed.
+         * An empty directory keeps them in memory only.
+         * */
+        explicit EdsCache(const std::string& directory);
+
+        /*
+         * The dictionary described by the EDS at path, or nullptr, after
+         * logging why, if it can't be read.
+         * */
+        std::shared_ptr<const EdsDictionary> load(const std::string& path);
+
+        /*
+         * Adds the entries to the device's dictionary, standing in for
+         * load_dictionary_from_eds. Entries of types kacanopen doesn't
+         * support are skipped, as it would.
+         * */
+        static void apply(const EdsDictionary& dictionary, kaco::Device& device);
+
+        /*
+         * The default place for the binary copies, $ROS_HOME/tfr_can_eds
+         * (~/.ros/tfr_can_eds).
+         * */
+        static std::string defaultDirectory();
+
+    private:
+        const std::string directory;
+        std::map<uint64_t, std::shared_ptr<const EdsDictionary>> loaded;
+
+        std::string cachePath(uint64_t hash) const;
+        bool readCache(uint64_t hash, EdsDictionary& dictionary) const;
+        void writeCache(uint64_t hash, const EdsDictionary& dictionary) const;
+    };
+
+    /*
+     * Parses the text of an EDS file. Returns false if it has no objects.
+     * */
+    bool parseEds(const std::string& text, EdsDictionary& dictionary);
+}
+
+#endif // EDS_CACHE_H
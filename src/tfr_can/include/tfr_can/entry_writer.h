@@ -0,0 +1,49 @@
+/****************************************************************************************
+ * File:            entry_writer.h
+ *
+ * Purpose:         Drop in replacement for kaco::EntrySubscriber that
+ *                  subscribes through a given NodeHandle.
+ *
+ *                  kaco::EntrySubscriber always subscribes on the global
+ *                  callback queue, so a write stuck waiting on one bus holds
+ *                  up the writes to every other bus. Each CanBus hands its
+ *                  writers a NodeHandle on its own queue instead. Same
+ *                  "deviceN/set_<entry>" topic, same message type.
+ *
+ * Subscribes To:   /deviceN/set_<entry>
+ ***************************************************************************************/
+#ifndef ENTRY_WRITER_H
+#define ENTRY_WRITER_H
+
+#include "subscriber.h"
+#include "device.h"
+
+#include <ros/ros.h>
+#include <string>
+
+namespace tfr_can
+{
+    class EntryWriter : public kaco::Subscriber
+    {
+    public:
+        EntryWriter(kaco::Device& device, const std::string& entry_name, ros::NodeHandle& n,
+                kaco::WriteAccessMethod access_method = kaco::WriteAccessMethod::use_default);
+
+        void advertise() override;
+
+    private:
+        kaco::Device& device;
+        const std::string entry_name;
+        const std::string topic_name;
+        const kaco::WriteAccessMethod access_method;
+        ros::NodeHandle& node;
+        ros::Subscriber subscriber;
+
+        template <typename Msg, typename T>
+        void receive(const typename Msg::ConstPtr& msg);
+
+        void write(const kaco::Value& value);
+    };
+}
+
+#endif // ENTRY_WRITER_H
@@ -0,0 +1,76 @@
+/****************************************************************************************
+ * File:            frame_recorder.h
+ *
+ * Purpose:         Records every frame on the bus, received and sent, to a
+ *                  can_log.h log so a bad run can be looked at, and replayed
+ *                  with can_replay, after the fact.
+ *
+ *                  Like BusMonitor, the recorder listens on its own raw
+ *                  socket, which kacanopen's frames are looped back to. The
+ *                  log is memory mapped and grown a chunk at a time, so
+ *                  recording a frame is a copy into the page cache and never
+ *                  waits on the disk.
+ ***************************************************************************************/
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include "can_log.h"
+#include "socket_can.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace tfr_can
+{
+    class FrameRecorder
+    {
+    public:
+        FrameRecorder(const std::string& busname, const std::string& path);
+        ~FrameRecorder();
+        FrameRecorder(const FrameRecorder&) = delete;
+        FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+        /*
+         * Creates the log and starts recording. Logs and returns false if
+         * either the log or the socket can't be opened.
+         * */
+        bool start();
+
+        /*
+         * Stops recording and trims the log to the frames recorded.
+         * */
+        void stop();
+
+        /*
+         * A log name for a recording of the bus started now,
+         * can_<bus>_<date>-<time>.canlog in the given directory.
+         * */
+        static std::string defaultPath(const std::string& directory, const std::string& busname);
+
+    private:
+        // how much the log grows by when it fills up, 16MB
+        static const size_t CHUNK_RECORDS = (16 << 20) / sizeof(CanLogRecord);
+
+        const std::string busname;
+        const std::string path;
+
+        SocketCan socket;
+        std::thread record_thread;
+        std::atomic<bool> running;
+
+        int fd;
+        void* mapping;
+        size_t capacity;    // records that fit in the mapping
+
+        bool openLog();
+        bool grow();
+        void closeLog();
+        void record();
+
+        CanLogHeader& header();
+        CanLogRecord* records();
+    };
+}
+
+#endif // FRAME_RECORDER_H
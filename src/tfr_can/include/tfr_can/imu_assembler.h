@@ -0,0 +1,146 @@
+/****************************************************************************************
+ * File:            imu_assembler.h
+ *
+ * Purpose:         Puts the LPMS-CU2's readings back together into one
+ *                  sensor_msgs/Imu per sample.
+ *
+ *                  The IMU sends each reading as its own dictionary entry,
+ *                  two to a TPDO, and whatever isn't in its fixed mapping is
+ *                  polled over SDO. Published one topic per entry, a
+ *                  subscriber can't tell which readings belong together, so
+ *                  an orientation built from them mixes samples. Here every
+ *                  reading of the device is fed in as it is decoded, from
+ *                  the PDO receive thread or the poll thread:
+ *                  - a sample starts with the first reading after the last
+ *                    one ended, and is stamped with when that reading was
+ *                    taken, its SYNC or else its arrival,
+ *                  - it ends once every configured reading has arrived, or
+ *                    when one arrives a second time,
+ *                  - readings are used in groups (gyroscope, euler angles,
+ *                    linear acceleration, quaternion). A group only goes
+ *                    into the message when all of it arrived in the same
+ *                    sample, otherwise the group's last whole set is kept,
+ *                    so a quaternion is never torn.
+ *                  A sample is published once every configured group has
+ *                  been whole at least once, at whatever rate the IMU
+ *                  delivers them.
+ *
+ *                  The LPMS reports degrees and g, the message has radians
+ *                  and m/s^2. Without the quaternion entries the orientation
+ *                  is made from the euler angles (roll, pitch, yaw about x, y
+ *                  and z), and without either its covariance is -1, as for
+ *                  any missing part of a sensor_msgs/Imu.
+ *
+ * Publishes To:    ImuConfig::topic (sensor_msgs/Imu), device120/imu by default
+ ***************************************************************************************/
+#ifndef IMU_ASSEMBLER_H
+#define IMU_ASSEMBLER_H
+
+#include "can_topology.h"
+
+#include <ros/ros.h>
+#include <sensor_msgs/Imu.h>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace tfr_can
+{
+    class ImuAssembler
+    {
+    public:
+        enum Field : uint8_t
+        {
+            GYROSCOPE_X,
+            GYROSCOPE_Y,
+            GYROSCOPE_Z,
+            EULER_X,
+            EULER_Y,
+            EULER_Z,
+            LINEAR_ACCELERATION_X,
+            LINEAR_ACCELERATION_Y,
+            LINEAR_ACCELERATION_Z,
+            QUATERNION_W,
+            QUATERNION_X,
+            QUATERNION_Y,
+            QUATERNION_Z,
+            FIELDS
+        };
+
+        /*
+         * Which reading an LPMS entry such as "quaternion_w" is. Returns
+         * false for entries that aren't part of a sample.
+         * */
+        static bool field(const std::string& entry_name, Field& field);
+
+        /*
+         * The reading in an entry's 32 bits. The LPMS's entries are IEEE
+         * floats, whatever type its EDS gives them.
+         * */
+        static float reading(uint32_t bits)
+        {
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        ImuAssembler(ros::NodeHandle& n, const ImuConfig& config);
+        ImuAssembler(const ImuAssembler&) = delete;
+        ImuAssembler& operator=(const ImuAssembler&) = delete;
+
+        /*
+         * Adds a reading to the ones that make up a sample. Call for every
+         * configured entry before the first update().
+         * */
+        void expect(Field field);
+
+        /*
+         * A reading as the LPMS sent it, taken at stamp. Safe from any
+         * thread.
+         * */
+        void update(Field field, float value, const ros::Time& stamp);
+
+        /*
+         * A reading taken as it arrives.
+         * */
+        void update(Field field, float value)
+        {
+            update(field, value, ros::Time::now());
+        }
+
+        /*
+         * Samples that ended with a group only partly there.
+         * */
+        uint64_t tornSamples() const;
+
+    private:
+        enum Group : uint8_t
+        {
+            GYROSCOPE,
+            EULER,
+            LINEAR_ACCELERATION,
+            QUATERNION,
+            GROUPS
+        };
+
+        const ImuConfig config;
+        ros::Publisher publisher;
+
+        mutable std::mutex mutex;
+        uint32_t expected;
+        uint32_t received;
+        uint32_t whole;     // groups that have been whole at least once
+        ros::Time stamp;
+        float pending[FIELDS];
+        float values[FIELDS];
+        uint64_t torn;
+        sensor_msgs::Imu msg;
+
+        static uint32_t groupMask(Group group);
+        void endSample();
+        void fillOrientation();
+    };
+}
+
+#endif // IMU_ASSEMBLER_H
@@ -0,0 +1,66 @@
+/****************************************************************************************
+ * File:            monitored_entry_publisher.h
+ *
+ * Purpose:         Drop in replacement for kaco::EntryPublisher that records
+ *                  how long each request takes, and how often it fails, into
+ *                  an EntryStats.
+ *
+ *                  kaco::EntryPublisher logs and swallows SDO errors, so there
+ *                  is no way to count them from the outside. This publishes on
+ *                  the same "deviceN/get_<entry>" topic with the same message
+ *                  type, so subscribers can't tell the difference.
+ *
+ *                  Integer values are also written to a CanSnapshot slot, in
+ *                  which case the topic is optional. Readings that are part
+ *                  of an IMU sample go to its ImuAssembler instead of either.
+ *
+ * Publishes To:    /deviceN/get_<entry>
+ ***************************************************************************************/
+#ifndef MONITORED_ENTRY_PUBLISHER_H
+#define MONITORED_ENTRY_PUBLISHER_H
+
+#include "publisher.h"
+#include "device.h"
+#include "bus_monitor.h"
+#include "imu_assembler.h"
+
+#include <ros/ros.h>
+#include <tfr_utilities/can_snapshot.h>
+#include <memory>
+#include <string>
+
+namespace tfr_can
+{
+    class MonitoredEntryPublisher : public kaco::Publisher
+    {
+    public:
+        MonitoredEntryPublisher(kaco::Device& device, const std::string& entry_name,
+                std::shared_ptr<EntryStats> stats, int max_retries,
+                tfr_utilities::CanSnapshot::Slot* shared = nullptr,
+                bool publish_topic = true,
+                ImuAssembler* imu = nullptr,
+                kaco::ReadAccessMethod access_method = kaco::ReadAccessMethod::use_default);
+
+        void advertise() override;
+        void publish() override;
+
+    private:
+        kaco::Device& device;
+        const std::string entry_name;
+        const std::string topic_name;
+        const kaco::ReadAccessMethod access_method;
+        const int max_retries;
+        std::shared_ptr<EntryStats> stats;
+        tfr_utilities::CanSnapshot::Slot* const shared;
+        const bool publish_topic;
+        ImuAssembler* const imu;
+        ImuAssembler::Field imu_field;
+        kaco::Type type;
+        ros::Publisher publisher;
+
+        void writeSnapshot(const kaco::Value& value);
+        void publishValue(const kaco::Value& value);
+    };
+}
+
+#endif // MONITORED_ENTRY_PUBLISHER_H
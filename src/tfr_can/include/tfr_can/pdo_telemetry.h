@@ -0,0 +1,185 @@
+/****************************************************************************************
+ * File:            pdo_telemetry.h
+ *
+ * Purpose:         Bulk telemetry for the CAN bridge. Instead of polling every
+ *                  entry over SDO, the transmit PDOs of each device are mapped
+ *                  to carry the entries we care about. The bridge sends a SYNC
+ *                  at a fixed period, every device samples its mapped entries
+ *                  at that instant, and the resulting frames are decoded here
+ *                  onto the same "deviceN/get_<entry>" topics the SDO
+ *                  publishers use, and into the shared CanSnapshot.
+ *
+ *                  Entries that do not fit into a device's four TPDOs are
+ *                  handed back to the caller so they can keep being polled.
+ *
+ *                  An IMU's readings go to its ImuAssembler instead of their
+ *                  own topics, see setImu().
+ *
+ *                  Samples from a PDO that transmits on SYNC are stamped with
+ *                  the time that SYNC went out, which is when the device took
+ *                  them, in the snapshot and on the stamped topics alike.
+ *                  Those from event driven PDOs are stamped on arrival.
+ *
+ * Publishes To:    /deviceN/get_<entry> for every mapped entry
+ *                  /deviceN/get_<entry>/stamped (tfr_msgs/CanSample) the same,
+ *                      with the time it was sampled
+ ***************************************************************************************/
+#ifndef PDO_TELEMETRY_H
+#define PDO_TELEMETRY_H
+
+#include "core.h"
+#include "device.h"
+#include "imu_assembler.h"
+#include "types.h"
+
+#include <ros/ros.h>
+#include <tfr_msgs/CanSample.h>
+#include <tfr_utilities/can_snapshot.h>
+#include <tfr_utilities/seqlock.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tfr_can
+{
+    /*
+     * One object dictionary entry that can be carried by a PDO.
+     * */
+    struct PdoField
+    {
+        std::string entry_name;
+        uint16_t index;
+        uint8_t subindex;
+        kaco::Type type;
+    };
+
+    /*
+     * Looks up the dictionary location of a Roboteq query such as
+     * "qry_abcntr/channel_2". Returns false for entries we don't know how to map.
+     * */
+    bool roboteqField(const std::string& entry_name, PdoField& field);
+
+    /*
+     * Looks up the dictionary location of an LPMS-CU2 entry such as
+     * "quaternion_w". Returns false for entries we don't know how to map.
+     * */
+    bool lpmsField(const std::string& entry_name, PdoField& field);
+
+    /*
+     * Size of a field inside of a PDO in bits.
+     * */
+    uint8_t fieldBits(kaco::Type type);
+
+    class PdoTelemetry
+    {
+    public:
+        PdoTelemetry(kaco::Core& core, ros::NodeHandle& n,
+                std::chrono::milliseconds sync_period);
+        ~PdoTelemetry();
+        PdoTelemetry(const PdoTelemetry&) = delete;
+        PdoTelemetry& operator=(const PdoTelemetry&) = delete;
+        PdoTelemetry(PdoTelemetry&&) = delete;
+        PdoTelemetry& operator=(PdoTelemetry&&) = delete;
+
+        /*
+         * Rewrites the transmit PDO mapping of the device so that it carries
+         * the given fields, packed in order into as few PDOs as possible. All
+         * PDOs are set to transmit on every SYNC.
+         *
+         * Returns the fields that did not fit, which must be polled instead.
+         * */
+        std::vector<PdoField> mapTransmitPdos(kaco::Device& device,
+                const std::vector<PdoField>& fields);
+
+        /*
+         * For devices whose mapping is fixed by vendor software (the LPMS
+         * IMU), reads back the current TPDO mapping and decodes whichever of
+         * the given fields it contains.
+         *
+         * Returns the fields that are not transmitted, which must be polled
+         * instead.
+         * */
+        std::vector<PdoField> useExistingTransmitPdos(kaco::Device& device,
+                const std::vector<PdoField>& fields);
+
+        /*
+         * Where decoded values are written, and whether they are also
+         * published on their topics. Call before mapping any devices.
+         * */
+        void setSnapshot(tfr_utilities::CanSnapshot* snapshot, bool publish_topics);
+
+        /*
+         * Hands the readings of the device that make up an IMU sample to
+         * imu, which must outlive this. Call before mapping the device.
+         * */
+        void setImu(uint8_t node_id, ImuAssembler* imu);
+
+        /*
+         * Starts producing SYNC frames. Call once all devices are mapped.
+         * */
+        void start();
+
+        /*
+         * Stops producing SYNC frames.
+         * */
+        void stop();
+
+    private:
+        struct Slot
+        {
+            PdoField field;
+            uint8_t offset; // in bytes
+            ros::Publisher publisher;
+            ros::Publisher stamped_publisher;
+            tfr_utilities::CanSnapshot::Slot* shared;
+            // the field goes here instead, if it is part of an IMU sample
+            ImuAssembler* imu;
+            ImuAssembler::Field imu_field;
+        };
+
+        struct MappedPdo
+        {
+            uint8_t node_id;
+            uint16_t cob_id;
+            // sent in answer to a SYNC, rather than when its values change
+            bool synchronous;
+            std::vector<Slot> slots;
+        };
+
+        kaco::Core& core;
+        ros::NodeHandle& node;
+        const std::chrono::milliseconds sync_period;
+        tfr_utilities::CanSnapshot* snapshot;
+        bool publish_topics;
+        std::map<uint8_t, ImuAssembler*> imus;
+
+        // std::list so the pointers captured by the receive callbacks stay valid
+        std::list<MappedPdo> pdos;
+
+        std::thread sync_thread;
+        std::atomic<bool> running;
+
+        // when the latest SYNC went out, on the snapshot's clock and ROS's
+        struct SyncTime
+        {
+            uint64_t monotonic;
+            uint64_t ros;
+        };
+        tfr_utilities::SeqLock<SyncTime> last_sync;
+
+        void writeTransmitPdo(uint8_t node_id, uint8_t pdo_number,
+                const std::vector<PdoField>& fields);
+        void registerPdo(kaco::Device& device, uint8_t pdo_number,
+                const std::vector<PdoField>& fields, bool synchronous);
+        void decode(const MappedPdo& pdo, const std::vector<uint8_t>& data);
+        void produceSync();
+    };
+}
+
+#endif // PDO_TELEMETRY_H
@@ -0,0 +1,82 @@
+/****************************************************************************************
+ * File:            poll_scheduler.h
+ *
+ * Purpose:         Polls publishers at their own rates from a single thread.
+ *
+ *                  kaco::Bridge starts one thread per publisher, so every
+ *                  entry competes for the bus at the same time no matter how
+ *                  often it is needed. SDO transfers are serialized on the bus
+ *                  anyway, so instead we keep every publisher in one
+ *                  earliest-deadline-first queue and poll them back to back.
+ *                  Fast entries (encoders) get polled more often than slow
+ *                  ones (currents), and a publisher that falls behind skips
+ *                  the periods it missed rather than bursting to catch up.
+ ***************************************************************************************/
+#ifndef POLL_SCHEDULER_H
+#define POLL_SCHEDULER_H
+
+#include "publisher.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace tfr_can
+{
+    class PollScheduler
+    {
+    public:
+        PollScheduler();
+        ~PollScheduler();
+        PollScheduler(const PollScheduler&) = delete;
+        PollScheduler& operator=(const PollScheduler&) = delete;
+        PollScheduler(PollScheduler&&) = delete;
+        PollScheduler& operator=(PollScheduler&&) = delete;
+
+        /*
+         * Advertises the publisher and polls it at the given rate once started.
+         * Must be called before start().
+         * */
+        void add(std::shared_ptr<kaco::Publisher> publisher, double rate);
+
+        /*
+         * Starts polling on a background thread.
+         * */
+        void start();
+
+        /*
+         * Stops polling and joins the background thread.
+         * */
+        void stop();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Task
+        {
+            std::shared_ptr<kaco::Publisher> publisher;
+            Clock::duration period;
+            Clock::time_point deadline;
+        };
+
+        // orders the queue so the earliest deadline is on top
+        struct LaterDeadline
+        {
+            bool operator()(const Task& a, const Task& b) const
+            {
+                return a.deadline > b.deadline;
+            }
+        };
+
+        std::vector<Task> tasks;
+        std::thread thread;
+        std::atomic<bool> running;
+
+        void run();
+    };
+}
+
+#endif // POLL_SCHEDULER_H
@@ -0,0 +1,98 @@
+/****************************************************************************************
+ * File:            simulated_devices.h
+ *
+ * Purpose:         The devices on the rover's CAN bus, for can_simulator.
+ *
+ *                  SimulatedRoboteq stands in for the SDC3260/SBL2360 motor
+ *                  controllers. Each channel is a motor whose speed follows
+ *                  cmd_cango through a first order lag, whose position is
+ *                  reported by qry_abcntr and stops at its travel limits, and
+ *                  whose current rises with load and at stall. Like the real
+ *                  controllers, motors stop when commands stop arriving.
+ *
+ *                  SimulatedLpms stands in for the LPMS-CU2 IMU. Its yaw rate
+ *                  and forward acceleration follow whatever motion it is
+ *                  given, normally the simulated treads.
+ ***************************************************************************************/
+#ifndef SIMULATED_DEVICES_H
+#define SIMULATED_DEVICES_H
+
+#include "simulated_node.h"
+
+#include <random>
+#include <vector>
+
+namespace tfr_can
+{
+    struct MotorModel
+    {
+        double max_speed;       // [counts/s] at a command of 1000
+        double time_constant;   // [s]
+        double min_position;    // [counts] travel limits, ignored if min >= max
+        double max_position;
+        double free_amps;       // [A] drawn when moving without load
+        double stall_amps;      // [A] drawn at full command against a limit
+        uint8_t encoder;        // qry_abcntr channel the motor's position shows up on
+    };
+
+    class SimulatedRoboteq : public SimulatedNode
+    {
+    public:
+        /*
+         * One channel per motor. watchdog is how long a command is held
+         * before the motors stop, as the controller's RWD setting.
+         * */
+        SimulatedRoboteq(uint8_t node_id, const std::string& device_name,
+                const std::vector<MotorModel>& motors, double watchdog);
+
+        /*
+         * Speed of a motor in counts/s, channels count from 1.
+         * */
+        double speed(uint8_t channel) const;
+
+    protected:
+        void entryWritten(uint16_t index, uint8_t subindex) override;
+        void update(double dt) override;
+
+    private:
+        struct Motor
+        {
+            MotorModel model;
+            double command;
+            double speed;
+            double position;
+        };
+
+        std::vector<Motor> motors;
+        const double watchdog;
+        double since_command;
+    };
+
+    class SimulatedLpms : public SimulatedNode
+    {
+    public:
+        /*
+         * rate is how often the IMU sends its readings, in Hz.
+         * */
+        SimulatedLpms(uint8_t node_id, double rate);
+
+        /*
+         * How the rover is moving: yaw rate in rad/s and forward
+         * acceleration in m/s^2.
+         * */
+        void setMotion(double yaw_rate, double forward_acceleration);
+
+    protected:
+        void update(double dt) override;
+
+    private:
+        double yaw_rate;
+        double forward_acceleration;
+        double yaw;
+        std::mt19937 generator;
+        std::normal_distribution<double> gyro_noise;
+        std::normal_distribution<double> acceleration_noise;
+    };
+}
+
+#endif // SIMULATED_DEVICES_H
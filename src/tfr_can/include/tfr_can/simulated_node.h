@@ -0,0 +1,134 @@
+/****************************************************************************************
+ * File:            simulated_node.h
+ *
+ * Purpose:         A CANopen slave with just enough of CiA 301 for kacanopen
+ *                  and the bridge: NMT and node guarding, heartbeat, expedited
+ *                  and segmented SDO, transmit PDOs that can be remapped
+ *                  and sent on SYNC or on a timer, and receive PDOs with
+ *                  fixed COB-IDs and a mapping that can be changed.
+ *
+ *                  Subclasses fill in the object dictionary and update it
+ *                  from a physical model every step, see simulated_devices.h.
+ *                  Nothing here touches a socket, frames are passed in and
+ *                  handed back, so a whole bus can be simulated on one thread.
+ ***************************************************************************************/
+#ifndef SIMULATED_NODE_H
+#define SIMULATED_NODE_H
+
+#include <linux/can.h>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tfr_can
+{
+    class SimulatedNode
+    {
+    public:
+        SimulatedNode(uint8_t node_id, const std::string& device_name);
+        virtual ~SimulatedNode() = default;
+
+        uint8_t nodeId() const;
+
+        /*
+         * Sends the boot-up message. Call once the node is on the bus.
+         * */
+        void boot(std::vector<can_frame>& out);
+
+        /*
+         * Handles one frame from the bus, appending any replies to out.
+         * */
+        void receive(const can_frame& frame, std::vector<can_frame>& out);
+
+        /*
+         * Advances the model by dt seconds, appending any frames that came
+         * due (heartbeats, timer driven PDOs) to out.
+         * */
+        void step(double dt, std::vector<can_frame>& out);
+
+    protected:
+        enum class Access
+        {
+            READ_ONLY,
+            WRITE_ONLY,
+            READ_WRITE
+        };
+
+        /*
+         * Integer entries are stored little endian in the given number of
+         * bytes. Strings can only be read.
+         * */
+        void addEntry(uint16_t index, uint8_t subindex, uint8_t size, Access access,
+                int64_t initial = 0);
+        void addStringEntry(uint16_t index, uint8_t subindex, const std::string& value);
+
+        uint64_t getUnsigned(uint16_t index, uint8_t subindex) const;
+        int64_t getSigned(uint16_t index, uint8_t subindex) const;
+        void setInteger(uint16_t index, uint8_t subindex, int64_t value);
+        // stores the bits of a float, the way the LPMS reports its readings
+        void setFloat(uint16_t index, uint8_t subindex, float value);
+
+        /*
+         * Sets up a transmit PDO the way the device ships. mapping holds
+         * CiA 301 mapping words (index << 16 | subindex << 8 | bits).
+         * */
+        void setTransmitPdo(uint8_t pdo, uint8_t transmission_type,
+                uint16_t event_timer_ms, const std::vector<uint32_t>& mapping);
+
+        bool operational() const;
+
+        /*
+         * Called after the master wrote an entry over SDO or a receive PDO.
+         * */
+        virtual void entryWritten(uint16_t index, uint8_t subindex) {}
+
+        /*
+         * Advances the physical model.
+         * */
+        virtual void update(double dt) = 0;
+
+    private:
+        static const uint8_t NUM_TPDOS = 4;
+        static const uint8_t NUM_RPDOS = 4;
+
+        struct Entry
+        {
+            std::vector<uint8_t> data;
+            Access access;
+            bool is_string;
+        };
+
+        struct Segmented
+        {
+            bool active;
+            bool toggle;
+            uint32_t key;
+            size_t offset;
+        };
+
+        const uint8_t node_id;
+        std::map<uint32_t, Entry> dictionary;
+        uint8_t nmt_state;
+        bool guard_toggle;
+        Segmented upload;
+        double heartbeat_elapsed;
+        uint32_t sync_count;
+        double pdo_elapsed[NUM_TPDOS];
+
+        static uint32_t key(uint16_t index, uint8_t subindex);
+        Entry* find(uint16_t index, uint8_t subindex);
+        const Entry* find(uint16_t index, uint8_t subindex) const;
+
+        void handleNmt(const can_frame& frame, std::vector<can_frame>& out);
+        void handleSdo(const can_frame& frame, std::vector<can_frame>& out);
+        void handleSync(std::vector<can_frame>& out);
+        bool handleReceivePdo(const can_frame& frame);
+        void sendTransmitPdo(uint8_t pdo, std::vector<can_frame>& out);
+        can_frame sdoAbort(uint16_t index, uint8_t subindex, uint32_t code) const;
+        can_frame frame(uint32_t cob_id, std::initializer_list<uint8_t> data) const;
+    };
+}
+
+#endif // SIMULATED_NODE_H
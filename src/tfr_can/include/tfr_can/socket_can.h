@@ -0,0 +1,50 @@
+/****************************************************************************************
+ * File:            socket_can.h
+ *
+ * Purpose:         A raw SocketCAN socket, for the parts of tfr_can that talk
+ *                  to the bus directly instead of through kacanopen: the bus
+ *                  monitor, the frame recorder and the simulator.
+ ***************************************************************************************/
+#ifndef SOCKET_CAN_H
+#define SOCKET_CAN_H
+
+#include <linux/can.h>
+#include <chrono>
+#include <string>
+
+namespace tfr_can
+{
+    class SocketCan
+    {
+    public:
+        SocketCan();
+        ~SocketCan();
+        SocketCan(const SocketCan&) = delete;
+        SocketCan& operator=(const SocketCan&) = delete;
+
+        /*
+         * Binds to the named interface. With receive_errors the socket is
+         * also handed error frames. Logs and returns false on failure.
+         * */
+        bool open(const std::string& busname, bool receive_errors = false);
+
+        void close();
+
+        bool isOpen() const;
+
+        bool send(const struct can_frame& frame);
+
+        /*
+         * Waits up to timeout for a frame. Returns false if none arrived.
+         * If local is given it is set to whether the frame was sent from
+         * this machine (by another socket) rather than received off the bus.
+         * */
+        bool receive(struct can_frame& frame, std::chrono::microseconds timeout,
+                bool* local = nullptr);
+
+    private:
+        int socket_fd;
+    };
+}
+
+#endif // SOCKET_CAN_H
@@ -0,0 +1,163 @@
+#include "bus_monitor.h"
+
+#include <linux/can/error.h>
+
+namespace tfr_can
+{
+    // below this fraction of its configured rate an entry is falling behind
+    const double RATE_TOLERANCE = 0.9;
+
+    uint32_t parseBaudrate(const std::string& baudrate)
+    {
+        double value = std::stod(baudrate);
+        if (baudrate.back() == 'K' || baudrate.back() == 'k')
+            value *= 1000;
+        else if (baudrate.back() == 'M' || baudrate.back() == 'm')
+            value *= 1000000;
+        return static_cast<uint32_t>(value);
+    }
+
+    uint32_t frameBits(uint8_t length)
+    {
+        // SOF through CRC is subject to bit stuffing: 34 bits of header plus the data
+        const uint32_t stuffed = 34 + 8 * length;
+        // CRC delimiter, ACK, EOF and interframe space are not
+        const uint32_t fixed = 13;
+        return stuffed + fixed + (stuffed - 1) / 4;
+    }
+
+    BusMonitor::BusMonitor(ros::NodeHandle& n, const std::string& bus, uint32_t rate) :
+        busname{bus},
+        bitrate{rate},
+        diagnostics_publisher{n.advertise<tfr_msgs::CanBusStats>("diagnostics", 5)},
+        diagnostics_timer{n.createTimer(ros::Duration(1.0), &BusMonitor::publishDiagnostics, this)},
+        window_start{ros::Time::now()},
+        first_window{true},
+        running{false},
+        frames{0},
+        error_frames{0},
+        bits{0}
+    {
+        stats_msg.bus = busname;
+    }
+
+    BusMonitor::~BusMonitor()
+    {
+        stop();
+    }
+
+    std::shared_ptr<EntryStats> BusMonitor::addEntry(uint8_t node_id, const std::string& entry,
+            double rate)
+    {
+        auto stats = std::make_shared<EntryStats>(node_id, entry, rate);
+        std::lock_guard<std::mutex> lock(entries_mutex);
+        entries.push_back(stats);
+        stats_msg.entries.resize(entries.size());
+        return stats;
+    }
+
+    double BusMonitor::pollingLoad()
+    {
+        std::lock_guard<std::mutex> lock(entries_mutex);
+        double bits_per_second = 0;
+        for (const auto& stats : entries)
+            bits_per_second += stats->rate * 2 * frameBits(8);
+        return 100.0 * bits_per_second / bitrate;
+    }
+
+    bool BusMonitor::start()
+    {
+        // we want to see error frames too
+        if (!socket.open(busname, true))
+            return false;
+        running = true;
+        receive_thread = std::thread(&BusMonitor::receive, this);
+        return true;
+    }
+
+    void BusMonitor::stop()
+    {
+        running = false;
+        if (receive_thread.joinable())
+            receive_thread.join();
+        socket.close();
+    }
+
+    /*
+     * Frames sent by other sockets on this machine (kacanopen's) are looped
+     * back to us, so this sees both directions of traffic.
+     * */
+    void BusMonitor::receive()
+    {
+        struct can_frame frame;
+        while (running)
+        {
+            // wake up regularly so stop() doesn't hang on a quiet bus
+            if (!socket.receive(frame, std::chrono::milliseconds(100)))
+                continue;
+
+            if (frame.can_id & CAN_ERR_FLAG)
+            {
+                error_frames.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            frames.fetch_add(1, std::memory_order_relaxed);
+            bits.fetch_add(frameBits(frame.can_dlc), std::memory_order_relaxed);
+        }
+    }
+
+    void BusMonitor::publishDiagnostics(const ros::TimerEvent& event)
+    {
+        const ros::Time now = ros::Time::now();
+        const double window = (now - window_start).toSec();
+        window_start = now;
+        if (window <= 0)
+            return;
+
+        stats_msg.header.stamp = now;
+        stats_msg.window = window;
+        stats_msg.frames = static_cast<uint32_t>(frames.exchange(0));
+        stats_msg.error_frames = static_cast<uint32_t>(error_frames.exchange(0));
+        stats_msg.load = 100.0 * bits.exchange(0) / (bitrate * window);
+
+        {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            size_t behind = 0;
+            const EntryStats* slowest = nullptr;
+            double slowest_fraction = 1;
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                auto& stats = *entries[i];
+                auto& msg = stats_msg.entries[i];
+                msg.node_id = stats.node_id;
+                msg.entry = stats.entry;
+                msg.rate = stats.rate;
+                msg.achieved_rate = stats.polls.exchange(0) / window;
+                if (msg.rate > 0 && msg.achieved_rate < RATE_TOLERANCE * msg.rate)
+                {
+                    behind++;
+                    if (msg.achieved_rate / msg.rate < slowest_fraction)
+                    {
+                        slowest = &stats;
+                        slowest_fraction = msg.achieved_rate / msg.rate;
+                    }
+                }
+                msg.requests = static_cast<uint32_t>(stats.latency.count());
+                msg.errors = stats.errors.exchange(0);
+                msg.retries = stats.retries.exchange(0);
+                msg.p50 = stats.latency.percentile(50) * 1e-9;
+                msg.p99 = stats.latency.percentile(99) * 1e-9;
+                msg.max = stats.latency.max() * 1e-9;
+                stats.latency.reset();
+            }
+            if (behind > 0 && !first_window)
+                ROS_WARN_STREAM_THROTTLE(10.0, "tfr_can: " << behind << " entries on " << busname
+                        << " are polled below their configured rate, device"
+                        << static_cast<int>(slowest->node_id) << "/" << slowest->entry
+                        << " at " << static_cast<int>(100 * slowest_fraction)
+                        << "% of " << slowest->rate << " Hz, lower the rates in can_topology.yaml");
+        }
+        first_window = false;
+        diagnostics_publisher.publish(stats_msg);
+    }
+}
@@ -0,0 +1,142 @@
+#include "can_bridge.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+namespace tfr_can
+{
+    // The rover's bus, overridden with ~busname (e.g. "vcan0" for can_simulator)
+    // or ~buses
+    const std::string default_busname = "can1";
+
+    // Most drivers support the values "1M", "500K", "125K", "100K", "50K",
+    // "20K", "10K" and "5K".
+    const std::string default_baudrate = "250K";
+
+    CanBridge::CanBridge(ros::NodeHandle& n, ros::NodeHandle& private_n) :
+        node{n},
+        private_node{private_n}
+    {}
+
+    CanBridge::~CanBridge()
+    {
+        stop();
+    }
+
+    bool CanBridge::start()
+    {
+        std::string eds_files_path;
+        if (private_node.getParamCached("eds_files_path", eds_files_path))
+        {
+            PRINT("Loading EDS files from " << eds_files_path);
+        }
+        else
+        {
+            ERROR("tfr_can could not find the private parameter 'eds_files_path'. Make sure this parameter is getting set in the launch file for tfr_can.");
+        }
+
+        std::vector<BusConfig> bus_configs;
+        if (!loadBuses(private_node, "buses", bus_configs) || !loadTopology(private_node, "devices", topology))
+        {
+            return false;
+        }
+        if (bus_configs.empty())
+        {
+            BusConfig bus;
+            private_node.param<std::string>("busname", bus.name, default_busname);
+            private_node.param<std::string>("baudrate", bus.baudrate, default_baudrate);
+            bus_configs.push_back(bus);
+        }
+
+        // Parse each EDS before the buses come up, so devices are set up as soon as they are found
+        std::string eds_cache_directory;
+        private_node.param<std::string>("eds_cache_directory", eds_cache_directory,
+                EdsCache::defaultDirectory());
+        EdsCache eds_cache{eds_cache_directory};
+        std::map<int, std::shared_ptr<const EdsDictionary>> dictionaries;
+        for (const auto& config : topology)
+        {
+            dictionaries[config.node_id] = eds_cache.load(eds_files_path + config.eds_file);
+        }
+
+        BusOptions options;
+        double discovery_timeout;
+        int pdo_sync_period_ms;
+        private_node.param<double>("discovery_timeout", discovery_timeout, 2.0);
+        private_node.param<int>("sdo_retries", options.sdo_retries, 1);
+        private_node.param<bool>("publish_topics", options.publish_topics, true);
+        private_node.param<bool>("use_pdo_telemetry", options.use_pdo_telemetry, false);
+        private_node.param<int>("pdo_sync_period_ms", pdo_sync_period_ms, 10);
+        private_node.param<std::string>("record_directory", options.record_directory, "");
+        int command_period_ms, command_keep_alive_ms;
+        private_node.param<bool>("coalesce_commands", options.coalesce_commands, false);
+        private_node.param<int>("command_period_ms", command_period_ms, 10);
+        private_node.param<int>("command_keep_alive_ms", command_keep_alive_ms, 200);
+        options.discovery_timeout = std::chrono::duration<double>(discovery_timeout);
+        options.pdo_sync_period = std::chrono::milliseconds(pdo_sync_period_ms);
+        options.command_period = std::chrono::milliseconds(command_period_ms);
+        options.command_keep_alive = std::chrono::milliseconds(command_keep_alive_ms);
+        if (!snapshot.isOpen() && !options.publish_topics)
+        {
+            ERROR("tfr_can: the shared snapshot is unavailable, publishing topics anyway.");
+            options.publish_topics = true;
+        }
+        // whatever a previous bridge left there is not ours
+        snapshot.clear();
+
+        // Devices go on the bus they name, or the first one
+        for (const auto& device : topology)
+        {
+            auto bus = std::find_if(bus_configs.begin(), bus_configs.end(),
+                [&](const BusConfig& b) { return device.bus.empty() || b.name == device.bus; });
+            if (bus == bus_configs.end())
+            {
+                ERROR("tfr_can: device " << device.node_id << " is on " << device.bus << ", which is not in ~buses.");
+                return false;
+            }
+        }
+        for (const auto& bus_config : bus_configs)
+        {
+            std::vector<DeviceConfig> devices;
+            for (const auto& device : topology)
+            {
+                if (device.bus == bus_config.name || (device.bus.empty() && &bus_config == &bus_configs.front()))
+                {
+                    devices.push_back(device);
+                }
+            }
+            buses.emplace_back(new CanBus(node, private_node, bus_config, devices,
+                        snapshot.isOpen() ? &snapshot : nullptr));
+        }
+
+        // Buses discover their devices at the same time
+        std::vector<std::thread> starting;
+        std::vector<char> started(buses.size(), false);
+        for (size_t i = 0; i < buses.size(); i++)
+        {
+            starting.emplace_back([&, i]() { started[i] = buses[i]->start(options, dictionaries); });
+        }
+        for (auto& thread : starting)
+        {
+            thread.join();
+        }
+        if (std::find(started.begin(), started.end(), false) != started.end())
+        {
+            buses.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void CanBridge::stop()
+    {
+        for (auto& bus : buses)
+        {
+            bus->stop();
+        }
+        buses.clear();
+    }
+}
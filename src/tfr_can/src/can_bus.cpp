@@ -0,0 +1,322 @@
+#include "can_bus.h"
+
+#include "logger.h"
+#include "entry_writer.h"
+#include "monitored_entry_publisher.h"
+
+#include <algorithm>
+#include <string>
+
+namespace tfr_can
+{
+    const size_t num_devices_required = 1;
+    // percent of the bitrate polling may take and still leave room for the
+    // commands, PDOs and heartbeats
+    const double MAX_POLLING_LOAD = 60;
+
+    CanBus::CanBus(ros::NodeHandle& n, ros::NodeHandle& private_n, const BusConfig& bus,
+            const std::vector<DeviceConfig>& devices, tfr_utilities::CanSnapshot* shared) :
+        node{n},
+        private_node{private_n},
+        bus_config{bus},
+        topology{devices},
+        snapshot{shared},
+        write_node{n},
+        write_spinner{1, &write_queue},
+        sdo_retries{1},
+        publish_topics{true},
+        started{false}
+    {
+        write_node.setCallbackQueue(&write_queue);
+    }
+
+    CanBus::~CanBus()
+    {
+        stop();
+    }
+
+    const std::string& CanBus::name() const
+    {
+        return bus_config.name;
+    }
+
+    bool CanBus::start(const BusOptions& options,
+            const std::map<int, std::shared_ptr<const EdsDictionary>>& dictionaries)
+    {
+        master.core.nmt.register_device_alive_callback(
+                [this](const uint8_t)
+                {
+                    std::lock_guard<std::mutex> lock(discovery_mutex);
+                    device_alive.notify_all();
+                });
+        if (!master.start(bus_config.name, bus_config.baudrate))
+        {
+            ERROR("Starting master on " << bus_config.name << " failed.");
+            return false;
+        }
+        waitForDevices(options.discovery_timeout);
+        started = true;
+
+        sdo_retries = options.sdo_retries;
+        publish_topics = options.publish_topics;
+
+        // Latency, error and bus load statistics, published on ~diagnostics
+        monitor.reset(new BusMonitor(private_node, bus_config.name, parseBaudrate(bus_config.baudrate)));
+        if (!monitor->start())
+        {
+            ERROR("tfr_can: could not listen to " << bus_config.name << ", bus load will not be reported.");
+        }
+
+        // Raw traffic, for can_replay
+        if (!options.record_directory.empty())
+        {
+            recorder.reset(new FrameRecorder(bus_config.name,
+                        FrameRecorder::defaultPath(options.record_directory, bus_config.name)));
+            if (!recorder->start())
+            {
+                ERROR("tfr_can: could not record " << bus_config.name << ", continuing without a log.");
+                recorder.reset();
+            }
+        }
+
+        // Bulk telemetry: map the queries into TPDOs instead of polling each one over SDO.
+        if (options.use_pdo_telemetry)
+        {
+            telemetry.reset(new PdoTelemetry(master.core, node, options.pdo_sync_period));
+            telemetry->setSnapshot(snapshot, publish_topics);
+        }
+
+        // Motor commands: change-only, and every channel of a controller in one frame.
+        if (options.coalesce_commands)
+        {
+            coalescer.reset(new CommandCoalescer(master.core, write_node,
+                        options.command_period, options.command_keep_alive));
+        }
+
+        for (size_t i = 0; i < master.num_devices(); ++i)
+        {
+            kaco::Device& device = master.get_device(i);
+            device.start();
+
+            int deviceId = device.get_node_id();
+            PRINT("Found device with node ID " << deviceId << " on " << bus_config.name << ": " << device.get_entry("manufacturer_device_name"));
+
+            const DeviceConfig* device_config = findDevice(topology, deviceId);
+            if (device_config == nullptr)
+            {
+                ERROR("tfr_can: device " << deviceId << " is not configured on " << bus_config.name << ", ignoring it.");
+                continue;
+            }
+
+            auto dictionary = dictionaries.find(deviceId);
+            if (dictionary != dictionaries.end() && dictionary->second)
+            {
+                EdsCache::apply(*dictionary->second, device);
+            }
+            ROS_DEBUG_STREAM("tfr_can: device " << deviceId << " using " << device_config->eds_file);
+
+            addEntrySubscribers(device, *device_config);
+            addEntryPublishers(device, *device_config);
+        }
+
+        const double polling_load = monitor->pollingLoad();
+        if (polling_load > MAX_POLLING_LOAD)
+        {
+            ROS_WARN_STREAM("tfr_can: polling at the configured rates takes " << polling_load
+                    << "% of " << bus_config.name << ", entries will be polled less often than configured.");
+        }
+        else
+        {
+            ROS_INFO_STREAM("tfr_can: polling takes " << polling_load << "% of " << bus_config.name);
+        }
+
+        if (telemetry)
+        {
+            telemetry->start();
+        }
+        if (coalescer)
+        {
+            coalescer->start();
+        }
+        scheduler.start();
+        write_spinner.start();
+        return true;
+    }
+
+    /*
+     * Returns once every device in the topology has announced itself, or
+     * after timeout if at least num_devices_required have. kacanopen adds a
+     * device from its own alive callback, which may run after ours, so the
+     * wait also wakes up every few milliseconds to look again.
+     * */
+    void CanBus::waitForDevices(std::chrono::duration<double> timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(discovery_mutex);
+        while (ros::ok())
+        {
+            size_t configured = 0;
+            for (size_t i = 0; i < master.num_devices(); ++i)
+            {
+                if (findDevice(topology, master.get_device(i).get_node_id()) != nullptr)
+                    configured++;
+            }
+            if (configured == topology.size())
+                return;
+
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                if (master.num_devices() >= num_devices_required)
+                {
+                    ERROR("tfr_can: only " << configured << " of the " << topology.size() << " devices configured on " << bus_config.name << " answered, starting without the rest.");
+                    return;
+                }
+                ERROR("Number of devices found on " << bus_config.name << ": " << master.num_devices() << ". Waiting for " << num_devices_required << ".");
+                deadline += std::chrono::seconds(2);
+            }
+            device_alive.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+
+    void CanBus::stop()
+    {
+        if (!started)
+            return;
+        started = false;
+
+        write_spinner.stop();
+        if (coalescer)
+        {
+            coalescer->stop();
+        }
+        scheduler.stop();
+        if (monitor)
+        {
+            monitor->stop();
+        }
+        if (recorder)
+        {
+            recorder->stop();
+        }
+        if (telemetry)
+        {
+            telemetry->stop();
+        }
+        subscribers.clear();
+        coalescer.reset();
+        master.stop();
+    }
+
+    /*
+     * Publishes the read entries of a device at their configured rates. When
+     * PDO telemetry is enabled the entries are mapped into the device's
+     * transmit PDOs and decoded as they arrive; anything that could not be
+     * mapped falls back to SDO polling.
+     * */
+    void CanBus::addEntryPublishers(kaco::Device& device, const DeviceConfig& config)
+    {
+        std::vector<EntryConfig> entries;
+        for (const auto& entry : config.entries)
+        {
+            if (entry.direction == EntryDirection::READ)
+            {
+                entries.push_back(entry);
+            }
+        }
+        // Fastest entries first so they are the last to fall back to polling.
+        std::stable_sort(entries.begin(), entries.end(),
+            [](const EntryConfig& a, const EntryConfig& b) { return a.rate > b.rate; });
+
+        std::vector<EntryConfig> polled{entries};
+
+        // The IMU's readings are assembled into one message per sample.
+        ImuAssembler* imu = nullptr;
+        if (config.profile == DeviceProfile::LPMS && config.imu.enabled)
+        {
+            imus.emplace_back(new ImuAssembler(node, config.imu));
+            imu = imus.back().get();
+            for (const auto& entry : entries)
+            {
+                ImuAssembler::Field field;
+                if (ImuAssembler::field(entry.name, field))
+                {
+                    imu->expect(field);
+                }
+            }
+            if (telemetry)
+            {
+                telemetry->setImu(device.get_node_id(), imu);
+            }
+        }
+
+        if (telemetry)
+        {
+            const bool is_lpms = config.profile == DeviceProfile::LPMS;
+            std::vector<PdoField> fields;
+            polled.clear();
+            for (const auto& entry : entries)
+            {
+                PdoField field;
+                if ((is_lpms && lpmsField(entry.name, field)) || (!is_lpms && roboteqField(entry.name, field)))
+                {
+                    fields.push_back(field);
+                }
+                else
+                {
+                    polled.push_back(entry);
+                }
+            }
+
+            auto unmapped = config.fixed_pdo_mapping ? telemetry->useExistingTransmitPdos(device, fields)
+                : telemetry->mapTransmitPdos(device, fields);
+            for (const auto& field : unmapped)
+            {
+                auto entry = std::find_if(entries.begin(), entries.end(),
+                    [&](const EntryConfig& e) { return e.name == field.entry_name; });
+                polled.push_back(*entry);
+            }
+        }
+
+        for (const auto& entry : polled)
+        {
+            const uint8_t node_id = device.get_node_id();
+            auto stats = monitor->addEntry(node_id, entry.name, entry.rate);
+            ImuAssembler::Field field;
+            auto iopub = std::make_shared<MonitoredEntryPublisher>(device, entry.name,
+                    stats, sdo_retries,
+                    snapshot != nullptr ? snapshot->slot(topicName(node_id, entry.name)) : nullptr,
+                    publish_topics,
+                    imu != nullptr && ImuAssembler::field(entry.name, field) ? imu : nullptr);
+            scheduler.add(iopub, entry.rate);
+        }
+    }
+
+    /*
+     * Subscribes to the write entries of a device. With the coalescer a
+     * Roboteq's cmd_cango channels go to it, everything else gets an
+     * EntryWriter that writes each message as it arrives.
+     * */
+    void CanBus::addEntrySubscribers(kaco::Device& device, const DeviceConfig& config)
+    {
+        std::vector<EntryConfig> writes;
+        for (const auto& entry : config.entries)
+        {
+            if (entry.direction == EntryDirection::WRITE)
+            {
+                writes.push_back(entry);
+            }
+        }
+
+        if (coalescer && config.profile == DeviceProfile::ROBOTEQ)
+        {
+            writes = coalescer->addDevice(device, writes);
+        }
+
+        for (const auto& entry : writes)
+        {
+            auto iosub = std::make_shared<EntryWriter>(device, entry.name, write_node);
+            iosub->advertise();
+            subscribers.push_back(iosub);
+        }
+    }
+}
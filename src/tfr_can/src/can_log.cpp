@@ -0,0 +1,95 @@
+#include "can_log.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace tfr_can
+{
+    CanLog::CanLog() :
+        mapping{nullptr},
+        mapping_size{0},
+        records{0}
+    {}
+
+    CanLog::~CanLog()
+    {
+        close();
+    }
+
+    bool CanLog::open(const std::string& path, std::string& error)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error = std::strerror(errno);
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) < 0 || static_cast<size_t>(info.st_size) < sizeof(CanLogHeader))
+        {
+            error = "too short to be a log";
+            ::close(fd);
+            return false;
+        }
+
+        mapping_size = info.st_size;
+        mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            mapping = nullptr;
+            error = std::strerror(errno);
+            return false;
+        }
+
+        const CanLogHeader& log_header = header();
+        if (std::memcmp(log_header.magic, CAN_LOG_MAGIC, sizeof(CAN_LOG_MAGIC)) != 0)
+            error = "not a CAN log";
+        else if (log_header.version != CAN_LOG_VERSION
+                || log_header.record_size != sizeof(CanLogRecord))
+            error = "unsupported log version " + std::to_string(log_header.version);
+        if (!error.empty())
+        {
+            close();
+            return false;
+        }
+
+        // a log whose writer died may have fewer complete records than counted
+        const size_t complete = (mapping_size - sizeof(CanLogHeader)) / sizeof(CanLogRecord);
+        records = std::min<size_t>(log_header.records, complete);
+        return true;
+    }
+
+    void CanLog::close()
+    {
+        if (mapping != nullptr)
+            munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+        records = 0;
+    }
+
+    const CanLogHeader& CanLog::header() const
+    {
+        return *static_cast<const CanLogHeader*>(mapping);
+    }
+
+    size_t CanLog::size() const
+    {
+        return records;
+    }
+
+    const CanLogRecord& CanLog::operator[](size_t i) const
+    {
+        auto first = reinterpret_cast<const CanLogRecord*>(
+                static_cast<const char*>(mapping) + sizeof(CanLogHeader));
+        return first[i];
+    }
+}
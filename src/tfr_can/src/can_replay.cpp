@@ -0,0 +1,136 @@
+/**
+ * can_replay.cpp
+ *
+ * Plays a log recorded by the bridge (see frame_recorder.h) back onto a CAN
+ * interface, normally a vcan from setupVCAN.sh, with the frames spaced the
+ * way they were recorded. Frames go out on absolute deadlines measured from
+ * the start of the replay, so a late frame doesn't push back the ones after
+ * it and the timing of a replay doesn't drift.
+ *
+ * With --received only the devices' side of the traffic is replayed, which
+ * is what a bridge running against the vcan should be answering.
+ *
+ * Doesn't need ROS, run it with:
+ *     rosrun tfr_can can_replay <log> [--bus vcan0] [--speed 1.0] [--received]
+ * A speed of 0 sends the frames as fast as the interface takes them.
+ */
+#include "can_log.h"
+#include "socket_can.h"
+
+#include <time.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    void usage()
+    {
+        std::cerr << "usage: can_replay <log> [--bus vcan0] [--speed 1.0] [--received]" << std::endl;
+    }
+
+    uint64_t monotonic()
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+    }
+
+    void sleepUntil(uint64_t deadline)
+    {
+        struct timespec wake;
+        wake.tv_sec = deadline / 1000000000ull;
+        wake.tv_nsec = deadline % 1000000000ull;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) != 0)
+            ;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    std::string bus = "vcan0";
+    double speed = 1.0;
+    bool received_only = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--bus" && i + 1 < argc)
+            bus = argv[++i];
+        else if (arg == "--speed" && i + 1 < argc)
+            speed = std::atof(argv[++i]);
+        else if (arg == "--received")
+            received_only = true;
+        else if (path.empty() && arg[0] != '-')
+            path = arg;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (path.empty() || speed < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    tfr_can::CanLog log;
+    std::string error;
+    if (!log.open(path, error))
+    {
+        std::cerr << "can_replay: could not read " << path << ": " << error << std::endl;
+        return 1;
+    }
+    if (log.size() == 0)
+    {
+        std::cerr << "can_replay: " << path << " has no frames" << std::endl;
+        return 0;
+    }
+
+    tfr_can::SocketCan socket;
+    if (!socket.open(bus))
+        return 1;
+
+    std::cout << "can_replay: " << log.size() << " frames recorded on " << log.header().bus
+        << ", replaying onto " << bus << std::endl;
+
+    const uint64_t first = log[0].stamp;
+    const uint64_t start = monotonic();
+    uint64_t sent = 0;
+    uint64_t failed = 0;
+    uint64_t worst_lateness = 0;
+    for (size_t i = 0; i < log.size(); i++)
+    {
+        const tfr_can::CanLogRecord& record = log[i];
+        if (received_only && (record.flags & tfr_can::CanLogRecord::SENT))
+            continue;
+        // error frames are reported by the controller, they can't be sent
+        if (record.can_id & CAN_ERR_FLAG)
+            continue;
+
+        if (speed > 0)
+        {
+            const uint64_t deadline = start + static_cast<uint64_t>((record.stamp - first) / speed);
+            sleepUntil(deadline);
+            worst_lateness = std::max(worst_lateness, monotonic() - deadline);
+        }
+
+        struct can_frame frame;
+        std::memset(&frame, 0, sizeof(frame));
+        frame.can_id = record.can_id;
+        frame.can_dlc = std::min<uint8_t>(record.length, 8);
+        std::memcpy(frame.data, record.data, frame.can_dlc);
+        if (socket.send(frame))
+            sent++;
+        else
+            failed++;
+    }
+
+    std::cout << "can_replay: sent " << sent << " frames in " << (monotonic() - start) / 1e9
+        << " s, " << failed << " failed, worst lateness " << worst_lateness / 1e3 << " us"
+        << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+/**
+ * can_simulator.cpp
+ *
+ * Simulates the rover's CAN devices (the Roboteq motor controllers and the
+ * LPMS IMU) on a SocketCAN interface, normally a vcan created by
+ * setupVCAN.sh. Point the bridge at the same interface and the whole
+ * bridge + control stack runs, and can be benchmarked, without hardware.
+ *
+ * The devices are described in config/can_simulator.yaml. The IMU is driven
+ * by the simulated treads, so turning the rover shows up as a yaw rate.
+ *
+ * PARAMETERS:
+ *  ~bus: interface to simulate the devices on (string, default: vcan0)
+ *  ~step_rate: how often the models are advanced, in Hz (double, default: 1000)
+ *  ~devices: the devices on the bus, see can_simulator.yaml
+ *  ~drive: which motors are the treads, see can_simulator.yaml
+ */
+#include "simulated_devices.h"
+#include "socket_can.h"
+
+#include <ros/ros.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    double toDouble(XmlRpc::XmlRpcValue& value)
+    {
+        if (value.getType() == XmlRpc::XmlRpcValue::TypeInt)
+            return static_cast<int>(value);
+        return static_cast<double>(value);
+    }
+
+    double member(XmlRpc::XmlRpcValue& value, const std::string& name, double fallback)
+    {
+        return value.hasMember(name) ? toDouble(value[name]) : fallback;
+    }
+
+    bool readMotor(XmlRpc::XmlRpcValue& value, uint8_t channel, tfr_can::MotorModel& motor)
+    {
+        if (value.getType() != XmlRpc::XmlRpcValue::TypeStruct || !value.hasMember("max_speed"))
+            return false;
+        motor.max_speed = toDouble(value["max_speed"]);
+        motor.time_constant = member(value, "time_constant", 0.1);
+        motor.min_position = member(value, "min", 0);
+        motor.max_position = member(value, "max", 0);
+        motor.free_amps = member(value, "free_amps", 2.0);
+        motor.stall_amps = member(value, "stall_amps", 20.0);
+        motor.encoder = static_cast<uint8_t>(member(value, "encoder", channel));
+        return motor.max_speed > 0 && motor.time_constant > 0;
+    }
+
+    /*
+     * The rover's motion as seen by the IMU, from the tread speeds.
+     * */
+    struct Drive
+    {
+        tfr_can::SimulatedRoboteq* controller;
+        uint8_t left_channel;
+        uint8_t right_channel;
+        double counts_per_meter;
+        double wheel_span;
+        double previous_speed;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "can_simulator");
+    ros::NodeHandle private_n{"~"};
+
+    std::string bus;
+    double step_rate;
+    private_n.param<std::string>("bus", bus, "vcan0");
+    private_n.param<double>("step_rate", step_rate, 1000.0);
+
+    XmlRpc::XmlRpcValue devices;
+    if (!private_n.getParam("devices", devices) || devices.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+        ROS_ERROR("can_simulator: no device list, make sure can_simulator.yaml is loaded.");
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<tfr_can::SimulatedNode>> nodes;
+    std::vector<tfr_can::SimulatedLpms*> imus;
+    std::vector<std::pair<int, tfr_can::SimulatedRoboteq*>> controllers;
+    for (int i = 0; i < devices.size(); i++)
+    {
+        XmlRpc::XmlRpcValue& device = devices[i];
+        if (!device.hasMember("node_id") || !device.hasMember("type"))
+        {
+            ROS_ERROR_STREAM("can_simulator: device " << i << " needs a node_id and a type");
+            return 1;
+        }
+        const int node_id = static_cast<int>(device["node_id"]);
+        const std::string type = static_cast<std::string>(device["type"]);
+
+        if (type == "roboteq")
+        {
+            std::vector<tfr_can::MotorModel> motors;
+            XmlRpc::XmlRpcValue& list = device["motors"];
+            for (int j = 0; j < list.size(); j++)
+            {
+                tfr_can::MotorModel motor;
+                if (!readMotor(list[j], j + 1, motor))
+                {
+                    ROS_ERROR_STREAM("can_simulator: motor " << j + 1 << " of device "
+                            << node_id << " is malformed");
+                    return 1;
+                }
+                motors.push_back(motor);
+            }
+            std::string name = device.hasMember("name")
+                ? static_cast<std::string>(device["name"]) : "SDC3260";
+            auto controller = new tfr_can::SimulatedRoboteq(node_id, name, motors,
+                    member(device, "watchdog", 1.0));
+            nodes.emplace_back(controller);
+            controllers.emplace_back(node_id, controller);
+        }
+        else if (type == "lpms")
+        {
+            auto imu = new tfr_can::SimulatedLpms(node_id, member(device, "rate", 100));
+            nodes.emplace_back(imu);
+            imus.push_back(imu);
+        }
+        else
+        {
+            ROS_ERROR_STREAM("can_simulator: device " << node_id << " has unknown type " << type);
+            return 1;
+        }
+    }
+
+    Drive drive{nullptr, 1, 2, 1, 1, 0};
+    XmlRpc::XmlRpcValue drive_param;
+    if (private_n.getParam("drive", drive_param))
+    {
+        const int node_id = static_cast<int>(member(drive_param, "node_id", 8));
+        for (auto& controller : controllers)
+            if (controller.first == node_id)
+                drive.controller = controller.second;
+        drive.left_channel = static_cast<uint8_t>(member(drive_param, "left_channel", 1));
+        drive.right_channel = static_cast<uint8_t>(member(drive_param, "right_channel", 2));
+        drive.counts_per_meter = member(drive_param, "counts_per_meter", 1);
+        drive.wheel_span = member(drive_param, "wheel_span", 1);
+    }
+
+    tfr_can::SocketCan socket;
+    if (!socket.open(bus))
+    {
+        ROS_ERROR_STREAM("can_simulator: could not open " << bus << ", did you run setupVCAN.sh?");
+        return 1;
+    }
+
+    std::vector<can_frame> out;
+    for (auto& node : nodes)
+        node->boot(out);
+
+    ROS_INFO_STREAM("can_simulator: simulating " << nodes.size() << " devices on " << bus);
+
+    const double dt = 1.0 / step_rate;
+    const auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(dt));
+    auto next_step = std::chrono::steady_clock::now();
+    can_frame in;
+    while (ros::ok())
+    {
+        for (const auto& frame : out)
+            socket.send(frame);
+        out.clear();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_step)
+        {
+            auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(next_step - now);
+            if (socket.receive(in, timeout))
+                for (auto& node : nodes)
+                    node->receive(in, out);
+            continue;
+        }
+
+        if (drive.controller != nullptr)
+        {
+            const double left = drive.controller->speed(drive.left_channel) / drive.counts_per_meter;
+            const double right = drive.controller->speed(drive.right_channel) / drive.counts_per_meter;
+            const double speed = (left + right) / 2;
+            for (auto imu : imus)
+                imu->setMotion((right - left) / drive.wheel_span, (speed - drive.previous_speed) / dt);
+            drive.previous_speed = speed;
+        }
+        for (auto& node : nodes)
+            node->step(dt, out);
+
+        next_step += step;
+        // don't try to catch up after being descheduled for a long time
+        if (now - next_step > 10 * step)
+            next_step = now;
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include "can_topology.h"
+
+namespace tfr_can
+{
+    namespace
+    {
+        bool readEntry(XmlRpc::XmlRpcValue& value, double default_rate, EntryConfig& entry)
+        {
+            if (value.getType() != XmlRpc::XmlRpcValue::TypeStruct || !value.hasMember("name"))
+                return false;
+
+            entry.name = static_cast<std::string>(value["name"]);
+            entry.direction = EntryDirection::READ;
+            entry.rate = default_rate;
+
+            if (value.hasMember("direction"))
+            {
+                std::string direction = static_cast<std::string>(value["direction"]);
+                if (direction == "write")
+                    entry.direction = EntryDirection::WRITE;
+                else if (direction != "read")
+                    return false;
+            }
+
+            if (value.hasMember("rate"))
+            {
+                if (value["rate"].getType() == XmlRpc::XmlRpcValue::TypeInt)
+                    entry.rate = static_cast<int>(value["rate"]);
+                else
+                    entry.rate = static_cast<double>(value["rate"]);
+            }
+            return entry.rate > 0;
+        }
+
+        double readDouble(XmlRpc::XmlRpcValue& value, const std::string& name, double fallback)
+        {
+            if (!value.hasMember(name))
+                return fallback;
+            if (value[name].getType() == XmlRpc::XmlRpcValue::TypeInt)
+                return static_cast<int>(value[name]);
+            return static_cast<double>(value[name]);
+        }
+
+        /*
+         * Defaults are the LPMS-CU2's datasheet: 0.5 degrees static
+         * orientation accuracy, 0.05 deg/s gyroscope and 2 mg accelerometer
+         * noise.
+         * */
+        void readImu(XmlRpc::XmlRpcValue& value, int node_id, ImuConfig& imu)
+        {
+            imu.enabled = value.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+            imu.topic = "device" + std::to_string(node_id) + "/imu";
+            imu.frame_id = "imu";
+            imu.orientation_stddev = 0.0087;
+            imu.angular_velocity_stddev = 0.00087;
+            imu.linear_acceleration_stddev = 0.02;
+            if (!imu.enabled)
+                return;
+            if (value.hasMember("topic"))
+                imu.topic = static_cast<std::string>(value["topic"]);
+            if (value.hasMember("frame_id"))
+                imu.frame_id = static_cast<std::string>(value["frame_id"]);
+            imu.orientation_stddev = readDouble(value, "orientation_stddev",
+                    imu.orientation_stddev);
+            imu.angular_velocity_stddev = readDouble(value, "angular_velocity_stddev",
+                    imu.angular_velocity_stddev);
+            imu.linear_acceleration_stddev = readDouble(value, "linear_acceleration_stddev",
+                    imu.linear_acceleration_stddev);
+        }
+    }
+
+    bool loadBuses(ros::NodeHandle& n, const std::string& param, std::vector<BusConfig>& buses)
+    {
+        XmlRpc::XmlRpcValue list;
+        if (!n.getParam(param, list))
+            return true;
+        if (list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_ERROR_STREAM("tfr_can: '" << param << "' should be a list of buses");
+            return false;
+        }
+
+        for (int i = 0; i < list.size(); i++)
+        {
+            XmlRpc::XmlRpcValue& value = list[i];
+            if (value.getType() != XmlRpc::XmlRpcValue::TypeStruct || !value.hasMember("name"))
+            {
+                ROS_ERROR_STREAM("tfr_can: bus " << i << " needs a name");
+                return false;
+            }
+            BusConfig bus{static_cast<std::string>(value["name"]), "250K"};
+            if (value.hasMember("baudrate"))
+                bus.baudrate = static_cast<std::string>(value["baudrate"]);
+            buses.push_back(bus);
+        }
+        return true;
+    }
+
+    bool loadTopology(ros::NodeHandle& n, const std::string& param,
+            std::vector<DeviceConfig>& devices)
+    {
+        XmlRpc::XmlRpcValue list;
+        if (!n.getParam(param, list) || list.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_ERROR_STREAM("tfr_can: no device list at '" << param
+                    << "'. Make sure can_topology.yaml is loaded by the launch file.");
+            return false;
+        }
+
+        double default_rate;
+        n.param<double>("default_rate", default_rate, 100.0);
+
+        for (int i = 0; i < list.size(); i++)
+        {
+            XmlRpc::XmlRpcValue& value = list[i];
+            if (!value.hasMember("node_id") || !value.hasMember("eds")
+                    || !value.hasMember("entries"))
+            {
+                ROS_ERROR_STREAM("tfr_can: device " << i
+                        << " needs a node_id, an eds file and a list of entries");
+                return false;
+            }
+
+            DeviceConfig device{};
+            device.node_id = static_cast<int>(value["node_id"]);
+            device.eds_file = static_cast<std::string>(value["eds"]);
+            if (value.hasMember("bus"))
+                device.bus = static_cast<std::string>(value["bus"]);
+            device.profile = DeviceProfile::ROBOTEQ;
+            if (value.hasMember("profile")
+                    && static_cast<std::string>(value["profile"]) == "lpms")
+                device.profile = DeviceProfile::LPMS;
+            device.fixed_pdo_mapping = value.hasMember("fixed_pdo_mapping")
+                && static_cast<bool>(value["fixed_pdo_mapping"]);
+            XmlRpc::XmlRpcValue imu;
+            if (device.profile == DeviceProfile::LPMS && value.hasMember("imu"))
+                imu = value["imu"];
+            readImu(imu, device.node_id, device.imu);
+
+            XmlRpc::XmlRpcValue& entries = value["entries"];
+            for (int j = 0; j < entries.size(); j++)
+            {
+                EntryConfig entry{};
+                if (!readEntry(entries[j], default_rate, entry))
+                {
+                    ROS_ERROR_STREAM("tfr_can: entry " << j << " of device "
+                            << device.node_id << " is malformed");
+                    return false;
+                }
+                device.entries.push_back(entry);
+            }
+            devices.push_back(device);
+        }
+        return true;
+    }
+
+    const DeviceConfig* findDevice(const std::vector<DeviceConfig>& devices, int node_id)
+    {
+        for (const auto& device : devices)
+            if (device.node_id == node_id)
+                return &device;
+        return nullptr;
+    }
+
+    std::string topicName(int node_id, const std::string& entry_name)
+    {
+        return "device" + std::to_string(node_id) + "/get_" + entry_name;
+    }
+
+    std::string commandTopicName(int node_id, const std::string& entry_name)
+    {
+        return "device" + std::to_string(node_id) + "/set_" + entry_name;
+    }
+}
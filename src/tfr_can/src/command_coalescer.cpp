@@ -0,0 +1,211 @@
+#include "command_coalescer.h"
+
+#include "canopen_error.h"
+#include "sdo_error.h"
+
+#include <boost/bind.hpp>
+#include <algorithm>
+
+namespace tfr_can
+{
+    // CANopen communication profile (CiA 301) locations
+    const uint16_t RPDO_COMMUNICATION_INDEX = 0x1400;
+    const uint16_t RPDO_MAPPING_INDEX = 0x1600;
+    // RPDO3 and RPDO4, RPDO1 and RPDO2 carry the Roboteq user variables
+    const uint8_t FIRST_RPDO = 2;
+    const uint8_t NUM_RPDOS = 4;
+    const uint8_t CHANNELS_PER_FRAME = 2;
+
+    // Roboteq cmd_cango, from roboteq_motor_controllers_v60.eds
+    const uint16_t CMD_CANGO_INDEX = 0x2000;
+    const std::string CMD_CANGO_PREFIX = "cmd_cango/cmd_cango_";
+
+    namespace
+    {
+        std::vector<uint8_t> littleEndian(uint32_t value, uint8_t size)
+        {
+            std::vector<uint8_t> bytes(size);
+            for (uint8_t i = 0; i < size; i++)
+                bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+            return bytes;
+        }
+
+        uint32_t fromLittleEndian(const std::vector<uint8_t>& bytes)
+        {
+            uint32_t value = 0;
+            for (size_t i = 0; i < bytes.size() && i < 4; i++)
+                value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+            return value;
+        }
+    }
+
+    CommandCoalescer::CommandCoalescer(kaco::Core& c, ros::NodeHandle& n,
+            std::chrono::milliseconds send_period, std::chrono::milliseconds keep_alive_period) :
+        core{c},
+        node{n},
+        period{send_period},
+        keep_alive{keep_alive_period},
+        running{false}
+    {}
+
+    CommandCoalescer::~CommandCoalescer()
+    {
+        stop();
+    }
+
+    std::vector<EntryConfig> CommandCoalescer::addDevice(kaco::Device& device,
+            const std::vector<EntryConfig>& entries)
+    {
+        const uint8_t node_id = device.get_node_id();
+        std::vector<EntryConfig> remaining;
+        std::vector<Channel*> added;
+        for (const auto& entry : entries)
+        {
+            if (entry.name.compare(0, CMD_CANGO_PREFIX.size(), CMD_CANGO_PREFIX) != 0)
+            {
+                remaining.push_back(entry);
+                continue;
+            }
+            const int number = std::stoi(entry.name.substr(CMD_CANGO_PREFIX.size()));
+            channels.emplace_back(entry.name, static_cast<uint8_t>(number));
+            Channel* channel = &channels.back();
+            channel->subscriber = node.subscribe<std_msgs::Int32>(
+                    commandTopicName(node_id, entry.name), 1,
+                    boost::bind(&CommandCoalescer::receive, this, channel, _1));
+            added.push_back(channel);
+        }
+        std::sort(added.begin(), added.end(),
+                [](const Channel* a, const Channel* b) { return a->channel < b->channel; });
+
+        uint8_t pdo_number = FIRST_RPDO;
+        for (size_t i = 0; i < added.size(); i += CHANNELS_PER_FRAME)
+        {
+            Frame frame{&device, 0, false, {}, Clock::time_point{}};
+            frame.channels.assign(added.begin() + i,
+                    added.begin() + std::min(added.size(), i + CHANNELS_PER_FRAME));
+            if (pdo_number < NUM_RPDOS)
+            {
+                try
+                {
+                    frame.cob_id = mapReceivePdo(node_id, pdo_number, frame.channels);
+                    frame.mapped = true;
+                }
+                catch (const kaco::sdo_error& error)
+                {
+                    ROS_WARN_STREAM("tfr_can: could not map RPDO" << (pdo_number + 1)
+                            << " of device " << static_cast<int>(node_id)
+                            << ", writing its commands over SDO: " << error.what());
+                }
+                pdo_number++;
+            }
+            frames.push_back(frame);
+        }
+        return remaining;
+    }
+
+    void CommandCoalescer::start()
+    {
+        running = true;
+        send_thread = std::thread(&CommandCoalescer::send, this);
+    }
+
+    void CommandCoalescer::stop()
+    {
+        running = false;
+        if (send_thread.joinable())
+            send_thread.join();
+    }
+
+    /*
+     * The Roboteq's receive PDO COB-IDs and transmission types are fixed
+     * (asynchronous, applied on arrival), only the mapping can change.
+     * Clearing the count first is what CiA 301 asks for in that case.
+     * */
+    uint16_t CommandCoalescer::mapReceivePdo(uint8_t node_id, uint8_t pdo_number,
+            const std::vector<Channel*>& mapped)
+    {
+        const uint16_t mapping = RPDO_MAPPING_INDEX + pdo_number;
+        const uint32_t cob_id = fromLittleEndian(core.sdo.upload(node_id,
+                    RPDO_COMMUNICATION_INDEX + pdo_number, 1));
+
+        core.sdo.download(node_id, mapping, 0, 1, littleEndian(0, 1));
+        for (uint8_t i = 0; i < mapped.size(); i++)
+        {
+            uint32_t entry = (static_cast<uint32_t>(CMD_CANGO_INDEX) << 16)
+                | (static_cast<uint32_t>(mapped[i]->channel) << 8) | 32;
+            core.sdo.download(node_id, mapping, i + 1, 4, littleEndian(entry, 4));
+        }
+        core.sdo.download(node_id, mapping, 0, 1, littleEndian(mapped.size(), 1));
+        return static_cast<uint16_t>(cob_id & 0x7FF);
+    }
+
+    void CommandCoalescer::receive(Channel* channel, const std_msgs::Int32::ConstPtr& msg)
+    {
+        channel->value.store(msg->data, std::memory_order_relaxed);
+        channel->received.store(true, std::memory_order_release);
+    }
+
+    void CommandCoalescer::send()
+    {
+        auto next = Clock::now();
+        while (running)
+        {
+            next += period;
+            std::this_thread::sleep_until(next);
+            const auto now = Clock::now();
+            for (auto& frame : frames)
+            {
+                sendFrame(frame, now);
+            }
+        }
+    }
+
+    /*
+     * A frame goes out when a command in it changed, or when a keep alive is
+     * due and commands are still arriving.
+     * */
+    void CommandCoalescer::sendFrame(Frame& frame, Clock::time_point now)
+    {
+        bool arrived = false;
+        bool changed = false;
+        for (const Channel* channel : frame.channels)
+        {
+            arrived |= channel->received.load(std::memory_order_acquire);
+            changed |= channel->value.load(std::memory_order_relaxed) != channel->sent;
+        }
+        if (!changed && !(arrived && now - frame.last_sent >= keep_alive))
+            return;
+
+        std::vector<uint8_t> data;
+        for (Channel* channel : frame.channels)
+        {
+            const bool channel_arrived = channel->received.exchange(false, std::memory_order_acquire);
+            const int32_t value = channel->value.load(std::memory_order_relaxed);
+            const bool write = value != channel->sent || channel_arrived;
+            channel->sent = value;
+            if (frame.mapped)
+            {
+                auto bytes = littleEndian(static_cast<uint32_t>(value), 4);
+                data.insert(data.end(), bytes.begin(), bytes.end());
+            }
+            else if (write)
+            {
+                try
+                {
+                    frame.device->set_entry(channel->entry_name, kaco::Value(value),
+                            kaco::WriteAccessMethod::sdo);
+                }
+                catch (const kaco::canopen_error& error)
+                {
+                    ROS_WARN_STREAM_THROTTLE(1.0, "tfr_can: writing "
+                            << channel->entry_name << " failed: " << error.what());
+                }
+            }
+        }
+        if (frame.mapped)
+        {
+            core.pdo.send(frame.cob_id, data);
+        }
+        frame.last_sent = now;
+    }
+}
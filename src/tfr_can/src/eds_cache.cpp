@@ -0,0 +1,355 @@
+#include "eds_cache.h"
+
+#include <ros/ros.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace tfr_can
+{
+    namespace
+    {
+        const char CACHE_MAGIC[8] = {'T', 'F', 'R', 'E', 'D', 'S', 'C', '1'};
+
+        using Section = std::map<std::string, std::string>;
+
+        std::string trim(const std::string& text)
+        {
+            const auto begin = text.find_first_not_of(" \t\r\n");
+            if (begin == std::string::npos)
+                return "";
+            const auto end = text.find_last_not_of(" \t\r\n");
+            return text.substr(begin, end - begin + 1);
+        }
+
+        std::string lower(std::string text)
+        {
+            std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+            return text;
+        }
+
+        /*
+         * kacanopen's Utils::escape
+         * */
+        std::string escape(const std::string& name)
+        {
+            std::string escaped = lower(name);
+            std::replace(escaped.begin(), escaped.end(), ' ', '_');
+            std::replace(escaped.begin(), escaped.end(), '-', '_');
+            return escaped;
+        }
+
+        bool isHex(const std::string& text)
+        {
+            return !text.empty() && std::all_of(text.begin(), text.end(), ::isxdigit);
+        }
+
+        unsigned long number(const Section& section, const std::string& key, unsigned long fallback)
+        {
+            auto value = section.find(key);
+            if (value == section.end() || value->second.empty())
+                return fallback;
+            return std::strtoul(value->second.c_str(), nullptr, 0);
+        }
+
+        std::string text(const Section& section, const std::string& key)
+        {
+            auto value = section.find(key);
+            return value == section.end() ? "" : value->second;
+        }
+
+        EdsEntry::Access access(const std::string& type)
+        {
+            const std::string access_type = lower(type);
+            if (access_type == "ro")
+                return EdsEntry::READ_ONLY;
+            if (access_type == "wo")
+                return EdsEntry::WRITE_ONLY;
+            if (access_type == "const")
+                return EdsEntry::CONSTANT;
+            // rw, rwr and rww
+            return EdsEntry::READ_WRITE;
+        }
+
+        EdsEntry entry(const Section& section, uint16_t index, uint8_t subindex,
+                const std::string& name)
+        {
+            return EdsEntry{index, subindex, static_cast<uint16_t>(number(section, "datatype", 0)),
+                access(text(section, "accesstype")), name};
+        }
+
+        /*
+         * Fowler-Noll-Vo, only used to tell EDS files apart.
+         * */
+        uint64_t fnv1a(const std::string& data)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (unsigned char byte : data)
+            {
+                hash ^= byte;
+                hash *= 0x100000001b3ull;
+            }
+            return hash;
+        }
+
+        bool dataType(uint16_t code, kaco::Type& type)
+        {
+            switch (code)
+            {
+                case 0x0001: type = kaco::Type::boolean; return true;
+                case 0x0002: type = kaco::Type::int8; return true;
+                case 0x0003: type = kaco::Type::int16; return true;
+                case 0x0004: type = kaco::Type::int32; return true;
+                case 0x0005: type = kaco::Type::uint8; return true;
+                case 0x0006: type = kaco::Type::uint16; return true;
+                case 0x0007: type = kaco::Type::uint32; return true;
+                case 0x0008: type = kaco::Type::real32; return true;
+                case 0x0009: type = kaco::Type::string; return true;
+                case 0x0011: type = kaco::Type::real64; return true;
+                case 0x0015: type = kaco::Type::int64; return true;
+                case 0x001B: type = kaco::Type::uint64; return true;
+                default: return false;
+            }
+        }
+
+        kaco::AccessType accessType(EdsEntry::Access access)
+        {
+            switch (access)
+            {
+                case EdsEntry::READ_ONLY: return kaco::AccessType::read_only;
+                case EdsEntry::WRITE_ONLY: return kaco::AccessType::write_only;
+                case EdsEntry::CONSTANT: return kaco::AccessType::constant;
+                default: return kaco::AccessType::read_write;
+            }
+        }
+
+        template <typename T>
+        void put(std::string& out, T value)
+        {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        template <typename T>
+        bool get(const std::string& in, size_t& offset, T& value)
+        {
+            if (offset + sizeof(value) > in.size())
+                return false;
+            std::memcpy(&value, in.data() + offset, sizeof(value));
+            offset += sizeof(value);
+            return true;
+        }
+
+        bool readFile(const std::string& path, std::string& contents)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file)
+                return false;
+            std::ostringstream buffer;
+            buffer << file.rdbuf();
+            contents = buffer.str();
+            return true;
+        }
+    }
+
+    bool parseEds(const std::string& eds, EdsDictionary& dictionary)
+    {
+        std::map<std::string, Section> sections;
+        Section* current = nullptr;
+        std::istringstream lines(eds);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            line = trim(line);
+            if (line.empty() || line[0] == ';')
+                continue;
+            if (line[0] == '[')
+            {
+                const auto end = line.find(']');
+                current = &sections[lower(line.substr(1, end - 1))];
+                continue;
+            }
+            const auto equals = line.find('=');
+            if (current != nullptr && equals != std::string::npos)
+                (*current)[lower(trim(line.substr(0, equals)))] = trim(line.substr(equals + 1));
+        }
+
+        dictionary.clear();
+        for (const auto& section : sections)
+        {
+            const std::string& name = section.first;
+            if (name.size() < 4 || !isHex(name.substr(0, 4)))
+                continue;
+            const uint16_t index = std::strtoul(name.substr(0, 4).c_str(), nullptr, 16);
+
+            if (name.size() == 4)
+            {
+                // variables, arrays and records are told apart by ObjectType
+                if (number(section.second, "objecttype", 0x7) == 0x7)
+                    dictionary.push_back(entry(section.second, index, 0,
+                                escape(text(section.second, "parametername"))));
+                continue;
+            }
+
+            if (name.compare(4, 3, "sub") != 0 || !isHex(name.substr(7)))
+                continue;
+            auto parent = sections.find(name.substr(0, 4));
+            if (parent == sections.end())
+                continue;
+            const unsigned long type = number(parent->second, "objecttype", 0x7);
+            if (type != 0x8 && type != 0x9)
+                continue;
+            const uint8_t subindex = std::strtoul(name.substr(7).c_str(), nullptr, 16);
+            dictionary.push_back(entry(section.second, index, subindex,
+                        escape(text(parent->second, "parametername")) + "/"
+                        + escape(text(section.second, "parametername"))));
+        }
+
+        std::sort(dictionary.begin(), dictionary.end(),
+                [](const EdsEntry& a, const EdsEntry& b)
+                {
+                    return a.index < b.index || (a.index == b.index && a.subindex < b.subindex);
+                });
+        return !dictionary.empty();
+    }
+
+    EdsCache::EdsCache(const std::string& cache_directory) :
+        directory{cache_directory}
+    {}
+
+    std::string EdsCache::defaultDirectory()
+    {
+        const char* ros_home = std::getenv("ROS_HOME");
+        if (ros_home != nullptr)
+            return std::string(ros_home) + "/tfr_can_eds";
+        const char* home = std::getenv("HOME");
+        if (home != nullptr)
+            return std::string(home) + "/.ros/tfr_can_eds";
+        return "";
+    }
+
+    std::shared_ptr<const EdsDictionary> EdsCache::load(const std::string& path)
+    {
+        std::string eds;
+        if (!readFile(path, eds))
+        {
+            ROS_ERROR_STREAM("tfr_can: could not read " << path);
+            return nullptr;
+        }
+
+        const uint64_t hash = fnv1a(eds);
+        auto found = loaded.find(hash);
+        if (found != loaded.end())
+            return found->second;
+
+        auto dictionary = std::make_shared<EdsDictionary>();
+        if (!readCache(hash, *dictionary))
+        {
+            if (!parseEds(eds, *dictionary))
+            {
+                ROS_ERROR_STREAM("tfr_can: " << path << " has no objects in it");
+                return nullptr;
+            }
+            writeCache(hash, *dictionary);
+        }
+        loaded[hash] = dictionary;
+        return dictionary;
+    }
+
+    void EdsCache::apply(const EdsDictionary& dictionary, kaco::Device& device)
+    {
+        for (const auto& entry : dictionary)
+        {
+            kaco::Type type;
+            // the mandatory entries are already there from device.start()
+            if (!dataType(entry.data_type, type) || device.has_entry(entry.name))
+                continue;
+            device.add_entry(entry.index, entry.subindex, entry.name, type, accessType(entry.access));
+        }
+    }
+
+    std::string EdsCache::cachePath(uint64_t hash) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.edsc", static_cast<unsigned long long>(hash));
+        return directory + name;
+    }
+
+    /*
+     * magic, hash, entry count, then per entry: index, subindex, data type,
+     * access, name length and name
+     * */
+    bool EdsCache::readCache(uint64_t hash, EdsDictionary& dictionary) const
+    {
+        std::string cache;
+        if (directory.empty() || !readFile(cachePath(hash), cache))
+            return false;
+
+        size_t offset = sizeof(CACHE_MAGIC);
+        uint64_t cached_hash;
+        uint32_t count;
+        if (cache.compare(0, sizeof(CACHE_MAGIC), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+                || !get(cache, offset, cached_hash) || cached_hash != hash
+                || !get(cache, offset, count))
+            return false;
+
+        dictionary.resize(count);
+        for (auto& entry : dictionary)
+        {
+            uint8_t access, length;
+            if (!get(cache, offset, entry.index) || !get(cache, offset, entry.subindex)
+                    || !get(cache, offset, entry.data_type) || !get(cache, offset, access)
+                    || !get(cache, offset, length) || offset + length > cache.size())
+                return false;
+            entry.access = static_cast<EdsEntry::Access>(access);
+            entry.name = cache.substr(offset, length);
+            offset += length;
+        }
+        return true;
+    }
+
+    void EdsCache::writeCache(uint64_t hash, const EdsDictionary& dictionary) const
+    {
+        if (directory.empty())
+            return;
+        if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST)
+        {
+            ROS_WARN_STREAM("tfr_can: could not create " << directory << ": " << strerror(errno));
+            return;
+        }
+
+        std::string cache(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        put(cache, hash);
+        put(cache, static_cast<uint32_t>(dictionary.size()));
+        for (const auto& entry : dictionary)
+        {
+            const uint8_t length = std::min<size_t>(entry.name.size(), 255);
+            put(cache, entry.index);
+            put(cache, entry.subindex);
+            put(cache, entry.data_type);
+            put(cache, static_cast<uint8_t>(entry.access));
+            put(cache, length);
+            cache.append(entry.name, 0, length);
+        }
+
+        // written aside and renamed, so a bridge starting alongside never sees half a file
+        const std::string path = cachePath(hash);
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(cache.data(), cache.size());
+            if (!file)
+            {
+                ROS_WARN_STREAM("tfr_can: could not write " << temporary);
+                return;
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) < 0)
+            ROS_WARN_STREAM("tfr_can: could not write " << path << ": " << strerror(errno));
+    }
+}
@@ -0,0 +1,86 @@
+#include "entry_writer.h"
+
+#include "can_topology.h"
+#include "canopen_error.h"
+
+#include <std_msgs/Bool.h>
+#include <std_msgs/Float32.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Int8.h>
+#include <std_msgs/Int16.h>
+#include <std_msgs/Int32.h>
+#include <std_msgs/String.h>
+#include <std_msgs/UInt8.h>
+#include <std_msgs/UInt16.h>
+#include <std_msgs/UInt32.h>
+
+namespace tfr_can
+{
+    EntryWriter::EntryWriter(kaco::Device& d, const std::string& entry, ros::NodeHandle& n,
+            kaco::WriteAccessMethod access) :
+        device{d},
+        entry_name{entry},
+        topic_name{commandTopicName(d.get_node_id(), entry)},
+        access_method{access},
+        node{n}
+    {}
+
+    void EntryWriter::advertise()
+    {
+        switch (device.get_entry_type(entry_name))
+        {
+            case kaco::Type::boolean:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Bool, bool>, this);
+                break;
+            case kaco::Type::uint8:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::UInt8, uint8_t>, this);
+                break;
+            case kaco::Type::uint16:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::UInt16, uint16_t>, this);
+                break;
+            case kaco::Type::uint32:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::UInt32, uint32_t>, this);
+                break;
+            case kaco::Type::int8:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Int8, int8_t>, this);
+                break;
+            case kaco::Type::int16:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Int16, int16_t>, this);
+                break;
+            case kaco::Type::int32:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Int32, int32_t>, this);
+                break;
+            case kaco::Type::real32:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Float32, float>, this);
+                break;
+            case kaco::Type::real64:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::Float64, double>, this);
+                break;
+            case kaco::Type::string:
+                subscriber = node.subscribe(topic_name, 1, &EntryWriter::receive<std_msgs::String, std::string>, this);
+                break;
+            default:
+                ROS_ERROR_STREAM("tfr_can: " << topic_name << " has a type we can't write");
+                break;
+        }
+    }
+
+    template <typename Msg, typename T>
+    void EntryWriter::receive(const typename Msg::ConstPtr& msg)
+    {
+        write(kaco::Value(static_cast<T>(msg->data)));
+    }
+
+    void EntryWriter::write(const kaco::Value& value)
+    {
+        try
+        {
+            device.set_entry(entry_name, value, access_method);
+        }
+        catch (const kaco::canopen_error& error)
+        {
+            ROS_WARN_STREAM_THROTTLE(1.0, "tfr_can: writing " << topic_name
+                    << " failed: " << error.what());
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include "frame_recorder.h"
+
+#include <ros/ros.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace tfr_can
+{
+    namespace
+    {
+        uint64_t nanoseconds(clockid_t clock)
+        {
+            struct timespec now;
+            clock_gettime(clock, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+        }
+
+        size_t logSize(size_t records)
+        {
+            return sizeof(CanLogHeader) + records * sizeof(CanLogRecord);
+        }
+    }
+
+    FrameRecorder::FrameRecorder(const std::string& bus, const std::string& log_path) :
+        busname{bus},
+        path{log_path},
+        running{false},
+        fd{-1},
+        mapping{nullptr},
+        capacity{0}
+    {}
+
+    FrameRecorder::~FrameRecorder()
+    {
+        stop();
+    }
+
+    std::string FrameRecorder::defaultPath(const std::string& directory, const std::string& bus)
+    {
+        char stamp[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+        const std::string name = "can_" + bus + "_" + stamp + ".canlog";
+        if (directory.empty() || directory.back() == '/')
+            return directory + name;
+        return directory + "/" + name;
+    }
+
+    bool FrameRecorder::start()
+    {
+        if (!openLog())
+            return false;
+        // error frames are part of what went wrong
+        if (!socket.open(busname, true))
+        {
+            closeLog();
+            return false;
+        }
+        running = true;
+        record_thread = std::thread(&FrameRecorder::record, this);
+        ROS_INFO_STREAM("tfr_can: recording " << busname << " to " << path);
+        return true;
+    }
+
+    void FrameRecorder::stop()
+    {
+        running = false;
+        if (record_thread.joinable())
+            record_thread.join();
+        socket.close();
+        closeLog();
+    }
+
+    bool FrameRecorder::openLog()
+    {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not create " << path << ": " << strerror(errno));
+            return false;
+        }
+        if (!grow())
+        {
+            closeLog();
+            return false;
+        }
+
+        CanLogHeader& log_header = header();
+        std::memcpy(log_header.magic, CAN_LOG_MAGIC, sizeof(CAN_LOG_MAGIC));
+        log_header.version = CAN_LOG_VERSION;
+        log_header.record_size = sizeof(CanLogRecord);
+        log_header.start_realtime = nanoseconds(CLOCK_REALTIME);
+        log_header.start_monotonic = nanoseconds(CLOCK_MONOTONIC);
+        log_header.records = 0;
+        std::strncpy(log_header.bus, busname.c_str(), sizeof(log_header.bus) - 1);
+        return true;
+    }
+
+    /*
+     * Extends the file by a chunk and maps the new size. Only the recording
+     * thread touches the mapping once it is running, so it is free to move.
+     * */
+    bool FrameRecorder::grow()
+    {
+        const size_t old_size = mapping == nullptr ? 0 : logSize(capacity);
+        const size_t new_capacity = capacity + CHUNK_RECORDS;
+        const size_t new_size = logSize(new_capacity);
+        if (ftruncate(fd, new_size) < 0)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not extend " << path << ": " << strerror(errno));
+            return false;
+        }
+
+        void* grown = mapping == nullptr
+            ? mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+            : mremap(mapping, old_size, new_size, MREMAP_MAYMOVE);
+        if (grown == MAP_FAILED)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not map " << path << ": " << strerror(errno));
+            return false;
+        }
+        mapping = grown;
+        capacity = new_capacity;
+        return true;
+    }
+
+    void FrameRecorder::closeLog()
+    {
+        if (mapping != nullptr)
+        {
+            const size_t size = logSize(header().records);
+            munmap(mapping, logSize(capacity));
+            if (ftruncate(fd, size) < 0)
+                ROS_WARN_STREAM("tfr_can: could not trim " << path << ": " << strerror(errno));
+            mapping = nullptr;
+            capacity = 0;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    void FrameRecorder::record()
+    {
+        struct can_frame frame;
+        bool local = false;
+        while (running)
+        {
+            if (!socket.receive(frame, std::chrono::milliseconds(100), &local))
+                continue;
+            const uint64_t stamp = nanoseconds(CLOCK_MONOTONIC);
+
+            CanLogHeader& log_header = header();
+            if (log_header.records == capacity && !grow())
+            {
+                ROS_ERROR("tfr_can: the CAN log is full, recording stopped.");
+                return;
+            }
+
+            CanLogRecord& entry = records()[header().records];
+            entry.stamp = stamp;
+            entry.can_id = frame.can_id;
+            entry.length = frame.can_dlc;
+            entry.flags = local ? CanLogRecord::SENT : 0;
+            entry.reserved = 0;
+            std::memcpy(entry.data, frame.data, sizeof(entry.data));
+            // counted only once complete, see can_log.h
+            header().records++;
+        }
+    }
+
+    CanLogHeader& FrameRecorder::header()
+    {
+        return *static_cast<CanLogHeader*>(mapping);
+    }
+
+    CanLogRecord* FrameRecorder::records()
+    {
+        return reinterpret_cast<CanLogRecord*>(static_cast<char*>(mapping) + sizeof(CanLogHeader));
+    }
+}
@@ -0,0 +1,187 @@
+#include "imu_assembler.h"
+
+#include <cmath>
+#include <map>
+
+namespace tfr_can
+{
+    namespace
+    {
+        const double PI = 3.14159265358979323846;
+        const double DEGREES = PI / 180;
+        const double STANDARD_GRAVITY = 9.80665;
+
+        void setDiagonal(boost::array<double, 9>& covariance, double stddev)
+        {
+            covariance.fill(0);
+            covariance[0] = covariance[4] = covariance[8] = stddev * stddev;
+        }
+
+        void setMissing(boost::array<double, 9>& covariance)
+        {
+            covariance.fill(0);
+            covariance[0] = -1;
+        }
+    }
+
+    bool ImuAssembler::field(const std::string& entry_name, Field& field)
+    {
+        static const std::map<std::string, Field> fields{
+            {"gyroscope_x", GYROSCOPE_X}, {"gyroscope_y", GYROSCOPE_Y},
+            {"gyroscope_z", GYROSCOPE_Z},
+            {"euler_x", EULER_X}, {"euler_y", EULER_Y}, {"euler_z", EULER_Z},
+            {"linear_acceleration_x", LINEAR_ACCELERATION_X},
+            {"linear_acceleration_y", LINEAR_ACCELERATION_Y},
+            {"linear_acceleration_z", LINEAR_ACCELERATION_Z},
+            {"quaternion_w", QUATERNION_W}, {"quaternion_x", QUATERNION_X},
+            {"quaternion_y", QUATERNION_Y}, {"quaternion_z", QUATERNION_Z}
+        };
+
+        auto found = fields.find(entry_name);
+        if (found == fields.end())
+            return false;
+        field = found->second;
+        return true;
+    }
+
+    ImuAssembler::ImuAssembler(ros::NodeHandle& n, const ImuConfig& c) :
+        config(c),
+        publisher{n.advertise<sensor_msgs::Imu>(c.topic, 50)},
+        expected{0},
+        received{0},
+        whole{0},
+        pending{},
+        values{},
+        torn{0}
+    {
+        msg.header.frame_id = c.frame_id;
+        msg.orientation.w = 1;
+        setMissing(msg.orientation_covariance);
+        setMissing(msg.angular_velocity_covariance);
+        setMissing(msg.linear_acceleration_covariance);
+    }
+
+    uint32_t ImuAssembler::groupMask(Group group)
+    {
+        switch (group)
+        {
+            case GYROSCOPE:
+                return 0x7u << GYROSCOPE_X;
+            case EULER:
+                return 0x7u << EULER_X;
+            case LINEAR_ACCELERATION:
+                return 0x7u << LINEAR_ACCELERATION_X;
+            default:
+                return 0xFu << QUATERNION_W;
+        }
+    }
+
+    void ImuAssembler::expect(Field field)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        expected |= 1u << field;
+
+        // covariances of whatever the configured readings can fill in
+        const uint32_t quaternion = groupMask(QUATERNION);
+        const uint32_t euler = groupMask(EULER);
+        if ((expected & quaternion) == quaternion || (expected & euler) == euler)
+            setDiagonal(msg.orientation_covariance, config.orientation_stddev);
+        if (expected & groupMask(GYROSCOPE))
+            setDiagonal(msg.angular_velocity_covariance, config.angular_velocity_stddev);
+        if (expected & groupMask(LINEAR_ACCELERATION))
+            setDiagonal(msg.linear_acceleration_covariance, config.linear_acceleration_stddev);
+    }
+
+    void ImuAssembler::update(Field field, float value, const ros::Time& taken)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const uint32_t bit = 1u << field;
+        if ((expected & bit) == 0)
+            return;
+        if ((received & bit) != 0)
+            endSample();
+        if (received == 0)
+            stamp = taken;
+        pending[field] = value;
+        received |= bit;
+        if (received == expected)
+            endSample();
+    }
+
+    uint64_t ImuAssembler::tornSamples() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return torn;
+    }
+
+    /*
+     * Keeps the groups that came whole, and publishes if that's every
+     * group at least once. Called with the mutex held.
+     * */
+    void ImuAssembler::endSample()
+    {
+        bool updated = false;
+        for (uint8_t g = 0; g < GROUPS; g++)
+        {
+            const uint32_t mask = groupMask(static_cast<Group>(g)) & expected;
+            if (mask == 0 || (received & mask) == 0)
+                continue;
+            if ((received & mask) != mask)
+            {
+                torn++;
+                continue;
+            }
+            for (uint8_t f = 0; f < FIELDS; f++)
+                if (mask & (1u << f))
+                    values[f] = pending[f];
+            whole |= mask;
+            updated = true;
+        }
+        received = 0;
+        if (!updated || whole != expected)
+            return;
+
+        msg.header.stamp = stamp;
+        fillOrientation();
+        msg.angular_velocity.x = values[GYROSCOPE_X] * DEGREES;
+        msg.angular_velocity.y = values[GYROSCOPE_Y] * DEGREES;
+        msg.angular_velocity.z = values[GYROSCOPE_Z] * DEGREES;
+        msg.linear_acceleration.x = values[LINEAR_ACCELERATION_X] * STANDARD_GRAVITY;
+        msg.linear_acceleration.y = values[LINEAR_ACCELERATION_Y] * STANDARD_GRAVITY;
+        msg.linear_acceleration.z = values[LINEAR_ACCELERATION_Z] * STANDARD_GRAVITY;
+        publisher.publish(msg);
+    }
+
+    void ImuAssembler::fillOrientation()
+    {
+        if ((expected & groupMask(QUATERNION)) == groupMask(QUATERNION))
+        {
+            double w = values[QUATERNION_W];
+            double x = values[QUATERNION_X];
+            double y = values[QUATERNION_Y];
+            double z = values[QUATERNION_Z];
+            // floats off the bus are only nearly normalized
+            const double norm = std::sqrt(w * w + x * x + y * y + z * z);
+            if (norm == 0)
+                return;
+            msg.orientation.w = w / norm;
+            msg.orientation.x = x / norm;
+            msg.orientation.y = y / norm;
+            msg.orientation.z = z / norm;
+        }
+        else if ((expected & groupMask(EULER)) == groupMask(EULER))
+        {
+            const double roll = values[EULER_X] * DEGREES / 2;
+            const double pitch = values[EULER_Y] * DEGREES / 2;
+            const double yaw = values[EULER_Z] * DEGREES / 2;
+            msg.orientation.w = std::cos(roll) * std::cos(pitch) * std::cos(yaw)
+                + std::sin(roll) * std::sin(pitch) * std::sin(yaw);
+            msg.orientation.x = std::sin(roll) * std::cos(pitch) * std::cos(yaw)
+                - std::cos(roll) * std::sin(pitch) * std::sin(yaw);
+            msg.orientation.y = std::cos(roll) * std::sin(pitch) * std::cos(yaw)
+                + std::sin(roll) * std::cos(pitch) * std::sin(yaw);
+            msg.orientation.z = std::cos(roll) * std::cos(pitch) * std::sin(yaw)
+                - std::sin(roll) * std::sin(pitch) * std::cos(yaw);
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include "monitored_entry_publisher.h"
+
+#include "can_topology.h"
+#include "canopen_error.h"
+
+#include <std_msgs/Bool.h>
+#include <std_msgs/Float32.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Int8.h>
+#include <std_msgs/Int16.h>
+#include <std_msgs/Int32.h>
+#include <std_msgs/String.h>
+#include <std_msgs/UInt8.h>
+#include <std_msgs/UInt16.h>
+#include <std_msgs/UInt32.h>
+#include <chrono>
+
+namespace tfr_can
+{
+    namespace
+    {
+        template <typename Msg, typename T>
+        void publishAs(const ros::Publisher& publisher, const kaco::Value& value)
+        {
+            Msg msg;
+            msg.data = static_cast<T>(value);
+            publisher.publish(msg);
+        }
+    }
+
+    MonitoredEntryPublisher::MonitoredEntryPublisher(kaco::Device& d,
+            const std::string& entry, std::shared_ptr<EntryStats> s, int retries,
+            tfr_utilities::CanSnapshot::Slot* slot, bool topic, ImuAssembler* assembler,
+            kaco::ReadAccessMethod access) :
+        device{d},
+        entry_name{entry},
+        topic_name{topicName(d.get_node_id(), entry)},
+        access_method{access},
+        max_retries{retries},
+        stats{s},
+        shared{assembler != nullptr ? nullptr : slot},
+        publish_topic{topic && assembler == nullptr},
+        imu{assembler},
+        imu_field{},
+        type{kaco::Type::invalid}
+    {
+        if (imu != nullptr && !ImuAssembler::field(entry_name, imu_field))
+            ROS_ERROR_STREAM("tfr_can: " << topic_name << " is not part of an IMU sample");
+    }
+
+    void MonitoredEntryPublisher::advertise()
+    {
+        ros::NodeHandle n;
+        type = device.get_entry_type(entry_name);
+        if (!publish_topic)
+            return;
+        switch (type)
+        {
+            case kaco::Type::boolean:
+                publisher = n.advertise<std_msgs::Bool>(topic_name, 1);
+                break;
+            case kaco::Type::uint8:
+                publisher = n.advertise<std_msgs::UInt8>(topic_name, 1);
+                break;
+            case kaco::Type::uint16:
+                publisher = n.advertise<std_msgs::UInt16>(topic_name, 1);
+                break;
+            case kaco::Type::uint32:
+                publisher = n.advertise<std_msgs::UInt32>(topic_name, 1);
+                break;
+            case kaco::Type::int8:
+                publisher = n.advertise<std_msgs::Int8>(topic_name, 1);
+                break;
+            case kaco::Type::int16:
+                publisher = n.advertise<std_msgs::Int16>(topic_name, 1);
+                break;
+            case kaco::Type::int32:
+                publisher = n.advertise<std_msgs::Int32>(topic_name, 1);
+                break;
+            case kaco::Type::real32:
+                publisher = n.advertise<std_msgs::Float32>(topic_name, 1);
+                break;
+            case kaco::Type::real64:
+                publisher = n.advertise<std_msgs::Float64>(topic_name, 1);
+                break;
+            case kaco::Type::string:
+                publisher = n.advertise<std_msgs::String>(topic_name, 1);
+                break;
+            default:
+                ROS_ERROR_STREAM("tfr_can: " << topic_name << " has a type we can't publish");
+                break;
+        }
+    }
+
+    /*
+     * Called by the poll scheduler. Retries a failed request up to
+     * max_retries times before giving up until the next period.
+     * */
+    void MonitoredEntryPublisher::publish()
+    {
+        stats->polls.fetch_add(1, std::memory_order_relaxed);
+        for (int attempt = 0; attempt <= max_retries; attempt++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                const kaco::Value value = device.get_entry(entry_name, access_method);
+                const auto latency = std::chrono::steady_clock::now() - start;
+                stats->latency.record(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+                if (imu != nullptr)
+                    imu->update(imu_field, ImuAssembler::reading(static_cast<uint32_t>(value)));
+                if (shared != nullptr)
+                    writeSnapshot(value);
+                if (publish_topic)
+                    publishValue(value);
+                return;
+            }
+            catch (const kaco::canopen_error& error)
+            {
+                stats->errors.fetch_add(1, std::memory_order_relaxed);
+                if (attempt < max_retries)
+                    stats->retries.fetch_add(1, std::memory_order_relaxed);
+                else
+                    ROS_WARN_STREAM_THROTTLE(1.0, "tfr_can: reading " << topic_name
+                            << " failed: " << error.what());
+            }
+        }
+    }
+
+    void MonitoredEntryPublisher::writeSnapshot(const kaco::Value& value)
+    {
+        int64_t data;
+        switch (type)
+        {
+            case kaco::Type::boolean:
+                data = static_cast<bool>(value);
+                break;
+            case kaco::Type::uint8:
+                data = static_cast<uint8_t>(value);
+                break;
+            case kaco::Type::uint16:
+                data = static_cast<uint16_t>(value);
+                break;
+            case kaco::Type::uint32:
+                data = static_cast<uint32_t>(value);
+                break;
+            case kaco::Type::int8:
+                data = static_cast<int8_t>(value);
+                break;
+            case kaco::Type::int16:
+                data = static_cast<int16_t>(value);
+                break;
+            case kaco::Type::int32:
+                data = static_cast<int32_t>(value);
+                break;
+            default:
+                // only integers go into the snapshot
+                return;
+        }
+        tfr_utilities::CanSnapshot::write(*shared, data, tfr_utilities::CanSnapshot::now());
+    }
+
+    void MonitoredEntryPublisher::publishValue(const kaco::Value& value)
+    {
+        switch (type)
+        {
+            case kaco::Type::boolean:
+                publishAs<std_msgs::Bool, bool>(publisher, value);
+                break;
+            case kaco::Type::uint8:
+                publishAs<std_msgs::UInt8, uint8_t>(publisher, value);
+                break;
+            case kaco::Type::uint16:
+                publishAs<std_msgs::UInt16, uint16_t>(publisher, value);
+                break;
+            case kaco::Type::uint32:
+                publishAs<std_msgs::UInt32, uint32_t>(publisher, value);
+                break;
+            case kaco::Type::int8:
+                publishAs<std_msgs::Int8, int8_t>(publisher, value);
+                break;
+            case kaco::Type::int16:
+                publishAs<std_msgs::Int16, int16_t>(publisher, value);
+                break;
+            case kaco::Type::int32:
+                publishAs<std_msgs::Int32, int32_t>(publisher, value);
+                break;
+            case kaco::Type::real32:
+                publishAs<std_msgs::Float32, float>(publisher, value);
+                break;
+            case kaco::Type::real64:
+                publishAs<std_msgs::Float64, double>(publisher, value);
+                break;
+            case kaco::Type::string:
+                publishAs<std_msgs::String, std::string>(publisher, value);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,467 @@
+#include "pdo_telemetry.h"
+
+#include "can_topology.h"
+#include "sdo_error.h"
+
+#include <std_msgs/Int16.h>
+#include <std_msgs/Int32.h>
+#include <std_msgs/UInt16.h>
+#include <std_msgs/UInt32.h>
+#include <algorithm>
+#include <map>
+
+namespace tfr_can
+{
+    // CANopen communication profile (CiA 301) locations
+    const uint16_t TPDO_COMMUNICATION_INDEX = 0x1800;
+    const uint16_t TPDO_MAPPING_INDEX = 0x1A00;
+    const uint16_t TPDO_COB_ID_BASE[4] = {0x180, 0x280, 0x380, 0x480};
+    const uint8_t NUM_TPDOS = 4;
+    const uint8_t PDO_BITS = 64;
+    const uint32_t PDO_DISABLED = 0x80000000;
+    const uint8_t TRANSMIT_ON_EVERY_SYNC = 1;
+    // transmission types up to this one answer a SYNC, those above are
+    // remote requested or event driven
+    const uint8_t LAST_SYNCHRONOUS_TRANSMISSION = 240;
+    const uint16_t SYNC_COB_ID = 0x80;
+
+    namespace
+    {
+        std::vector<uint8_t> littleEndian(uint32_t value, uint8_t size)
+        {
+            std::vector<uint8_t> bytes(size);
+            for (uint8_t i = 0; i < size; i++)
+                bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+            return bytes;
+        }
+
+        uint32_t fromLittleEndian(const std::vector<uint8_t>& bytes)
+        {
+            uint32_t value = 0;
+            for (size_t i = 0; i < bytes.size() && i < 4; i++)
+                value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+            return value;
+        }
+
+        bool splitChannel(const std::string& entry_name, std::string& object,
+                uint8_t& channel)
+        {
+            auto slash = entry_name.find('/');
+            auto underscore = entry_name.rfind('_');
+            if (slash == std::string::npos || underscore == std::string::npos
+                    || underscore < slash)
+                return false;
+            object = entry_name.substr(0, slash);
+            channel = static_cast<uint8_t>(std::stoi(entry_name.substr(underscore + 1)));
+            return true;
+        }
+    }
+
+    bool roboteqField(const std::string& entry_name, PdoField& field)
+    {
+        // index and type of each runtime query, from roboteq_motor_controllers_v60.eds
+        static const std::map<std::string, std::pair<uint16_t, kaco::Type>> queries{
+            {"qry_motamps", {0x2100, kaco::Type::int16}},
+            {"qry_abcntr",  {0x2104, kaco::Type::int32}},
+            {"qry_batamps", {0x210C, kaco::Type::int16}}
+        };
+
+        std::string object;
+        uint8_t channel;
+        if (!splitChannel(entry_name, object, channel))
+            return false;
+
+        auto query = queries.find(object);
+        if (query == queries.end())
+            return false;
+
+        field.entry_name = entry_name;
+        field.index = query->second.first;
+        field.subindex = channel;
+        field.type = query->second.second;
+        return true;
+    }
+
+    bool lpmsField(const std::string& entry_name, PdoField& field)
+    {
+        // from LPMS-CU2_32BitDataSettings.eds, all values are 32 bits wide
+        static const std::map<std::string, uint16_t> objects{
+            {"gyroscope_x", 0x2000}, {"gyroscope_y", 0x2001}, {"gyroscope_z", 0x2002},
+            {"euler_x", 0x2100}, {"euler_y", 0x2101}, {"euler_z", 0x2102},
+            {"linear_acceleration_x", 0x2200},
+            {"linear_acceleration_y", 0x2201},
+            {"linear_acceleration_z", 0x2202},
+            {"quaternion_w", 0x2400}, {"quaternion_x", 0x2401},
+            {"quaternion_y", 0x2402}, {"quaternion_z", 0x2403}
+        };
+
+        auto object = objects.find(entry_name);
+        if (object == objects.end())
+            return false;
+
+        field.entry_name = entry_name;
+        field.index = object->second;
+        field.subindex = 0;
+        field.type = kaco::Type::uint32;
+        return true;
+    }
+
+    uint8_t fieldBits(kaco::Type type)
+    {
+        switch (type)
+        {
+            case kaco::Type::int16:
+            case kaco::Type::uint16:
+                return 16;
+            default:
+                return 32;
+        }
+    }
+
+    PdoTelemetry::PdoTelemetry(kaco::Core& c, ros::NodeHandle& n,
+            std::chrono::milliseconds period) :
+        core{c},
+        node{n},
+        sync_period{period},
+        snapshot{nullptr},
+        publish_topics{true},
+        running{false}
+    {}
+
+    PdoTelemetry::~PdoTelemetry()
+    {
+        stop();
+    }
+
+    /*
+     * Greedily packs the fields into the device's four TPDOs in order.
+     * */
+    std::vector<PdoField> PdoTelemetry::mapTransmitPdos(kaco::Device& device,
+            const std::vector<PdoField>& fields)
+    {
+        const uint8_t node_id = device.get_node_id();
+        std::vector<PdoField> unmapped{};
+        std::vector<std::vector<PdoField>> packed(NUM_TPDOS);
+        uint8_t pdo_number = 0;
+        uint8_t used_bits = 0;
+
+        for (const auto& field : fields)
+        {
+            const uint8_t bits = fieldBits(field.type);
+            if (used_bits + bits > PDO_BITS)
+            {
+                pdo_number++;
+                used_bits = 0;
+            }
+            if (pdo_number >= NUM_TPDOS)
+            {
+                unmapped.push_back(field);
+                continue;
+            }
+            packed[pdo_number].push_back(field);
+            used_bits += bits;
+        }
+
+        for (uint8_t i = 0; i < NUM_TPDOS; i++)
+        {
+            try
+            {
+                writeTransmitPdo(node_id, i, packed[i]);
+                if (!packed[i].empty())
+                    registerPdo(device, i, packed[i], true);
+            }
+            catch (const kaco::sdo_error& error)
+            {
+                ROS_ERROR_STREAM("tfr_can: could not map TPDO" << (i + 1)
+                        << " of device " << static_cast<int>(node_id)
+                        << ", falling back to polling: " << error.what());
+                unmapped.insert(unmapped.end(), packed[i].begin(), packed[i].end());
+            }
+        }
+        return unmapped;
+    }
+
+    std::vector<PdoField> PdoTelemetry::useExistingTransmitPdos(kaco::Device& device,
+            const std::vector<PdoField>& fields)
+    {
+        const uint8_t node_id = device.get_node_id();
+        std::vector<PdoField> unmapped{fields};
+
+        for (uint8_t i = 0; i < NUM_TPDOS; i++)
+        {
+            std::vector<PdoField> transmitted{};
+            bool synchronous;
+            try
+            {
+                synchronous = fromLittleEndian(core.sdo.upload(node_id,
+                            TPDO_COMMUNICATION_INDEX + i, 2)) <= LAST_SYNCHRONOUS_TRANSMISSION;
+                auto count = fromLittleEndian(core.sdo.upload(node_id,
+                            TPDO_MAPPING_INDEX + i, 0));
+                for (uint8_t sub = 1; sub <= count; sub++)
+                {
+                    auto mapping = fromLittleEndian(core.sdo.upload(node_id,
+                                TPDO_MAPPING_INDEX + i, sub));
+                    uint16_t index = static_cast<uint16_t>(mapping >> 16);
+                    uint8_t subindex = static_cast<uint8_t>(mapping >> 8);
+
+                    auto match = std::find_if(unmapped.begin(), unmapped.end(),
+                            [&](const PdoField& f)
+                            { return f.index == index && f.subindex == subindex; });
+                    if (match == unmapped.end())
+                    {
+                        // keep the offsets right for the fields after this one
+                        PdoField filler{"", index, subindex,
+                            (mapping & 0xFF) == 16 ? kaco::Type::uint16 : kaco::Type::uint32};
+                        transmitted.push_back(filler);
+                        continue;
+                    }
+                    transmitted.push_back(*match);
+                    unmapped.erase(match);
+                }
+            }
+            catch (const kaco::sdo_error& error)
+            {
+                ROS_WARN_STREAM("tfr_can: could not read TPDO" << (i + 1)
+                        << " mapping of device " << static_cast<int>(node_id)
+                        << ": " << error.what());
+                continue;
+            }
+            if (!transmitted.empty())
+                registerPdo(device, i, transmitted, synchronous);
+        }
+        return unmapped;
+    }
+
+    /*
+     * Follows the mapping procedure from CiA 301: disable the PDO, clear the
+     * mapping, write the entries, set the count and then re-enable it.
+     * */
+    void PdoTelemetry::writeTransmitPdo(uint8_t node_id, uint8_t pdo_number,
+            const std::vector<PdoField>& fields)
+    {
+        const uint16_t communication = TPDO_COMMUNICATION_INDEX + pdo_number;
+        const uint16_t mapping = TPDO_MAPPING_INDEX + pdo_number;
+        const uint32_t cob_id = TPDO_COB_ID_BASE[pdo_number] + node_id;
+
+        core.sdo.download(node_id, communication, 1, 4,
+                littleEndian(cob_id | PDO_DISABLED, 4));
+        if (fields.empty())
+            return;
+
+        core.sdo.download(node_id, mapping, 0, 1, littleEndian(0, 1));
+        for (uint8_t i = 0; i < fields.size(); i++)
+        {
+            const auto& field = fields[i];
+            uint32_t entry = (static_cast<uint32_t>(field.index) << 16)
+                | (static_cast<uint32_t>(field.subindex) << 8)
+                | fieldBits(field.type);
+            core.sdo.download(node_id, mapping, i + 1, 4, littleEndian(entry, 4));
+        }
+        core.sdo.download(node_id, mapping, 0, 1, littleEndian(fields.size(), 1));
+
+        core.sdo.download(node_id, communication, 2, 1,
+                littleEndian(TRANSMIT_ON_EVERY_SYNC, 1));
+        core.sdo.download(node_id, communication, 1, 4, littleEndian(cob_id, 4));
+    }
+
+    void PdoTelemetry::registerPdo(kaco::Device& device, uint8_t pdo_number,
+            const std::vector<PdoField>& fields, bool synchronous)
+    {
+        const uint8_t node_id = device.get_node_id();
+        MappedPdo pdo{node_id,
+            static_cast<uint16_t>(TPDO_COB_ID_BASE[pdo_number] + node_id),
+            synchronous, {}};
+
+        uint8_t offset = 0;
+        for (const auto& field : fields)
+        {
+            ros::Publisher publisher{};
+            ros::Publisher stamped_publisher{};
+            tfr_utilities::CanSnapshot::Slot* shared = nullptr;
+            ImuAssembler* imu = nullptr;
+            ImuAssembler::Field imu_field{};
+            auto assembler = imus.find(node_id);
+            if (!field.entry_name.empty() && assembler != imus.end()
+                    && ImuAssembler::field(field.entry_name, imu_field))
+            {
+                imu = assembler->second;
+                ROS_DEBUG_STREAM("tfr_can: " << field.entry_name << " of device "
+                        << static_cast<int>(node_id) << " carried by PDO 0x"
+                        << std::hex << pdo.cob_id << std::dec
+                        << " at byte " << static_cast<int>(offset) << " into its IMU sample");
+            }
+            else if (!field.entry_name.empty())
+            {
+                auto topic = topicName(node_id, field.entry_name);
+                if (snapshot != nullptr)
+                    shared = snapshot->slot(topic);
+                if (publish_topics)
+                {
+                    switch (field.type)
+                    {
+                        case kaco::Type::int16:
+                            publisher = node.advertise<std_msgs::Int16>(topic, 5);
+                            break;
+                        case kaco::Type::uint16:
+                            publisher = node.advertise<std_msgs::UInt16>(topic, 5);
+                            break;
+                        case kaco::Type::int32:
+                            publisher = node.advertise<std_msgs::Int32>(topic, 5);
+                            break;
+                        default:
+                            publisher = node.advertise<std_msgs::UInt32>(topic, 5);
+                            break;
+                    }
+                    stamped_publisher = node.advertise<tfr_msgs::CanSample>(topic + "/stamped", 5);
+                }
+                ROS_DEBUG_STREAM("tfr_can: " << topic << " carried by PDO 0x"
+                        << std::hex << pdo.cob_id << std::dec
+                        << " at byte " << static_cast<int>(offset));
+            }
+            pdo.slots.push_back(Slot{field, offset, publisher, stamped_publisher, shared,
+                    imu, imu_field});
+            offset += fieldBits(field.type) / 8;
+        }
+
+        pdos.push_back(pdo);
+        const MappedPdo* registered = &pdos.back();
+        core.pdo.add_pdo_received_callback(registered->cob_id,
+                [this, registered](std::vector<uint8_t> data)
+                {
+                    decode(*registered, data);
+                });
+    }
+
+    /*
+     * Runs on the kacanopen receive thread. A synchronous PDO answers the
+     * latest SYNC, the devices reply well within a sync period.
+     * */
+    void PdoTelemetry::decode(const MappedPdo& pdo, const std::vector<uint8_t>& data)
+    {
+        const SyncTime sync = last_sync.read();
+        uint64_t stamp;
+        ros::Time time;
+        if (pdo.synchronous && sync.monotonic != 0)
+        {
+            stamp = sync.monotonic;
+            time.fromNSec(sync.ros);
+        }
+        else
+        {
+            stamp = tfr_utilities::CanSnapshot::now();
+            time = ros::Time::now();
+        }
+        for (const auto& slot : pdo.slots)
+        {
+            const uint8_t size = fieldBits(slot.field.type) / 8;
+            if (slot.field.entry_name.empty() || slot.offset + size > data.size())
+                continue;
+
+            std::vector<uint8_t> bytes(data.begin() + slot.offset,
+                    data.begin() + slot.offset + size);
+            const uint32_t raw = fromLittleEndian(bytes);
+            if (slot.imu != nullptr)
+            {
+                slot.imu->update(slot.imu_field, ImuAssembler::reading(raw), time);
+                continue;
+            }
+            int64_t value;
+            switch (slot.field.type)
+            {
+                case kaco::Type::int16:
+                    value = static_cast<int16_t>(raw);
+                    break;
+                case kaco::Type::uint16:
+                    value = static_cast<uint16_t>(raw);
+                    break;
+                case kaco::Type::int32:
+                    value = static_cast<int32_t>(raw);
+                    break;
+                default:
+                    value = raw;
+                    break;
+            }
+
+            if (slot.shared != nullptr)
+                tfr_utilities::CanSnapshot::write(*slot.shared, value, stamp);
+            if (!publish_topics)
+                continue;
+
+            switch (slot.field.type)
+            {
+                case kaco::Type::int16:
+                {
+                    std_msgs::Int16 msg;
+                    msg.data = static_cast<int16_t>(value);
+                    slot.publisher.publish(msg);
+                    break;
+                }
+                case kaco::Type::uint16:
+                {
+                    std_msgs::UInt16 msg;
+                    msg.data = static_cast<uint16_t>(value);
+                    slot.publisher.publish(msg);
+                    break;
+                }
+                case kaco::Type::int32:
+                {
+                    std_msgs::Int32 msg;
+                    msg.data = static_cast<int32_t>(value);
+                    slot.publisher.publish(msg);
+                    break;
+                }
+                default:
+                {
+                    std_msgs::UInt32 msg;
+                    msg.data = static_cast<uint32_t>(value);
+                    slot.publisher.publish(msg);
+                    break;
+                }
+            }
+            tfr_msgs::CanSample stamped;
+            stamped.header.stamp = time;
+            stamped.value = value;
+            slot.stamped_publisher.publish(stamped);
+        }
+    }
+
+    void PdoTelemetry::start()
+    {
+        if (running.exchange(true))
+            return;
+        sync_thread = std::thread(&PdoTelemetry::produceSync, this);
+    }
+
+    void PdoTelemetry::stop()
+    {
+        running = false;
+        if (sync_thread.joinable())
+            sync_thread.join();
+    }
+
+    void PdoTelemetry::setSnapshot(tfr_utilities::CanSnapshot* shared, bool topics)
+    {
+        snapshot = shared;
+        publish_topics = topics;
+    }
+
+    void PdoTelemetry::setImu(uint8_t node_id, ImuAssembler* imu)
+    {
+        imus[node_id] = imu;
+    }
+
+    void PdoTelemetry::produceSync()
+    {
+        kaco::Message sync{SYNC_COB_ID, false, 0, {0, 0, 0, 0, 0, 0, 0, 0}};
+        auto next = std::chrono::steady_clock::now();
+        while (running && ros::ok())
+        {
+            // stamped before it goes out, so no answer can beat it
+            last_sync.write(SyncTime{tfr_utilities::CanSnapshot::now(),
+                    ros::Time::now().toNSec()});
+            core.send(sync);
+            next += sync_period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
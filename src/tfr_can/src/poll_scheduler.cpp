@@ -0,0 +1,67 @@
+#include "poll_scheduler.h"
+
+#include <ros/ros.h>
+
+namespace tfr_can
+{
+    PollScheduler::PollScheduler() :
+        running{false}
+    {}
+
+    PollScheduler::~PollScheduler()
+    {
+        stop();
+    }
+
+    void PollScheduler::add(std::shared_ptr<kaco::Publisher> publisher, double rate)
+    {
+        publisher->advertise();
+        auto period = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / rate));
+        tasks.push_back(Task{publisher, period, Clock::time_point{}});
+    }
+
+    void PollScheduler::start()
+    {
+        if (running.exchange(true))
+            return;
+        thread = std::thread(&PollScheduler::run, this);
+    }
+
+    void PollScheduler::stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void PollScheduler::run()
+    {
+        std::priority_queue<Task, std::vector<Task>, LaterDeadline> queue;
+        const auto now = Clock::now();
+        for (auto task : tasks)
+        {
+            task.deadline = now;
+            queue.push(task);
+        }
+
+        while (running && ros::ok() && !queue.empty())
+        {
+            Task task = queue.top();
+            queue.pop();
+
+            std::this_thread::sleep_until(task.deadline);
+            task.publisher->publish();
+
+            // skip any periods we missed instead of bursting to catch up
+            const auto finished = Clock::now();
+            task.deadline += task.period;
+            if (task.deadline < finished)
+            {
+                auto missed = (finished - task.deadline) / task.period + 1;
+                task.deadline += missed * task.period;
+            }
+            queue.push(task);
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#include "simulated_devices.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_can
+{
+    // Roboteq runtime commands and queries, from roboteq_motor_controllers_v60.eds
+    const uint16_t CMD_CANGO = 0x2000;
+    const uint16_t CMD_SENCNTR = 0x2003;
+    const uint16_t QRY_MOTAMPS = 0x2100;
+    const uint16_t QRY_ABCNTR = 0x2104;
+    const uint16_t QRY_BATAMPS = 0x210C;
+
+    // LPMS-CU2 readings, from LPMS-CU2_32BitDataSettings.eds
+    const uint16_t LPMS_GYROSCOPE = 0x2000;
+    const uint16_t LPMS_EULER = 0x2100;
+    const uint16_t LPMS_LINEAR_ACCELERATION = 0x2200;
+    const uint16_t LPMS_QUATERNION = 0x2400;
+
+    const double GRAVITY = 9.80665;
+    const double PI = 3.14159265358979;
+
+    SimulatedRoboteq::SimulatedRoboteq(uint8_t node_id, const std::string& device_name,
+            const std::vector<MotorModel>& models, double watchdog_timeout) :
+        SimulatedNode{node_id, device_name},
+        watchdog{watchdog_timeout},
+        since_command{0}
+    {
+        uint8_t channels = models.size();
+        for (const auto& model : models)
+        {
+            motors.push_back(Motor{model, 0, 0, 0});
+            channels = std::max(channels, model.encoder);
+        }
+
+        for (uint16_t index : {CMD_CANGO, CMD_SENCNTR, QRY_MOTAMPS, QRY_ABCNTR, QRY_BATAMPS})
+            addEntry(index, 0, 1, Access::READ_ONLY, channels);
+        for (uint8_t channel = 1; channel <= channels; channel++)
+        {
+            addEntry(CMD_CANGO, channel, 4, Access::WRITE_ONLY);
+            addEntry(CMD_SENCNTR, channel, 4, Access::WRITE_ONLY);
+            addEntry(QRY_MOTAMPS, channel, 2, Access::READ_ONLY);
+            addEntry(QRY_ABCNTR, channel, 4, Access::READ_ONLY);
+            addEntry(QRY_BATAMPS, channel, 2, Access::READ_ONLY);
+        }
+
+        // motors start in the middle of their travel
+        for (auto& motor : motors)
+        {
+            if (motor.model.min_position < motor.model.max_position)
+                motor.position = (motor.model.min_position + motor.model.max_position) / 2;
+            setInteger(QRY_ABCNTR, motor.model.encoder, std::lround(motor.position));
+        }
+    }
+
+    double SimulatedRoboteq::speed(uint8_t channel) const
+    {
+        if (channel < 1 || channel > motors.size())
+            return 0;
+        return motors[channel - 1].speed;
+    }
+
+    void SimulatedRoboteq::entryWritten(uint16_t index, uint8_t subindex)
+    {
+        if (index == CMD_CANGO && subindex >= 1 && subindex <= motors.size())
+        {
+            motors[subindex - 1].command = std::max(-1000.0, std::min(1000.0,
+                        static_cast<double>(getSigned(index, subindex))));
+            since_command = 0;
+        }
+        else if (index == CMD_SENCNTR)
+        {
+            for (auto& motor : motors)
+                if (motor.model.encoder == subindex)
+                    motor.position = getSigned(index, subindex);
+        }
+    }
+
+    void SimulatedRoboteq::update(double dt)
+    {
+        since_command += dt;
+        if (since_command > watchdog)
+            for (auto& motor : motors)
+                motor.command = 0;
+
+        for (size_t i = 0; i < motors.size(); i++)
+        {
+            Motor& motor = motors[i];
+            const MotorModel& model = motor.model;
+            const double duty = std::abs(motor.command) / 1000.0;
+            const double target = motor.command / 1000.0 * model.max_speed;
+
+            motor.speed += (target - motor.speed) * std::min(1.0, dt / model.time_constant);
+            motor.position += motor.speed * dt;
+
+            bool stalled = false;
+            if (model.min_position < model.max_position
+                    && (motor.position <= model.min_position || motor.position >= model.max_position))
+            {
+                motor.position = std::max(model.min_position, std::min(model.max_position, motor.position));
+                stalled = (motor.position == model.min_position && target < 0)
+                    || (motor.position == model.max_position && target > 0);
+                motor.speed = 0;
+            }
+
+            double amps;
+            if (stalled)
+                amps = model.stall_amps * duty;
+            else
+                amps = model.free_amps * std::abs(motor.speed) / model.max_speed
+                    + model.stall_amps * std::abs(target - motor.speed) / model.max_speed;
+            amps = std::min(amps, model.stall_amps);
+
+            // amps are reported in tenths
+            const uint8_t channel = i + 1;
+            setInteger(QRY_ABCNTR, model.encoder, std::lround(motor.position));
+            setInteger(QRY_MOTAMPS, channel, std::lround(amps * 10));
+            setInteger(QRY_BATAMPS, channel, std::lround(amps * duty * 10));
+        }
+    }
+
+    SimulatedLpms::SimulatedLpms(uint8_t node_id, double rate) :
+        SimulatedNode{node_id, "LPMS-CU2"},
+        yaw_rate{0},
+        forward_acceleration{0},
+        yaw{0},
+        generator{node_id},
+        gyro_noise{0, 0.05},
+        acceleration_noise{0, 0.002}
+    {
+        for (uint16_t axis = 0; axis < 3; axis++)
+        {
+            addEntry(LPMS_GYROSCOPE + axis, 0, 4, Access::READ_ONLY);
+            addEntry(LPMS_EULER + axis, 0, 4, Access::READ_ONLY);
+            addEntry(LPMS_LINEAR_ACCELERATION + axis, 0, 4, Access::READ_ONLY);
+        }
+        for (uint16_t component = 0; component < 4; component++)
+            addEntry(LPMS_QUATERNION + component, 0, 4, Access::READ_ONLY);
+        setFloat(LPMS_QUATERNION, 0, 1.0f);
+
+        // the mapping the IMU ships with, sent on its own clock
+        const uint16_t period = static_cast<uint16_t>(std::lround(1000.0 / rate));
+        setTransmitPdo(0, 0xFE, period, {0x20000020, 0x20010020});
+        setTransmitPdo(1, 0xFE, period, {0x20020020, 0x21000020});
+        setTransmitPdo(2, 0xFE, period, {0x21010020, 0x21020020});
+        setTransmitPdo(3, 0xFE, period, {0x22000020, 0x22010020});
+    }
+
+    void SimulatedLpms::setMotion(double rate, double acceleration)
+    {
+        yaw_rate = rate;
+        forward_acceleration = acceleration;
+    }
+
+    /*
+     * The LPMS reports angles in degrees and accelerations in g.
+     * */
+    void SimulatedLpms::update(double dt)
+    {
+        yaw = std::remainder(yaw + yaw_rate * dt, 2 * PI);
+
+        setFloat(LPMS_GYROSCOPE + 0, 0, gyro_noise(generator));
+        setFloat(LPMS_GYROSCOPE + 1, 0, gyro_noise(generator));
+        setFloat(LPMS_GYROSCOPE + 2, 0, yaw_rate * 180 / PI + gyro_noise(generator));
+
+        setFloat(LPMS_EULER + 0, 0, 0);
+        setFloat(LPMS_EULER + 1, 0, 0);
+        setFloat(LPMS_EULER + 2, 0, yaw * 180 / PI);
+
+        setFloat(LPMS_LINEAR_ACCELERATION + 0, 0,
+                forward_acceleration / GRAVITY + acceleration_noise(generator));
+        setFloat(LPMS_LINEAR_ACCELERATION + 1, 0, acceleration_noise(generator));
+        setFloat(LPMS_LINEAR_ACCELERATION + 2, 0, acceleration_noise(generator));
+
+        setFloat(LPMS_QUATERNION + 0, 0, std::cos(yaw / 2));
+        setFloat(LPMS_QUATERNION + 1, 0, 0);
+        setFloat(LPMS_QUATERNION + 2, 0, 0);
+        setFloat(LPMS_QUATERNION + 3, 0, std::sin(yaw / 2));
+    }
+}
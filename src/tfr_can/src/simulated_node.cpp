@@ -0,0 +1,469 @@
+#include "simulated_node.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace tfr_can
+{
+    // CANopen communication profile (CiA 301) function codes and states
+    const uint32_t NMT_COB_ID = 0x000;
+    const uint32_t SYNC_COB_ID = 0x080;
+    const uint32_t SDO_RESPONSE_BASE = 0x580;
+    const uint32_t SDO_REQUEST_BASE = 0x600;
+    const uint32_t HEARTBEAT_BASE = 0x700;
+    const uint32_t TPDO_COB_ID_BASE = 0x180;
+    const uint32_t RPDO_COB_ID_BASE = 0x200;
+    const uint32_t PDO_DISABLED = 0x80000000;
+
+    const uint16_t HEARTBEAT_PRODUCER_INDEX = 0x1017;
+    const uint16_t TPDO_COMMUNICATION_INDEX = 0x1800;
+    const uint16_t TPDO_MAPPING_INDEX = 0x1A00;
+    const uint16_t RPDO_COMMUNICATION_INDEX = 0x1400;
+    const uint16_t RPDO_MAPPING_INDEX = 0x1600;
+
+    const uint8_t STATE_BOOT_UP = 0x00;
+    const uint8_t STATE_STOPPED = 0x04;
+    const uint8_t STATE_OPERATIONAL = 0x05;
+    const uint8_t STATE_PRE_OPERATIONAL = 0x7F;
+
+    // SDO abort codes
+    const uint32_t ABORT_TOGGLE_BIT = 0x05030000;
+    const uint32_t ABORT_INVALID_COMMAND = 0x05040001;
+    const uint32_t ABORT_WRITE_ONLY = 0x06010001;
+    const uint32_t ABORT_READ_ONLY = 0x06010002;
+    const uint32_t ABORT_NO_OBJECT = 0x06020000;
+    const uint32_t ABORT_LENGTH = 0x06070010;
+
+    SimulatedNode::SimulatedNode(uint8_t id, const std::string& device_name) :
+        node_id{id},
+        nmt_state{STATE_PRE_OPERATIONAL},
+        guard_toggle{false},
+        upload{false, false, 0, 0},
+        heartbeat_elapsed{0},
+        sync_count{0},
+        pdo_elapsed{}
+    {
+        addEntry(0x1000, 0, 4, Access::READ_ONLY, 0x00000191); // device type
+        addEntry(0x1001, 0, 1, Access::READ_ONLY);              // error register
+        addStringEntry(0x1008, 0, device_name);
+        addEntry(HEARTBEAT_PRODUCER_INDEX, 0, 2, Access::READ_WRITE, 1000);
+        addEntry(0x1018, 0, 1, Access::READ_ONLY, 4);           // identity
+        for (uint8_t sub = 1; sub <= 4; sub++)
+            addEntry(0x1018, sub, 4, Access::READ_ONLY);
+
+        for (uint8_t pdo = 0; pdo < NUM_TPDOS; pdo++)
+        {
+            const uint16_t communication = TPDO_COMMUNICATION_INDEX + pdo;
+            addEntry(communication, 0, 1, Access::READ_ONLY, 5);
+            addEntry(communication, 1, 4, Access::READ_WRITE,
+                    TPDO_COB_ID_BASE + 0x100 * pdo + node_id);
+            addEntry(communication, 2, 1, Access::READ_WRITE, 0xFE);
+            addEntry(communication, 3, 2, Access::READ_WRITE);
+            addEntry(communication, 5, 2, Access::READ_WRITE);
+
+            const uint16_t mapping = TPDO_MAPPING_INDEX + pdo;
+            addEntry(mapping, 0, 1, Access::READ_WRITE);
+            for (uint8_t sub = 1; sub <= 8; sub++)
+                addEntry(mapping, sub, 4, Access::READ_WRITE);
+        }
+
+        // Like the Roboteq, only the mapping of a receive PDO can change
+        for (uint8_t pdo = 0; pdo < NUM_RPDOS; pdo++)
+        {
+            const uint16_t communication = RPDO_COMMUNICATION_INDEX + pdo;
+            addEntry(communication, 0, 1, Access::READ_ONLY, 2);
+            addEntry(communication, 1, 4, Access::READ_ONLY,
+                    RPDO_COB_ID_BASE + 0x100 * pdo + node_id);
+            addEntry(communication, 2, 1, Access::READ_ONLY, 0xFF);
+
+            const uint16_t mapping = RPDO_MAPPING_INDEX + pdo;
+            addEntry(mapping, 0, 1, Access::READ_WRITE);
+            for (uint8_t sub = 1; sub <= 8; sub++)
+                addEntry(mapping, sub, 4, Access::READ_WRITE);
+        }
+    }
+
+    uint8_t SimulatedNode::nodeId() const
+    {
+        return node_id;
+    }
+
+    void SimulatedNode::boot(std::vector<can_frame>& out)
+    {
+        nmt_state = STATE_PRE_OPERATIONAL;
+        out.push_back(frame(HEARTBEAT_BASE + node_id, {STATE_BOOT_UP}));
+    }
+
+    void SimulatedNode::receive(const can_frame& in, std::vector<can_frame>& out)
+    {
+        const uint32_t cob_id = in.can_id & CAN_SFF_MASK;
+        if (cob_id == NMT_COB_ID)
+        {
+            handleNmt(in, out);
+        }
+        else if (cob_id == SYNC_COB_ID)
+        {
+            handleSync(out);
+        }
+        else if (cob_id == SDO_REQUEST_BASE + node_id && nmt_state != STATE_STOPPED)
+        {
+            handleSdo(in, out);
+        }
+        else if (cob_id == HEARTBEAT_BASE + node_id && (in.can_id & CAN_RTR_FLAG))
+        {
+            // node guarding
+            out.push_back(frame(HEARTBEAT_BASE + node_id,
+                        {static_cast<uint8_t>(nmt_state | (guard_toggle ? 0x80 : 0))}));
+            guard_toggle = !guard_toggle;
+        }
+        else if (operational())
+        {
+            handleReceivePdo(in);
+        }
+    }
+
+    void SimulatedNode::step(double dt, std::vector<can_frame>& out)
+    {
+        update(dt);
+
+        const double heartbeat_period = getUnsigned(HEARTBEAT_PRODUCER_INDEX, 0) / 1000.0;
+        heartbeat_elapsed += dt;
+        if (heartbeat_period > 0 && heartbeat_elapsed >= heartbeat_period)
+        {
+            heartbeat_elapsed = 0;
+            out.push_back(frame(HEARTBEAT_BASE + node_id, {nmt_state}));
+        }
+
+        if (!operational())
+            return;
+
+        for (uint8_t pdo = 0; pdo < NUM_TPDOS; pdo++)
+        {
+            const uint16_t communication = TPDO_COMMUNICATION_INDEX + pdo;
+            const uint64_t type = getUnsigned(communication, 2);
+            const double period = getUnsigned(communication, 5) / 1000.0;
+            if (type < 0xFE || period <= 0)
+                continue;
+            pdo_elapsed[pdo] += dt;
+            if (pdo_elapsed[pdo] >= period)
+            {
+                pdo_elapsed[pdo] -= period;
+                sendTransmitPdo(pdo, out);
+            }
+        }
+    }
+
+    void SimulatedNode::addEntry(uint16_t index, uint8_t subindex, uint8_t size,
+            Access access, int64_t initial)
+    {
+        dictionary[key(index, subindex)] = Entry{std::vector<uint8_t>(size), access, false};
+        setInteger(index, subindex, initial);
+    }
+
+    void SimulatedNode::addStringEntry(uint16_t index, uint8_t subindex,
+            const std::string& value)
+    {
+        dictionary[key(index, subindex)] = Entry{
+            std::vector<uint8_t>(value.begin(), value.end()), Access::READ_ONLY, true};
+    }
+
+    uint64_t SimulatedNode::getUnsigned(uint16_t index, uint8_t subindex) const
+    {
+        const Entry* entry = find(index, subindex);
+        if (entry == nullptr || entry->is_string)
+            return 0;
+        uint64_t value = 0;
+        for (size_t i = 0; i < entry->data.size() && i < 8; i++)
+            value |= static_cast<uint64_t>(entry->data[i]) << (8 * i);
+        return value;
+    }
+
+    int64_t SimulatedNode::getSigned(uint16_t index, uint8_t subindex) const
+    {
+        const Entry* entry = find(index, subindex);
+        uint64_t value = getUnsigned(index, subindex);
+        const size_t bits = entry == nullptr ? 64 : 8 * entry->data.size();
+        if (bits > 0 && bits < 64 && (value >> (bits - 1)) & 1)
+            value |= ~0ull << bits;
+        return static_cast<int64_t>(value);
+    }
+
+    void SimulatedNode::setInteger(uint16_t index, uint8_t subindex, int64_t value)
+    {
+        Entry* entry = find(index, subindex);
+        if (entry == nullptr || entry->is_string)
+            return;
+        for (size_t i = 0; i < entry->data.size(); i++)
+            entry->data[i] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+    }
+
+    void SimulatedNode::setFloat(uint16_t index, uint8_t subindex, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        setInteger(index, subindex, bits);
+    }
+
+    void SimulatedNode::setTransmitPdo(uint8_t pdo, uint8_t transmission_type,
+            uint16_t event_timer_ms, const std::vector<uint32_t>& mapping)
+    {
+        const uint16_t communication = TPDO_COMMUNICATION_INDEX + pdo;
+        setInteger(communication, 2, transmission_type);
+        setInteger(communication, 5, event_timer_ms);
+        const uint16_t map = TPDO_MAPPING_INDEX + pdo;
+        setInteger(map, 0, mapping.size());
+        for (size_t i = 0; i < mapping.size(); i++)
+            setInteger(map, i + 1, mapping[i]);
+    }
+
+    bool SimulatedNode::operational() const
+    {
+        return nmt_state == STATE_OPERATIONAL;
+    }
+
+    uint32_t SimulatedNode::key(uint16_t index, uint8_t subindex)
+    {
+        return static_cast<uint32_t>(index) << 8 | subindex;
+    }
+
+    SimulatedNode::Entry* SimulatedNode::find(uint16_t index, uint8_t subindex)
+    {
+        auto entry = dictionary.find(key(index, subindex));
+        return entry == dictionary.end() ? nullptr : &entry->second;
+    }
+
+    const SimulatedNode::Entry* SimulatedNode::find(uint16_t index, uint8_t subindex) const
+    {
+        auto entry = dictionary.find(key(index, subindex));
+        return entry == dictionary.end() ? nullptr : &entry->second;
+    }
+
+    void SimulatedNode::handleNmt(const can_frame& in, std::vector<can_frame>& out)
+    {
+        if (in.can_dlc < 2 || (in.data[1] != 0 && in.data[1] != node_id))
+            return;
+        switch (in.data[0])
+        {
+            case 0x01:
+                nmt_state = STATE_OPERATIONAL;
+                break;
+            case 0x02:
+                nmt_state = STATE_STOPPED;
+                break;
+            case 0x80:
+                nmt_state = STATE_PRE_OPERATIONAL;
+                break;
+            case 0x81:
+            case 0x82:
+                upload.active = false;
+                sync_count = 0;
+                boot(out);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void SimulatedNode::handleSdo(const can_frame& in, std::vector<can_frame>& out)
+    {
+        if (in.can_dlc < 8)
+            return;
+        const uint8_t command = in.data[0] >> 5;
+        const uint16_t index = in.data[1] | in.data[2] << 8;
+        const uint8_t subindex = in.data[3];
+        const uint8_t index_low = in.data[1], index_high = in.data[2];
+
+        switch (command)
+        {
+            case 1: // initiate download
+            {
+                Entry* entry = find(index, subindex);
+                const bool expedited = in.data[0] & 0x02;
+                const bool size_indicated = in.data[0] & 0x01;
+                const size_t size = size_indicated ? 4 - ((in.data[0] >> 2) & 0x03) : 4;
+                if (entry == nullptr)
+                    out.push_back(sdoAbort(index, subindex, ABORT_NO_OBJECT));
+                else if (entry->access == Access::READ_ONLY)
+                    out.push_back(sdoAbort(index, subindex, ABORT_READ_ONLY));
+                else if (!expedited)
+                    out.push_back(sdoAbort(index, subindex, ABORT_INVALID_COMMAND));
+                else if (size > entry->data.size())
+                    out.push_back(sdoAbort(index, subindex, ABORT_LENGTH));
+                else
+                {
+                    std::fill(entry->data.begin(), entry->data.end(), 0);
+                    std::copy(in.data + 4, in.data + 4 + size, entry->data.begin());
+                    out.push_back(frame(SDO_RESPONSE_BASE + node_id,
+                                {0x60, index_low, index_high, subindex, 0, 0, 0, 0}));
+                    entryWritten(index, subindex);
+                }
+                break;
+            }
+            case 2: // initiate upload
+            {
+                const Entry* entry = find(index, subindex);
+                if (entry == nullptr)
+                {
+                    out.push_back(sdoAbort(index, subindex, ABORT_NO_OBJECT));
+                }
+                else if (entry->access == Access::WRITE_ONLY)
+                {
+                    out.push_back(sdoAbort(index, subindex, ABORT_WRITE_ONLY));
+                }
+                else if (!entry->is_string && entry->data.size() <= 4)
+                {
+                    const uint8_t unused = 4 - entry->data.size();
+                    can_frame reply = frame(SDO_RESPONSE_BASE + node_id,
+                            {static_cast<uint8_t>(0x43 | unused << 2), index_low,
+                            index_high, subindex, 0, 0, 0, 0});
+                    std::copy(entry->data.begin(), entry->data.end(), reply.data + 4);
+                    out.push_back(reply);
+                }
+                else
+                {
+                    const uint32_t size = entry->data.size();
+                    upload = Segmented{true, false, key(index, subindex), 0};
+                    out.push_back(frame(SDO_RESPONSE_BASE + node_id,
+                                {0x41, index_low, index_high, subindex,
+                                static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+                                static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24)}));
+                }
+                break;
+            }
+            case 3: // upload segment
+            {
+                const bool toggle = in.data[0] & 0x10;
+                auto entry = dictionary.find(upload.key);
+                if (!upload.active || entry == dictionary.end())
+                {
+                    out.push_back(sdoAbort(0, 0, ABORT_INVALID_COMMAND));
+                    break;
+                }
+                if (toggle != upload.toggle)
+                {
+                    upload.active = false;
+                    out.push_back(sdoAbort(upload.key >> 8, upload.key & 0xFF, ABORT_TOGGLE_BIT));
+                    break;
+                }
+                const auto& data = entry->second.data;
+                const size_t length = std::min<size_t>(7, data.size() - upload.offset);
+                const bool last = upload.offset + length >= data.size();
+                can_frame reply = frame(SDO_RESPONSE_BASE + node_id, {0, 0, 0, 0, 0, 0, 0, 0});
+                reply.data[0] = (toggle ? 0x10 : 0) | (7 - length) << 1 | (last ? 0x01 : 0);
+                std::copy(data.begin() + upload.offset, data.begin() + upload.offset + length,
+                        reply.data + 1);
+                out.push_back(reply);
+                upload.offset += length;
+                upload.toggle = !upload.toggle;
+                upload.active = !last;
+                break;
+            }
+            case 4: // abort from the master
+                upload.active = false;
+                break;
+            default:
+                out.push_back(sdoAbort(index, subindex, ABORT_INVALID_COMMAND));
+                break;
+        }
+    }
+
+    void SimulatedNode::handleSync(std::vector<can_frame>& out)
+    {
+        if (!operational())
+            return;
+        sync_count++;
+        for (uint8_t pdo = 0; pdo < NUM_TPDOS; pdo++)
+        {
+            const uint64_t type = getUnsigned(TPDO_COMMUNICATION_INDEX + pdo, 2);
+            if (type >= 1 && type <= 240 && sync_count % type == 0)
+                sendTransmitPdo(pdo, out);
+        }
+    }
+
+    /*
+     * Writes the mapped entries of the receive PDO the frame belongs to, if
+     * any. A frame shorter than its mapping is ignored, as CiA 301 allows.
+     * */
+    bool SimulatedNode::handleReceivePdo(const can_frame& in)
+    {
+        const uint32_t cob_id = in.can_id & CAN_SFF_MASK;
+        for (uint8_t pdo = 0; pdo < NUM_RPDOS; pdo++)
+        {
+            const uint32_t pdo_cob_id = getUnsigned(RPDO_COMMUNICATION_INDEX + pdo, 1);
+            if ((pdo_cob_id & PDO_DISABLED) || (pdo_cob_id & CAN_SFF_MASK) != cob_id)
+                continue;
+
+            const uint16_t map = RPDO_MAPPING_INDEX + pdo;
+            const uint64_t count = getUnsigned(map, 0);
+            uint8_t offset = 0;
+            for (uint8_t i = 1; i <= count && i <= 8; i++)
+            {
+                const uint32_t word = getUnsigned(map, i);
+                offset += (word & 0xFF) / 8;
+            }
+            if (count == 0 || offset > in.can_dlc)
+                return false;
+
+            offset = 0;
+            for (uint8_t i = 1; i <= count && i <= 8; i++)
+            {
+                const uint32_t word = getUnsigned(map, i);
+                const uint16_t index = word >> 16;
+                const uint8_t subindex = (word >> 8) & 0xFF;
+                const uint8_t bytes = (word & 0xFF) / 8;
+                Entry* entry = find(index, subindex);
+                if (entry != nullptr && !entry->is_string)
+                {
+                    std::fill(entry->data.begin(), entry->data.end(), 0);
+                    std::copy(in.data + offset,
+                            in.data + offset + std::min<size_t>(bytes, entry->data.size()),
+                            entry->data.begin());
+                    entryWritten(index, subindex);
+                }
+                offset += bytes;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void SimulatedNode::sendTransmitPdo(uint8_t pdo, std::vector<can_frame>& out)
+    {
+        const uint32_t cob_id = getUnsigned(TPDO_COMMUNICATION_INDEX + pdo, 1);
+        const uint16_t map = TPDO_MAPPING_INDEX + pdo;
+        const uint64_t count = getUnsigned(map, 0);
+        if ((cob_id & PDO_DISABLED) || count == 0)
+            return;
+
+        can_frame pdo_frame = frame(cob_id & CAN_SFF_MASK, {});
+        for (uint8_t i = 1; i <= count && i <= 8; i++)
+        {
+            const uint32_t word = getUnsigned(map, i);
+            const Entry* entry = find(word >> 16, (word >> 8) & 0xFF);
+            const uint8_t bytes = (word & 0xFF) / 8;
+            if (entry == nullptr || pdo_frame.can_dlc + bytes > 8)
+                return;
+            for (uint8_t b = 0; b < bytes; b++)
+                pdo_frame.data[pdo_frame.can_dlc++] = b < entry->data.size() ? entry->data[b] : 0;
+        }
+        out.push_back(pdo_frame);
+    }
+
+    can_frame SimulatedNode::sdoAbort(uint16_t index, uint8_t subindex, uint32_t code) const
+    {
+        return frame(SDO_RESPONSE_BASE + node_id,
+                {0x80, static_cast<uint8_t>(index), static_cast<uint8_t>(index >> 8), subindex,
+                static_cast<uint8_t>(code), static_cast<uint8_t>(code >> 8),
+                static_cast<uint8_t>(code >> 16), static_cast<uint8_t>(code >> 24)});
+    }
+
+    can_frame SimulatedNode::frame(uint32_t cob_id, std::initializer_list<uint8_t> data) const
+    {
+        can_frame result;
+        std::memset(&result, 0, sizeof(result));
+        result.can_id = cob_id;
+        result.can_dlc = static_cast<uint8_t>(data.size());
+        std::copy(data.begin(), data.end(), result.data);
+        return result;
+    }
+}
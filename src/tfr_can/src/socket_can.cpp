@@ -0,0 +1,105 @@
+#include "socket_can.h"
+
+#include <ros/ros.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace tfr_can
+{
+    SocketCan::SocketCan() :
+        socket_fd{-1}
+    {}
+
+    SocketCan::~SocketCan()
+    {
+        close();
+    }
+
+    bool SocketCan::open(const std::string& busname, bool receive_errors)
+    {
+        close();
+        socket_fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+        if (socket_fd < 0)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not open a socket: " << strerror(errno));
+            return false;
+        }
+
+        struct ifreq ifr;
+        std::memset(&ifr, 0, sizeof(ifr));
+        std::strncpy(ifr.ifr_name, busname.c_str(), IFNAMSIZ - 1);
+        if (ioctl(socket_fd, SIOCGIFINDEX, &ifr) < 0)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not find " << busname << ": " << strerror(errno));
+            close();
+            return false;
+        }
+
+        if (receive_errors)
+        {
+            can_err_mask_t error_mask = CAN_ERR_MASK;
+            setsockopt(socket_fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &error_mask, sizeof(error_mask));
+        }
+
+        struct sockaddr_can addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = ifr.ifr_ifindex;
+        if (bind(socket_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            ROS_ERROR_STREAM("tfr_can: could not bind to " << busname << ": " << strerror(errno));
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void SocketCan::close()
+    {
+        if (socket_fd >= 0)
+        {
+            ::close(socket_fd);
+            socket_fd = -1;
+        }
+    }
+
+    bool SocketCan::isOpen() const
+    {
+        return socket_fd >= 0;
+    }
+
+    bool SocketCan::send(const struct can_frame& frame)
+    {
+        return write(socket_fd, &frame, sizeof(frame)) == sizeof(frame);
+    }
+
+    bool SocketCan::receive(struct can_frame& frame, std::chrono::microseconds timeout,
+            bool* local)
+    {
+        struct pollfd readable{socket_fd, POLLIN, 0};
+        struct timespec wait;
+        wait.tv_sec = timeout.count() / 1000000;
+        wait.tv_nsec = (timeout.count() % 1000000) * 1000;
+        if (ppoll(&readable, 1, &wait, nullptr) <= 0)
+            return false;
+
+        struct iovec buffer{&frame, sizeof(frame)};
+        struct msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &buffer;
+        message.msg_iovlen = 1;
+        if (recvmsg(socket_fd, &message, 0) != sizeof(frame))
+            return false;
+        // the kernel flags frames looped back from sockets on this machine
+        if (local != nullptr)
+            *local = (message.msg_flags & MSG_DONTROUTE) != 0;
+        return true;
+    }
+}
@@ -0,0 +1,254 @@
+/****************************************************************************************
+ * File:            control.h
+ *
+ * Purpose:         The controller layer of the control node: the controller
+ *                  manager, the hardware layer under it, and the services
+ *                  that switch them on and off. execute() is one cycle of the
+ *                  control loop.
+ *
+ *                  Nothing in a cycle talks to the parameter server or the
+ *                  master: settings come in through services and topics,
+ *                  publishers are created once and messages are reused.
+ *                  Nor does a cycle allocate, as long as nobody subscribes
+ *                  to the motor commands. Once the CAN bridge does, roscpp
+ *                  serializes each command RobotInterface publishes into a
+ *                  buffer it allocates. control_benchmark checks both, and
+ *                  reports how much the commands' publishing allocates.
+ *
+ *                  The IMU is integrated by an ImuIntegrator on a thread of
+ *                  its own, see imu_integrator.h.
+ *
+ *                  Each phase of a cycle (read, controllers, write) is
+ *                  timed, see tfr_utilities/phase_timer.h. A second's worth
+ *                  is published at a time, and the whole run is logged when
+ *                  the node shuts down. Configure with
+ *                  -DPHASE_TIMING=OFF to leave the probes out.
+ *
+ * Publishes To:    ~phase_timing (tfr_msgs/PhaseTimingStats)
+ *
+ * Services:        /toggle_control, /toggle_motors, /bin_state, /arm_state,
+ *                  /zero_turntable, /write_arm_values
+ ***************************************************************************************/
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <ros/ros.h>
+#include <std_srvs/SetBool.h>
+#include <std_srvs/Empty.h>
+#include <tfr_msgs/BinStateSrv.h>
+#include <tfr_msgs/ArmStateSrv.h>
+#include <tfr_msgs/PhaseTimingStats.h>
+#include <tfr_utilities/phase_timer.h>
+#include <controller_manager/controller_manager.h>
+#include <sstream>
+#include <vector>
+#include "imu_integrator.h"
+#include "robot_interface.h"
+
+namespace tfr_control
+{
+    class Control
+    {
+        public:
+            Control(ros::NodeHandle &n, double rate, bool use_fake_values,
+                    const double *lower_limits, const double *upper_limits):
+                robot_interface{n, use_fake_values, lower_limits, upper_limits},
+                controller_interface{&robot_interface},
+                eStopControl{n.advertiseService("toggle_control", &Control::toggleControl,this)},
+                eStopMotors{n.advertiseService("toggle_motors", &Control::toggleControl,this)},
+                binService{n.advertiseService("bin_state", &Control::getBinState,this)},
+                armService{n.advertiseService("arm_state", &Control::getArmState,this)},
+                zeroService{n.advertiseService("zero_turntable", &Control::zeroTurntable,this)},
+                writeArmService{n.advertiseService("write_arm_values", &Control::writeArmValues,this)},
+                cycle{1/rate},
+                enabled{false},
+                imu_integrator{n},
+                phase_timer{{{"read", "controllers", "write"}}}
+            {
+#if TFR_PHASE_TIMING
+                ros::NodeHandle private_n{"~"};
+                phase_timing_pub = private_n.advertise<tfr_msgs::PhaseTimingStats>("phase_timing", 5);
+                phase_timing_timer = n.createTimer(ros::Duration(1.0), &Control::publishPhaseTiming, this);
+                phase_timing_msg.phases.resize(CYCLE_PHASES + 1);
+                phase_window_start = ros::Time::now();
+#endif
+            }
+
+            ~Control()
+            {
+#if TFR_PHASE_TIMING
+                std::ostringstream table;
+                phase_timer.dump(table);
+                ROS_INFO_STREAM("control: time spent in each phase of the control loop\n" << table.str());
+#endif
+            }
+
+            /*
+             * performs one iteration of the control loop
+             * */
+            void execute()
+            {
+                update(ros::Time::now(), cycle);
+                cycle.sleep();
+            }
+
+            /*
+             * performs one iteration of the control loop without sleeping, for
+             * the realtime loop which keeps its own time
+             * */
+            void update(const ros::Time& time, const ros::Duration& period)
+            {
+                TFR_PHASE_BEGIN(phase_timer);
+                //update from hardware
+                robot_interface.read(time);
+                TFR_PHASE_LAP(phase_timer, READ);
+                //update controllers
+                controller_interface.update(time, period);
+                if (!enabled)
+                    robot_interface.clearCommands();
+                TFR_PHASE_LAP(phase_timer, CONTROLLERS);
+                //update hardware from controllers
+                robot_interface.write(time);
+                TFR_PHASE_LAP(phase_timer, WRITE);
+                TFR_PHASE_END(phase_timer);
+            }
+
+        private:
+            //the hardware layer
+            tfr_control::RobotInterface robot_interface;
+
+            //the controller layer
+            controller_manager::ControllerManager controller_interface;
+
+            //emergency stop
+            ros::ServiceServer eStopControl;
+            ros::ServiceServer eStopMotors;
+
+            //state services
+            ros::ServiceServer binService;
+            ros::ServiceServer armService;
+
+            //reset service
+            ros::ServiceServer zeroService;
+
+            //arm output enable
+            ros::ServiceServer writeArmService;
+
+            //how fast to spin
+            ros::Duration cycle;
+
+            //if our motors are enabled
+            bool enabled;
+
+            // dead reckoning from the IMU, on its own thread
+            ImuIntegrator imu_integrator;
+
+            // the phases of update(), in order
+            enum CyclePhase
+            {
+                READ,
+                CONTROLLERS,
+                WRITE,
+                CYCLE_PHASES
+            };
+            // recorded by the loop, read out by the timer on the spinner
+            tfr_utilities::PhaseTimer<CYCLE_PHASES> phase_timer;
+            tfr_utilities::PhaseSummary phase_window[CYCLE_PHASES + 1];
+            ros::Publisher phase_timing_pub;
+            ros::Timer phase_timing_timer;
+            tfr_msgs::PhaseTimingStats phase_timing_msg;
+            ros::Time phase_window_start;
+
+            void publishPhaseTiming(const ros::TimerEvent& event)
+            {
+                const ros::Time now = ros::Time::now();
+                phase_timer.takeWindow(phase_window);
+                phase_timing_msg.header.stamp = now;
+                phase_timing_msg.window = (now - phase_window_start).toSec();
+                phase_window_start = now;
+                for (int i = 0; i <= CYCLE_PHASES; i++)
+                {
+                    const tfr_utilities::PhaseSummary& summary = phase_window[i];
+                    auto& phase = phase_timing_msg.phases[i];
+                    phase.name = summary.name;
+                    phase.count = static_cast<uint32_t>(summary.count);
+                    phase.mean = summary.mean * 1e-9;
+                    phase.p50 = summary.p50 * 1e-9;
+                    phase.p99 = summary.p99 * 1e-9;
+                    phase.p999 = summary.p999 * 1e-9;
+                    phase.max = summary.max * 1e-9;
+                }
+                phase_timing_pub.publish(phase_timing_msg);
+            }
+
+            /*
+             * Toggles the emergency stop on and off
+             * */
+            bool toggleControl(std_srvs::SetBool::Request& request,
+                    std_srvs::SetBool::Response& response)
+            {
+                enabled = request.data;
+                robot_interface.setEnabled(request.data);
+                return true;
+            }
+
+            /*
+             * Toggles the emergency stop on and off
+             * */
+            bool toggleMotors(std_srvs::SetBool::Request& request,
+                    std_srvs::SetBool::Response& response)
+            {
+                enabled = request.data;
+                robot_interface.setEnabled(request.data);
+                return true;
+            }
+
+
+            /*
+             * Gets the state of the bin
+             * */
+            bool getBinState(tfr_msgs::BinStateSrv::Request& request,
+                    tfr_msgs::BinStateSrv::Response& response)
+            {
+                response.state = static_cast<double>(robot_interface.getBinState());
+                return true;
+            }
+
+            /*
+             * Gets the state of the arm
+             * */
+            bool getArmState(tfr_msgs::ArmStateSrv::Request& request,
+                    tfr_msgs::ArmStateSrv::Response& response)
+            {
+                std::vector<double> states{};
+                robot_interface.getArmState(states);
+                response.states = states;
+                return true;
+            }
+
+            /*
+             * Turns writing the arm commands to the motor controllers on and off
+             * */
+            bool writeArmValues(std_srvs::SetBool::Request& request,
+                    std_srvs::SetBool::Response& response)
+            {
+                robot_interface.setWriteArmValues(request.data);
+                response.success = true;
+                return true;
+            }
+
+            /*
+             * Toggles the emergency stop on and off
+             * */
+            bool zeroTurntable(std_srvs::Empty::Request& request,
+                    std_srvs::Empty::Response& response)
+            {
+                robot_interface.zeroTurntable();
+                return true;
+            }
+
+
+    };
+}
+
+#endif // CONTROL_H
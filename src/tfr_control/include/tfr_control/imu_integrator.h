@@ -0,0 +1,75 @@
+/****************************************************************************************
+ * File:            imu_integrator.h
+ *
+ * Purpose:         Dead reckoning from the IMU, off the control loop.
+ *
+ *                  Takes each sensor_msgs/Imu the CAN bridge assembles and
+ *                  integrates it with tfr_utilities::ImuPreintegrator, over
+ *                  the time between the samples' stamps. The orientation
+ *                  comes from the gyroscope less its bias, the acceleration
+ *                  has gravity and its bias taken out, and both biases are
+ *                  learned whenever the robot stands still.
+ *
+ *                  The subscription has a callback queue and a spinner
+ *                  thread of its own, so samples are integrated as they
+ *                  arrive, at the IMU's rate, whatever the control loop or
+ *                  the node's other callbacks are doing.
+ *
+ * Parameters:      ~imu/gravity (m/s^2, default 0, the LPMS's linear
+ *                      acceleration has it taken out already)
+ *                  ~imu/max_dt (s, default 0.1) longer gaps restart it
+ *                  ~imu/gyro_noise (rad/s/sqrt(Hz), default 0.00087)
+ *                  ~imu/orientation_gain (1/s, default 0.1) how fast the
+ *                      tilt follows the sensor's own orientation
+ *                  ~imu/stationary_gyro (rad/s, default 0.02),
+ *                  ~imu/stationary_acceleration (m/s^2, default 0.1),
+ *                  ~imu/stationary_time (s, default 0.5) what standing still is
+ *                  ~imu/bias_time_constant (s, default 5.0)
+ *
+ * Subscribes To:   /device120/imu (sensor_msgs/Imu) from the CAN bridge
+ *
+ * Publishes To:    /sensors/mti/sensor/imu (sensor_msgs/Imu) corrected, one
+ *                      per sample
+ *                  /sensors/orientation_prior (tfr_msgs/OrientationPrior)
+ *                      heading for the drivebase odometry, one per sample
+ ***************************************************************************************/
+#ifndef IMU_INTEGRATOR_H
+#define IMU_INTEGRATOR_H
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <sensor_msgs/Imu.h>
+#include <tfr_msgs/OrientationPrior.h>
+#include <tfr_utilities/imu_preintegrator.h>
+
+namespace tfr_control
+{
+    class ImuIntegrator
+    {
+    public:
+        /*
+         * Reads its parameters and starts integrating.
+         * */
+        explicit ImuIntegrator(ros::NodeHandle& n);
+        ~ImuIntegrator();
+        ImuIntegrator(const ImuIntegrator&) = delete;
+        ImuIntegrator& operator=(const ImuIntegrator&) = delete;
+
+    private:
+        ros::CallbackQueue queue;
+        ros::NodeHandle node;
+        ros::AsyncSpinner spinner;
+
+        tfr_utilities::ImuPreintegrator integrator;
+        ros::Subscriber imu_sub;
+        ros::Publisher imu_pub;
+        ros::Publisher prior_pub;
+        sensor_msgs::Imu imu_msg;
+        tfr_msgs::OrientationPrior prior_msg;
+
+        static tfr_utilities::ImuPreintegrator::Settings loadSettings();
+        void integrate(const sensor_msgs::Imu::ConstPtr& msg);
+    };
+}
+
+#endif // IMU_INTEGRATOR_H
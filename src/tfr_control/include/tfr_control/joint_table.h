@@ -0,0 +1,134 @@
+/****************************************************************************************
+ * File:            joint_table.h
+ *
+ * Purpose:         Everything RobotInterface knows about each joint's hardware,
+ *                  one row per joint in tfr_utilities::Joint order.
+ *
+ *                  The row says which motor controller topics the joint is
+ *                  read and commanded through, how its encoder maps onto the
+ *                  joint, and which way its motor is mounted. RobotInterface
+ *                  splits the table into per-joint arrays once and read() and
+ *                  write() only walk those, so connecting a joint is a matter
+ *                  of filling in its row here.
+ *
+ *                  Slot names in the CAN snapshot are the topics without
+ *                  their leading slash.
+ ***************************************************************************************/
+#ifndef JOINT_TABLE_H
+#define JOINT_TABLE_H
+
+#include <tfr_utilities/joints.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace tfr_control
+{
+    enum class JointKind
+    {
+        // driven at a velocity, velocity fed back from the encoder, always
+        // written
+        TREAD,
+        // position fed back from the encoder, only written with
+        // /write_arm_values and only to real hardware
+        ARM,
+        // position fed back from the encoder like ARM, but always written
+        BIN,
+        // no hardware behind it yet, state stays zero and commands go nowhere
+        UNCONNECTED,
+    };
+
+    struct JointDescriptor
+    {
+        tfr_utilities::Joint joint;
+        JointKind kind;
+        // must match the joint names in the URDF and controllers.yaml
+        const char* name;
+        // namespace of the joint's own controller when it takes a single
+        // std_msgs/Float64 command, which is then the joint's setpoint, and
+        // its pid_debug topics go under it. nullptr for the others.
+        const char* controller;
+        // nullptr where the joint doesn't have one. amps_topic is the motor
+        // current, std_msgs/Int16 in ROBOTEQ_AMPS_PER_COUNT.
+        const char* encoder_topic;
+        const char* amps_topic;
+        const char* command_topic;
+        // a second motor driven with the same command, when two move the
+        // joint together
+        const char* twin_command_topic;
+        // the encoder reads encoder_min at joint_min and encoder_max at
+        // joint_max, linear in between. For the treads that is meters of
+        // tread over one motor revolution.
+        int32_t encoder_min;
+        int32_t encoder_max;
+        double joint_min;
+        double joint_max;
+        // -1 where the motor is mounted backwards
+        int32_t command_sign;
+    };
+
+    constexpr double TREAD_METERS_PER_REVOLUTION = 2 * 3.14159265358979 * 0.1524;
+
+    // the Roboteqs report current in tenths of an amp
+    constexpr double ROBOTEQ_AMPS_PER_COUNT = 0.1;
+
+    constexpr JointDescriptor JOINT_TABLE[] = {
+        {tfr_utilities::Joint::LEFT_TREAD, JointKind::TREAD, "left_tread_joint", "/left_tread_velocity_controller",
+            "/device8/get_qry_abcntr/channel_1", nullptr, "/device8/set_cmd_cango/cmd_cango_1", nullptr,
+            0, 5120, 0.0, TREAD_METERS_PER_REVOLUTION, -1},
+        {tfr_utilities::Joint::RIGHT_TREAD, JointKind::TREAD, "right_tread_joint", "/right_tread_velocity_controller",
+            "/device8/get_qry_abcntr/channel_2", nullptr, "/device8/set_cmd_cango/cmd_cango_2", nullptr,
+            0, 5120, 0.0, TREAD_METERS_PER_REVOLUTION, -1},
+        // twin actuators on channels 2 and 3, fed back from the encoder and
+        // current on channel 3. Retracted at 0 and extended at the URDF's
+        // upper limit. The extended count is only estimated from the arm
+        // actuators' strokes, RobotInterface takes the measured one from
+        // ~bin_encoder_max.
+        {tfr_utilities::Joint::BIN, JointKind::BIN, "bin_joint", "/bin_position_controller",
+            "/device12/get_qry_abcntr/channel_3", "/device12/get_qry_motamps/channel_3",
+            "/device12/set_cmd_cango/cmd_cango_3", "/device12/set_cmd_cango/cmd_cango_2",
+            0, 850, 0.0, 3.14159265358979 / 4, 1},
+        {tfr_utilities::Joint::TURNTABLE, JointKind::ARM, "turntable_joint", nullptr,
+            "/device4/get_qry_abcntr/channel_1", "/device4/get_qry_motamps/channel_1",
+            "/device4/set_cmd_cango/cmd_cango_1", nullptr,
+            -25760, 25760, -2 * 3.14159265358979, 2 * 3.14159265358979, -1},
+        // "channel_2" is correct for the encoder. Reads 888 all the way up
+        // (actuator extended) and 0 all the way down. Mounted backwards.
+        {tfr_utilities::Joint::LOWER_ARM, JointKind::ARM, "lower_arm_joint", nullptr,
+            "/device12/get_qry_abcntr/channel_2", "/device12/get_qry_motamps/channel_1",
+            "/device12/set_cmd_cango/cmd_cango_1", nullptr,
+            888, 0, 0.104, 1.55, -1},
+        // arm up at encoder_min, down with the actuator extended at encoder_max
+        {tfr_utilities::Joint::UPPER_ARM, JointKind::ARM, "upper_arm_joint", nullptr,
+            "/device4/get_qry_abcntr/channel_3", "/device4/get_qry_motamps/channel_3",
+            "/device4/set_cmd_cango/cmd_cango_3", nullptr,
+            836, 0, 0.98, 2.4, 1},
+        // scoop open at encoder_min, closed with the actuator extended at
+        // encoder_max
+        {tfr_utilities::Joint::SCOOP, JointKind::ARM, "scoop_joint", nullptr,
+            "/device4/get_qry_abcntr/channel_2", "/device4/get_qry_motamps/channel_2",
+            "/device4/set_cmd_cango/cmd_cango_2", nullptr,
+            1721, 0, -1.16614, 1.62, 1},
+    };
+
+    static_assert(sizeof(JOINT_TABLE) / sizeof(JOINT_TABLE[0]) == tfr_utilities::Joint::JOINT_COUNT,
+            "JOINT_TABLE needs exactly one row per joint");
+
+    constexpr bool jointTableInOrder(std::size_t row = 0)
+    {
+        return row == tfr_utilities::Joint::JOINT_COUNT
+            || (JOINT_TABLE[row].joint == static_cast<tfr_utilities::Joint>(row)
+                && jointTableInOrder(row + 1));
+    }
+    static_assert(jointTableInOrder(), "JOINT_TABLE rows must be in tfr_utilities::Joint order");
+
+    /*
+     * Joint units per encoder count.
+     * */
+    constexpr double encoderScale(const JointDescriptor& row)
+    {
+        return row.encoder_max == row.encoder_min ? 0.0
+            : (row.joint_max - row.joint_min) / (row.encoder_max - row.encoder_min);
+    }
+}
+
+#endif // JOINT_TABLE_H
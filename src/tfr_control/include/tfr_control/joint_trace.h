@@ -0,0 +1,115 @@
+/****************************************************************************************
+ * File:            joint_trace.h
+ *
+ * Purpose:         Full rate trace of every joint, taken off the control loop.
+ *
+ *                  RobotInterface::write() pushes one JointTraceRecord per
+ *                  cycle into a SpscRing, which is all the loop pays for. A
+ *                  background thread drains the ring every 10ms and
+ *                  - appends every record to ~trace_file, if set, and
+ *                  - publishes the newest record at ~trace_rate, as
+ *                    ~joint_trace and as the pid_debug topics of every joint
+ *                    with a controller in JOINT_TABLE.
+ *                  When the ring is full the record is dropped and counted,
+ *                  the loop never waits on the trace.
+ *
+ *                  The file is a JointTraceFileHeader followed by the raw
+ *                  records, in the machine's byte order.
+ *
+ * Publishes To:    ~joint_trace (tfr_msgs/JointTrace)
+ *                  <controller>/pid_debug/setpoint (std_msgs/Float64)
+ *                  <controller>/pid_debug/state (std_msgs/Float64)
+ *                  <controller>/pid_debug/command (std_msgs/Int32)
+ ***************************************************************************************/
+#ifndef JOINT_TRACE_H
+#define JOINT_TRACE_H
+
+#include <ros/ros.h>
+#include <std_msgs/Float64.h>
+#include <std_msgs/Int32.h>
+#include <tfr_msgs/JointTrace.h>
+#include <tfr_utilities/joints.h>
+#include <tfr_utilities/spsc_ring.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+namespace tfr_control
+{
+    /*
+     * One control cycle, by joint. Floats keep it to a couple of cache
+     * lines.
+     * */
+    struct JointTraceRecord
+    {
+        uint64_t stamp;     // nanoseconds, ros::Time
+        float setpoint[tfr_utilities::Joint::JOINT_COUNT];
+        float position[tfr_utilities::Joint::JOINT_COUNT];
+        float velocity[tfr_utilities::Joint::JOINT_COUNT];
+        float current[tfr_utilities::Joint::JOINT_COUNT];
+        int32_t command[tfr_utilities::Joint::JOINT_COUNT];
+    };
+
+    struct JointTraceFileHeader
+    {
+        char magic[8];          // "TFRTRACE"
+        uint32_t version;
+        uint32_t joint_count;
+        uint32_t record_size;   // sizeof(JointTraceRecord)
+    };
+
+    class JointTrace
+    {
+    public:
+        /*
+         * file is where to append every record, empty for none. rate is how
+         * often to publish, 0 for never.
+         * */
+        JointTrace(ros::NodeHandle& n, const std::string& file, double rate);
+        ~JointTrace();
+        JointTrace(const JointTrace&) = delete;
+        JointTrace& operator=(const JointTrace&) = delete;
+
+        /*
+         * Control thread only. Never blocks; returns false if the record was
+         * dropped.
+         * */
+        bool push(const JointTraceRecord& record)
+        {
+            if (!ring.push(record))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        // a second and more of cycles at 1kHz
+        tfr_utilities::SpscRing<JointTraceRecord, 2048> ring;
+        std::atomic<uint32_t> dropped;
+
+        std::FILE* trace_file;
+        const uint64_t publish_period;  // nanoseconds, 0 for never
+        uint64_t last_publish;
+
+        ros::Publisher trace_publisher;
+        tfr_msgs::JointTrace trace_msg;
+        ros::Publisher pid_debug_setpoint[tfr_utilities::Joint::JOINT_COUNT];
+        ros::Publisher pid_debug_state[tfr_utilities::Joint::JOINT_COUNT];
+        ros::Publisher pid_debug_command[tfr_utilities::Joint::JOINT_COUNT];
+        std_msgs::Float64 setpoint_msg, state_msg;
+        std_msgs::Int32 command_msg;
+
+        std::thread drain_thread;
+        std::atomic<bool> running;
+
+        void drain();
+        bool drainRing(JointTraceRecord& newest);
+        void publish(const JointTraceRecord& record);
+    };
+}
+
+#endif // JOINT_TRACE_H
@@ -0,0 +1,77 @@
+/****************************************************************************************
+ * File:            realtime_loop.h
+ *
+ * Purpose:         Runs the control cycle on its own thread, for ~realtime.
+ *
+ *                  The thread is SCHED_FIFO, optionally pinned to one CPU,
+ *                  and wakes on absolute CLOCK_MONOTONIC deadlines, so a slow
+ *                  cycle doesn't push every later one back the way a relative
+ *                  sleep does. ROS callbacks stay on the node's AsyncSpinner
+ *                  and never run on this thread.
+ *
+ *                  Every cycle's period, wake up jitter and run time are
+ *                  recorded, and once a second they are published and reset.
+ *                  A cycle that is still running when the next one is due
+ *                  counts as an overrun, and the missed deadlines are
+ *                  skipped rather than run back to back.
+ *
+ * Publishes To:    ~loop_stats (tfr_msgs/ControlLoopStats)
+ ***************************************************************************************/
+#ifndef REALTIME_LOOP_H
+#define REALTIME_LOOP_H
+
+#include <ros/ros.h>
+#include <tfr_msgs/ControlLoopStats.h>
+#include <tfr_utilities/latency_histogram.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace tfr_control
+{
+    class RealtimeLoop
+    {
+    public:
+        // called with the time of the cycle and how long it has been since the last one
+        using Cycle = std::function<void(const ros::Time&, const ros::Duration&)>;
+
+        /*
+         * priority is the SCHED_FIFO priority (1-99), cpu the one to pin the
+         * thread to, or -1 to let it run anywhere.
+         * */
+        RealtimeLoop(ros::NodeHandle& n, double rate, int priority, int cpu, Cycle cycle);
+        ~RealtimeLoop();
+        RealtimeLoop(const RealtimeLoop&) = delete;
+        RealtimeLoop& operator=(const RealtimeLoop&) = delete;
+
+        void start();
+        void stop();
+
+    private:
+        const uint64_t period;     // nanoseconds
+        const int priority;
+        const int cpu;
+        const Cycle cycle;
+
+        std::thread loop_thread;
+        std::atomic<bool> running;
+
+        // written by the loop, read and reset by the stats timer
+        tfr_utilities::LatencyHistogram periods;
+        tfr_utilities::LatencyHistogram jitter;
+        tfr_utilities::LatencyHistogram execution;
+        std::atomic<uint64_t> overruns;
+
+        ros::Publisher stats_publisher;
+        ros::Timer stats_timer;
+        tfr_msgs::ControlLoopStats stats_msg;
+        ros::Time window_start;
+
+        void run();
+        void configureThread();
+        void publishStats(const ros::TimerEvent& event);
+    };
+}
+
+#endif // REALTIME_LOOP_H
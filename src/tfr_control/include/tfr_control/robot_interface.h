@@ -16,19 +16,33 @@
 
 #include <ros/ros.h>
 #include <std_msgs/Float64.h>
+#include <std_msgs/Int16.h>
 #include <std_msgs/Int32.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/joint_state_interface.h>
 #include <hardware_interface/robot_hw.h>
+#include <hardware_interface/controller_info.h>
+#include <list>
 #include <utility>
 #include <algorithm>
 #include <tfr_msgs/ArduinoAReading.h>
 #include <tfr_msgs/ArduinoBReading.h>
 #include <tfr_msgs/PwmCommand.h>
+#include <tfr_msgs/CurrentLimitEvent.h>
+#include <tfr_utilities/can_snapshot.h>
 #include <tfr_utilities/control_code.h>
+#include <tfr_utilities/current_limiter.h>
 #include <tfr_utilities/joints.h>
+#include <tfr_utilities/seqlock.h>
+#include <tfr_utilities/spsc_ring.h>
+#include <tfr_utilities/velocity_estimator.h>
+#include "joint_table.h"
+#include "joint_trace.h"
+#include "simulated_hardware.h"
+#include "tread_odometry.h"
 #include <vector>
-#include <mutex>
+#include <memory>
+#include <atomic>
 #include <limits>
 #include <ros/ros.h>
 #include <tf/transform_broadcaster.h>
@@ -54,15 +68,15 @@ namespace tfr_control {
         
         /*
          * Reads state from hardware (encoders/potentiometers) and writes it to
-         * shared memory 
+         * shared memory. time is the cycle's.
          * */
-        void read();
+        void read(const ros::Time& time);
 	
         /*
          * Takes commanded states from shared memory, enforces basic safety
          * contraints, and writes them to hardware
          * */
-        void write();
+        void write(const ros::Time& time);
 	
 	
         /*
@@ -82,8 +96,27 @@ namespace tfr_control {
         void clearCommands();
 	
         void setEnabled(bool val);
+
+        /*
+         * The acceleration of a joint as of the last read(), m/s^2 for the
+         * treads. Zero for the joints that don't estimate it.
+         * */
+        double getAcceleration(tfr_utilities::Joint joint) const;
+	
+        /*
+         * Whether the arm commands are sent to the motor controllers, set
+         * through the /write_arm_values service.
+         * */
+        void setWriteArmValues(bool val);
 	
         void zeroTurntable();
+
+        /*
+         * Tracks which joints are commanded by position, see
+         * positionCommand().
+         * */
+        void doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
+                const std::list<hardware_interface::ControllerInfo>& stop_list) override;
         
 		
 		
@@ -100,139 +133,177 @@ namespace tfr_control {
 
         double turntable_offset;
 
-		// Read the relative velocity counters from the brushless motor controller
-		ros::Subscriber brushless_right_tread_vel;
-		ros::Subscriber brushless_left_tread_vel;
-		
-		volatile ros::Subscriber turntable_subscriber_encoder;
-		volatile ros::Subscriber turntable_subscriber_amps;
-		ros::Publisher  turntable_publisher;
-		volatile int32_t turntable_encoder = 0;
-		volatile double turntable_amps = 0.0;
-		std::mutex turntable_mutex;
-		
-		volatile ros::Subscriber lower_arm_subscriber_encoder;
-		volatile ros::Subscriber lower_arm_subscriber_amps;
-		ros::Publisher  lower_arm_publisher;
-		volatile int32_t lower_arm_encoder = 0;
-		volatile double lower_arm_amps = 0.0;
-		std::mutex lower_arm_mutex;
-		
-		volatile ros::Subscriber upper_arm_subscriber_encoder;
-		volatile ros::Subscriber upper_arm_subscriber_amps;
-		ros::Publisher  upper_arm_publisher;
-		volatile int32_t upper_arm_encoder = 0;
-		volatile double upper_arm_amps = 0.0;
-		std::mutex upper_arm_mutex;
-		
-		volatile ros::Subscriber scoop_subscriber_encoder;
-		volatile ros::Subscriber scoop_subscriber_amps;
-		ros::Publisher  scoop_publisher;
-		volatile int32_t scoop_encoder = 0;
-		volatile double scoop_amps = 0.0;
-		std::mutex scoop_mutex;
-		
-		void readTurntableEncoder(const std_msgs::Int32 &msg);
-		void readTurntableAmps(const std_msgs::Float64 &msg);
-		
-		void readLowerArmEncoder(const std_msgs::Int32 &msg);
-		void readLowerArmAmps(const std_msgs::Float64 &msg);
-		
-		void readUpperArmEncoder(const std_msgs::Int32 &msg);
-		void readUpperArmAmps(const std_msgs::Float64 &msg);
-		
-		void readScoopEncoder(const std_msgs::Int32 &msg);
-		void readScoopAmps(const std_msgs::Float64 &msg);
-		
-		ros::Publisher brushless_right_tread_vel_publisher;
-		ros::Publisher brushless_left_tread_vel_publisher;
-		
-		
-		std::mutex brushless_right_tread_mutex;
-		int32_t accumulated_brushless_right_tread_vel = 0;
-		int32_t accumulated_brushless_right_tread_vel_num_updates = 0;
-		ros::Time accumulated_brushless_right_tread_vel_start_time;
-		ros::Time accumulated_brushless_right_tread_vel_end_time;
-		
-		
-		
-		void setBrushlessLeftEncoder(const std_msgs::Int32 &msg);
-		void setBrushlessRightEncoder(const std_msgs::Int32 &msg);
-		
-		int32_t left_tread_absolute_encoder_previous = 0;
-		int32_t left_tread_absolute_encoder_current = 0;
-		ros::Time left_tread_time_previous;
-		ros::Time left_tread_time_current;
-		
-		int32_t right_tread_absolute_encoder_previous = 0;
-		int32_t right_tread_absolute_encoder_current = 0;
-		ros::Time right_tread_time_previous;
-		ros::Time right_tread_time_current;
-		
-		const double pi = 3.14159265358979;
-		
-		std::mutex brushless_left_tread_mutex;
-		int32_t accumulated_brushless_left_tread_vel = 0;
-		int32_t accumulated_brushless_left_tread_vel_num_updates = 0;
-		ros::Time accumulated_brushless_left_tread_vel_start_time;
-		ros::Time accumulated_brushless_left_tread_vel_end_time;
-		
-		
-		void accumulateBrushlessRightVel(const std_msgs::Int32 &msg);
-		void accumulateBrushlessLeftVel(const std_msgs::Int32 &msg);
-		
-		
-		double readBrushlessRightVel();
-		double readBrushlessLeftVel();
-		
-		const bool enable_left_tread_pid_debug_output = true;
-		
-		ros::Publisher left_tread_publisher_pid_debug_setpoint;
-		ros::Publisher left_tread_publisher_pid_debug_state;
-		ros::Publisher left_tread_publisher_pid_debug_command;
-		
-		
-		const int32_t brushless_encoder_count_per_revolution = 5120;
-		double brushlessEncoderCountToRadians(int32_t encoder_count);
-		double brushlessEncoderCountToRevolutions(int32_t encoder_count);
-		double encoderDeltaToLinearSpeed(int32_t encoder_delta, ros::Duration time_delta);
-		
-        int32_t bin_encoder_min = 0;
-        int32_t bin_encoder_max = 1000;
-        double bin_joint_min = 0.0;
-        double bin_joint_max = 0.0;
+		/*
+		 * JOINT_TABLE split into one array per column, filled in once by the
+		 * constructor so read() and write() are plain loops over joints.
+		 * Only ARM and BIN joints have a position scale and offset, the rest are
+		 * zero and read a position of 0 through the same line. Joints
+		 * without a current reading have no effort_per_amp.
+		 * */
+		JointKind joint_kind[tfr_utilities::Joint::JOINT_COUNT];
+		double position_offset[tfr_utilities::Joint::JOINT_COUNT]{};
+		double position_scale[tfr_utilities::Joint::JOINT_COUNT]{};
+		double velocity_scale[tfr_utilities::Joint::JOINT_COUNT]{};
+		double command_sign[tfr_utilities::Joint::JOINT_COUNT]{};
+		double effort_per_amp[tfr_utilities::Joint::JOINT_COUNT]{};
+		
+		// by joint, empty where the table has no topic
+		ros::Subscriber encoder_subscribers[tfr_utilities::Joint::JOINT_COUNT];
+		ros::Subscriber amps_subscribers[tfr_utilities::Joint::JOINT_COUNT];
+		ros::Publisher command_publishers[tfr_utilities::Joint::JOINT_COUNT];
+		ros::Publisher twin_publishers[tfr_utilities::Joint::JOINT_COUNT];
+		// reused every cycle
+		std_msgs::Int32 command_msgs[tfr_utilities::Joint::JOINT_COUNT];
+		
+		/*
+		 * Everything the feedback callbacks receive, by joint. The callbacks
+		 * run on the node's single spinner thread and publish into sensors
+		 * without waiting; read() takes one copy of it per cycle, so every
+		 * joint in a cycle comes from the same moment. Stamps are
+		 * nanoseconds, ros::Time from the topics or the snapshot's clock.
+		 * */
+		struct SensorState
+		{
+		    int32_t encoder[tfr_utilities::Joint::JOINT_COUNT];
+		    uint64_t encoder_stamp[tfr_utilities::Joint::JOINT_COUNT];
+		    double amps[tfr_utilities::Joint::JOINT_COUNT];
+		    uint64_t amps_stamp[tfr_utilities::Joint::JOINT_COUNT];
+		};
+		tfr_utilities::SeqLock<SensorState> sensors;
+		// the control thread's copy for this cycle
+		SensorState sensor_state{};
+		
+		void receiveEncoder(tfr_utilities::Joint joint, int32_t encoder);
+		void receiveAmps(tfr_utilities::Joint joint, double amps);
+		
+		/*
+		 * Reading straight from the CAN bridge's shared snapshot instead of
+		 * the device topics (~use_can_snapshot), through the same topics'
+		 * slots. Samples older than ~can_snapshot_max_age seconds are
+		 * left out, and a joint with a reading that old, or none, has lost
+		 * its feedback: write() sends it nothing but zero until the
+		 * bridge is back. lost_feedback has a bit per such joint, for
+		 * feedback_timer to report off the control thread.
+		 * */
+		std::unique_ptr<tfr_utilities::CanSnapshot> can_snapshot;
+		struct SnapshotSource
+		{
+		    tfr_utilities::CanSnapshot::Slot* slot;
+		    uint32_t count;
+		};
+		SnapshotSource encoder_sources[tfr_utilities::Joint::JOINT_COUNT]{};
+		SnapshotSource amps_sources[tfr_utilities::Joint::JOINT_COUNT]{};
+		uint64_t snapshot_max_age;
+		bool feedback_lost[tfr_utilities::Joint::JOINT_COUNT]{};
+		std::atomic<uint32_t> lost_feedback;
+		uint32_t reported_lost_feedback;
+		ros::Timer feedback_timer;
+		
+		/*
+		 * Everything read from and written to the motor controllers goes
+		 * to this instead with ~simulated_hardware. It is stepped from the
+		 * last cycle's time to this one's in read().
+		 * */
+		std::unique_ptr<SimulatedHardware> simulation;
+		ros::Time simulation_time;
+		void readSimulation(const ros::Time& time);
+		void sendCommand(tfr_utilities::Joint joint);
+		
+		void openCanSnapshot(ros::NodeHandle& n);
+		void readCanSnapshot(SensorState& state, uint64_t now);
+		bool pollSnapshot(SnapshotSource& source, tfr_utilities::CanSample& sample,
+		        uint64_t now) const;
+		bool snapshotLost(const SnapshotSource& source, uint64_t stamp, uint64_t now) const;
+		void reportLostFeedback(const ros::TimerEvent& event);
+		
+		/*
+		 * Joint velocities are fitted to the encoder readings of the last
+		 * ~tread_velocity_window or ~arm_velocity_window seconds, by the
+		 * stamps they were received at, on the control thread only. The
+		 * stamps are the bridge's with ~use_can_snapshot, which keeps ROS
+		 * queueing out of them. The estimators thin out readings that come
+		 * faster than their buffer could hold a window of.
+		 * */
+		tfr_utilities::VelocityEstimator velocity_estimators[tfr_utilities::Joint::JOINT_COUNT];
+		// the estimators' velocities, in counts/s
+		double encoder_rates[tfr_utilities::Joint::JOINT_COUNT]{};
+		void readVelocity(tfr_utilities::Joint joint, uint64_t now);
+		
+		/*
+		 * With ~tread_odometry/enabled, the drivebase odometry is moved on
+		 * from this cycle's tread counts whenever either is new, see
+		 * tread_odometry.h.
+		 * */
+		std::unique_ptr<TreadOdometry> tread_odometry;
+		uint64_t odometry_stamps[2]{};
+		void readOdometry(const ros::Time& time);
+		
+		/*
+		 * Effort is the signed motor current times ~effort_per_amp/<joint
+		 * name>, turned around with the command for joints whose motor runs
+		 * backwards, and low pass filtered with a ~effort_filter second
+		 * time constant.
+		 * */
+		double effort_filter;
+		void readEffort(tfr_utilities::Joint joint, double dt);
+		
+		// pushed in by the services and topics, never looked up in the loop
+		std::atomic<bool> write_arm_values;
+		// the commands of the joints' own controllers, NaN for the rest
+		std::atomic<double> setpoints[tfr_utilities::Joint::JOINT_COUNT];
+		ros::Subscriber setpoint_subscribers[tfr_utilities::Joint::JOINT_COUNT];
+		
+		/*
+		 * Current protection, for the joints whose current we read, see
+		 * current_limiter.h. It scales back or zeroes the command in
+		 * write() the same cycle the current is over. Changes of state
+		 * are queued for current_event_timer to publish on
+		 * ~current_limit_events, off the control thread.
+		 * */
+		bool current_limited[tfr_utilities::Joint::JOINT_COUNT]{};
+		tfr_utilities::CurrentLimiter current_limiters[tfr_utilities::Joint::JOINT_COUNT];
+		tfr_utilities::CurrentLimiter::State current_states[tfr_utilities::Joint::JOINT_COUNT]{};
+		struct CurrentEvent
+		{
+		    uint64_t stamp;
+		    tfr_utilities::Joint joint;
+		    tfr_utilities::CurrentLimiter::State state;
+		    float amps;
+		    float heat;
+		    float scale;
+		};
+		tfr_utilities::SpscRing<CurrentEvent, 64> current_events;
+		ros::Publisher current_event_publisher;
+		ros::Timer current_event_timer;
+		tfr_msgs::CurrentLimitEvent current_event_msg;
+		void loadCurrentLimits();
 
-        int32_t turntable_encoder_min = -25760;
-        int32_t turntable_encoder_max = 25760;
-        double turntable_joint_min = -2 * 3.14159265358979;
-        double turntable_joint_max = 2 * 3.14159265358979;
-
-		
-		/* 
-			Arm all the way up (actutator extended):
-				encoder: 0
-				joint position: 0.1
-			Arm all the way down (actuator retracted):
-				encoder: 149
-				joint position: 1.55
-		*/
-		 int32_t arm_lower_encoder_min = 888;
-		 int32_t arm_lower_encoder_max = 0;
-		 double arm_lower_joint_min = 0.104; // lower arm UP
-		 double arm_lower_joint_max = 1.55;
-		
-		 int32_t arm_upper_encoder_min = 836; // arm UP
-		 int32_t arm_upper_encoder_max = 0;
-		 double arm_upper_joint_min = 0.98; // arm UP
-		 double arm_upper_joint_max = 2.4; // arm DOWN, actuator EXTENDED
-		
-		 int32_t arm_end_encoder_min = 1721;
-		 int32_t arm_end_encoder_max = 0;
-		 double arm_end_joint_min = -1.16614; // scoop OPEN
-		 double arm_end_joint_max = 1.62; // actuator EXTENDED, scoop CLOSED
-		
-		const int32_t get_arm_lower_min_int();
-		const int32_t get_arm_lower_max_int();
+		/*
+		 * Every connected joint can be run by an effort controller or a
+		 * position one. In position mode the command is a position, and
+		 * write() drives the motor at ~position_control/<joint name>/gain
+		 * times the error, stopping within its tolerance, and giving up on
+		 * targets outside position_low to position_high or that the joint
+		 * stalls short of for its stall_time.
+		 * */
+		bool position_mode[tfr_utilities::Joint::JOINT_COUNT]{};
+		double position_gain[tfr_utilities::Joint::JOINT_COUNT]{};
+		double position_tolerance[tfr_utilities::Joint::JOINT_COUNT]{};
+		double position_low[tfr_utilities::Joint::JOINT_COUNT]{};
+		double position_high[tfr_utilities::Joint::JOINT_COUNT]{};
+		double stall_time[tfr_utilities::Joint::JOINT_COUNT]{};
+		// where the joint was when it last moved towards stall_target
+		double stall_target[tfr_utilities::Joint::JOINT_COUNT]{};
+		double stall_position[tfr_utilities::Joint::JOINT_COUNT]{};
+		ros::Time stall_since[tfr_utilities::Joint::JOINT_COUNT];
+		double positionCommand(tfr_utilities::Joint joint, const ros::Time& time);
+		void limitCurrent(tfr_utilities::Joint joint, double dt, const ros::Time& time);
+		void publishCurrentEvents(const ros::TimerEvent& event);
+		
+		// every cycle goes in, see joint_trace.h
+		std::unique_ptr<JointTrace> trace;
+		JointTraceRecord trace_record{};
+		void recordTrace();
 
         // Populated by controller layer for us to use
         double command_values[tfr_utilities::Joint::JOINT_COUNT]{};
@@ -243,19 +314,17 @@ namespace tfr_control {
         double velocity_values[tfr_utilities::Joint::JOINT_COUNT]{};
         // Populated by us for controller layer to use
         double effort_values[tfr_utilities::Joint::JOINT_COUNT]{};
+        // Populated by us, see getAcceleration()
+        double acceleration_values[tfr_utilities::Joint::JOINT_COUNT]{};
         //used to limit acceleration pull on the drivebase
         std::pair<double, double> drivebase_v0;
         ros::Time last_update;
 
-        template <typename T>
-    	T linear_interp(T x, T x1, T y1, T x2, T y2);
-
         template <typename T>
         T clamp(const T input, const T bound_1, const T bound_2);
         
         void registerJointEffortInterface(std::string name, tfr_utilities::Joint joint);
         void registerJointPositionInterface(std::string name, tfr_utilities::Joint joint);
-        //void registerBinJoint(std::string name, Joint joint);
 
         void adjustFakeJoint(const tfr_utilities::Joint &joint);
 
@@ -0,0 +1,99 @@
+/****************************************************************************************
+ * File:            simulated_hardware.h
+ *
+ * Purpose:         Stands in for the motor controllers with ~simulated_hardware,
+ *                  so the whole hardware layer (encoder scaling, velocity
+ *                  estimation, limits, traces) runs without a robot.
+ *
+ *                  RobotInterface hands it each joint's command exactly as it
+ *                  would have been published (-1000 to 1000, after the
+ *                  joint's sign), steps it by the cycle's period, and reads
+ *                  back encoder counts and motor current.
+ *
+ *                  Every joint with hardware in JOINT_TABLE gets an actuator:
+ *                  - the command asks for a fraction of max_speed,
+ *                  - the actuator's speed follows it with a first order lag
+ *                    (time_constant) or a second order response
+ *                    (natural_frequency, damping), with its acceleration
+ *                    limited to max_acceleration,
+ *                  - position integrates speed, arm joints and the bin stop
+ *                    dead at the ends of their range,
+ *                  - the encoder is the position rounded to whole counts of
+ *                    the joint's encoder scale (5120 a revolution on the
+ *                    treads),
+ *                  - current is an idle draw plus terms in speed and
+ *                    acceleration, and a stall current when driven into an
+ *                    end stop. It is signed the way the motor is driven, or
+ *                    turning when it isn't, as the motor controllers report
+ *                    it, and zero while it does neither.
+ *
+ * Parameters:      ~simulation/<joint name>/order (1 or 2)
+ *                  ~simulation/<joint name>/max_speed (joint units/s)
+ *                  ~simulation/<joint name>/time_constant (s)
+ *                  ~simulation/<joint name>/natural_frequency (rad/s)
+ *                  ~simulation/<joint name>/damping
+ *                  ~simulation/<joint name>/max_acceleration (joint units/s^2)
+ *                  ~simulation/<joint name>/initial_position (joint units)
+ *                  ~simulation/<joint name>/amps_idle, amps_per_speed,
+ *                      amps_per_acceleration, amps_stall
+ *                  Defaults depend on whether the joint is a tread or on the
+ *                  arm, see simulated_hardware.cpp.
+ ***************************************************************************************/
+#ifndef SIMULATED_HARDWARE_H
+#define SIMULATED_HARDWARE_H
+
+#include <tfr_utilities/joints.h>
+#include <cstdint>
+
+namespace tfr_control
+{
+    class SimulatedHardware
+    {
+    public:
+        struct ActuatorModel
+        {
+            int order;
+            double max_speed;
+            double time_constant;
+            double natural_frequency;
+            double damping;
+            double max_acceleration;
+            double amps_idle;
+            double amps_per_speed;
+            double amps_per_acceleration;
+            double amps_stall;
+        };
+
+        // Reads the models from the parameter server, construct it outside
+        // the control loop
+        SimulatedHardware();
+
+        /*
+         * The command for the next step, as the motor controller would have
+         * got it.
+         * */
+        void command(tfr_utilities::Joint joint, int32_t value);
+
+        /*
+         * Moves every actuator on by dt seconds.
+         * */
+        void step(double dt);
+
+        int32_t encoder(tfr_utilities::Joint joint) const;
+        double amps(tfr_utilities::Joint joint) const;
+
+    private:
+        bool simulated[tfr_utilities::Joint::JOINT_COUNT]{};
+        bool bounded[tfr_utilities::Joint::JOINT_COUNT]{};
+        ActuatorModel models[tfr_utilities::Joint::JOINT_COUNT]{};
+
+        // joint units
+        double commanded_speed[tfr_utilities::Joint::JOINT_COUNT]{};
+        double position[tfr_utilities::Joint::JOINT_COUNT]{};
+        double speed[tfr_utilities::Joint::JOINT_COUNT]{};
+        double acceleration[tfr_utilities::Joint::JOINT_COUNT]{};
+        bool stalled[tfr_utilities::Joint::JOINT_COUNT]{};
+    };
+}
+
+#endif // SIMULATED_HARDWARE_H
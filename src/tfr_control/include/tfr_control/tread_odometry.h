@@ -0,0 +1,152 @@
+/****************************************************************************************
+ * File:            tread_odometry.h
+ *
+ * Purpose:         Drivebase odometry inside the control node, from the same
+ *                  tread encoder counts RobotInterface reads for the
+ *                  controllers each cycle.
+ *
+ *                  The counts are the motor controllers' absolute ones, so
+ *                  the pose is moved by tfr_utilities::TreadEncoderOdometry
+ *                  straight from them and a dropped reading costs nothing.
+ *                  update() runs on the control thread and neither blocks nor
+ *                  allocates. The pose goes out to a timer through a SeqLock,
+ *                  and the services' corrections come in through another,
+ *                  to be applied by the next update().
+ *
+ *                  The covariance is carried through each step, see
+ *                  tfr_utilities/diff_drive_odometry.h, and the treads'
+ *                  noise is inflated while their yaw rate and the IMU's
+ *                  disagree, see tfr_utilities/slip_detector.h.
+ *
+ *                  Takes the place of tfr_sensor's drivebase_odom_publisher,
+ *                  only one of the two should run.
+ *
+ * Parameters:      ~tread_odometry/enabled (bool, default false)
+ *                  ~tread_odometry/left_meters_per_count,
+ *                  ~tread_odometry/right_meters_per_count (m, default the
+ *                      treads' encoder scale in JOINT_TABLE, negative for an
+ *                      encoder that counts down going forwards)
+ *                  ~tread_odometry/wheel_span (m, default
+ *                      tfr_utilities::TREAD_WHEEL_SPAN)
+ *                  ~tread_odometry/max_step (m, default 0.5) longer steps
+ *                      between two readings start the count over
+ *                  ~tread_odometry/noise_per_meter (m^2/m, default 0.001)
+ *                      variance a tread's distance picks up per meter
+ *                  ~tread_odometry/velocity_stddev (m/s, default 0.05) of
+ *                      each tread's speed
+ *                  ~tread_odometry/slip/rate_tolerance (rad/s, default 0.1),
+ *                  ~tread_odometry/slip/time_constant (s, default 0.2),
+ *                  ~tread_odometry/slip/max_inflation (default 100),
+ *                  ~tread_odometry/slip/imu_timeout (s, default 0.25)
+ *                  ~tread_odometry/rate (hz, default 50)
+ *                  ~tread_odometry/parent_frame (default "odom")
+ *                  ~tread_odometry/child_frame (default "base_footprint")
+ *
+ * Subscribes To:   /sensors/orientation_prior (tfr_msgs/OrientationPrior) the
+ *                      IMU's yaw rate
+ *
+ * Publishes To:    /drivebase_odom (nav_msgs/Odometry)
+ *                  /drivebase_odom/slip (tfr_msgs/SlipIndicator)
+ *
+ * Services:        /set_drivebase_odometry (tfr_msgs/SetOdometry) moves the
+ *                      pose towards a new one, a limited step at a time
+ *                  /reset_drivebase_odometry (tfr_msgs/SetOdometry) jumps to
+ *                      it and forgets the covariance
+ ***************************************************************************************/
+#ifndef TREAD_ODOMETRY_H
+#define TREAD_ODOMETRY_H
+
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <tfr_msgs/OrientationPrior.h>
+#include <tfr_msgs/SetOdometry.h>
+#include <tfr_msgs/SlipIndicator.h>
+#include <tfr_utilities/seqlock.h>
+#include <tfr_utilities/slip_detector.h>
+#include <tfr_utilities/tread_encoder_odometry.h>
+#include <tfr_utilities/tread_odometry_message.h>
+#include <cstdint>
+#include <string>
+
+namespace tfr_control
+{
+    class TreadOdometry
+    {
+    public:
+        /*
+         * Whether ~tread_odometry/enabled is set.
+         * */
+        static bool enabled();
+
+        explicit TreadOdometry(ros::NodeHandle& n);
+        TreadOdometry(const TreadOdometry&) = delete;
+        TreadOdometry& operator=(const TreadOdometry&) = delete;
+
+        /*
+         * The treads' latest absolute counts and how fast they are
+         * counting, counts/s, as of time. Control thread only.
+         * */
+        void update(int32_t left, int32_t right, double left_rate, double right_rate,
+                const ros::Time& time);
+
+    private:
+        // the largest correction /set_drivebase_odometry makes at once
+        static constexpr double MAX_XY_DELTA = 0.25;
+        static constexpr double MAX_THETA_DELTA = 0.13;
+
+        tfr_utilities::TreadEncoderOdometry::Settings settings;
+        tfr_utilities::TreadEncoderOdometry odometry;
+        double velocity_variance;
+        tfr_utilities::SlipDetector slip;
+        ros::Time last_update;
+
+        // the IMU's, from the spinner thread
+        struct ImuRate
+        {
+            uint64_t stamp;
+            double yaw_rate;
+        };
+        tfr_utilities::SeqLock<ImuRate> imu_rate;
+        uint64_t imu_stamp;
+
+        struct Correction
+        {
+            uint32_t count;
+            tfr_utilities::DiffDriveOdometry::Pose pose;
+            bool smooth;
+        };
+        tfr_utilities::SeqLock<Correction> corrections;
+        uint32_t corrections_applied;
+
+        struct Estimate
+        {
+            uint64_t stamp;
+            tfr_utilities::TreadOdometryEstimate odometry;
+        };
+        tfr_utilities::SeqLock<Estimate> estimate;
+        uint64_t published_stamp;
+
+        std::string parent_frame;
+        std::string child_frame;
+        ros::Subscriber prior_subscriber;
+        ros::Publisher odometry_publisher;
+        ros::Publisher slip_publisher;
+        ros::ServiceServer set_odometry;
+        ros::ServiceServer reset_odometry;
+        ros::Timer publish_timer;
+        nav_msgs::Odometry msg;
+        tfr_msgs::SlipIndicator slip_msg;
+
+        static tfr_utilities::TreadEncoderOdometry::Settings loadSettings();
+        static tfr_utilities::SlipDetector::Settings loadSlipSettings();
+        void receivePrior(const tfr_msgs::OrientationPriorConstPtr& prior);
+        bool setOdometry(tfr_msgs::SetOdometry::Request& request,
+                tfr_msgs::SetOdometry::Response& response);
+        bool resetOdometry(tfr_msgs::SetOdometry::Request& request,
+                tfr_msgs::SetOdometry::Response& response);
+        void correct(const tfr_msgs::SetOdometry::Request& request, bool smooth);
+        void publish(const ros::TimerEvent& event);
+    };
+}
+
+#endif // TREAD_ODOMETRY_H
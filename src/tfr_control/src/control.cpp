@@ -9,12 +9,56 @@
  *
  * PARAMETERS:
  *  ~rate: in hz how fast we want to run the control loop (double, default:10)
+ *  ~in_process_can: run the CAN bridge inside of this node instead of as
+ *      its own process, configured from ~can/ (bool, default: false)
+ *  ~use_can_snapshot: read feedback from the CAN bridge's shared snapshot
+ *      instead of the device topics (bool, default: false)
+ *  ~can_snapshot_max_age: with ~use_can_snapshot, how old in seconds a
+ *      joint's feedback may get before it is no longer driven (double,
+ *      default: 0.5)
+ *  ~realtime: run the control loop on its own SCHED_FIFO thread with
+ *      absolute deadlines, see realtime_loop.h (bool, default: false)
+ *  ~realtime_priority: SCHED_FIFO priority of that thread (int, default: 80)
+ *  ~realtime_cpu: CPU to pin that thread to, -1 for none (int, default: -1)
+ *  ~simulated_hardware: run against simulated motor controllers instead of
+ *      the CAN topics, see simulated_hardware.h (bool, default: false)
+ *  ~simulation_speed: with ~simulated_hardware, how many times faster than
+ *      real time to run, 0 for as fast as it goes (double, default: 1.0)
+ *  ~current_limits/: per joint current protection applied in the control
+ *      loop, see config/current_limits.yaml
+ *  ~position_control/<joint>/gain, tolerance: motor command per radian of
+ *      error, and the error to stop within, for joints run by a position
+ *      controller (double, default: 2000, 0.01)
+ *  ~position_control/<joint>/stall_time: seconds a joint in position mode
+ *      may go without moving towards its target before it is no longer
+ *      driven (double, default: 1.0)
+ *  ~bin_encoder_max: the bin encoder's count raised all the way (int,
+ *      default: 850, an estimate)
+ *  ~imu/: how the IMU is integrated, see imu_integrator.h
+ *  ~tread_odometry/: drivebase odometry from the tread counts read each
+ *      cycle, off unless ~tread_odometry/enabled, see tread_odometry.h
+ * PUBLISHES:
+ *  ~loop_stats - period, jitter and overruns of the loop, with ~realtime
+ *  /clock - the simulated time, with ~simulated_hardware. Set /use_sim_time
+ *      for the other nodes to follow it.
+ *  ~current_limit_events - a joint going into or out of current foldback
+ *      or a trip
+ *  ~phase_timing - time spent in each phase of the control loop, see
+ *      control.h
+ *  /sensors/mti/sensor/imu - the IMU, bias and gravity corrected
+ *  /sensors/orientation_prior - heading from the IMU for the drivebase
+ *      odometry
+ *  /drivebase_odom - with ~tread_odometry/enabled
  * SERVICES:
  *  /toggle_control - uses the empty service, needs to be explicitly turned on to work
  *  /toggle_motors - uses the empty service, needs to be explicitly turned on to work
  *  /bin_state - gives the position of the bin
  *  /arm_state - gives the 4d position of the arm
  *  /zero_turntable - zeros the position of the turntable
+ *  /write_arm_values - turns writing the arm commands to the motors on and
+ *      off, starts from the /write_arm_values parameter
+ *  /set_drivebase_odometry, /reset_drivebase_odometry - with
+ *      ~tread_odometry/enabled
  */
 #include <ros/ros.h>
 #include <std_srvs/SetBool.h>
@@ -26,10 +70,14 @@
 #include <sstream>
 #include <controller_manager/controller_manager.h>
 #include <tfr_utilities/joints.h>
-#include "robot_interface.h"
+#include <tfr_can/can_bridge.h>
+#include <rosgraph_msgs/Clock.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "control.h"
+#include "realtime_loop.h"
 #include "bin_control_server.h"
-#include <sensor_msgs/Imu.h>
-#include <geometry_msgs/Vector3.h>
 
 
 
@@ -85,286 +133,44 @@ void initializeTestCode(ros::NodeHandle& n)
 }
 //END TEST CODE
 
-
-class Control
+/*
+ * Runs the control loop on a clock of its own, one period per cycle, and
+ * publishes it on /clock. Only waits on the wall clock to hold it to speed
+ * times real time, so with a speed of 0 it goes as fast as the cycles do.
+ * */
+void runSimulation(ros::NodeHandle& n, tfr_control::Control& control, double rate, double speed)
 {
-    public:
-        Control(ros::NodeHandle &n, double& rate):
-            robot_interface{n, use_fake_values, lower_limits, upper_limits},
-            controller_interface{&robot_interface},
-            eStopControl{n.advertiseService("toggle_control", &Control::toggleControl,this)},
-            eStopMotors{n.advertiseService("toggle_motors", &Control::toggleControl,this)},
-            binService{n.advertiseService("bin_state", &Control::getBinState,this)},
-            armService{n.advertiseService("arm_state", &Control::getArmState,this)},
-            zeroService{n.advertiseService("zero_turntable", &Control::zeroTurntable,this)},
-            cycle{1/rate},
-            enabled{false},
-			quat_x_sub{n.subscribe("/device120/quaternion_x", 5, &Control::updatePrivateLocalVariable1,this)},
-			quat_y_sub{n.subscribe("/device120/quaternion_y", 5, &Control::updatePrivateLocalVariable2,this)},
-			quat_z_sub{n.subscribe("/device120/quaternion_z", 5, &Control::updatePrivateLocalVariable3,this)},
-			quat_w_sub{n.subscribe("/device120/quaternion_w", 5, &Control::updatePrivateLocalVariable4,this)},
-			lin_vel_x_sub{n.subscribe("linear_acceleration_x", 5, &Control::accumulateX,this)},
-			lin_vel_y_sub{n.subscribe("linear_acceleration_y", 5, &Control::accumulateY,this)},
-			lin_vel_z_sub{n.subscribe("linear_acceleration_z", 5, &Control::accumulateZ,this)}
-		{}
-        
-        /*
-         * performs one iteration of the control loop
-         * */
-        void execute()
-        {
-            //update from hardware
-            robot_interface.read();
-            //update controllers
-            controller_interface.update(ros::Time::now(), cycle);
-            if (!enabled)
-                robot_interface.clearCommands();
-            //update hardware from controllers
-            robot_interface.write();
-			
-			publishIMUOdometry();
-			
-            cycle.sleep();
-        }
-
-    private:
-        //the hardware layer
-        tfr_control::RobotInterface robot_interface;
-
-        //the controller layer
-        controller_manager::ControllerManager controller_interface;
-
-        //emergency stop
-        ros::ServiceServer eStopControl;
-        ros::ServiceServer eStopMotors;
-
-        //state services
-        ros::ServiceServer binService;
-        ros::ServiceServer armService;
-
-        //reset service
-        ros::ServiceServer zeroService;
-
-        //how fast to spin
-        ros::Duration cycle;
-
-		double quat_x = 0;
-		double quat_y = 0;
-		double quat_z = 0;
-		double quat_w = 0;
-		
-		double lin_acc_x = 0;
-		double lin_acc_y = 0;
-		double lin_acc_z = 0;
-		
-		double lin_vel_x = 0;
-		double lin_vel_y = 0;
-		double lin_vel_z = 0;
-		
-		ros::Subscriber quat_x_sub;
-		ros::Subscriber quat_y_sub;
-		ros::Subscriber quat_z_sub;
-		ros::Subscriber quat_w_sub;
-		
-		ros::Subscriber lin_vel_x_sub;
-		ros::Subscriber lin_vel_y_sub;
-		ros::Subscriber lin_vel_z_sub;
-		
-		void updatePrivateLocalVariable1(const std_msgs::Float64 &value)
-		{
-			quat_x = value.data;
-		}
-		
-		void updatePrivateLocalVariable2(const std_msgs::Float64 &value)
-		{
-			quat_y = value.data;
-		}
-		
-		void updatePrivateLocalVariable3(const std_msgs::Float64 &value)
-		{
-			quat_z = value.data;
-		}
-		
-		void updatePrivateLocalVariable4(const std_msgs::Float64 &value)
-		{
-			quat_w = value.data;
-		}
-		
-		
-		void accumulateX(const std_msgs::Float64 &value)
-		{
-			lin_acc_x = value.data;
-			lin_vel_x += value.data;
-		}
-		
-		void accumulateY(const std_msgs::Float64 &value)
-		{
-			lin_acc_y = value.data;
-			lin_vel_y += value.data;
-		}
-		
-		void accumulateZ(const std_msgs::Float64 &value)
-		{
-			lin_acc_z = value.data;
-			lin_vel_z += value.data;
-		}
-		
-		
-        //if our motors are enabled
-        bool enabled;
-
-		void publishIMUOdometry()
-		{
-		    //TODO:
-		    ros::NodeHandle n;
-            ros::Publisher odom_pub = n.advertise<sensor_msgs::Imu>("/sensors/mti/sensor/imu", 50);
-            tf::TransformBroadcaster odom_broadcaster;
-            //abcd
-            double imu_x = 0.0;
-            double imu_y = 0.0;
-            double imu_th = 0.0;
-
-            double imu_vx = 0.1;
-            double imu_vy = -0.1;
-            double imu_vth = 0.1;
-
-            ros::Time current_time, last_time;
-            current_time = ros::Time::now();
-            last_time = ros::Time::now();
-
-            //ros::Rate r(1.0);
-            if (n.ok()){
-
-                //ros::spinOnce();               // check for incoming messages
-                current_time = ros::Time::now();
-
-                //compute odometry in a typical way given the velocities of the robot
-                double dt = (current_time - last_time).toSec();
-                double delta_x = 0;//(vx * cos(th) - vy * sin(th)) * dt;
-                double delta_y = 0;//(vx * sin(th) + vy * cos(th)) * dt;
-                double delta_th = 0;//vth * dt;
-
-                //x += delta_x;
-                //y += delta_y;
-                //th += delta_th;
-
-                //since all odometry is 6DOF we'll need a quaternion created from yaw
-                geometry_msgs::Quaternion odom_quat{};// = tf::createQuaternionMsgFromYaw(th);
-
-                odom_quat.x = quat_x;
-                odom_quat.y = quat_y;
-                odom_quat.z = quat_z;
-                odom_quat.w = quat_w;
-
-                //first, we'll publish the transform over tf
-                geometry_msgs::TransformStamped odom_trans;
-                odom_trans.header.stamp = current_time;
-                odom_trans.header.frame_id = "odom";
-                odom_trans.child_frame_id = "base_link";
-
-                //odom_trans.transform.translation.x = x;
-                //odom_trans.transform.translation.y = y;
-                //odom_trans.transform.translation.z = 0.0;
-                //odom_trans.transform.rotation = odom_quat;
-
-                //send the transform
-                //odom_broadcaster.sendTransform(odom_trans);
-
-                //next, we'll publish the odometry message over ROS
-                nav_msgs::Odometry odom;
-                odom.header.stamp = current_time;
-                odom.header.frame_id = "odom";
-
-                //set the position
-                //odom.pose.pose.position.x = x;
-                //odom.pose.pose.position.y = y;
-                //odom.pose.pose.position.z = 0.0;
-                odom.pose.pose.orientation = odom_quat;
-
-                //set the velocity
-                odom.child_frame_id = "base_link";
-                odom.twist.twist.linear.x = lin_vel_x;
-                odom.twist.twist.linear.y = lin_vel_y;
-                odom.twist.twist.linear.z = lin_vel_z;
-                //odom.twist.twist.angular.z = vth;
-
-                //publish the message
-                //odom_pub.publish(odom);
-
-                sensor_msgs::Imu imu_msg;
-                imu_msg.orientation = odom_quat;
-
-                geometry_msgs::Vector3 lin_acc;
-                lin_acc.x = lin_acc_x;
-                lin_acc.y = lin_acc_y;
-                lin_acc.z = lin_acc_z;
-
-                imu_msg.linear_acceleration = lin_acc;
-
-                odom_pub.publish(imu_msg);
-
-                last_time = current_time;
-                //r.sleep();
-            }
-		}
-
-        /*
-         * Toggles the emergency stop on and off
-         * */
-        bool toggleControl(std_srvs::SetBool::Request& request,
-                std_srvs::SetBool::Response& response)
-        {
-            enabled = request.data;
-            robot_interface.setEnabled(request.data);
-            return true;
-        }
-
-        /*
-         * Toggles the emergency stop on and off
-         * */
-        bool toggleMotors(std_srvs::SetBool::Request& request,
-                std_srvs::SetBool::Response& response)
-        {
-            enabled = request.data;
-            robot_interface.setEnabled(request.data);
-            return true;
-        }
-
+    if (speed != 1.0 && !ros::Time::isSimTime())
+    {
+        ROS_WARN("control: /use_sim_time isn't set, the other nodes won't keep up with the simulation.");
+    }
 
-        /*
-         * Gets the state of the bin
-         * */
-        bool getBinState(tfr_msgs::BinStateSrv::Request& request,
-                tfr_msgs::BinStateSrv::Response& response)
-        {
-            response.state = static_cast<double>(robot_interface.getBinState());
-            return true;
-        }
+    ros::Publisher clock_publisher = n.advertise<rosgraph_msgs::Clock>("/clock", 1);
+    rosgraph_msgs::Clock clock;
+    const ros::Duration period{1.0 / rate};
+    // starts from the wall clock, so stamps look like those of any other run
+    ros::Time time;
+    time.fromNSec(ros::WallTime::now().toNSec());
 
-        /*
-         * Gets the state of the arm
-         * */
-        bool getArmState(tfr_msgs::ArmStateSrv::Request& request,
-                tfr_msgs::ArmStateSrv::Response& response)
-        {
-            std::vector<double> states{};
-            robot_interface.getArmState(states);
-            response.states = states;
-            return true;
-        }
+    const auto wall_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(speed > 0 ? 1.0 / (rate * speed) : 0.0));
+    auto wall_deadline = std::chrono::steady_clock::now();
+    while (ros::ok())
+    {
+        time = time + period;
+        clock.clock = time;
+        clock_publisher.publish(clock);
+        control.update(time, period);
 
-        /*
-         * Toggles the emergency stop on and off
-         * */
-        bool zeroTurntable(std_srvs::Empty::Request& request,
-                std_srvs::Empty::Response& response)
+        if (speed > 0)
         {
-            robot_interface.zeroTurntable();
-            return true;
+            wall_deadline += wall_period;
+            std::this_thread::sleep_until(wall_deadline);
         }
+    }
+}
 
 
-};
 
 int main(int argc, char **argv)
 {
@@ -373,6 +179,15 @@ int main(int argc, char **argv)
 
     double rate;
     ros::param::param<double>("~rate", rate, 10.0);
+    bool realtime;
+    int realtime_priority, realtime_cpu;
+    ros::param::param<bool>("~realtime", realtime, false);
+    ros::param::param<int>("~realtime_priority", realtime_priority, 80);
+    ros::param::param<int>("~realtime_cpu", realtime_cpu, -1);
+    bool simulated_hardware;
+    double simulation_speed;
+    ros::param::param<bool>("~simulated_hardware", simulated_hardware, false);
+    ros::param::param<double>("~simulation_speed", simulation_speed, 1.0);
 
     //test code
     if (use_fake_values)
@@ -383,12 +198,50 @@ int main(int argc, char **argv)
     ros::AsyncSpinner spinner(1);
     spinner.start();
 
-    Control control{n, rate};
+    // The bridge writes straight into the snapshot RobotInterface reads
+    bool in_process_can;
+    ros::param::param<bool>("~in_process_can", in_process_can, false);
+    ros::NodeHandle can_n{"~can"};
+    std::unique_ptr<tfr_can::CanBridge> can_bridge;
+    if (in_process_can)
+    {
+        can_bridge.reset(new tfr_can::CanBridge(n, can_n));
+        if (!can_bridge->start())
+        {
+            ROS_ERROR("control: could not start the CAN bridge");
+            return 1;
+        }
+    }
+
+    tfr_control::Control control{n, rate, use_fake_values, lower_limits, upper_limits};
 
-    while (ros::ok())
+    // Callbacks are all served by the spinner above, never on the loop's thread
+    if (simulated_hardware)
     {
-        ros::spinOnce();
-        control.execute();
+        if (realtime)
+        {
+            ROS_WARN("control: ~realtime is ignored with ~simulated_hardware");
+        }
+        runSimulation(n, control, rate, simulation_speed);
+    }
+    else if (realtime)
+    {
+        ros::NodeHandle private_n{"~"};
+        tfr_control::RealtimeLoop loop{private_n, rate, realtime_priority, realtime_cpu,
+            [&control](const ros::Time& time, const ros::Duration& period)
+            {
+                control.update(time, period);
+            }};
+        loop.start();
+        ros::waitForShutdown();
+        loop.stop();
+    }
+    else
+    {
+        while (ros::ok())
+        {
+            control.execute();
+        }
     }
     return 0;
 }
@@ -0,0 +1,221 @@
+/**
+ * control_benchmark.cpp
+ *
+ * Runs the control loop in fake mode and checks that a cycle neither
+ * allocates nor talks to the master, see control.h. Needs a roscore.
+ *
+ * That only holds while nobody subscribes to the motor commands: roscpp
+ * serializes every message it publishes to a subscriber into a buffer of
+ * its own. So the cycles are counted twice, first with nobody listening,
+ * which has to come out clean, then with a subscriber on every command
+ * topic, as the CAN bridge would be. The second run's allocations are
+ * reported as the known cost of publishing the commands, not failed on.
+ *
+ * Allocations are counted by replacing the global operator new, and master
+ * calls by wrapping ros::master::execute, which every parameter and
+ * registration call in roscpp goes through. Only the benchmark thread is
+ * counted, callbacks on the spinner thread are not part of a cycle.
+ *
+ * Build with -DCMAKE_BUILD_TYPE=Release, roscpp checks every publish with a
+ * ROS_ASSERT that allocates when assertions are on.
+ *
+ * PARAMETERS:
+ *  ~rate: how fast to run the loop (double, default: 1000)
+ *  ~cycles: how many cycles to count (int, default: 5000)
+ *  ~warmup_cycles: cycles to run first, without counting (int, default: 100)
+ *  ~subscribe_commands: whether to do the second run (bool, default: true)
+ *
+ * Exits with 1 if a cycle of the first run allocated, or any cycle called
+ * the master.
+ */
+#include <ros/ros.h>
+#include <ros/master.h>
+#include <std_msgs/Int32.h>
+#include <tfr_utilities/joints.h>
+#include "control.h"
+#include "joint_table.h"
+#include <dlfcn.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace
+{
+    thread_local bool counting = false;
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> master_calls{0};
+
+    void* countedAllocation(std::size_t size)
+    {
+        if (counting)
+            allocations.fetch_add(1, std::memory_order_relaxed);
+        void* memory = std::malloc(size == 0 ? 1 : size);
+        if (memory == nullptr)
+            throw std::bad_alloc();
+        return memory;
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocation(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace ros
+{
+    namespace master
+    {
+        /*
+         * Takes the place of roscpp's own (the benchmark is linked with
+         * -rdynamic), counts the call and passes it on.
+         * */
+        bool execute(const std::string& method, const XmlRpc::XmlRpcValue& request,
+                XmlRpc::XmlRpcValue& response, XmlRpc::XmlRpcValue& payload,
+                bool wait_for_master)
+        {
+            using Execute = bool (*)(const std::string&, const XmlRpc::XmlRpcValue&,
+                    XmlRpc::XmlRpcValue&, XmlRpc::XmlRpcValue&, bool);
+            static Execute roscpp_execute = []
+            {
+                Dl_info info;
+                dladdr(reinterpret_cast<void*>(&execute), &info);
+                return reinterpret_cast<Execute>(dlsym(RTLD_NEXT, info.dli_sname));
+            }();
+
+            if (counting)
+                master_calls.fetch_add(1, std::memory_order_relaxed);
+            return roscpp_execute(method, request, response, payload, wait_for_master);
+        }
+    }
+}
+
+namespace
+{
+    struct Run
+    {
+        int cycles;
+        double seconds;
+        uint64_t allocations;
+        uint64_t master_calls;
+    };
+
+    Run countCycles(tfr_control::Control& control, int cycles, int warmup_cycles)
+    {
+        // the first cycles set up what roscpp creates lazily
+        for (int i = 0; i < warmup_cycles && ros::ok(); i++)
+            control.execute();
+
+        allocations = 0;
+        master_calls = 0;
+        const auto start = std::chrono::steady_clock::now();
+        counting = true;
+        int counted = 0;
+        for (; counted < cycles && ros::ok(); counted++)
+            control.execute();
+        counting = false;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return Run{counted, elapsed.count(), allocations, master_calls};
+    }
+
+    void report(const char* name, const Run& run)
+    {
+        ROS_INFO_STREAM("control_benchmark: " << name << ": " << run.cycles << " cycles in "
+                << run.seconds << " s (" << run.cycles / run.seconds << " Hz), "
+                << run.allocations << " allocations ("
+                << static_cast<double>(run.allocations) / std::max(run.cycles, 1)
+                << " a cycle), " << run.master_calls << " master calls");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "control_benchmark");
+    ros::NodeHandle n;
+
+    double rate;
+    int cycles, warmup_cycles;
+    bool subscribe_commands;
+    ros::param::param<double>("~rate", rate, 1000.0);
+    ros::param::param<int>("~cycles", cycles, 5000);
+    ros::param::param<int>("~warmup_cycles", warmup_cycles, 100);
+    ros::param::param<bool>("~subscribe_commands", subscribe_commands, true);
+
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
+
+    // no joint limits, the fake joints just follow their commands
+    double limits[tfr_utilities::Joint::JOINT_COUNT] = {};
+    tfr_control::Control control{n, rate, true, limits, limits};
+
+    const Run quiet = countCycles(control, cycles, warmup_cycles);
+    report("nobody subscribed", quiet);
+    bool failed = quiet.allocations != 0 || quiet.master_calls != 0;
+
+    if (subscribe_commands && ros::ok())
+    {
+        // listen the way the CAN bridge does, the messages are dropped on
+        // the spinner thread
+        std::vector<ros::Subscriber> subscribers;
+        for (const tfr_control::JointDescriptor& row : tfr_control::JOINT_TABLE)
+        {
+            for (const char* topic : {row.command_topic, row.twin_command_topic})
+            {
+                if (topic != nullptr)
+                    subscribers.push_back(n.subscribe<std_msgs::Int32>(topic, 1,
+                                [](const std_msgs::Int32::ConstPtr&) {}));
+            }
+        }
+        // connecting happens on roscpp's threads, the cycles keep publishing
+        // meanwhile
+        const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(5.0);
+        for (const ros::Subscriber& subscriber : subscribers)
+        {
+            while (subscriber.getNumPublishers() == 0 && ros::WallTime::now() < deadline && ros::ok())
+                control.execute();
+        }
+
+        const Run listened = countCycles(control, cycles, warmup_cycles);
+        report("commands subscribed", listened);
+        if (listened.allocations != 0)
+        {
+            ROS_WARN("control_benchmark: publishing the commands to their subscribers "
+                    "allocates, as roscpp does for every message it sends");
+        }
+        failed = failed || listened.master_calls != 0;
+    }
+
+    if (failed)
+    {
+        ROS_ERROR("control_benchmark: the control loop allocated or called the master");
+        return 1;
+    }
+    return 0;
+}
@@ -46,10 +46,6 @@ namespace tfr_control
         right_cmd.data = right_velocity;
         left_tread_publisher.publish(left_cmd);
         right_tread_publisher.publish(right_cmd);
-        
-        // Debug. Write the setpoints to the parameter server so that other nodes can see them.
-        n.setParam("/left_tread_velocity_controller/setpoint", left_cmd.data);
-        n.setParam("/right_tread_velocity_controller/setpoint", right_cmd.data);
     }
 
 }
@@ -0,0 +1,90 @@
+#include "imu_integrator.h"
+
+namespace tfr_control
+{
+    ImuIntegrator::ImuIntegrator(ros::NodeHandle& n) :
+        node{n},
+        spinner{1, &queue},
+        integrator{loadSettings()}
+    {
+        node.setCallbackQueue(&queue);
+        imu_sub = node.subscribe("/device120/imu", 50, &ImuIntegrator::integrate, this);
+        imu_pub = node.advertise<sensor_msgs::Imu>("/sensors/mti/sensor/imu", 50);
+        prior_pub = node.advertise<tfr_msgs::OrientationPrior>("/sensors/orientation_prior", 50);
+        spinner.start();
+    }
+
+    ImuIntegrator::~ImuIntegrator()
+    {
+        spinner.stop();
+    }
+
+    tfr_utilities::ImuPreintegrator::Settings ImuIntegrator::loadSettings()
+    {
+        ros::NodeHandle n{"~imu"};
+        tfr_utilities::ImuPreintegrator::Settings settings;
+        n.param<double>("gravity", settings.gravity, 0.0);
+        n.param<double>("max_dt", settings.max_dt, 0.1);
+        n.param<double>("gyro_noise", settings.gyro_noise, 0.00087);
+        n.param<double>("orientation_gain", settings.orientation_gain, 0.1);
+        n.param<double>("stationary_gyro", settings.stationary_gyro, 0.02);
+        n.param<double>("stationary_acceleration", settings.stationary_acceleration, 0.1);
+        n.param<double>("stationary_time", settings.stationary_time, 0.5);
+        n.param<double>("bias_time_constant", settings.bias_time_constant, 5.0);
+        return settings;
+    }
+
+    /*
+     * Runs on the spinner's thread, once per sample.
+     * */
+    void ImuIntegrator::integrate(const sensor_msgs::Imu::ConstPtr& msg)
+    {
+        using tfr_utilities::ImuPreintegrator;
+        const ImuPreintegrator::Vector gyro{msg->angular_velocity.x,
+            msg->angular_velocity.y, msg->angular_velocity.z};
+        const ImuPreintegrator::Vector force{msg->linear_acceleration.x,
+            msg->linear_acceleration.y, msg->linear_acceleration.z};
+        // a covariance of -1 means the sensor has no orientation
+        const bool has_orientation = msg->orientation_covariance[0] >= 0;
+        const ImuPreintegrator::Quaternion measured{msg->orientation.w,
+            msg->orientation.x, msg->orientation.y, msg->orientation.z};
+        if (!integrator.update(msg->header.stamp.toSec(), gyro, force,
+                    has_orientation ? &measured : nullptr))
+            return;
+
+        const ImuPreintegrator::State& state = integrator.state();
+        imu_msg.header = msg->header;
+        imu_msg.orientation.w = state.orientation.w;
+        imu_msg.orientation.x = state.orientation.x;
+        imu_msg.orientation.y = state.orientation.y;
+        imu_msg.orientation.z = state.orientation.z;
+        // roll and pitch are as good as the sensor's, if it has them, yaw is
+        // the gyroscope's
+        imu_msg.orientation_covariance = msg->orientation_covariance;
+        if (!has_orientation)
+        {
+            imu_msg.orientation_covariance.fill(0);
+            imu_msg.orientation_covariance[0] = state.yaw_variance;
+            imu_msg.orientation_covariance[4] = state.yaw_variance;
+        }
+        imu_msg.orientation_covariance[8] = state.yaw_variance;
+        imu_msg.angular_velocity.x = state.angular_velocity.x;
+        imu_msg.angular_velocity.y = state.angular_velocity.y;
+        imu_msg.angular_velocity.z = state.angular_velocity.z;
+        imu_msg.angular_velocity_covariance = msg->angular_velocity_covariance;
+        imu_msg.linear_acceleration.x = state.linear_acceleration.x;
+        imu_msg.linear_acceleration.y = state.linear_acceleration.y;
+        imu_msg.linear_acceleration.z = state.linear_acceleration.z;
+        imu_msg.linear_acceleration_covariance = msg->linear_acceleration_covariance;
+        imu_pub.publish(imu_msg);
+
+        prior_msg.header = msg->header;
+        prior_msg.orientation = imu_msg.orientation;
+        prior_msg.yaw = state.yaw;
+        prior_msg.yaw_rate = state.yaw_rate;
+        prior_msg.yaw_variance = state.yaw_variance;
+        prior_msg.yaw_rate_variance = msg->angular_velocity_covariance[8];
+        prior_msg.stationary = state.stationary;
+        prior_pub.publish(prior_msg);
+    }
+}
@@ -0,0 +1,140 @@
+#include "joint_trace.h"
+#include "joint_table.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace tfr_control
+{
+    JointTrace::JointTrace(ros::NodeHandle& n, const std::string& file, double rate) :
+        dropped{0},
+        trace_file{nullptr},
+        publish_period{rate > 0 ? static_cast<uint64_t>(1e9 / rate) : 0},
+        last_publish{0},
+        running{false}
+    {
+        if (!file.empty())
+        {
+            trace_file = std::fopen(file.c_str(), "wb");
+            if (trace_file == nullptr)
+            {
+                ROS_ERROR_STREAM("control: could not open trace file " << file << ": "
+                        << std::strerror(errno));
+            }
+            else
+            {
+                JointTraceFileHeader header;
+                std::memcpy(header.magic, "TFRTRACE", sizeof(header.magic));
+                header.version = 1;
+                header.joint_count = tfr_utilities::Joint::JOINT_COUNT;
+                header.record_size = sizeof(JointTraceRecord);
+                std::fwrite(&header, sizeof(header), 1, trace_file);
+            }
+        }
+
+        if (publish_period != 0)
+        {
+            ros::NodeHandle private_n{"~"};
+            trace_publisher = private_n.advertise<tfr_msgs::JointTrace>("joint_trace", 5);
+            for (const JointDescriptor& row : JOINT_TABLE)
+            {
+                trace_msg.name.push_back(row.name);
+                if (row.controller == nullptr)
+                    continue;
+                const std::string controller{row.controller};
+                pid_debug_setpoint[row.joint] =
+                    n.advertise<std_msgs::Float64>(controller + "/pid_debug/setpoint", 1);
+                pid_debug_state[row.joint] =
+                    n.advertise<std_msgs::Float64>(controller + "/pid_debug/state", 1);
+                pid_debug_command[row.joint] =
+                    n.advertise<std_msgs::Int32>(controller + "/pid_debug/command", 1);
+            }
+            const std::size_t joints = trace_msg.name.size();
+            trace_msg.setpoint.resize(joints);
+            trace_msg.position.resize(joints);
+            trace_msg.velocity.resize(joints);
+            trace_msg.current.resize(joints);
+            trace_msg.command.resize(joints);
+        }
+
+        if (trace_file != nullptr || publish_period != 0)
+        {
+            running = true;
+            drain_thread = std::thread(&JointTrace::drain, this);
+        }
+    }
+
+    JointTrace::~JointTrace()
+    {
+        running = false;
+        if (drain_thread.joinable())
+            drain_thread.join();
+        if (trace_file != nullptr)
+            std::fclose(trace_file);
+    }
+
+    void JointTrace::drain()
+    {
+        JointTraceRecord newest;
+        while (running)
+        {
+            if (drainRing(newest) && publish_period != 0
+                    && newest.stamp - last_publish >= publish_period)
+            {
+                last_publish = newest.stamp;
+                publish(newest);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        // whatever was left goes to the file
+        drainRing(newest);
+        if (trace_file != nullptr)
+            std::fflush(trace_file);
+    }
+
+    /*
+     * Empties the ring into the file. Returns false if it was already
+     * empty, otherwise newest holds the last record taken out.
+     * */
+    bool JointTrace::drainRing(JointTraceRecord& newest)
+    {
+        bool any = false;
+        while (ring.pop(newest))
+        {
+            any = true;
+            if (trace_file != nullptr)
+                std::fwrite(&newest, sizeof(newest), 1, trace_file);
+        }
+        return any;
+    }
+
+    void JointTrace::publish(const JointTraceRecord& record)
+    {
+        trace_msg.header.stamp.fromNSec(record.stamp);
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            trace_msg.setpoint[joint] = record.setpoint[joint];
+            trace_msg.position[joint] = record.position[joint];
+            trace_msg.velocity[joint] = record.velocity[joint];
+            trace_msg.current[joint] = record.current[joint];
+            trace_msg.command[joint] = record.command[joint];
+        }
+        trace_msg.dropped = dropped.exchange(0, std::memory_order_relaxed);
+        trace_publisher.publish(trace_msg);
+
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            if (row.controller == nullptr)
+                continue;
+            setpoint_msg.data = record.setpoint[row.joint];
+            // what the controller is controlling
+            state_msg.data = row.kind == JointKind::TREAD ? record.velocity[row.joint]
+                : record.position[row.joint];
+            command_msg.data = record.command[row.joint];
+            pid_debug_setpoint[row.joint].publish(setpoint_msg);
+            pid_debug_state[row.joint].publish(state_msg);
+            pid_debug_command[row.joint].publish(command_msg);
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#include "realtime_loop.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace tfr_control
+{
+    namespace
+    {
+        uint64_t monotonicNow()
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + now.tv_nsec;
+        }
+
+        void sleepUntil(uint64_t deadline)
+        {
+            struct timespec until;
+            until.tv_sec = deadline / 1000000000ull;
+            until.tv_nsec = deadline % 1000000000ull;
+            // restarts after a signal, the deadline doesn't move
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, nullptr) == EINTR);
+        }
+    }
+
+    RealtimeLoop::RealtimeLoop(ros::NodeHandle& n, double rate, int fifo_priority,
+            int pinned_cpu, Cycle cycle_function) :
+        period{static_cast<uint64_t>(1e9 / rate)},
+        priority{fifo_priority},
+        cpu{pinned_cpu},
+        cycle{cycle_function},
+        running{false},
+        overruns{0},
+        stats_publisher{n.advertise<tfr_msgs::ControlLoopStats>("loop_stats", 5)},
+        stats_timer{n.createTimer(ros::Duration(1.0), &RealtimeLoop::publishStats, this)},
+        window_start{ros::Time::now()}
+    {
+        stats_msg.target_period = period * 1e-9;
+    }
+
+    RealtimeLoop::~RealtimeLoop()
+    {
+        stop();
+    }
+
+    void RealtimeLoop::start()
+    {
+        running = true;
+        loop_thread = std::thread(&RealtimeLoop::run, this);
+    }
+
+    void RealtimeLoop::stop()
+    {
+        running = false;
+        if (loop_thread.joinable())
+            loop_thread.join();
+    }
+
+    /*
+     * Both need privileges the node may not have (CAP_SYS_NICE or an rtprio
+     * limit), so failing is a warning and the loop still runs, just without
+     * the guarantees.
+     * */
+    void RealtimeLoop::configureThread()
+    {
+        struct sched_param param;
+        std::memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0)
+        {
+            ROS_WARN_STREAM("control: could not run the control loop at SCHED_FIFO priority "
+                    << priority << ": " << strerror(error));
+        }
+
+        if (cpu >= 0)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+            error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            if (error != 0)
+            {
+                ROS_WARN_STREAM("control: could not pin the control loop to CPU "
+                        << cpu << ": " << strerror(error));
+            }
+        }
+    }
+
+    void RealtimeLoop::run()
+    {
+        configureThread();
+
+        uint64_t deadline = monotonicNow();
+        uint64_t last_start = 0;
+        while (running && ros::ok())
+        {
+            deadline += period;
+            sleepUntil(deadline);
+
+            const uint64_t start = monotonicNow();
+            jitter.record(start - deadline);
+            const uint64_t elapsed = last_start == 0 ? period : start - last_start;
+            if (last_start != 0)
+                periods.record(elapsed);
+            last_start = start;
+
+            cycle(ros::Time::now(), ros::Duration().fromNSec(elapsed));
+
+            const uint64_t end = monotonicNow();
+            execution.record(end - start);
+            if (end > deadline + period)
+            {
+                overruns.fetch_add(1, std::memory_order_relaxed);
+                // pick up at the next deadline still ahead instead of catching up
+                deadline += (end - deadline) / period * period;
+            }
+        }
+    }
+
+    void RealtimeLoop::publishStats(const ros::TimerEvent& event)
+    {
+        const ros::Time now = ros::Time::now();
+        const double window = (now - window_start).toSec();
+        window_start = now;
+        if (window <= 0)
+            return;
+
+        stats_msg.header.stamp = now;
+        stats_msg.window = window;
+        stats_msg.cycles = static_cast<uint32_t>(execution.count());
+        stats_msg.overruns = static_cast<uint32_t>(overruns.exchange(0));
+        stats_msg.period_mean = periods.mean() * 1e-9;
+        stats_msg.period_max = periods.max() * 1e-9;
+        stats_msg.jitter_p50 = jitter.percentile(50) * 1e-9;
+        stats_msg.jitter_p99 = jitter.percentile(99) * 1e-9;
+        stats_msg.jitter_max = jitter.max() * 1e-9;
+        stats_msg.execution_p99 = execution.percentile(99) * 1e-9;
+        stats_msg.execution_max = execution.max() * 1e-9;
+        periods.reset();
+        jitter.reset();
+        execution.reset();
+        stats_publisher.publish(stats_msg);
+    }
+}
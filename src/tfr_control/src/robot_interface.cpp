@@ -19,46 +19,10 @@ namespace tfr_control
             const double *lower_lim, const double *upper_lim) :
 
 
-        brushless_left_tread_vel{n.subscribe("/device8/get_qry_abcntr/channel_1", 5,
-                &RobotInterface::setBrushlessLeftEncoder, this)},
-        brushless_left_tread_vel_publisher{n.advertise<std_msgs::Int32>("/device8/set_cmd_cango/cmd_cango_1", 1)},
-        
-        
-        brushless_right_tread_vel{n.subscribe("/device8/get_qry_abcntr/channel_2", 5,
-                &RobotInterface::setBrushlessRightEncoder, this)},
-        brushless_right_tread_vel_publisher{n.advertise<std_msgs::Int32>("/device8/set_cmd_cango/cmd_cango_2", 1)},
-        
-        
-        turntable_subscriber_encoder{n.subscribe("/device4/get_qry_abcntr/channel_1", 5,
-                &RobotInterface::readTurntableEncoder, this)},
-        turntable_subscriber_amps{n.subscribe("/device4/get_qry_batamps/channel_1", 1,
-                &RobotInterface::readTurntableAmps, this)},
-        turntable_publisher{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_1", 1)},
-        
-        
-        lower_arm_subscriber_encoder{n.subscribe("/device12/get_qry_abcntr/channel_2", 5, // "channel_2" is correct.
-                &RobotInterface::readLowerArmEncoder, this)},
-        lower_arm_subscriber_amps{n.subscribe("/device12/get_qry_batamps/channel_1", 1,
-                &RobotInterface::readLowerArmAmps, this)},
-        lower_arm_publisher{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_1", 1)},
-        
-        
-        upper_arm_subscriber_encoder{n.subscribe("/device4/get_qry_abcntr/channel_3", 5,
-                &RobotInterface::readUpperArmEncoder, this)},
-        upper_arm_subscriber_amps{n.subscribe("/device4/get_qry_batamps/channel_3", 1,
-                &RobotInterface::readUpperArmAmps, this)},
-        upper_arm_publisher{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_3", 1)},
-        
-        
-        scoop_subscriber_encoder{n.subscribe("/device4/get_qry_abcntr/channel_2", 5,
-                &RobotInterface::readScoopEncoder, this)},
-        scoop_subscriber_amps{n.subscribe("/device4/get_qry_batamps/channel_2", 1,
-                &RobotInterface::readScoopAmps, this)},
-        scoop_publisher{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_2", 1)},
-        
-        left_tread_publisher_pid_debug_setpoint{n.advertise<std_msgs::Float64>("/left_tread_velocity_controller/pid_debug/setpoint", 1)},
-        left_tread_publisher_pid_debug_state{n.advertise<std_msgs::Float64>("/left_tread_velocity_controller/pid_debug/state", 1)},
-        left_tread_publisher_pid_debug_command{n.advertise<std_msgs::Int32>("/left_tread_velocity_controller/pid_debug/command", 1)},
+        snapshot_max_age{0},
+        lost_feedback{0},
+        reported_lost_feedback{0},
+        write_arm_values{false},
         
         //pwm_publisher{n.advertise<tfr_msgs::PwmCommand>("/motor_output", 15)},
         use_fake_values{fakes}, lower_limits{lower_lim},
@@ -66,44 +30,136 @@ namespace tfr_control
         last_update{ros::Time::now()},
         enabled{true}
     {
-        /*
-        // TODO: Enable getting parameters from server instead of hardcoded values in .h file.
-        if (    !n.getParam("bin_joint/min", static_cast<int>(bin_encoder_min))
-             || !n.getParam("bin_joint/max", static_cast<int>(bin_encoder_max))
-             || !n.getParam("turntable_joint/min", static_cast<int>(turntable_encoder_min))
-             || !n.getParam("turntable_joint/max", static_cast<int>(turntable_encoder_max))
-             || !n.getParam("lower_arm_joint/min", static_cast<int>(arm_lower_encoder_min))
-             || !n.getParam("lower_arm_joint/max", static_cast<int>(arm_lower_encoder_max))
-             || !n.getParam("upper_arm_joint/min", static_cast<int>(arm_upper_encoder_min))
-             || !n.getParam("upper_arm_joint/max", static_cast<int>(arm_upper_encoder_max))
-             || !n.getParam("scoop_joint/min", static_cast<int>(arm_end_encoder_min))
-             || !n.getParam("scoop_joint/max", static_cast<int>(arm_end_encoder_max))
-           )
-           {
-               ROS_ERROR("tfr_control failed to find all of the encoder limits. Maybe they weren't uploaded to the parameter server by the launch file?");
-           }
-        */
-        
-        // Note: the string parameters in these constructors must match the
-        // joint names from the URDF, and yaml controller description. 
+        // Note: the joint names in the table must match the joint names from
+        // the URDF, and yaml controller description. 
 
 	// DEBUG: Try to make printing faster
 	std::ios_base::sync_with_stdio(false);
 
-        // Connect and register each joint with appropriate interfaces at our
-        // layer
-        registerJointEffortInterface("left_tread_joint", tfr_utilities::Joint::LEFT_TREAD);
-        registerJointEffortInterface("right_tread_joint", tfr_utilities::Joint::RIGHT_TREAD);
-        registerJointEffortInterface("bin_joint", tfr_utilities::Joint::BIN); 
-        registerJointEffortInterface("turntable_joint", tfr_utilities::Joint::TURNTABLE);
-        registerJointEffortInterface("lower_arm_joint", tfr_utilities::Joint::LOWER_ARM);
-        registerJointEffortInterface("upper_arm_joint", tfr_utilities::Joint::UPPER_ARM);
-        registerJointEffortInterface("scoop_joint", tfr_utilities::Joint::SCOOP);
+        double tread_velocity_window, arm_velocity_window;
+        ros::param::param<double>("~tread_velocity_window", tread_velocity_window, 0.1);
+        // the arm encoders count a lot slower than the treads'
+        ros::param::param<double>("~arm_velocity_window", arm_velocity_window, 0.2);
+        ros::param::param<double>("~effort_filter", effort_filter, 0.05);
+
+        bool simulated_hardware = false;
+        ros::param::param<bool>("~simulated_hardware", simulated_hardware, false);
+        if (simulated_hardware && !use_fake_values)
+        {
+            simulation.reset(new SimulatedHardware());
+        }
+
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            const tfr_utilities::Joint joint = row.joint;
+            joint_kind[joint] = row.kind;
+            command_sign[joint] = row.command_sign;
+            if (row.kind == JointKind::ARM || row.kind == JointKind::BIN)
+            {
+                JointDescriptor measured = row;
+                if (row.kind == JointKind::BIN)
+                {
+                    ros::param::param<int32_t>("~bin_encoder_max", measured.encoder_max, row.encoder_max);
+                }
+                position_scale[joint] = encoderScale(measured);
+                position_offset[joint] = row.joint_min - position_scale[joint] * row.encoder_min;
+                position_low[joint] = std::min(row.joint_min, row.joint_max);
+                position_high[joint] = std::max(row.joint_min, row.joint_max);
+                velocity_scale[joint] = position_scale[joint];
+                velocity_estimators[joint] = tfr_utilities::VelocityEstimator{arm_velocity_window};
+            }
+            else if (row.kind == JointKind::TREAD)
+            {
+                velocity_scale[joint] = encoderScale(row);
+                velocity_estimators[joint] = tfr_utilities::VelocityEstimator{tread_velocity_window};
+            }
+
+            // none of the motor controller topics when simulated
+            if (row.encoder_topic != nullptr && !simulation)
+            {
+                encoder_subscribers[joint] = n.subscribe<std_msgs::Int32>(row.encoder_topic, 5,
+                        [this, joint](const std_msgs::Int32::ConstPtr& msg)
+                        {
+                            receiveEncoder(joint, msg->data);
+                        });
+            }
+            if (row.amps_topic != nullptr)
+            {
+                ros::param::param<double>(std::string("~effort_per_amp/") + row.name,
+                        effort_per_amp[joint], 1.0);
+            }
+            if (row.amps_topic != nullptr && !simulation)
+            {
+                amps_subscribers[joint] = n.subscribe<std_msgs::Int16>(row.amps_topic, 1,
+                        [this, joint](const std_msgs::Int16::ConstPtr& msg)
+                        {
+                            receiveAmps(joint, ROBOTEQ_AMPS_PER_COUNT * msg->data);
+                        });
+            }
+            if (row.command_topic != nullptr && !simulation)
+            {
+                command_publishers[joint] = n.advertise<std_msgs::Int32>(row.command_topic, 1);
+            }
+            if (row.twin_command_topic != nullptr && !simulation)
+            {
+                twin_publishers[joint] = n.advertise<std_msgs::Int32>(row.twin_command_topic, 1);
+            }
+            setpoints[joint] = std::numeric_limits<double>::quiet_NaN();
+            if (row.controller != nullptr)
+            {
+                setpoint_subscribers[joint] = n.subscribe<std_msgs::Float64>(
+                        std::string(row.controller) + "/command", 1,
+                        [this, joint](const std_msgs::Float64::ConstPtr& msg)
+                        {
+                            setpoints[joint] = msg->data;
+                        });
+            }
+
+            // Connect and register each joint with appropriate interfaces at our
+            // layer
+            registerJointEffortInterface(row.name, joint);
+            if (row.kind != JointKind::UNCONNECTED)
+            {
+                const std::string prefix = std::string("~position_control/") + row.name + "/";
+                ros::param::param<double>(prefix + "gain", position_gain[joint], 2000.0);
+                ros::param::param<double>(prefix + "tolerance", position_tolerance[joint], 0.01);
+                ros::param::param<double>(prefix + "stall_time", stall_time[joint], 1.0);
+                registerJointPositionInterface(row.name, joint);
+            }
+        }
         //register the interfaces with the controller layer
         registerInterface(&joint_state_interface);
         registerInterface(&joint_effort_interface);
         registerInterface(&joint_position_interface);
         
+        // Only the starting value, /write_arm_values changes it after this
+        bool write_arm_values_param = false;
+        ros::param::param<bool>("/write_arm_values", write_arm_values_param, false);
+        write_arm_values = write_arm_values_param;
+
+        std::string trace_file;
+        double trace_rate;
+        ros::param::param<std::string>("~trace_file", trace_file, "");
+        ros::param::param<double>("~trace_rate", trace_rate, 50.0);
+        trace.reset(new JointTrace(n, trace_file, trace_rate));
+
+        loadCurrentLimits();
+        ros::NodeHandle private_n{"~"};
+        current_event_publisher = private_n.advertise<tfr_msgs::CurrentLimitEvent>("current_limit_events", 10);
+        current_event_timer = n.createTimer(ros::Duration(0.05), &RobotInterface::publishCurrentEvents, this);
+
+        bool use_can_snapshot = false;
+        ros::param::param<bool>("~use_can_snapshot", use_can_snapshot, false);
+        if (use_can_snapshot && !use_fake_values && !simulation)
+        {
+            openCanSnapshot(n);
+        }
+
+        // the fake treads have no counts to follow
+        if (TreadOdometry::enabled() && !use_fake_values)
+        {
+            tread_odometry.reset(new TreadOdometry(n));
+        }
         
         for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
         {
@@ -120,223 +176,384 @@ namespace tfr_control
      * is written to some safe sensible default (usually 0).
      *
      * */
- void RobotInterface::read() 
+ void RobotInterface::read(const ros::Time& time) 
     {
-        //LEFT_TREAD
-        position_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 0;
-        velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = readBrushlessLeftVel();
-        effort_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 0;
+        // on the same clock as the stamps
+        const uint64_t now = can_snapshot ? tfr_utilities::CanSnapshot::now()
+            : simulation ? time.toNSec() : ros::Time::now().toNSec();
 
-        //RIGHT_TREAD
-        position_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 0;
-        velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = readBrushlessRightVel();
-        effort_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 0;
+        // One consistent copy of the feedback for the whole cycle
+        if (simulation)
+        {
+            readSimulation(time);
+        }
+        else if (can_snapshot)
+        {
+            readCanSnapshot(sensor_state, now);
+        }
+        else
+        {
+            sensor_state = sensors.read();
+        }
+        const SensorState& state = sensor_state;
 
         if (!use_fake_values)
         {
-            //TURNTABLE
-            double turntable_position_double = 
-                linear_interp<double>(static_cast<double>(turntable_encoder), static_cast<double>(turntable_encoder_min),
-                    turntable_joint_min,
-                    static_cast<double>(turntable_encoder_max),
-                    turntable_joint_max
-                    );
-            
-            position_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = turntable_position_double;
-                //reading_a.arm_turntable_pos + turntable_offset;
-            velocity_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = 0; 
-            effort_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = 0;
-
-            //LOWER_ARM
-            //position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = reading_a.arm_lower_pos;
-            double lower_arm_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(lower_arm_encoder),
-                    static_cast<double>(arm_lower_encoder_min),
-                    arm_lower_joint_min,
-                    static_cast<double>(arm_lower_encoder_max),
-                    arm_lower_joint_max
-                    );
-        
-            double upper_arm_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(upper_arm_encoder),
-                    static_cast<double>(arm_upper_encoder_min),
-                    arm_upper_joint_min,
-                    static_cast<double>(arm_upper_encoder_max),
-                    arm_upper_joint_max
-                    );
-
-            double scoop_position_double = 
-                linear_interp<double>(
-                    static_cast<double>(scoop_encoder),
-                    static_cast<double>(arm_end_encoder_min),
-                    arm_end_joint_min,
-                    static_cast<double>(arm_end_encoder_max),
-                    arm_end_joint_max
-                    );
-
-            position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = lower_arm_position_double;
-            velocity_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = 0;
-            effort_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = 0;
-
-            //UPPER_ARM
-            position_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = upper_arm_position_double; //reading_a.arm_upper_pos;
-            velocity_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = 0;
-            effort_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = 0;
-
-            //SCOOP
-            position_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = scoop_position_double; //reading_a.arm_scoop_pos;
-            velocity_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = 0;
-            effort_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = 0;
-
-            /*
-            ROS_INFO_STREAM("turntable_position: read: encoder: " << turntable_encoder << std::endl);
-            ROS_INFO_STREAM("turntable_position: read: " << position_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] << std::endl);
-            */
-            
-            /*
-            ROS_INFO_STREAM("arm_lower_position: read: encoder: " << lower_arm_encoder << std::endl);
-            ROS_INFO_STREAM("arm_lower_position: read: " << position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] << std::endl);
-            */
-            
-            /*
-            ROS_INFO_STREAM("arm_upper_position: read: encoder: " << upper_arm_encoder << std::endl);
-            ROS_INFO_STREAM("arm_upper_position: read: " << position_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] << std::endl);
-            */
-            
-            /*
-            ROS_INFO_STREAM("scoop_position: read: encoder: " << scoop_encoder << std::endl);
-            ROS_INFO_STREAM("scoop_position: read: " << position_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] << std::endl);
-            */
-            
-        }
- 
-        //BIN
-        position_values[static_cast<int>(tfr_utilities::Joint::BIN)] = 0; 
-        velocity_values[static_cast<int>(tfr_utilities::Joint::BIN)] = 0;
-        effort_values[static_cast<int>(tfr_utilities::Joint::BIN)] = 0;
+            // the joints without an encoder position have a zero scale and
+            // offset
+            for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+            {
+                position_values[joint] = position_offset[joint]
+                    + position_scale[joint] * static_cast<double>(state.encoder[joint]);
+            }
+        }
 
+        const double dt = std::max(0.0, (time - last_update).toSec());
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            // the fake joints are moved by write() and have nothing to read
+            if (joint_kind[joint] == JointKind::TREAD
+                    || (joint_kind[joint] != JointKind::UNCONNECTED && !use_fake_values))
+            {
+                readVelocity(static_cast<tfr_utilities::Joint>(joint), now);
+                readEffort(static_cast<tfr_utilities::Joint>(joint), dt);
+            }
+            else
+            {
+                velocity_values[joint] = 0;
+                effort_values[joint] = 0;
+            }
+        }
+
+        if (tread_odometry)
+        {
+            readOdometry(time);
+        }
+    }
+
+    /*
+     * Hands the tread counts the controllers were given this cycle to the
+     * odometry, once both treads have reported and either has something
+     * new.
+     * */
+    void RobotInterface::readOdometry(const ros::Time& time)
+    {
+        const int left = tfr_utilities::Joint::LEFT_TREAD;
+        const int right = tfr_utilities::Joint::RIGHT_TREAD;
+        const SensorState& state = sensor_state;
+        if (state.encoder_stamp[left] == 0 || state.encoder_stamp[right] == 0
+                || (state.encoder_stamp[left] == odometry_stamps[0]
+                    && state.encoder_stamp[right] == odometry_stamps[1]))
+        {
+            return;
+        }
+        odometry_stamps[0] = state.encoder_stamp[left];
+        odometry_stamps[1] = state.encoder_stamp[right];
+        tread_odometry->update(state.encoder[left], state.encoder[right],
+                encoder_rates[left], encoder_rates[right], time);
+    }
+
+    void RobotInterface::readEffort(tfr_utilities::Joint joint, double dt)
+    {
+        // the motor current is signed the way the motor turns, as the
+        // command is
+        const double effort = command_sign[joint] * effort_per_amp[joint] * sensor_state.amps[joint];
+        const double alpha = effort_filter > 0 ? dt / (effort_filter + dt) : 1.0;
+        effort_values[joint] += alpha * (effort - effort_values[joint]);
     }
 
     /*
      * Writes command values from our controllers to our motors and actuators.
      *
      * Takes in command values from the controllers and these values are scaled
-     * to pwm outputs and written to the right place. There are some edge cases
-     * for twin actuators, which are controlled as if they are one joint. 
+     * to pwm outputs and written to the right place. Twin actuators, the
+     * bin's, are controlled as if they are one joint and both get its
+     * command.
      *
-     * The controller gives a command value to move them as one, then we scale
-     * our pwm outputs to move them back into sync if they get out of wack.
+     * Joints in position mode are commanded by their position error, see
+     * positionCommand().
      * */
-    void RobotInterface::write() 
-    {
-
-        double signal;
-        if (use_fake_values) //test code  for working with rviz simulator
-        {
-            adjustFakeJoint(tfr_utilities::Joint::TURNTABLE);
-            adjustFakeJoint(tfr_utilities::Joint::LOWER_ARM);
-            adjustFakeJoint(tfr_utilities::Joint::UPPER_ARM);
-            adjustFakeJoint(tfr_utilities::Joint::SCOOP);
-        }
-        else  // we are working with the real arm
-        {
-            bool write_arm_values;
-            if (not ros::param::getCached("/write_arm_values", write_arm_values)) {write_arm_values = false;}
-            if (write_arm_values){
-                //ROS_INFO("Robot Interface: writing arm values");
-                
-                //TURNTABLE
-                int32_t turntable_position =  std::max(std::min(-command_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)], 1000.0), -1000.0);
-                std_msgs::Int32 turntable_position_msg;
-                turntable_position_msg.data = turntable_position;
-                turntable_publisher.publish(turntable_position_msg);
-
-
-                //LOWER_ARM
-                //NOTE we reverse these because actuator is mounted backwards
-                int32_t arm_lower_position = std::max(std::min(-command_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)],1000.0), -1000.0);
-                std_msgs::Int32 arm_lower_position_msg;
-                arm_lower_position_msg.data = arm_lower_position;
-                lower_arm_publisher.publish(arm_lower_position_msg);
-            
-
-                //UPPER_ARM
-                int32_t arm_upper_position = std::max(std::min(command_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)], 1000.0), -1000.0);
-
-                std_msgs::Int32 arm_upper_position_msg;
-                arm_upper_position_msg.data = arm_upper_position;
-                upper_arm_publisher.publish(arm_upper_position_msg);
-            
-
-                //SCOOP
-                int32_t scoop_position = std::max(std::min(command_values[static_cast<int>(tfr_utilities::Joint::SCOOP)], 1000.0), -1000.0);
-                        
-                std_msgs::Int32 scoop_position_msg;
-                scoop_position_msg.data = scoop_position;
-                scoop_publisher.publish(scoop_position_msg);
-            
-            } else {
-                //ROS_INFO("Robot Interface: not writing arm values");
-            }
-            
+    void RobotInterface::write(const ros::Time& time) 
+    {
+
+        const bool write_arm = write_arm_values;
+
+        // every joint's command in the motor controllers' range, whether or
+        // not it is sent
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            // an arm joint that isn't sent to can't be stalling
+            if (joint_kind[joint] == JointKind::ARM && !write_arm)
+                stall_since[joint] = ros::Time{};
+            const double command = position_mode[joint] && !use_fake_values
+                ? positionCommand(static_cast<tfr_utilities::Joint>(joint), time)
+                : command_values[joint];
+            command_msgs[joint].data = feedback_lost[joint] ? 0 : static_cast<int32_t>(
+                    command_sign[joint] * clamp(command, -1000.0, 1000.0));
         }
-        
-        //LEFT_TREAD
-        double left_tread_command = command_values[static_cast<int32_t>(tfr_utilities::Joint::LEFT_TREAD)];
-        std_msgs::Int32 left_tread_msg;
-        left_tread_msg.data = -1 * clamp(static_cast<int32_t>(left_tread_command), -1000, 1000);
-	    brushless_left_tread_vel_publisher.publish(left_tread_msg);
 
-        //ROS_INFO_STREAM("left_tread_velocity_value: " << velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] << std::endl);
-	    //ROS_INFO_STREAM("left_tread_command: " << left_tread_command << std::endl);
+        // protection acts on this cycle's command, before anything is sent
+        const double dt = std::max(0.0, (time - last_update).toSec());
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            if (current_limited[joint])
+            {
+                limitCurrent(static_cast<tfr_utilities::Joint>(joint), dt, time);
+            }
+        }
 
-        
-        
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            switch (joint_kind[joint])
+            {
+                case JointKind::TREAD:
+                    sendCommand(static_cast<tfr_utilities::Joint>(joint));
+                    break;
+                case JointKind::ARM:
+                    if (use_fake_values) //test code  for working with rviz simulator
+                    {
+                        adjustFakeJoint(static_cast<tfr_utilities::Joint>(joint));
+                    }
+                    else if (write_arm)
+                    {
+                        sendCommand(static_cast<tfr_utilities::Joint>(joint));
+                    }
+                    break;
+                case JointKind::BIN:
+                    if (use_fake_values)
+                    {
+                        adjustFakeJoint(static_cast<tfr_utilities::Joint>(joint));
+                    }
+                    else
+                    {
+                        sendCommand(static_cast<tfr_utilities::Joint>(joint));
+                    }
+                    break;
+                case JointKind::UNCONNECTED:
+                    break;
+            }
+        }
 
-	    if (enable_left_tread_pid_debug_output)
-	    {
-	        double left_tread_setpoint = 0;
-            ros::param::get("/left_tread_velocity_controller/setpoint", left_tread_setpoint);
-            
-            /*
-            ROS_INFO_STREAM_NAMED("debugrobotinterface", 
-            "left_tread: " << std::setw(8) << std::setprecision(2) << left_tread_setpoint << ", "
-            << std::setw(8) << std::setprecision(2) << velocity_values[tfr_utilities::Joint::LEFT_TREAD] << ", "
-            << std::setw(8) << left_tread_msg.data);
-	        */
-	        std_msgs::Float64 left_tread_setpoint_msg;
-	        std_msgs::Float64 left_tread_state_msg;
-	        
-	        left_tread_setpoint_msg.data = left_tread_setpoint;
-	        left_tread_state_msg.data = velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)];
-	        
-	        left_tread_publisher_pid_debug_setpoint.publish(left_tread_setpoint_msg);
-	        left_tread_publisher_pid_debug_state.publish(left_tread_state_msg);
-	        left_tread_publisher_pid_debug_command.publish(left_tread_msg);
-	        
-	    }
-
-
-        //RIGHT_TREAD
-        double right_tread_command = command_values[static_cast<int32_t>(tfr_utilities::Joint::RIGHT_TREAD)];
-        std_msgs::Int32 right_tread_msg;
-        right_tread_msg.data = -1 * clamp(static_cast<int32_t>(right_tread_command), -1000, 1000);
-        brushless_right_tread_vel_publisher.publish(right_tread_msg);
-        
         //UPKEEP
-        last_update = ros::Time::now();
+        last_update = time;
         drivebase_v0.first = velocity_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)];
         drivebase_v0.second = velocity_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)];
+
+        recordTrace();
     }
-    
-    template <typename T>
-    T RobotInterface::linear_interp(T x, T x1, T y1, T x2, T y2)
+
+    /*
+     * Reads the limits of every joint with a current reading, from
+     * ~current_limits/<joint name>/, see config/current_limits.yaml.
+     * */
+    void RobotInterface::loadCurrentLimits()
+    {
+        bool enabled;
+        ros::param::param<bool>("~current_limits/enabled", enabled, true);
+        if (!enabled)
+        {
+            ROS_WARN("control: current limits are off");
+            return;
+        }
+
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            if (row.amps_topic == nullptr)
+                continue;
+            const std::string prefix = std::string("~current_limits/") + row.name + "/";
+            tfr_utilities::CurrentLimiter::Limits limits;
+            ros::param::param<double>(prefix + "continuous", limits.continuous, 8.0);
+            ros::param::param<double>(prefix + "peak", limits.peak, 20.0);
+            ros::param::param<double>(prefix + "release", limits.release, 4.0);
+            ros::param::param<double>(prefix + "i2t_time", limits.i2t_time, 2.0);
+            current_limiters[row.joint] = tfr_utilities::CurrentLimiter{limits};
+            current_limited[row.joint] = true;
+        }
+    }
+
+    /*
+     * Runs the joint's limiter on this cycle's current, and scales its
+     * command by what it allows.
+     * */
+    void RobotInterface::limitCurrent(tfr_utilities::Joint joint, double dt,
+            const ros::Time& time)
+    {
+        tfr_utilities::CurrentLimiter& limiter = current_limiters[joint];
+        const double amps = sensor_state.amps[joint];
+        const double scale = limiter.update(amps, dt);
+        command_msgs[joint].data = static_cast<int32_t>(command_msgs[joint].data * scale);
+
+        if (limiter.state() != current_states[joint])
+        {
+            current_states[joint] = limiter.state();
+            // a full queue only loses the report, the command is limited
+            // either way
+            current_events.push(CurrentEvent{time.toNSec(), joint, limiter.state(),
+                    static_cast<float>(amps), static_cast<float>(limiter.heat()),
+                    static_cast<float>(scale)});
+        }
+    }
+
+    void RobotInterface::publishCurrentEvents(const ros::TimerEvent& event)
+    {
+        CurrentEvent current_event;
+        while (current_events.pop(current_event))
+        {
+            current_event_msg.header.stamp.fromNSec(current_event.stamp);
+            current_event_msg.joint = JOINT_TABLE[current_event.joint].name;
+            current_event_msg.state = current_event.state;
+            current_event_msg.amps = current_event.amps;
+            current_event_msg.heat = current_event.heat;
+            current_event_msg.scale = current_event.scale;
+            current_event_publisher.publish(current_event_msg);
+            if (current_event.state == tfr_utilities::CurrentLimiter::TRIPPED)
+            {
+                ROS_WARN_STREAM("control: " << current_event_msg.joint << " tripped at "
+                        << current_event.amps << " A");
+            }
+        }
+    }
+
+    void RobotInterface::sendCommand(tfr_utilities::Joint joint)
+    {
+        if (simulation)
+        {
+            simulation->command(joint, command_msgs[joint].data);
+        }
+        else
+        {
+            // roscpp serializes into a new buffer for each subscriber's
+            // sake, the one allocation left in a cycle, see control.h
+            command_publishers[joint].publish(command_msgs[joint]);
+            if (twin_publishers[joint])
+            {
+                twin_publishers[joint].publish(command_msgs[joint]);
+            }
+        }
+    }
+
+    /*
+     * The motor command that takes a joint in position mode to the
+     * position its controller asked for: proportional to the error,
+     * nothing once inside the tolerance.
+     *
+     * Nothing either for a target the joint can't reach, which would only
+     * hold its motors stalled against an end stop: one past the joint's
+     * travel, or one it has stopped short of, not moving by the tolerance
+     * for stall_time. A new target or the joint moving tries again.
+     * */
+    double RobotInterface::positionCommand(tfr_utilities::Joint joint, const ros::Time& time)
+    {
+        const double target = command_values[joint];
+        const double position = position_values[joint];
+        const double tolerance = position_tolerance[joint];
+        if (target != stall_target[joint] || std::abs(position - stall_position[joint]) > tolerance
+                || stall_since[joint].isZero())
+        {
+            stall_target[joint] = target;
+            stall_position[joint] = position;
+            stall_since[joint] = time;
+        }
+
+        const double error = target - position;
+        if (std::abs(error) <= tolerance)
+        {
+            stall_since[joint] = time;
+            return 0.0;
+        }
+        if (target < position_low[joint] - tolerance || target > position_high[joint] + tolerance)
+            return 0.0;
+        if ((time - stall_since[joint]).toSec() > stall_time[joint])
+            return 0.0;
+        return position_gain[joint] * error;
+    }
+
+    /*
+     * Called by the controller manager, on the control thread, as
+     * controllers start and stop. A joint is in position mode while a
+     * controller holds it through the PositionJointInterface, and back to
+     * effort when that controller stops.
+     * */
+    void RobotInterface::doSwitch(const std::list<hardware_interface::ControllerInfo>& start_list,
+            const std::list<hardware_interface::ControllerInfo>& stop_list)
+    {
+        const std::string position_interface = "hardware_interface::PositionJointInterface";
+        for (const hardware_interface::ControllerInfo& controller : stop_list)
+        {
+            for (const hardware_interface::InterfaceResources& claimed : controller.claimed_resources)
+            {
+                if (claimed.hardware_interface != position_interface)
+                    continue;
+                for (const JointDescriptor& row : JOINT_TABLE)
+                {
+                    if (claimed.resources.count(row.name) != 0)
+                        position_mode[row.joint] = false;
+                }
+            }
+        }
+        for (const hardware_interface::ControllerInfo& controller : start_list)
+        {
+            for (const hardware_interface::InterfaceResources& claimed : controller.claimed_resources)
+            {
+                if (claimed.hardware_interface != position_interface)
+                    continue;
+                for (const JointDescriptor& row : JOINT_TABLE)
+                {
+                    if (claimed.resources.count(row.name) != 0)
+                    {
+                        position_mode[row.joint] = true;
+                        // hold still until the controller says otherwise
+                        command_values[row.joint] = position_values[row.joint];
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * Runs the simulated motor controllers up to this cycle and reads them
+     * the way the bridge would have, everything stamped with the cycle's
+     * time.
+     * */
+    void RobotInterface::readSimulation(const ros::Time& time)
+    {
+        if (!simulation_time.isZero() && time > simulation_time)
+        {
+            simulation->step((time - simulation_time).toSec());
+        }
+        simulation_time = time;
+
+        const uint64_t stamp = time.toNSec();
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            if (row.encoder_topic != nullptr)
+            {
+                sensor_state.encoder[row.joint] = simulation->encoder(row.joint);
+                sensor_state.encoder_stamp[row.joint] = stamp;
+            }
+            if (row.amps_topic != nullptr)
+            {
+                sensor_state.amps[row.joint] = simulation->amps(row.joint);
+                sensor_state.amps_stamp[row.joint] = stamp;
+            }
+        }
+    }
+
+    /*
+     * Hands this cycle to the trace, whatever was sent or not.
+     * */
+    void RobotInterface::recordTrace()
     {
-        // line defined by two points: (x1, y1) and (x2, y2)
-        T y = ((y2 - y1)/(x2 - x1))*(x - x1) + y1;
-        return y;
+        trace_record.stamp = last_update.toNSec();
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            trace_record.setpoint[joint] = static_cast<float>(setpoints[joint].load(std::memory_order_relaxed));
+            trace_record.position[joint] = static_cast<float>(position_values[joint]);
+            trace_record.velocity[joint] = static_cast<float>(velocity_values[joint]);
+            trace_record.current[joint] = static_cast<float>(sensor_state.amps[joint]);
+            trace_record.command[joint] = command_msgs[joint].data;
+        }
+        trace->push(trace_record);
     }
     
     template <typename T>
@@ -356,36 +573,19 @@ namespace tfr_control
         return std::max(std::min(input, upper_bound), lower_bound);
     }
 
-    // TODO: Horrible duplication of code should be removed.
-    // has hardcoded min joint position in header file
-    const int32_t RobotInterface::get_arm_lower_min_int()
+    void RobotInterface::setEnabled(bool val)
     {
-        double arm_lower_joint_min_mapped = linear_interp<double>(arm_lower_joint_min * -10,
-                arm_lower_joint_min,
-                std::numeric_limits<int32_t>::min(),
-                arm_lower_joint_max, 
-                std::numeric_limits<int32_t>::max());
-        int32_t arm_lower_joint_min_mapped_int = static_cast<int32_t>(arm_lower_joint_min_mapped);
-        
-        return arm_lower_joint_min_mapped_int;
+        enabled = val;
     }
-        
-    // has hardcoded max joint position in header file
-    const int32_t RobotInterface::get_arm_lower_max_int()
-    {
-        double arm_lower_joint_max_mapped = linear_interp<double>(arm_lower_joint_max * 10,
-                arm_lower_joint_min,
-                std::numeric_limits<int32_t>::min(),
-                arm_lower_joint_max, 
-                std::numeric_limits<int32_t>::max());
-        int32_t arm_lower_joint_max_mapped_int = static_cast<int32_t>(arm_lower_joint_max_mapped);
-        
-        return arm_lower_joint_max_mapped_int;
+
+    double RobotInterface::getAcceleration(tfr_utilities::Joint joint) const
+    {
+        return acceleration_values[joint];
     }
-    
-    void RobotInterface::setEnabled(bool val)
+
+    void RobotInterface::setWriteArmValues(bool val)
     {
-        enabled = val;
+        write_arm_values = val;
     }
 
     void RobotInterface::adjustFakeJoint(const tfr_utilities::Joint &j)
@@ -407,24 +607,11 @@ namespace tfr_control
      * */
     void RobotInterface::clearCommands()
     {
-        //LEFT_TREAD
-        command_values[static_cast<int>(tfr_utilities::Joint::LEFT_TREAD)] = 0;
-
-        //RIGHT_TREAD
-        command_values[static_cast<int>(tfr_utilities::Joint::RIGHT_TREAD)] = 0;
-
-        //TURNTABLE
-        command_values[static_cast<int>(tfr_utilities::Joint::TURNTABLE)] = 0;
-
-        //LOWER_ARM
-        command_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = 0;
-        
-        //UPPER_ARM
-        command_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = 0;
-        //SCOOP
-        command_values[static_cast<int>(tfr_utilities::Joint::SCOOP)] = 0;
-        //BIN
-        command_values[static_cast<int>(tfr_utilities::Joint::BIN)] = 0;
+        // no effort, and the joints in position mode stay where they are
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            command_values[joint] = position_mode[joint] ? position_values[joint] : 0;
+        }
     }
 
     /*
@@ -446,72 +633,28 @@ namespace tfr_control
         position.push_back(position_values[static_cast<int>(tfr_utilities::Joint::SCOOP)]);
     }
 
-    void RobotInterface::readTurntableEncoder(const std_msgs::Int32 &msg)
-    {
-        turntable_mutex.lock();
-        
-        turntable_encoder = msg.data;
-        
-        turntable_mutex.unlock();
-    }
-    
-    void RobotInterface::readTurntableAmps(const std_msgs::Float64 &msg)
+    /*
+     * Publishes one reading into the shared sensor state. Called from the
+     * subscription callbacks, which all run on the one spinner thread.
+     * */
+    void RobotInterface::receiveEncoder(tfr_utilities::Joint joint, int32_t encoder)
     {
-        turntable_amps = msg.data;
+        const uint64_t stamp = ros::Time::now().toNSec();
+        sensors.update([=](SensorState& state)
+            {
+                state.encoder[joint] = encoder;
+                state.encoder_stamp[joint] = stamp;
+            });
     }
 
-    void RobotInterface::readLowerArmEncoder(const std_msgs::Int32 &msg)
-    {
-        lower_arm_mutex.lock();
-        
-        lower_arm_encoder = msg.data;
-        //ROS_INFO_STREAM("lower_arm_encoder: " << lower_arm_encoder << std::endl);
-        
-        lower_arm_mutex.unlock();
-    }
-    
-    // TODO: Add mutex to protect all of these arm readings from reading while writing.
-    void RobotInterface::readLowerArmAmps(const std_msgs::Float64 &msg)
-    {
-        lower_arm_amps = msg.data;
-        //position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = msg.data;
-        //ROS_INFO_STREAM("lower_arm_ams: " << position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] << std::endl);
-    }
-    
-    
-    void RobotInterface::readUpperArmEncoder(const std_msgs::Int32 &msg)
+    void RobotInterface::receiveAmps(tfr_utilities::Joint joint, double amps)
     {
-        upper_arm_mutex.lock();
-        
-        upper_arm_encoder = msg.data;
-        //ROS_INFO_STREAM("upper_arm_encoder: " << upper_arm_encoder << std::endl);
-        
-        upper_arm_mutex.unlock();
-    }
-    
-    void RobotInterface::readUpperArmAmps(const std_msgs::Float64 &msg)
-    {
-        upper_arm_amps = msg.data;
-        //position_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] = msg.data;
-        //ROS_INFO_STREAM("lower_arm_ams: " << position_values[static_cast<int>(tfr_utilities::Joint::UPPER_ARM)] << std::endl);
-    }
-    
-    
-    void RobotInterface::readScoopEncoder(const std_msgs::Int32 &msg)
-    {
-        scoop_mutex.lock();
-        
-        scoop_encoder = msg.data;
-        //ROS_INFO_STREAM("scoop_encoder: " << scoop_encoder << std::endl);
-        
-        scoop_mutex.unlock();
-    }
-    
-    void RobotInterface::readScoopAmps(const std_msgs::Float64 &msg)
-    {
-        scoop_amps = msg.data;
-        //position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] = msg.data;
-        //ROS_INFO_STREAM("lower_arm_ams: " << position_values[static_cast<int>(tfr_utilities::Joint::LOWER_ARM)] << std::endl);
+        const uint64_t stamp = ros::Time::now().toNSec();
+        sensors.update([=](SensorState& state)
+            {
+                state.amps[joint] = amps;
+                state.amps_stamp[joint] = stamp;
+            });
     }
 
     /*
@@ -530,137 +673,149 @@ namespace tfr_control
         joint_effort_interface.registerHandle(handle);
     }
 
+
+
     /*
-     * Register this joint with each neccessary hardware interface
+     * Switches the encoder and current feedback over to the CAN bridge's
+     * shared snapshot. The topic subscriptions are dropped so there is only
+     * ever one writer.
      * */
-     /*
-    void RobotInterface::registerBinJoint(std::string name, Joint joint) 
+    void RobotInterface::openCanSnapshot(ros::NodeHandle& n)
     {
-        auto idx = static_cast<int>(joint);
-        //give the joint a state
-        JointStateHandle state_handle(name, &position_values[idx],
-            &velocity_values[idx], &effort_values[idx]);
-        joint_state_interface.registerHandle(state_handle);
+        can_snapshot.reset(new tfr_utilities::CanSnapshot());
+        if (!can_snapshot->isOpen())
+        {
+            ROS_ERROR("tfr_control: could not open the CAN snapshot, using the device topics instead.");
+            can_snapshot.reset();
+            return;
+        }
+        double max_age;
+        ros::param::param<double>("~can_snapshot_max_age", max_age, 0.5);
+        snapshot_max_age = static_cast<uint64_t>(max_age * 1e9);
+        feedback_timer = n.createTimer(ros::Duration(0.2), &RobotInterface::reportLostFeedback, this);
 
-        //allow the joint to be commanded
-        JointHandle handle(state_handle, &command_values[idx]);
-        joint_position_interface.registerHandle(handle);
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            encoder_subscribers[row.joint].shutdown();
+            amps_subscribers[row.joint].shutdown();
+            if (row.encoder_topic != nullptr)
+            {
+                encoder_sources[row.joint].slot = can_snapshot->slot(row.encoder_topic + 1);
+            }
+            if (row.amps_topic != nullptr)
+            {
+                amps_sources[row.joint].slot = can_snapshot->slot(row.amps_topic + 1);
+            }
+        }
     }
-    */
-
 
-    void RobotInterface::setBrushlessLeftEncoder(const std_msgs::Int32 &msg)
-    {
-        left_tread_absolute_encoder_current = msg.data;
-        left_tread_time_current = ros::Time::now();
-    }
-    
-    void RobotInterface::setBrushlessRightEncoder(const std_msgs::Int32 &msg)
+    /*
+     * Returns true if the slot holds a sample we haven't seen yet, and it
+     * is recent enough to use.
+     * */
+    bool RobotInterface::pollSnapshot(SnapshotSource& source, tfr_utilities::CanSample& sample,
+            uint64_t now) const
     {
-        right_tread_absolute_encoder_current = msg.data;
-        right_tread_time_current = ros::Time::now();
+        if (source.slot == nullptr
+                || !tfr_utilities::CanSnapshot::read(*source.slot, sample)
+                || sample.count == source.count)
+        {
+            return false;
+        }
+        source.count = sample.count;
+        return !snapshotLost(source, sample.stamp, now);
     }
 
     /*
-     * Register this joint with each neccessary hardware interface
+     * Whether a slot's latest sample, stamped stamp, is missing or too old.
+     * Slots the joint doesn't read are never lost.
      * */
-    void RobotInterface::registerJointPositionInterface(std::string name, tfr_utilities::Joint joint) 
+    bool RobotInterface::snapshotLost(const SnapshotSource& source, uint64_t stamp,
+            uint64_t now) const
     {
-        auto idx = static_cast<int>(joint);
-        //give the joint a state
-        JointStateHandle state_handle(name, &position_values[idx],
-            &velocity_values[idx], &effort_values[idx]);
-        joint_state_interface.registerHandle(state_handle);
-
-        //allow the joint to be commanded
-        JointHandle handle(state_handle, &command_values[idx]);
-        joint_position_interface.registerHandle(handle);
+        return source.slot != nullptr
+            && (stamp == 0 || (now > stamp && now - stamp > snapshot_max_age));
     }
 
-    // get the ratio of the encoder count to the max encoder count for a revolution
-    double RobotInterface::brushlessEncoderCountToRadians(int32_t encoder_count)
+    /*
+     * Does what the topic callbacks would have, for every new sample, but
+     * straight into the control thread's copy of the state. Samples that
+     * haven't changed leave the last value in place until they are too
+     * old, when the joint's feedback is lost.
+     * */
+    void RobotInterface::readCanSnapshot(SensorState& state, uint64_t now)
     {
-        return (2 * pi) * brushlessEncoderCountToRevolutions(encoder_count);
+        tfr_utilities::CanSample sample;
+        uint32_t lost = 0;
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            if (pollSnapshot(encoder_sources[joint], sample, now))
+            {
+                state.encoder[joint] = static_cast<int32_t>(sample.value);
+                state.encoder_stamp[joint] = sample.stamp;
+            }
+            if (pollSnapshot(amps_sources[joint], sample, now))
+            {
+                state.amps[joint] = ROBOTEQ_AMPS_PER_COUNT * static_cast<double>(sample.value);
+                state.amps_stamp[joint] = sample.stamp;
+            }
+            feedback_lost[joint] = snapshotLost(encoder_sources[joint], state.encoder_stamp[joint], now)
+                || snapshotLost(amps_sources[joint], state.amps_stamp[joint], now);
+            if (feedback_lost[joint])
+            {
+                lost |= 1u << joint;
+            }
+        }
+        lost_feedback.store(lost, std::memory_order_relaxed);
     }
 
-    double RobotInterface::brushlessEncoderCountToRevolutions(int32_t encoder_count)
-    {
-        return (static_cast<double>(encoder_count) / static_cast<double>(brushless_encoder_count_per_revolution));
-    }
-   
-    // returns the linear speed of the robot (how fast it is moving forwards) in meters / second.
-    double RobotInterface::encoderDeltaToLinearSpeed(int32_t encoder_delta, ros::Duration time_delta)
+    /*
+     * Says which joints lost or got back their feedback since the last
+     * time.
+     * */
+    void RobotInterface::reportLostFeedback(const ros::TimerEvent& event)
     {
-        const double wheel_radius_meters = 0.1524; 
-        const double wheel_circumference = 2 * pi * wheel_radius_meters;
-        
-        const double revolutions = brushlessEncoderCountToRevolutions(encoder_delta);
-        
-        const double linear_speed_meters_per_sec = (wheel_circumference * revolutions) / time_delta.toSec();
-        
-        return linear_speed_meters_per_sec;
+        const uint32_t lost = lost_feedback.load(std::memory_order_relaxed);
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            const uint32_t bit = 1u << row.joint;
+            if ((lost & bit) == (reported_lost_feedback & bit))
+                continue;
+            if (lost & bit)
+                ROS_ERROR_STREAM("control: no CAN feedback for " << row.name
+                        << " in the last " << snapshot_max_age * 1e-9 << " s, not driving it");
+            else
+                ROS_INFO_STREAM("control: CAN feedback for " << row.name << " is back");
+        }
+        reported_lost_feedback = lost;
     }
 
-    
-    void RobotInterface::accumulateBrushlessRightVel(const std_msgs::Int32 &msg)
-    {
-        brushless_right_tread_mutex.lock();
-
-        accumulated_brushless_right_tread_vel = msg.data;
-        accumulated_brushless_right_tread_vel_num_updates++;
-        accumulated_brushless_right_tread_vel_end_time = ros::Time::now(); // keep this call inside the mutex. The readBrushlessRightVel() call will also update it.
-
-        brushless_right_tread_mutex.unlock();
-        
-    }
-    
-    void RobotInterface::accumulateBrushlessLeftVel(const std_msgs::Int32 &msg)
+    /*
+     * Lets the joint, already registered for effort, be commanded by
+     * position too. Both share the one command value, see doSwitch().
+     * */
+    void RobotInterface::registerJointPositionInterface(std::string name, tfr_utilities::Joint joint) 
     {
-        brushless_left_tread_mutex.lock();
-
-        accumulated_brushless_left_tread_vel = msg.data;
-        accumulated_brushless_left_tread_vel_num_updates++;
-        accumulated_brushless_left_tread_vel_end_time = ros::Time::now();
-
-        brushless_left_tread_mutex.unlock();
-        
-        
+        auto idx = static_cast<int>(joint);
+        JointHandle handle(joint_state_interface.getHandle(name), &command_values[idx]);
+        joint_position_interface.registerHandle(handle);
     }
-    
-    double RobotInterface::readBrushlessRightVel()
-    {
-        brushless_right_tread_mutex.lock();
 
-        int32_t encoder_delta = right_tread_absolute_encoder_current - right_tread_absolute_encoder_previous;
-        
-        ros::Duration time_delta = right_tread_time_current - right_tread_time_previous;
-        
-        right_tread_absolute_encoder_previous = right_tread_absolute_encoder_current;
-        right_tread_time_previous = right_tread_time_current;
-        
-        brushless_right_tread_mutex.unlock();
-        
-        const double linear_speed_meters_per_sec = encoderDeltaToLinearSpeed(encoder_delta, time_delta);
-        
-        return linear_speed_meters_per_sec;
-    }
-    
-    double RobotInterface::readBrushlessLeftVel()
+    /*
+     * Feeds the joint's latest encoder reading to its estimator, if it is a
+     * new one, and sets its velocity and acceleration in joint units.
+     * */
+    void RobotInterface::readVelocity(tfr_utilities::Joint joint, uint64_t now)
     {
-        brushless_left_tread_mutex.lock();
-
-        int32_t encoder_delta = left_tread_absolute_encoder_current - left_tread_absolute_encoder_previous;
-        
-        ros::Duration time_delta = left_tread_time_current - left_tread_time_previous;
-        
-        left_tread_absolute_encoder_previous = left_tread_absolute_encoder_current;
-        left_tread_time_previous = left_tread_time_current;
-        
-        brushless_left_tread_mutex.unlock();
-        
-        const double linear_speed_meters_per_sec = encoderDeltaToLinearSpeed(encoder_delta, time_delta);
-        
-        return linear_speed_meters_per_sec;
+        if (sensor_state.encoder_stamp[joint] != 0)
+        {
+            velocity_estimators[joint].addSample(sensor_state.encoder[joint], sensor_state.encoder_stamp[joint]);
+        }
+        double velocity, acceleration;
+        velocity_estimators[joint].estimate(now, velocity, acceleration);
+        encoder_rates[joint] = velocity;
+        velocity_values[joint] = velocity_scale[joint] * velocity;
+        acceleration_values[joint] = velocity_scale[joint] * acceleration;
     }
     
     
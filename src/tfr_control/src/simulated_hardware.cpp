@@ -0,0 +1,178 @@
+#include "simulated_hardware.h"
+#include "joint_table.h"
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace tfr_control
+{
+    namespace
+    {
+        // longest step the models are integrated over, for the second order
+        // ones to stay stable at any loop rate
+        const double MAX_SUBSTEP = 0.001;
+
+        const SimulatedHardware::ActuatorModel TREAD_DEFAULTS{
+            1,      // order
+            1.0,    // max_speed, m/s
+            0.2,    // time_constant
+            10.0,   // natural_frequency
+            0.8,    // damping
+            2.0,    // max_acceleration
+            0.5,    // amps_idle
+            8.0,    // amps_per_speed
+            4.0,    // amps_per_acceleration
+            40.0,   // amps_stall
+        };
+
+        const SimulatedHardware::ActuatorModel ARM_DEFAULTS{
+            1,      // order
+            0.25,   // max_speed, rad/s
+            0.05,   // time_constant
+            20.0,   // natural_frequency
+            0.9,    // damping
+            1.0,    // max_acceleration
+            0.2,    // amps_idle
+            4.0,    // amps_per_speed
+            1.0,    // amps_per_acceleration
+            15.0,   // amps_stall
+        };
+
+        SimulatedHardware::ActuatorModel loadModel(const JointDescriptor& row,
+                const SimulatedHardware::ActuatorModel& defaults, double& initial_position)
+        {
+            ros::NodeHandle n{"~simulation/" + std::string(row.name)};
+            SimulatedHardware::ActuatorModel model;
+            n.param<int>("order", model.order, defaults.order);
+            n.param<double>("max_speed", model.max_speed, defaults.max_speed);
+            n.param<double>("time_constant", model.time_constant, defaults.time_constant);
+            n.param<double>("natural_frequency", model.natural_frequency, defaults.natural_frequency);
+            n.param<double>("damping", model.damping, defaults.damping);
+            n.param<double>("max_acceleration", model.max_acceleration, defaults.max_acceleration);
+            n.param<double>("amps_idle", model.amps_idle, defaults.amps_idle);
+            n.param<double>("amps_per_speed", model.amps_per_speed, defaults.amps_per_speed);
+            n.param<double>("amps_per_acceleration", model.amps_per_acceleration,
+                    defaults.amps_per_acceleration);
+            n.param<double>("amps_stall", model.amps_stall, defaults.amps_stall);
+            const double default_position = initial_position;
+            n.param<double>("initial_position", initial_position, default_position);
+
+            if (model.order != 1 && model.order != 2)
+            {
+                ROS_WARN_STREAM("control: " << row.name << " simulation order must be 1 or 2, using 1");
+                model.order = 1;
+            }
+            model.time_constant = std::max(model.time_constant, MAX_SUBSTEP);
+            model.max_speed = std::abs(model.max_speed);
+            return model;
+        }
+    }
+
+    SimulatedHardware::SimulatedHardware()
+    {
+        for (const JointDescriptor& row : JOINT_TABLE)
+        {
+            if (row.kind == JointKind::UNCONNECTED)
+                continue;
+            const tfr_utilities::Joint joint = row.joint;
+            simulated[joint] = true;
+            bounded[joint] = row.kind != JointKind::TREAD;
+
+            const double low = std::min(row.joint_min, row.joint_max);
+            const double high = std::max(row.joint_min, row.joint_max);
+            double initial_position = bounded[joint] ? std::max(low, std::min(0.0, high)) : 0.0;
+            models[joint] = loadModel(row,
+                    row.kind == JointKind::TREAD ? TREAD_DEFAULTS : ARM_DEFAULTS, initial_position);
+            position[joint] = initial_position;
+        }
+    }
+
+    void SimulatedHardware::command(tfr_utilities::Joint joint, int32_t value)
+    {
+        // undo the sign the interface put on for the motor's mounting
+        const double fraction = JOINT_TABLE[joint].command_sign * value / 1000.0;
+        commanded_speed[joint] = std::max(-1.0, std::min(fraction, 1.0)) * models[joint].max_speed;
+    }
+
+    void SimulatedHardware::step(double dt)
+    {
+        if (dt <= 0)
+            return;
+        const int substeps = static_cast<int>(std::ceil(dt / MAX_SUBSTEP));
+        const double h = dt / substeps;
+
+        for (int joint = 0; joint < tfr_utilities::Joint::JOINT_COUNT; joint++)
+        {
+            if (!simulated[joint])
+                continue;
+            const ActuatorModel& model = models[joint];
+            const JointDescriptor& row = JOINT_TABLE[joint];
+            const double low = std::min(row.joint_min, row.joint_max);
+            const double high = std::max(row.joint_min, row.joint_max);
+            const double target = commanded_speed[joint];
+
+            for (int i = 0; i < substeps; i++)
+            {
+                double a;
+                if (model.order == 1)
+                {
+                    a = (target - speed[joint]) / model.time_constant;
+                }
+                else
+                {
+                    const double w = model.natural_frequency;
+                    a = acceleration[joint]
+                        + h * (w * w * (target - speed[joint]) - 2 * model.damping * w * acceleration[joint]);
+                }
+                a = std::max(-model.max_acceleration, std::min(a, model.max_acceleration));
+                acceleration[joint] = a;
+                speed[joint] += a * h;
+                position[joint] += speed[joint] * h;
+
+                stalled[joint] = false;
+                if (bounded[joint] && (position[joint] <= low || position[joint] >= high))
+                {
+                    const bool at_low = position[joint] <= low;
+                    position[joint] = at_low ? low : high;
+                    if (at_low ? speed[joint] < 0 : speed[joint] > 0)
+                    {
+                        speed[joint] = 0;
+                        acceleration[joint] = 0;
+                    }
+                    stalled[joint] = at_low ? target < 0 : target > 0;
+                }
+            }
+        }
+    }
+
+    int32_t SimulatedHardware::encoder(tfr_utilities::Joint joint) const
+    {
+        const JointDescriptor& row = JOINT_TABLE[joint];
+        const double scale = encoderScale(row);
+        if (!simulated[joint] || scale == 0)
+            return 0;
+        const int64_t counts = row.encoder_min + std::llround((position[joint] - row.joint_min) / scale);
+        // a 32 bit counter, wrapping like the motor controllers' do
+        return static_cast<int32_t>(static_cast<uint32_t>(counts));
+    }
+
+    double SimulatedHardware::amps(tfr_utilities::Joint joint) const
+    {
+        if (!simulated[joint])
+            return 0;
+        const ActuatorModel& model = models[joint];
+        // the current flows the way the motor is driven, or while it isn't,
+        // the way it is still turning. Neither, it draws nothing.
+        const double drive = commanded_speed[joint] != 0 ? commanded_speed[joint] : speed[joint];
+        const double direction = drive > 0 ? 1.0 : drive < 0 ? -1.0 : 0.0;
+        double amps = model.amps_idle
+            + model.amps_per_speed * std::abs(speed[joint])
+            + model.amps_per_acceleration * std::abs(acceleration[joint]);
+        if (stalled[joint] && model.max_speed > 0)
+            amps += model.amps_stall * std::abs(commanded_speed[joint]) / model.max_speed;
+        // as the motor controller reports it, signed by the motor's mounting
+        return JOINT_TABLE[joint].command_sign * direction * amps;
+    }
+}
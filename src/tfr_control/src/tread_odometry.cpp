@@ -0,0 +1,153 @@
+#include "tread_odometry.h"
+#include "joint_table.h"
+#include <tf/transform_datatypes.h>
+
+namespace tfr_control
+{
+    constexpr double TreadOdometry::MAX_XY_DELTA;
+    constexpr double TreadOdometry::MAX_THETA_DELTA;
+
+    bool TreadOdometry::enabled()
+    {
+        bool enabled;
+        ros::param::param<bool>("~tread_odometry/enabled", enabled, false);
+        return enabled;
+    }
+
+    TreadOdometry::TreadOdometry(ros::NodeHandle& n) :
+        settings{loadSettings()},
+        odometry{settings},
+        slip{loadSlipSettings()},
+        imu_stamp{0},
+        corrections_applied{0},
+        published_stamp{0}
+    {
+        ros::NodeHandle private_n{"~tread_odometry"};
+        double rate, velocity_stddev;
+        private_n.param<double>("rate", rate, 50.0);
+        private_n.param<double>("velocity_stddev", velocity_stddev, 0.05);
+        velocity_variance = velocity_stddev * velocity_stddev;
+        private_n.param<std::string>("parent_frame", parent_frame, "odom");
+        private_n.param<std::string>("child_frame", child_frame, "base_footprint");
+
+        prior_subscriber = n.subscribe("/sensors/orientation_prior", 10, &TreadOdometry::receivePrior, this);
+        odometry_publisher = n.advertise<nav_msgs::Odometry>("/drivebase_odom", 15);
+        slip_publisher = n.advertise<tfr_msgs::SlipIndicator>("/drivebase_odom/slip", 15);
+        set_odometry = n.advertiseService("/set_drivebase_odometry", &TreadOdometry::setOdometry, this);
+        reset_odometry = n.advertiseService("/reset_drivebase_odometry", &TreadOdometry::resetOdometry, this);
+        publish_timer = n.createTimer(ros::Duration(1.0 / rate), &TreadOdometry::publish, this);
+    }
+
+    tfr_utilities::TreadEncoderOdometry::Settings TreadOdometry::loadSettings()
+    {
+        const JointDescriptor& left = JOINT_TABLE[tfr_utilities::Joint::LEFT_TREAD];
+        const JointDescriptor& right = JOINT_TABLE[tfr_utilities::Joint::RIGHT_TREAD];
+        ros::NodeHandle n{"~tread_odometry"};
+        tfr_utilities::TreadEncoderOdometry::Settings settings;
+        n.param<double>("left_meters_per_count", settings.left_meters_per_count, encoderScale(left));
+        n.param<double>("right_meters_per_count", settings.right_meters_per_count, encoderScale(right));
+        n.param<double>("wheel_span", settings.wheel_span, tfr_utilities::TREAD_WHEEL_SPAN);
+        n.param<double>("max_step", settings.max_step, 0.5);
+        n.param<double>("noise_per_meter", settings.noise_per_meter, 0.001);
+        return settings;
+    }
+
+    tfr_utilities::SlipDetector::Settings TreadOdometry::loadSlipSettings()
+    {
+        ros::NodeHandle n{"~tread_odometry/slip"};
+        tfr_utilities::SlipDetector::Settings settings;
+        n.param<double>("rate_tolerance", settings.rate_tolerance, 0.1);
+        n.param<double>("time_constant", settings.time_constant, 0.2);
+        n.param<double>("max_inflation", settings.max_inflation, 100.0);
+        n.param<double>("imu_timeout", settings.imu_timeout, 0.25);
+        return settings;
+    }
+
+    void TreadOdometry::update(int32_t left, int32_t right, double left_rate, double right_rate,
+            const ros::Time& time)
+    {
+        const Correction correction = corrections.read();
+        if (correction.count != corrections_applied)
+        {
+            corrections_applied = correction.count;
+            tfr_utilities::DiffDriveOdometry& drive = odometry.odometry();
+            drive.reset(correction.smooth
+                    ? tfr_utilities::DiffDriveOdometry::approach(drive.pose(),
+                        correction.pose, MAX_XY_DELTA, MAX_THETA_DELTA)
+                    : correction.pose);
+            if (!correction.smooth)
+                drive.setCovariance({});
+        }
+
+        const ImuRate imu = imu_rate.read();
+        if (imu.stamp != imu_stamp)
+        {
+            imu_stamp = imu.stamp;
+            slip.imu(imu.yaw_rate, imu.stamp * 1e-9);
+        }
+
+        const double v_l = settings.left_meters_per_count * left_rate;
+        const double v_r = settings.right_meters_per_count * right_rate;
+        const double angular = (v_r - v_l) / settings.wheel_span;
+        const double dt = last_update.isZero() ? 0.0 : (time - last_update).toSec();
+        last_update = time;
+        const double inflation = slip.update(angular, time.toSec(), dt);
+        odometry.update(left, right, inflation);
+
+        estimate.write(Estimate{time.toNSec(), tfr_utilities::estimateOf(odometry.odometry(),
+                    slip, v_l, v_r, velocity_variance, inflation)});
+    }
+
+    /*
+     * On the spinner thread, the only writer of imu_rate.
+     * */
+    void TreadOdometry::receivePrior(const tfr_msgs::OrientationPriorConstPtr& prior)
+    {
+        imu_rate.write(ImuRate{prior->header.stamp.toNSec(), prior->yaw_rate});
+    }
+
+    bool TreadOdometry::setOdometry(tfr_msgs::SetOdometry::Request& request,
+            tfr_msgs::SetOdometry::Response& response)
+    {
+        correct(request, true);
+        return true;
+    }
+
+    bool TreadOdometry::resetOdometry(tfr_msgs::SetOdometry::Request& request,
+            tfr_msgs::SetOdometry::Response& response)
+    {
+        ROS_INFO("control: resetting drivebase odometry");
+        correct(request, false);
+        return true;
+    }
+
+    /*
+     * On the spinner thread, which makes it the corrections' only writer.
+     * The next update() applies it.
+     * */
+    void TreadOdometry::correct(const tfr_msgs::SetOdometry::Request& request, bool smooth)
+    {
+        corrections.update([&](Correction& correction)
+            {
+                correction.count++;
+                correction.pose = {request.pose.position.x, request.pose.position.y,
+                    tf::getYaw(request.pose.orientation)};
+                correction.smooth = smooth;
+            });
+    }
+
+    void TreadOdometry::publish(const ros::TimerEvent& event)
+    {
+        const Estimate latest = estimate.read();
+        if (latest.stamp == published_stamp)
+            return;
+        published_stamp = latest.stamp;
+
+        msg.header.stamp.fromNSec(latest.stamp);
+        msg.header.frame_id = parent_frame;
+        msg.child_frame_id = child_frame;
+        tfr_utilities::fillMessages(latest.odometry, msg, slip_msg);
+        odometry_publisher.publish(msg);
+        slip_publisher.publish(slip_msg);
+    }
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "robot_interface.h"
+#include <std_msgs/Int16.h>
+#include <tfr_msgs/CurrentLimitEvent.h>
+#include <mutex>
+#include <vector>
+
+using tfr_utilities::Joint;
+
+namespace
+{
+    const double NO_LIMITS[Joint::JOINT_COUNT] = {};
+
+    /*
+     * Waits for done() while the spinner delivers messages.
+     * */
+    template <typename F>
+    bool waitFor(F done, double timeout)
+    {
+        const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+        while (!done())
+        {
+            if (ros::WallTime::now() > deadline)
+                return false;
+            ros::WallDuration(0.01).sleep();
+        }
+        return true;
+    }
+}
+
+TEST(CurrentFeedback, PublishedCurrentTripsTheLimiter)
+{
+    ros::NodeHandle n;
+    ros::NodeHandle private_n{"~"};
+    tfr_control::RobotInterface robot{n, false, NO_LIMITS, NO_LIMITS};
+
+    std::mutex mutex;
+    std::vector<tfr_msgs::CurrentLimitEvent> events;
+    ros::Subscriber event_subscriber = private_n.subscribe<tfr_msgs::CurrentLimitEvent>(
+            "current_limit_events", 10,
+            [&](const tfr_msgs::CurrentLimitEvent::ConstPtr& event)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                events.push_back(*event);
+            });
+
+    // as the bridge publishes it, in tenths of an amp: 30 A, past the
+    // default 20 A peak
+    const tfr_control::JointDescriptor& turntable = tfr_control::JOINT_TABLE[Joint::TURNTABLE];
+    ros::Publisher amps_publisher = n.advertise<std_msgs::Int16>(turntable.amps_topic, 1, true);
+    ASSERT_TRUE(waitFor([&]() { return amps_publisher.getNumSubscribers() > 0; }, 5.0));
+    std_msgs::Int16 amps;
+    amps.data = 300;
+    amps_publisher.publish(amps);
+
+    // run the cycle until the limiter has reported
+    ASSERT_TRUE(waitFor([&]()
+                {
+                    const ros::Time now = ros::Time::now();
+                    robot.read(now);
+                    robot.write(now);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    return !events.empty();
+                }, 5.0));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(events.front().joint, turntable.name);
+    EXPECT_EQ(events.front().state, tfr_utilities::CurrentLimiter::TRIPPED);
+    EXPECT_NEAR(events.front().amps, 30.0, 1e-3);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_current_feedback");
+    ros::AsyncSpinner spinner{1};
+    spinner.start();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "robot_interface.h"
+
+using tfr_utilities::Joint;
+
+namespace
+{
+    const double NO_LIMITS[Joint::JOINT_COUNT] = {};
+}
+
+/*
+ * Driven backwards, a joint's effort is negative whichever way its motor is
+ * mounted: the turntable's backwards, the scoop's not.
+ * */
+TEST(SimulatedEffort, ReverseDriveIsNegative)
+{
+    ros::NodeHandle n;
+    tfr_control::RobotInterface robot{n, false, NO_LIMITS, NO_LIMITS};
+    robot.setWriteArmValues(true);
+
+    hardware_interface::EffortJointInterface* efforts =
+        robot.get<hardware_interface::EffortJointInterface>();
+    ASSERT_NE(efforts, nullptr);
+    hardware_interface::JointHandle turntable = efforts->getHandle("turntable_joint");
+    hardware_interface::JointHandle scoop = efforts->getHandle("scoop_joint");
+    turntable.setCommand(-500);
+    scoop.setCommand(-500);
+
+    // half a second of simulated cycles
+    ros::Time time = ros::Time::now();
+    for (int cycle = 0; cycle < 50; cycle++)
+    {
+        time += ros::Duration(0.01);
+        robot.read(time);
+        robot.write(time);
+    }
+
+    EXPECT_LT(turntable.getVelocity(), 0);
+    EXPECT_LT(turntable.getEffort(), 0);
+    EXPECT_LT(scoop.getVelocity(), 0);
+    EXPECT_LT(scoop.getEffort(), 0);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    ros::init(argc, argv, "test_simulated_effort");
+    return RUN_ALL_TESTS();
+}
@@ -1,6 +1,5 @@
 #include <ros/ros.h>
 #include <geometry_msgs/Twist.h>
-#include <std_msgs/Int32.h>
 #include <std_msgs/Float64.h>
 #include <tfr_msgs/EmptyAction.h>
 #include <tfr_msgs/ArucoAction.h>
@@ -12,6 +11,7 @@
 #include <image_transport/image_transport.h>
 #include <actionlib/server/simple_action_server.h>
 #include <actionlib/client/simple_action_client.h>
+#include <cmath>
 /*
  * The dumping action server, it backs up the rover into the navigational aid
  * slowly.
@@ -33,6 +33,10 @@
  *   -/cmd_vel geometry_msgs/Twist the drivebase velocity
  *   -/bin_position_controller/command std_msgs/Float64 the position of the bin
  *
+ * The bin is moved by position and watched through /bin_state until it is
+ * within ~bin_tolerance of where it was sent (default 0.03 rad), giving up
+ * after ~bin_timeout seconds (default 20).
+ *
  * */
 class Dumper
 {
@@ -61,16 +65,15 @@ class Dumper
             image_client{node.serviceClient<tfr_msgs::WrappedImage>(service_name)},
             velocity_publisher{node.advertise<geometry_msgs::Twist>("cmd_vel", 10)},
             bin_publisher{node.advertise<std_msgs::Float64>("/bin_position_controller/command", 10)},
-			can_bin_publisher_1{node.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_1", 2)},
-			can_bin_publisher_2{node.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_2", 2)},
+            bin_state_client{node.serviceClient<tfr_msgs::BinStateSrv>("bin_state")},
             detector{"light_detection"},
             aruco{"aruco_action_server",true},
             constraints{c},
             arm_manipulator{node}
         {
             ROS_INFO("dumping action server initializing");
-			bin_command_extend.data = 1000;
-			bin_command_retract.data = -1000;
+            ros::param::param<double>("~bin_tolerance", bin_tolerance, 0.03);
+            ros::param::param<double>("~bin_timeout", bin_timeout, 20.0);
             detector.waitForServer();
             aruco.waitForServer();
             server.start();
@@ -91,11 +94,9 @@ class Dumper
         ros::ServiceClient image_client;
         ros::Publisher velocity_publisher;
         ros::Publisher bin_publisher;
-		ros::Publisher can_bin_publisher_1;
-		ros::Publisher can_bin_publisher_2;
-		
-		std_msgs::Int32 bin_command_extend;
-		std_msgs::Int32 bin_command_retract;
+        ros::ServiceClient bin_state_client;
+        double bin_tolerance;
+        double bin_timeout;
 
         ArmManipulator arm_manipulator;
 
@@ -168,9 +169,6 @@ class Dumper
             ros::Duration(3.0).sleep();
             arm_manipulator.moveArm(0.87, 0.1, 1.07, 1.5);
             ros::Duration(3.0).sleep();
-            std_msgs::Float64 bin_cmd;
-            bin_cmd.data = tfr_utilities::JointAngle::BIN_MAX;
-            tfr_msgs::BinStateSrv query;
 			
 			extendBin();
             if (server.isPreemptRequested())
@@ -202,44 +200,47 @@ class Dumper
 			retractBin();
 		}
 
-		void extendBin()
+		bool extendBin()
 		{
-			//const double dumping_extend_time = 20.0;
-			const int num_loop_iterations = 200; // 20 seconds
-			int cur_loop_iteration = 0;
-            while (!server.isPreemptRequested() && ros::ok() && cur_loop_iteration < num_loop_iterations)
-            {
-				/*
-                ros::service::call("bin_state", query);
-                using namespace tfr_utilities;
-                if (JointAngle::BIN_MAX - query.response.state < 0.1)
-                    break;
-                bin_publisher.publish(bin_cmd);
-                ros::Duration(0.1).sleep();
-				*/
-
-				can_bin_publisher_1.publish(bin_command_extend);
-				can_bin_publisher_2.publish(bin_command_extend);
-				cur_loop_iteration++;
-				ros::Duration(0.1).sleep();
-            }	
+			return moveBin(tfr_utilities::JointAngle::BIN_MAX);
 		}
 		
-		void retractBin()
+		bool retractBin()
 		{
-			const int num_loop_iterations = 200; // 20 seconds
-			int cur_loop_iteration = 0;
-            while (!server.isPreemptRequested() && ros::ok() && cur_loop_iteration < num_loop_iterations)
-            {
-				
-				can_bin_publisher_1.publish(bin_command_retract);
-				can_bin_publisher_2.publish(bin_command_retract);
-				cur_loop_iteration++;
-				ros::Duration(0.1).sleep();
-				
-            }	
+			return moveBin(tfr_utilities::JointAngle::BIN_MIN);
 		}
 
+        /*
+         * Sends the bin to target and waits for it to get there. Returns
+         * false if it was preempted or didn't make it in time, the bin is
+         * left holding wherever it was sent either way.
+         * */
+        bool moveBin(double target)
+        {
+            std_msgs::Float64 bin_cmd;
+            bin_cmd.data = target;
+            tfr_msgs::BinStateSrv query;
+            ros::Rate rate(10);
+            const ros::Time deadline = ros::Time::now() + ros::Duration(bin_timeout);
+            while (!server.isPreemptRequested() && ros::ok())
+            {
+                bin_publisher.publish(bin_cmd);
+                if (bin_state_client.call(query)
+                        && std::abs(target - query.response.state) < bin_tolerance)
+                {
+                    return true;
+                }
+                if (ros::Time::now() > deadline)
+                {
+                    ROS_WARN("dumping action server: bin didn't reach %f, it is at %f",
+                            target, query.response.state);
+                    return false;
+                }
+                rate.sleep();
+            }
+            return false;
+        }
+
         /*
          *  Back up and turn slightly to match the orientation of the aruco board
          * */
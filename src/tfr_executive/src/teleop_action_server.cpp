@@ -75,8 +75,6 @@ class TeleopExecutive
             bin_publisher{n.advertise<std_msgs::Float64>("/bin_position_controller/command", 5)},
             digging_client{n, "dig"},
             arm_client{n, "move_arm", true},
-            right_bin_pub{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_3", 1)},
-            left_bin_pub{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_2", 1)},
             turntable_pub{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_1", 1)},
             lower_arm_pub{n.advertise<std_msgs::Int32>("/device12/set_cmd_cango/cmd_cango_1", 1)},
             upper_arm_pub{n.advertise<std_msgs::Int32>("/device4/set_cmd_cango/cmd_cango_3", 1)},
@@ -120,13 +118,18 @@ class TeleopExecutive
             scoop_pub.publish(msg);   
         }
         
-        //dev 12
+        //dev 12, the bin holds wherever it is now
         void stop_bin_movement(){
             std_msgs::Int32 msg;
             msg.data = 0;
-            right_bin_pub.publish(msg);
-            left_bin_pub.publish(msg);
             lower_arm_pub.publish(msg);   
+            tfr_msgs::BinStateSrv query;
+            if (ros::service::call("bin_state", query))
+            {
+                std_msgs::Float64 bin_cmd;
+                bin_cmd.data = query.response.state;
+                bin_publisher.publish(bin_cmd);
+            }
         }
 
         /*
@@ -379,41 +382,12 @@ class TeleopExecutive
 
                 case (tfr_utilities::TeleopCode::DUMP):
                     {
-                        
-                        
                         //drivebase_publisher.publish(move_cmd);
                         ROS_INFO("Teleop Action Server: Command Recieved, DUMP");
-                        stop_bin_movement();
-                        int effort = 1;
-                        if (not ros::param::getCached("~dump_effort", effort)) {effort = 1;}
-						std_msgs::Int32 msg;
-                        msg.data = effort;
-                        right_bin_pub.publish(msg);
-                        left_bin_pub.publish(msg);
-                        /*//all zeros by default
-                        //arm_manipulator.moveArm(0.0, 0.1, 1.07, 1.5);
-                        ros::Duration(3.0).sleep();
-                        //arm_manipulator.moveArm(0.87, 0.1, 1.07, 1.5);
-                        ros::Duration(3.0).sleep();
+                        // the bin's position controller takes it there and holds it
                         std_msgs::Float64 bin_cmd;
                         bin_cmd.data = tfr_utilities::JointAngle::BIN_MAX;
-                        tfr_msgs::BinStateSrv query;
-                        while (!server.isPreemptRequested() && ros::ok())
-                        {
-                            ros::service::call("bin_state", query);
-                            using namespace tfr_utilities;
-                            if (JointAngle::BIN_MAX -  query.response.state <
-                                    0.01)
-                                break;
-                            bin_publisher.publish(bin_cmd);
-                            frequency.sleep();
-                        }
-                        if (server.isPreemptRequested())
-                        {
-                            ROS_INFO("Teleop Action Server: DUMP preempted");
-                            server.setPreempted();
-                            return;
-                        }*/
+                        bin_publisher.publish(bin_cmd);
                         ROS_INFO("Teleop Action Server: DUMP finished");
                         break;
                     }
@@ -422,33 +396,9 @@ class TeleopExecutive
                     {
                         //drivebase_publisher.publish(move_cmd);
                         ROS_INFO("Teleop Action Server: Command Recieved, RESET_DUMPING");
-                        stop_bin_movement();
-                        int effort = 1;
-                        if (not ros::param::getCached("~dump_effort", effort)) {effort = 1;}
-						std_msgs::Int32 msg;
-                        msg.data = -effort;
-                        right_bin_pub.publish(msg);
-                        left_bin_pub.publish(msg);
-                       /* //all zeros by default
                         std_msgs::Float64 bin_cmd;
                         bin_cmd.data = tfr_utilities::JointAngle::BIN_MIN;
-                        tfr_msgs::BinStateSrv query;
-                        while (!server.isPreemptRequested() && ros::ok())
-                        {
-                            ros::service::call("bin_state", query);
-                            using namespace tfr_utilities;
-                            if (query.response.state - JointAngle::BIN_MIN <
-                                    0.01)
-                                break;
-                            bin_publisher.publish(bin_cmd);
-                            frequency.sleep();
-                        }
-                        if (server.isPreemptRequested())
-                        {
-                            ROS_INFO("Teleop Action Server: DUMPING_RESET preempted");
-                            server.setPreempted();
-                            return;
-                        }*/
+                        bin_publisher.publish(bin_cmd);
                         ROS_INFO("Teleop Action Server: DUMPING_RESET finished");
                         break;
                     }
@@ -523,8 +473,6 @@ class TeleopExecutive
         actionlib::SimpleActionServer<tfr_msgs::TeleopAction> server;
         actionlib::SimpleActionClient<tfr_msgs::DiggingAction> digging_client;
         actionlib::SimpleActionClient<tfr_msgs::ArmMoveAction> arm_client;
-        ros::Publisher right_bin_pub;
-        ros::Publisher left_bin_pub;
         ros::Publisher turntable_pub;
         ros::Publisher lower_arm_pub;
         ros::Publisher upper_arm_pub;
@@ -277,7 +277,14 @@ namespace tfr_mission_control {
     }
 
     void MissionControl::setArmPID(bool value){
+        // the parameter is only where control starts from after a restart
         ros::param::set("/write_arm_values", value);
+        std_srvs::SetBool request;
+        request.request.data = value;
+        if (!ros::service::call("write_arm_values", request))
+        {
+            ROS_WARN("mission_control: could not reach write_arm_values");
+        }
         ui.arm_pid_enable_button->setEnabled(!value);
         ui.arm_pid_disable_button->setEnabled(value);
     }
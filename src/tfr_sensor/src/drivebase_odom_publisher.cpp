@@ -1,5 +1,27 @@
-/* * Converts measured wheel velocities into an an odometry message for use in
+/* * Converts measured tread motion into an an odometry message for use in
  * sensor fusion.
+ *
+ * Every tread sample is integrated as it arrives, stamped with its arrival
+ * (neither source has a header), along the exact arc the treads trace, see
+ * tfr_utilities/diff_drive_odometry.h. The newest pose is published on a
+ * timer of its own, stamped with the sample it is from.
+ *
+ * It follows one of two sources:
+ *   - "arduino": the speeds the arduinos measure. The interval since the last
+ *   sample of either tread is integrated with the speeds both treads had
+ *   over it.
+ *   - "encoders": the motor controller's absolute encoder counts, see
+ *   tfr_utilities/tread_encoder_odometry.h. The pose moves by however far
+ *   the counts came, so dropped samples lose nothing.
+ *
+ * The pose's covariance is carried through every step, see
+ * tfr_utilities/diff_drive_odometry.h. While the treads' yaw rate and the
+ * IMU's disagree the treads are slipping, and their noise is inflated to
+ * match, see tfr_utilities/slip_detector.h.
+ *
+ * The control node can do the same from the counts it reads for the
+ * controllers, see tfr_control/tread_odometry.h, in which case this node
+ * isn't run.
  * 
  * Not currently configured to publish transforms, as that is the job of sensor
  * fusion right now.
@@ -8,14 +30,36 @@
  *   - ~parent_frame: the frame our robot exists in (string, default: "odom")
  *   - ~child_frame: the frame of the robot (string, default: "base_footprint")
  *   - ~wheel_span: the separation of the treads of the robot. (double,
- *   default)
+ *   default tfr_utilities::TREAD_WHEEL_SPAN)
  *   - ~rate: how quickly to publish hz. (double, default 10)
+ *   - ~max_sample_gap: longest time a tread's speed is held for, longer
+ *   gaps are not integrated (double, default 0.5)
+ *   - ~source: "arduino" or "encoders" (string, default "arduino")
+ *   - ~left_meters_per_count, ~right_meters_per_count: tread per encoder
+ *   count, negative for an encoder counting down going forwards (double,
+ *   default 2 pi 0.1524 / 5120)
+ *   - ~max_step: longest a tread moves between two encoder samples, longer
+ *   steps start the count over (double, default 0.5)
+ *   - ~velocity_window: how far back encoder samples go into the speeds
+ *   (double, default 0.1)
+ *   - ~noise_per_meter: variance a tread's distance picks up per meter
+ *   (double, default 0.001)
+ *   - ~velocity_stddev: of each tread's speed (double, default 0.05)
+ *   - ~slip/rate_tolerance, ~slip/time_constant, ~slip/max_inflation,
+ *   ~slip/imu_timeout: see slip_detector.h (double, default 0.1, 0.2, 100,
+ *   0.25)
  * Subscribed topics:
- *   - /arduino :(tfr_msgs/ArduinoReading) The most current information coming
- *   in from the sensors.
+ *   - /sensors/arduino_a, /sensors/arduino_b :(tfr_msgs/ArduinoAReading,
+ *   tfr_msgs/ArduinoBReading) the left and right tread speeds, from "arduino".
+ *   - /device8/get_qry_abcntr/channel_1, /device8/get_qry_abcntr/channel_2 :
+ *   (std_msgs/Int32) the left and right tread encoder counts, from "encoders".
+ *   - /sensors/orientation_prior : (tfr_msgs/OrientationPrior) the IMU's yaw
+ *   rate.
  * Published topics: 
  *   - /drivebase_odom : (nav_msgs/Odometry) the location of the
  *   base_footprint tracked by tread motion.
+ *   - /drivebase_odom/slip : (tfr_msgs/SlipIndicator) whether the treads are
+ *   slipping, with every odometry message.
  * Services:
  *  - /set_drivebase_odometry : (tfr_msgs/SetOdometry) resets the basis of
  *  odometry to a new position
@@ -23,7 +67,9 @@
 #include <ros/ros.h>
 #include <tfr_msgs/ArduinoAReading.h>
 #include <tfr_msgs/ArduinoBReading.h>
+#include <tfr_msgs/OrientationPrior.h>
 #include <tfr_msgs/SetOdometry.h>
+#include <tfr_msgs/SlipIndicator.h>
 #include <tfr_msgs/PoseSrv.h>
 #include <geometry_msgs/Quaternion.h>
 #include <nav_msgs/Odometry.h>
@@ -34,6 +80,12 @@
 #include <tf2/convert.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2/LinearMath/Scalar.h>
+#include <std_msgs/Int32.h>
+#include <tfr_utilities/diff_drive_odometry.h>
+#include <tfr_utilities/slip_detector.h>
+#include <tfr_utilities/tread_encoder_odometry.h>
+#include <tfr_utilities/tread_odometry_message.h>
+#include <tfr_utilities/velocity_estimator.h>
 
 class DrivebaseOdometryPublisher
 {
@@ -47,29 +99,56 @@ class DrivebaseOdometryPublisher
 	DrivebaseOdometryPublisher(ros::NodeHandle &n, 
                 const std::string& p_frame, 
                 const std::string& c_frame,
-                const double& wheel_sep) :
+                const std::string& source,
+                const tfr_utilities::TreadEncoderOdometry::Settings& tread_settings,
+                const tfr_utilities::SlipDetector::Settings& slip_settings,
+                double velocity_stddev,
+                double rate,
+                double max_gap,
+                double velocity_window) :
+            tf_broadcaster{},
             parent_frame{p_frame},
             child_frame{c_frame},
-            wheel_span{wheel_sep},
-            x{},
-            y{},
-            angle{},
-            tf_broadcaster{}
+            settings{tread_settings},
+            treads{tread_settings},
+            max_sample_gap{max_gap},
+            velocity_variance{velocity_stddev * velocity_stddev},
+            slip{slip_settings},
+            inflation{1.0},
+            v_l{},
+            v_r{},
+            left_velocity{velocity_window},
+            right_velocity{velocity_window},
+            left_count{},
+            right_count{},
+            left_counted{false},
+            right_counted{false}
     {
 		//get most current sensor infromation 
-        arduino_a = n.subscribe("/sensors/arduino_a", 15, &DrivebaseOdometryPublisher::readArduinoA, this);
-        arduino_b = n.subscribe("/sensors/arduino_b", 15, &DrivebaseOdometryPublisher::readArduinoB, this);
+        if (source == "encoders")
+        {
+            left_encoder = n.subscribe("/device8/get_qry_abcntr/channel_1", 15, &DrivebaseOdometryPublisher::readLeftEncoder, this);
+            right_encoder = n.subscribe("/device8/get_qry_abcntr/channel_2", 15, &DrivebaseOdometryPublisher::readRightEncoder, this);
+        }
+        else
+        {
+            arduino_a = n.subscribe("/sensors/arduino_a", 15, &DrivebaseOdometryPublisher::readArduinoA, this);
+            arduino_b = n.subscribe("/sensors/arduino_b", 15, &DrivebaseOdometryPublisher::readArduinoB, this);
+        }
+		
+        //the IMU's yaw rate, to tell slip by
+        orientation_prior = n.subscribe("/sensors/orientation_prior", 15, &DrivebaseOdometryPublisher::readOrientationPrior, this);
 		
 		//odometry_publisher: publish to the location of the base_footprint tracked by tread motion.
         odometry_publisher = n.advertise<nav_msgs::Odometry>("/drivebase_odom", 15); 
+        slip_publisher = n.advertise<tfr_msgs::SlipIndicator>("/drivebase_odom/slip", 15);
 		
 		///set_drivebase_odometry : resets the basis of odometry to a new position
         set_odometry = n.advertiseService("set_drivebase_odometry", &DrivebaseOdometryPublisher::setOdometry, this);
         reset_odometry = n.advertiseService("reset_drivebase_odometry", &DrivebaseOdometryPublisher::resetOdometry, this);
-        angle.x = 0;
-        angle.y = 0;
-        angle.z = 0;
-        angle.w = 1;
+
+        //publishing is decoupled from integration
+        publish_timer = n.createTimer(ros::Duration(1.0 / rate), &DrivebaseOdometryPublisher::publishOdometry, this);
 	}
 
     ~DrivebaseOdometryPublisher() = default;
@@ -79,132 +158,158 @@ class DrivebaseOdometryPublisher
     DrivebaseOdometryPublisher& operator=(DrivebaseOdometryPublisher&) = delete;
 
         /*****************************************************************************************
-        * processOdometry: Main business logic for the node, takes in readings from the arduino,
-        * 		and publishes them across the network.
-		* Preconditions: is subscribed to recieve information from the sensors (tfr_msgs/ArduinoReading)
-		* Postconditions: Readings from the arduino are published across the network
+        * integrate: Moves the robot on to the time of a new tread sample
+		* Preconditions: v_l and v_r are the speeds the treads had since the last sample
+		* Postconditions: the pose is at stamp, or unchanged if the gap was too long to trust
         *****************************************************************************************/
-        void processOdometry()
+        void integrate(const ros::Time& stamp)
         {
-            //Grab the neccessary data
-            tfr_msgs::ArduinoAReading reading_a;
-            tfr_msgs::ArduinoBReading reading_b;
-            if (latest_arduino_a != nullptr)
-                reading_a = *latest_arduino_a;
-
-            if (latest_arduino_b != nullptr)
-                reading_b = *latest_arduino_b;
-
-            //first we process the data
-            auto t_1 = ros::Time::now();
-            double d_t = (t_1 - t_0).toSec();
-			
-            //if this is the first message we skip it to initialize time
-            //properly
-            if (!t_0.isValid())
+            //the first sample only starts the clock
+            if (!t_0.isZero())
             {
-                t_0 = ros::Time::now();
-                return;
+                double d_t = (stamp - t_0).toSec();
+                if (d_t <= 0)
+                    return;
+                if (d_t <= max_sample_gap)
+                {
+                    inflation = slip.update((v_r - v_l) / settings.wheel_span, stamp.toSec(), d_t);
+                    treads.odometry().move(v_l * d_t, v_r * d_t, inflation);
+                }
             }
+            t_0 = stamp;
+        }
 
-            //message gives us velocity in meters/second from each individual
-            //tread
-            double v_l = -reading_a.tread_left_vel;
-            double v_r = reading_b.tread_right_vel;
-
-            //basic differential kinematics to get combined velocities
-            double v_ang = (v_r-v_l)/wheel_span;
-            double v_lin = (v_r+v_l)/2;
-            
-            //break into xy components and increment
-            double d_angle = v_ang * d_t;
-            rotateQuaternionByYaw(angle, d_angle);
-
-            // yaw (z-axis rotation)
-            auto yaw = quaternionToYaw(angle);
-            double v_x = v_lin*cos(yaw);
-            double v_y = v_lin*sin(yaw);
-
-
-            double d_x = v_x * d_t;
-            x += d_x;
-
-            double d_y = v_y * d_t;
-            y += d_y;
-
-            t_0 = t_1;
-
-            //let's package up the message
-            nav_msgs::Odometry msg;
-            msg.header.stamp = ros::Time::now();
-            msg.header.frame_id = parent_frame;
-            msg.child_frame_id = child_frame;
-
-            msg.pose.pose.position.x = x;
-            msg.pose.pose.position.y = y;
-            msg.pose.pose.position.z = 0;
-            msg.pose.pose.orientation = angle;
-            msg.pose.covariance = { 1e-1,    0,    0,    0,    0,    0,
-                0, 1e-1,    0,    0,    0,    0,
-                0,    0, 1e-1,    0,    0,    0,
-                0,    0,    0, 1e-1,    0,    0,
-                0,    0,    0,    0, 1e-1,    0,
-                0,    0,    0,    0,    0, 1e-1 };
+        /*****************************************************************************************
+        * publishOdometry: publishes the latest pose across the network, on its own timer
+		* Preconditions: none
+		* Postconditions: the pose as of the newest tread sample is published
+        *****************************************************************************************/
+        void publishOdometry(const ros::TimerEvent& event)
+        {
+            if (t_0.isZero())
+                return;
 
-            msg.twist.twist.linear.x = v_x;
-            msg.twist.twist.linear.y = v_y;
-            msg.twist.twist.linear.z = 0;
-            msg.twist.twist.angular.x = 0;
-            msg.twist.twist.angular.y = 0;
-            msg.twist.twist.angular.z = v_ang;
-            msg.twist.covariance = { 5e-2,    0,    0,    0,    0,    0,
-                0, 5e-2,    0,    0,    0,    0,
-                0,    0, 5e-2,    0,    0,    0,
-                0,    0,    0, 5e-2,    0,    0,
-                0,    0,    0,    0, 5e-2,    0,
-                0,    0,    0,    0,    0, 5e-2 };
+            //let's package up the message, the same way the control node does
+            odometry_msg.header.stamp = t_0;
+            odometry_msg.header.frame_id = parent_frame;
+            odometry_msg.child_frame_id = child_frame;
+            tfr_utilities::fillMessages(tfr_utilities::estimateOf(treads.odometry(), slip,
+                        v_l, v_r, velocity_variance, inflation), odometry_msg, slip_msg);
 	//publish the message
-            odometry_publisher.publish(msg);
+            odometry_publisher.publish(odometry_msg);
+            slip_publisher.publish(slip_msg);
         }
 
 
+        /*****************************************************************************************
+        * countEncoders: Moves the robot on to the latest encoder counts
+		* Preconditions: left_count and right_count are the latest counts, stamped at stamp
+		* Postconditions: the pose is at the counts, and v_l, v_r are the treads' speeds
+        *****************************************************************************************/
+        void countEncoders(const ros::Time& stamp)
+        {
+            //only both treads together say where the robot is
+            if (!left_counted || !right_counted)
+                return;
+            double left_rate, right_rate, acceleration;
+            left_velocity.estimate(stamp.toNSec(), left_rate, acceleration);
+            right_velocity.estimate(stamp.toNSec(), right_rate, acceleration);
+            v_l = settings.left_meters_per_count * left_rate;
+            v_r = settings.right_meters_per_count * right_rate;
+            const double d_t = t_0.isZero() ? 0.0 : (stamp - t_0).toSec();
+            inflation = slip.update((v_r - v_l) / settings.wheel_span, stamp.toSec(), d_t);
+            treads.update(left_count, right_count, inflation);
+            t_0 = stamp;
+        }
+
     private:
         ros::Subscriber arduino_a; //the encoder data sub
         ros::Subscriber arduino_b; //the encoder data sub
-        tfr_msgs::ArduinoAReadingConstPtr latest_arduino_a;
-        tfr_msgs::ArduinoBReadingConstPtr latest_arduino_b;
+        ros::Subscriber left_encoder; //the encoder count subs
+        ros::Subscriber right_encoder;
+        ros::Subscriber orientation_prior; //the IMU's yaw rate sub
         ros::Publisher odometry_publisher; //the pub for our processed data
+        ros::Publisher slip_publisher;
         ros::ServiceServer set_odometry;
         ros::ServiceServer reset_odometry;
+        ros::Timer publish_timer;
         tf2_ros::TransformBroadcaster tf_broadcaster;
         const std::string& parent_frame; //the parent frame of the robot
         const std::string& child_frame; //the child frame of the robot
-        const double& wheel_span;
-        double x; //the x coordinate of the robot (meters)
-        double y; //the y coordinate of the robot (meters)
-        geometry_msgs::Quaternion angle; 
+        const tfr_utilities::TreadEncoderOdometry::Settings settings;
+        tfr_utilities::TreadEncoderOdometry treads; //the pose, in meters and radians
+        const double max_sample_gap; //seconds
+        const double velocity_variance; //of each tread's speed (m^2/s^2)
+        tfr_utilities::SlipDetector slip;
+        double inflation; //what the treads' noise is scaled by, for slip
+        double v_l; //the latest left tread speed (m/s)
+        double v_r; //the latest right tread speed (m/s)
+        tfr_utilities::VelocityEstimator left_velocity; //fitted to the encoder counts
+        tfr_utilities::VelocityEstimator right_velocity;
+        int32_t left_count; //the latest encoder counts
+        int32_t right_count;
+        bool left_counted; //whether there is a count yet
+        bool right_counted;
+        ros::Time t_0; //the time of the newest sample
+        nav_msgs::Odometry odometry_msg;
+        tfr_msgs::SlipIndicator slip_msg;
         const double MAX_XY_DELTA = 0.25;
-        const double MAX_THETA_DELTA = 0.065;
-        ros::Time t_0;
+        const double MAX_THETA_DELTA = 0.13; //radians of yaw
 
 	/********************************************************************************************
-	* readArduinoA: Get most current sensor infromation
+	* readArduinoA: Integrates up to a new left tread sample
 	* Preconditions: can subscribe to topic /arduino :(tfr_msgs/ArduinoReading)
-	* Postconditions: latest_arduino_a is updated with arduino from the /sensors/arduino_a topic 
+	* Postconditions: the pose is integrated up to now, and v_l is updated from the /sensors/arduino_a topic 
 	**********************************************************************************************/
      void readArduinoA(const tfr_msgs::ArduinoAReadingConstPtr &msg)
      {
-     	latest_arduino_a = msg;
+        integrate(ros::Time::now());
+        //the left motor is mounted the other way around
+        v_l = -msg->tread_left_vel;
      }
 
 	/********************************************************************************************
-	* readArduinoB: Get most current sensor infromation
+	* readArduinoB: Integrates up to a new right tread sample
 	* Preconditions: can subscribe to topic /arduino :(tfr_msgs/ArduinoReading)
-	* Postconditions: latest_arduino_b is updated with arduino from the /sensors/arduino_b topic
+	* Postconditions: the pose is integrated up to now, and v_r is updated from the /sensors/arduino_b topic
 	*********************************************************************************************/
         void readArduinoB(const tfr_msgs::ArduinoBReadingConstPtr &msg)
         {
-            latest_arduino_b = msg;
+            integrate(ros::Time::now());
+            v_r = msg->tread_right_vel;
+        }
+
+	/********************************************************************************************
+	* readOrientationPrior: Get the IMU's latest yaw rate
+	* Preconditions: can subscribe to topic /sensors/orientation_prior :(tfr_msgs/OrientationPrior)
+	* Postconditions: the slip detector has the IMU's yaw rate
+	*********************************************************************************************/
+        void readOrientationPrior(const tfr_msgs::OrientationPriorConstPtr &msg)
+        {
+            slip.imu(msg->yaw_rate, msg->header.stamp.toSec());
+        }
+
+	/********************************************************************************************
+	* readLeftEncoder, readRightEncoder: Moves on to a new encoder count
+	* Preconditions: can subscribe to the /device8/get_qry_abcntr topics :(std_msgs/Int32)
+	* Postconditions: the pose is moved on to the count
+	*********************************************************************************************/
+        void readLeftEncoder(const std_msgs::Int32ConstPtr &msg)
+        {
+            const ros::Time stamp = ros::Time::now();
+            left_count = msg->data;
+            left_counted = true;
+            left_velocity.addSample(left_count, stamp.toNSec());
+            countEncoders(stamp);
+        }
+
+        void readRightEncoder(const std_msgs::Int32ConstPtr &msg)
+        {
+            const ros::Time stamp = ros::Time::now();
+            right_count = msg->data;
+            right_counted = true;
+            right_velocity.addSample(right_count, stamp.toNSec());
+            countEncoders(stamp);
         }
 
        
@@ -212,34 +317,17 @@ class DrivebaseOdometryPublisher
 	* setOdometry: Set odometry from fiducial markers, provides smoothing
 	* Preconditions: can advertise to set_drivebase_odometry topic, can provide service to 
 	*				/set_drivebase_odometry : (tfr_msgs/SetOdometry)
-	* Postconditions: angle is updated with its new value, true is returned after the angle has been updated
+	* Postconditions: the pose is moved towards the request, true is returned after it has been updated
 	*********************************************************************************************************/
         bool setOdometry(tfr_msgs::SetOdometry::Request& request,
                 tfr_msgs::SetOdometry::Response& response)
         {
 
-            auto dx = request.pose.position.x - x;
-            if (std::abs(dx) >= MAX_XY_DELTA)
-                dx = (dx >= 0) ? MAX_XY_DELTA : -MAX_XY_DELTA;
-            x += dx;
-
-            auto dy = request.pose.position.y - y;
-            if (std::abs(dy) > MAX_XY_DELTA)
-                dy = (dy >= 0) ? MAX_XY_DELTA : -MAX_XY_DELTA;
-            y += dy;
-
-            auto new_q = getTfQuaternion(request.pose.orientation);
-            auto old_q = getTfQuaternion(angle);
-            auto delta = new_q * old_q.inverse();
-            if (std::abs(delta.getZ()) > MAX_THETA_DELTA)
-            {
-                auto sign = ( delta.getZ() * delta.getW() >= 0)? 1 : -1;
-                tf2::Quaternion rotation{0.0, 0.0, 0.065 * sign, 0.998};
-                auto new_value = old_q * rotation;
-                angle = getStdQuaternion(new_value);
-            }
-            else
-                angle = request.pose.orientation;
+            tfr_utilities::DiffDriveOdometry& odometry = treads.odometry();
+            const tfr_utilities::DiffDriveOdometry::Pose target{request.pose.position.x,
+                request.pose.position.y, quaternionToYaw(request.pose.orientation)};
+            odometry.reset(tfr_utilities::DiffDriveOdometry::approach(odometry.pose(),
+                        target, MAX_XY_DELTA, MAX_THETA_DELTA));
             return true;
         }
 
@@ -247,17 +335,17 @@ class DrivebaseOdometryPublisher
 	* setOdometry: Set odometry from fiducial markers, provides no smoothing
 	* Preconditions: can advertise to set_drivebase_odometry topic, can provide service to 
 	*				/set_drivebase_odometry : (tfr_msgs/SetOdometry)
-	* Postconditions: outputs message stating that odometry has been reset, angel has been reset based on position,
-	*				true is returned after angle has been updated
+	* Postconditions: outputs message stating that odometry has been reset, the pose has been reset to the request,
+	*				true is returned after the pose has been updated
 	*********************************************************************************************************/
         bool resetOdometry(tfr_msgs::SetOdometry::Request& request,
                 tfr_msgs::SetOdometry::Response& response)
         {
             ROS_INFO("Drivebase Odometry Publisher: resetting drivebase odometry");
 
-            x = request.pose.position.x;
-            y = request.pose.position.y;
-            angle = request.pose.orientation;
+            treads.odometry().reset({request.pose.position.x, request.pose.position.y,
+                    quaternionToYaw(request.pose.orientation)});
+            treads.odometry().setCovariance({});
             return true;
         }
 	
@@ -277,7 +365,7 @@ class DrivebaseOdometryPublisher
 	* Preconditions: quaternion parameter is initalized
 	* Postconditions: a quaternion value is returned
 	***************************************************************************************************/
-        geometry_msgs::Quaternion getStdQuaternion(tf2::Quaternion& q_0)
+        geometry_msgs::Quaternion getStdQuaternion(const tf2::Quaternion& q_0)
         {
             geometry_msgs::Quaternion q;
             q.x = q_0.getX();
@@ -326,20 +414,31 @@ int main(int argc, char **argv)
 	//NodeHandle is the main access point to communications with the ROS system.
     ros::NodeHandle n;
     std::string parent_frame, child_frame;
-    double wheel_span, r; //wheel_span: the separation of the treads of the robot.
-			  //r is the rate: how quickly to publish hz.
+    std::string source;
+    tfr_utilities::TreadEncoderOdometry::Settings settings;
+    double r, max_sample_gap, velocity_window, velocity_stddev; //r is the rate: how quickly to publish hz.
+			  //max_sample_gap: longest a tread speed is held (s)
     ros::param::param<std::string>("~parent_frame", parent_frame, "odom");
     ros::param::param<std::string>("~child_frame", child_frame, "base_footprint");
-    ros::param::param<double>("~wheel_span", wheel_span, 0.645);
+    ros::param::param<std::string>("~source", source, "arduino");
+    //wheel_span: the separation of the treads of the robot.
+    ros::param::param<double>("~wheel_span", settings.wheel_span, tfr_utilities::TREAD_WHEEL_SPAN);
+    ros::param::param<double>("~left_meters_per_count", settings.left_meters_per_count, 2 * 3.14159265358979 * 0.1524 / 5120);
+    ros::param::param<double>("~right_meters_per_count", settings.right_meters_per_count, 2 * 3.14159265358979 * 0.1524 / 5120);
+    ros::param::param<double>("~max_step", settings.max_step, 0.5);
+    ros::param::param<double>("~velocity_window", velocity_window, 0.1);
+    ros::param::param<double>("~noise_per_meter", settings.noise_per_meter, 0.001);
+    ros::param::param<double>("~velocity_stddev", velocity_stddev, 0.05);
+    tfr_utilities::SlipDetector::Settings slip_settings;
+    ros::param::param<double>("~slip/rate_tolerance", slip_settings.rate_tolerance, 0.1);
+    ros::param::param<double>("~slip/time_constant", slip_settings.time_constant, 0.2);
+    ros::param::param<double>("~slip/max_inflation", slip_settings.max_inflation, 100.0);
+    ros::param::param<double>("~slip/imu_timeout", slip_settings.imu_timeout, 0.25);
     ros::param::param<double>("~rate", r, 10.0);
-    DrivebaseOdometryPublisher publisher{n, parent_frame, child_frame, wheel_span};
-    ros::Rate rate(r);
-    while(ros::ok())
-    {
-        publisher.processOdometry(); //arduino readings are published across the network
-        ros::spinOnce();
-        rate.sleep();
-
-    }
+    ros::param::param<double>("~max_sample_gap", max_sample_gap, 0.5);
+    DrivebaseOdometryPublisher publisher{n, parent_frame, child_frame,
+        source, settings, slip_settings, velocity_stddev, r, max_sample_gap, velocity_window};
+    //samples are integrated in their callbacks, the timer publishes
+    ros::spin();
     return 0;
 }
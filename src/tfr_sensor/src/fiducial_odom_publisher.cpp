@@ -9,6 +9,10 @@
  *   ~odom_frame: The reference frame of odom  (string, default="odom")
  *   ~debug: print debugging info (bool, default: false)
  *   ~rate: how fast to process images
+ *   ~position_stddev: of x and y with the marker 1 m away, it grows with
+ *   the square of the distance, see covariance() (double, default: 0.05)
+ *   ~yaw_stddev: of the yaw with the marker 1 m away, it grows with the
+ *   distance (double, default: 0.05)
  * subscribed topics:
  *   image (sensor_msgs/Image) - the camera topic
  * published topics:
@@ -32,6 +36,8 @@
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/transform_listener.h>
+#include <algorithm>
+#include <cmath>
 
 class FiducialOdom
 {
@@ -39,12 +45,16 @@ class FiducialOdom
         FiducialOdom(ros::NodeHandle& n, 
                 const std::string& f_frame, 
                 const std::string& b_frame,
-                const std::string& o_frame) :
+                const std::string& o_frame,
+                double p_stddev,
+                double y_stddev) :
             aruco{"aruco_action_server", true},
             tf_manipulator{},
             footprint_frame{f_frame},
             bin_frame{b_frame},
             odometry_frame{o_frame},
+            position_stddev{p_stddev},
+            yaw_stddev{y_stddev},
             reset_service{n.advertiseService("/reset_fusion", &FiducialOdom::resetFusion, this)}
         {
             rear_cam_client = n.serviceClient<tfr_msgs::WrappedImage>("/on_demand/rear_cam/image_raw");
@@ -136,14 +146,11 @@ class FiducialOdom
                 odom.header.stamp = ros::Time::now();
                 odom.child_frame_id = footprint_frame;
 
-                //get our pose and fudge some covariances
+                //get our pose, as good as the marker is near
                 odom.pose.pose = relative_pose;
-                odom.pose.covariance = {  1e-1,   0,   0,   0,   0,   0,
-                    0,1e-1,   0,   0,   0,   0,
-                    0,   0,1e-1,   0,   0,   0,
-                    0,   0,   0,1e-1,   0,   0,
-                    0,   0,   0,   0,1e-1,   0,
-                    0,   0,   0,   0,   0,1e-1};
+                const auto& seen = unprocessed_pose.pose.position;
+                covariance(std::sqrt(seen.x * seen.x + seen.y * seen.y + seen.z * seen.z),
+                        odom.pose.covariance);
                 //fire it off! and cleanup
                 publisher.publish(odom);
 
@@ -177,6 +184,29 @@ class FiducialOdom
         const std::string& footprint_frame;
         const std::string& bin_frame;
         const std::string& odometry_frame;
+        const double position_stddev;
+        const double yaw_stddev;
+
+        /*
+         * A marker's pose is off by more the further away it is: its
+         * corners cover fewer pixels, so its position is off by about the
+         * square of the distance and its yaw by the distance. Closer than
+         * 1 m it is no better than at 1 m. z, roll and pitch aren't
+         * measured, they stay fixed.
+         * */
+        void covariance(double distance, boost::array<double, 36>& out) const
+        {
+            const double range = std::max(1.0, distance);
+            const double position = position_stddev * range * range;
+            const double yaw = yaw_stddev * range;
+            out.fill(0);
+            out[0] = position * position;
+            out[7] = position * position;
+            out[14] = 1e-1;
+            out[21] = 1e-1;
+            out[28] = 1e-1;
+            out[35] = yaw * yaw;
+        }
 
         tfr_msgs::ArucoResultConstPtr sendAruco(const tfr_msgs::WrappedImage& msg)
         {
@@ -197,14 +227,16 @@ int main(int argc, char** argv)
     ros::NodeHandle n{};
 
     std::string footprint_frame, bin_frame, odometry_frame;
-    double rate;
+    double rate, position_stddev, yaw_stddev;
     ros::param::param<std::string>("~footprint_frame", footprint_frame, "footprint");
     ros::param::param<std::string>("~bin_frame", bin_frame, "bin_footprint");
     ros::param::param<std::string>("~odometry_frame", odometry_frame, "odom");
     ros::param::param<double>("~rate",rate, 5);
+    ros::param::param<double>("~position_stddev", position_stddev, 0.05);
+    ros::param::param<double>("~yaw_stddev", yaw_stddev, 0.05);
 
     FiducialOdom fiducial_odom{n, footprint_frame, bin_frame,
-        odometry_frame};
+        odometry_frame, position_stddev, yaw_stddev};
 
     ros::Rate r(rate);
     while(ros::ok())
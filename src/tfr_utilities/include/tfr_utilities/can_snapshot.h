@@ -0,0 +1,125 @@
+/*
+ * Latest value of every CAN entry the bridge reads, in shared memory.
+ *
+ * The bridge writes each sample into a named slot as soon as it is decoded,
+ * and the control loop reads it directly, without a ROS message, a copy or
+ * a trip through the callback queue. Slots are named after the topic the
+ * value is mirrored on, such as "device4/get_qry_abcntr/channel_1", and live
+ * in a POSIX shared memory object, so this works the same whether the bridge
+ * is loaded into the control node or runs as its own process.
+ *
+ * Each slot is a seqlock with a single writer: writes never wait, and a
+ * reader retries in the rare case it overlaps a write, so it never sees a
+ * value paired with another sample's timestamp.
+ *
+ * The object outlives the processes using it, and with them whatever
+ * wrote its last samples. A bridge clears every slot when it starts, and
+ * a reader should go by the samples' stamps, not just their count, to
+ * tell a live bridge from a dead one's leftovers. Only the user, and its
+ * group, may open it.
+ * */
+#ifndef CAN_SNAPSHOT_H
+#define CAN_SNAPSHOT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tfr_utilities
+{
+    struct CanSample
+    {
+        int64_t value;
+        // CLOCK_MONOTONIC nanoseconds, see CanSnapshot::now(), 0 for a
+        // cleared slot
+        uint64_t stamp;
+        // number of samples written to the slot so far, tells a new sample
+        // from one that was already read
+        uint32_t count;
+    };
+
+    class CanSnapshot
+    {
+    public:
+        static const std::size_t SLOTS = 128;
+        static const std::size_t NAME_LENGTH = 56;
+
+        struct Slot
+        {
+            std::atomic<uint32_t> state;
+            std::atomic<uint32_t> sequence;
+            char name[NAME_LENGTH];
+            std::atomic<int64_t> value;
+            std::atomic<uint64_t> stamp;
+        };
+
+        /*
+         * Maps the shared snapshot, creating it if this is the first process
+         * to use it.
+         * */
+        CanSnapshot();
+        ~CanSnapshot();
+        CanSnapshot(const CanSnapshot&) = delete;
+        CanSnapshot& operator=(const CanSnapshot&) = delete;
+
+        bool isOpen() const;
+
+        /*
+         * Finds the slot with the given name, claiming a free one if nobody
+         * has used the name yet. Either side may get to a slot first. Returns
+         * nullptr if the snapshot isn't open or is full. Not for the hot path,
+         * look slots up once and keep the pointer.
+         * */
+        Slot* slot(const std::string& name);
+
+        /*
+         * Empties every slot's sample, keeping the names. For the writer,
+         * when it starts, so nothing a previous one wrote passes for new.
+         * */
+        void clear();
+
+        /*
+         * Publishes a sample. Only one thread may write to a given slot.
+         * */
+        static void write(Slot& slot, int64_t value, uint64_t stamp)
+        {
+            const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+            slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.value.store(value, std::memory_order_relaxed);
+            slot.stamp.store(stamp, std::memory_order_relaxed);
+            slot.sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        /*
+         * Copies out the latest sample. Returns false if nothing has been
+         * written to the slot yet.
+         * */
+        static bool read(const Slot& slot, CanSample& sample)
+        {
+            uint32_t before, after;
+            do
+            {
+                before = slot.sequence.load(std::memory_order_acquire);
+                sample.value = slot.value.load(std::memory_order_relaxed);
+                sample.stamp = slot.stamp.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = slot.sequence.load(std::memory_order_relaxed);
+            } while (before != after || (before & 1) != 0);
+            sample.count = before / 2;
+            return sample.count != 0;
+        }
+
+        /*
+         * The clock samples are stamped with, shared by every process.
+         * */
+        static uint64_t now();
+
+    private:
+        struct Region;
+        Region* region;
+    };
+}
+
+#endif // CAN_SNAPSHOT_H
@@ -0,0 +1,113 @@
+/*
+ * Current protection for one motor, fed the measured current every control
+ * cycle and answering how much of the command may still be sent.
+ *
+ * Two limits, as on a fuse or a motor datasheet:
+ *  - peak: at or above it the motor is tripped at once, the command is zero.
+ *  - continuous: above it the motor heats. The excess, amps^2 - continuous^2,
+ *    is integrated over time (I^2t), and cools back down below it. The
+ *    budget is what i2t_time seconds at peak current would use. Past half
+ *    of it the command is folded back linearly to nothing at the full
+ *    budget, which trips.
+ * A trip holds until the current is down to release and the heat is back
+ * under half the budget, so it doesn't chatter at the threshold.
+ * */
+#ifndef CURRENT_LIMITER_H
+#define CURRENT_LIMITER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace tfr_utilities
+{
+    class CurrentLimiter
+    {
+    public:
+        enum State : uint8_t
+        {
+            OK,
+            FOLDBACK,
+            TRIPPED,
+        };
+
+        struct Limits
+        {
+            double continuous;  // amps
+            double peak;        // amps
+            double release;     // amps
+            double i2t_time;    // seconds at peak current, 0 for no I^2t
+        };
+
+        // fraction of the heat budget where foldback starts, and a trip may
+        // release
+        static constexpr double FOLDBACK_START = 0.5;
+
+        explicit CurrentLimiter(const Limits& l = Limits{10.0, 25.0, 8.0, 2.0}) :
+            limits(l),
+            budget{std::max(0.0, (l.peak * l.peak - l.continuous * l.continuous) * l.i2t_time)},
+            heat_used{0},
+            tripped{false},
+            current_state{OK}
+        {
+        }
+
+        /*
+         * amps is the latest reading, dt the time since the last update in
+         * seconds. Returns the fraction of the command to send, 0 to 1.
+         * */
+        double update(double amps, double dt)
+        {
+            const double magnitude = std::abs(amps);
+            if (budget > 0)
+            {
+                const double excess = magnitude * magnitude - limits.continuous * limits.continuous;
+                heat_used = std::min(budget, std::max(0.0, heat_used + excess * dt));
+            }
+
+            if (tripped)
+            {
+                tripped = magnitude > limits.release || heat() > FOLDBACK_START;
+            }
+            else
+            {
+                tripped = magnitude >= limits.peak || (budget > 0 && heat_used >= budget);
+            }
+
+            if (tripped)
+            {
+                current_state = TRIPPED;
+                return 0.0;
+            }
+            if (heat() > FOLDBACK_START)
+            {
+                current_state = FOLDBACK;
+                return (1.0 - heat()) / (1.0 - FOLDBACK_START);
+            }
+            current_state = OK;
+            return 1.0;
+        }
+
+        State state() const
+        {
+            return current_state;
+        }
+
+        /*
+         * How much of the I^2t budget is used, 0 to 1.
+         * */
+        double heat() const
+        {
+            return budget > 0 ? heat_used / budget : 0.0;
+        }
+
+    private:
+        Limits limits;
+        double budget;      // A^2 s
+        double heat_used;   // A^2 s
+        bool tripped;
+        State current_state;
+    };
+}
+
+#endif // CURRENT_LIMITER_H
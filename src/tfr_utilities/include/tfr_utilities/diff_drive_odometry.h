@@ -0,0 +1,212 @@
+/*
+ * Pose of a differential drive (the treads) from how far each side moved.
+ *
+ * Between two samples each tread is taken to have moved at a constant
+ * speed, which puts the robot on a circular arc. The arc is followed
+ * exactly: turning by dtheta while covering ds moves it by
+ *     x += ds * (sin(theta + dtheta) - sin(theta)) / dtheta
+ *     y += ds * (cos(theta) - cos(theta + dtheta)) / dtheta
+ * which for a small turn becomes the midpoint (second order Runge-Kutta)
+ * step, ds along theta + dtheta / 2. Euler steps along the starting
+ * heading cut every corner, so a turn in place followed by a straight line
+ * ends up somewhere else depending on how often it is sampled. The arc
+ * does not.
+ *
+ * The pose's covariance, over x, y and yaw, is carried along with it. Each
+ * tread's distance is taken to be off by a variance of noise_per_meter
+ * times how far it went, and each step adds that through the step's
+ * Jacobians (Siegwart and Nourbakhsh's, taken at the arc's midpoint):
+ *     P = F P F^T + G diag(k |left|, k |right|) G^T
+ * A step can scale its tread noise up by an inflation factor, for when the
+ * treads are known to be slipping.
+ * */
+#ifndef DIFF_DRIVE_ODOMETRY_H
+#define DIFF_DRIVE_ODOMETRY_H
+
+#include <array>
+#include <cmath>
+
+namespace tfr_utilities
+{
+    class DiffDriveOdometry
+    {
+    public:
+        struct Pose
+        {
+            double x;       // m
+            double y;       // m
+            double yaw;     // rad, -pi to pi
+        };
+
+        // row major over x, y and yaw
+        typedef std::array<double, 9> Covariance;
+
+        // below this turn (rad) the arc is replaced by its midpoint step
+        static constexpr double SMALL_TURN = 1e-6;
+
+        /*
+         * wheel_span is the distance between the treads' centers in meters,
+         * noise_per_meter the variance (m^2) a tread picks up per meter it
+         * moves.
+         * */
+        explicit DiffDriveOdometry(double wheel_span, double noise_per_meter = 0.0) :
+            span{wheel_span},
+            noise{noise_per_meter},
+            current{0, 0, 0},
+            uncertainty{}
+        {
+        }
+
+        /*
+         * Moves the pose, the covariance stays.
+         * */
+        void reset(const Pose& pose)
+        {
+            current = pose;
+            current.yaw = std::remainder(pose.yaw, 2 * PI);
+        }
+
+        void setCovariance(const Covariance& covariance)
+        {
+            uncertainty = covariance;
+        }
+
+        /*
+         * The left tread moved left meters and the right one right meters,
+         * both positive forwards. inflation scales the treads' noise for
+         * this step.
+         * */
+        void move(double left, double right, double inflation = 1.0)
+        {
+            const double distance = (left + right) / 2;
+            const double turn = (right - left) / span;
+            propagate(distance, turn, inflation * noise * std::abs(left),
+                    inflation * noise * std::abs(right));
+            current = arc(current, distance, turn);
+        }
+
+        const Pose& pose() const
+        {
+            return current;
+        }
+
+        const Covariance& covariance() const
+        {
+            return uncertainty;
+        }
+
+        /*
+         * Variances of the linear and angular speed and their covariance,
+         * from the variances of the treads' speeds.
+         * */
+        void twistCovariance(double left_variance, double right_variance,
+                double& linear, double& angular, double& cross) const
+        {
+            linear = (left_variance + right_variance) / 4;
+            angular = (left_variance + right_variance) / (span * span);
+            cross = (right_variance - left_variance) / (2 * span);
+        }
+
+        double wheelSpan() const
+        {
+            return span;
+        }
+
+        /*
+         * Where a robot at start ends up after covering distance along an
+         * arc that turns it by turn radians.
+         * */
+        static Pose arc(const Pose& start, double distance, double turn)
+        {
+            Pose end;
+            if (std::abs(turn) < SMALL_TURN)
+            {
+                const double heading = start.yaw + turn / 2;
+                end.x = start.x + distance * std::cos(heading);
+                end.y = start.y + distance * std::sin(heading);
+            }
+            else
+            {
+                const double radius = distance / turn;
+                end.x = start.x + radius * (std::sin(start.yaw + turn) - std::sin(start.yaw));
+                end.y = start.y + radius * (std::cos(start.yaw) - std::cos(start.yaw + turn));
+            }
+            end.yaw = std::remainder(start.yaw + turn, 2 * PI);
+            return end;
+        }
+
+        /*
+         * from moved towards to by at most max_xy meters along each of x and
+         * y and max_yaw radians of yaw, the short way around.
+         * */
+        static Pose approach(const Pose& from, const Pose& to, double max_xy, double max_yaw)
+        {
+            Pose end;
+            end.x = from.x + clamp(to.x - from.x, max_xy);
+            end.y = from.y + clamp(to.y - from.y, max_xy);
+            end.yaw = std::remainder(from.yaw
+                    + clamp(std::remainder(to.yaw - from.yaw, 2 * PI), max_yaw), 2 * PI);
+            return end;
+        }
+
+    private:
+        static constexpr double PI = 3.14159265358979323846;
+
+        static double clamp(double value, double limit)
+        {
+            return value > limit ? limit : value < -limit ? -limit : value;
+        }
+
+        /*
+         * Adds a step's uncertainty to the covariance, with the treads'
+         * variances over the step, before the pose is moved.
+         * */
+        void propagate(double distance, double turn, double left_variance, double right_variance)
+        {
+            const double heading = current.yaw + turn / 2;
+            const double c = std::cos(heading);
+            const double s = std::sin(heading);
+            const double lever = distance / (2 * span);
+            // F, the step's Jacobian over the pose, is the identity but for
+            // how x and y follow the yaw
+            const double fx = -distance * s;
+            const double fy = distance * c;
+            // G, over the left and right distances
+            const double g[3][2] = {
+                {c / 2 + lever * s, c / 2 - lever * s},
+                {s / 2 - lever * c, s / 2 + lever * c},
+                {-1 / span, 1 / span}};
+
+            const Covariance& p = uncertainty;
+            // F P
+            double fp[3][3];
+            for (int col = 0; col < 3; col++)
+            {
+                fp[0][col] = p[col] + fx * p[6 + col];
+                fp[1][col] = p[3 + col] + fy * p[6 + col];
+                fp[2][col] = p[6 + col];
+            }
+            Covariance next;
+            for (int row = 0; row < 3; row++)
+            {
+                // (F P) F^T
+                next[row * 3 + 0] = fp[row][0] + fp[row][2] * fx;
+                next[row * 3 + 1] = fp[row][1] + fp[row][2] * fy;
+                next[row * 3 + 2] = fp[row][2];
+                for (int col = 0; col < 3; col++)
+                {
+                    next[row * 3 + col] += g[row][0] * left_variance * g[col][0]
+                        + g[row][1] * right_variance * g[col][1];
+                }
+            }
+            uncertainty = next;
+        }
+
+        double span;
+        double noise;
+        Pose current;
+        Covariance uncertainty;
+    };
+}
+
+#endif // DIFF_DRIVE_ODOMETRY_H
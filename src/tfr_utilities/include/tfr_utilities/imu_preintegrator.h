@@ -0,0 +1,263 @@
+/*
+ * Dead reckoning from an IMU's samples: orientation from the gyroscope,
+ * and velocity from the accelerometer with gravity taken out, both
+ * corrected by biases learned while the robot stands still.
+ *
+ * Each sample is integrated over the time since the previous one, from
+ * their stamps, not from when they were handled:
+ *  - the gyroscope, less its bias, turns the orientation by the rotation
+ *    vector w dt. If the sensor reports an orientation of its own, the
+ *    tilt (which way is up) is pulled towards it at orientation_gain per
+ *    second, so roll and pitch don't drift, but yaw is left to the
+ *    gyroscope.
+ *  - the accelerometer measures specific force, acceleration less gravity.
+ *    gravity is added back along the world's z, and the result rotated into
+ *    the world is integrated into velocity. Set gravity to 0 for a sensor
+ *    that already takes it out, like the LPMS's linear acceleration.
+ *  - standing still means the gyroscope reading, less its bias, is under
+ *    stationary_gyro and the acceleration under stationary_acceleration for
+ *    stationary_time. Then whatever they read is bias: both biases follow
+ *    it with a time constant of bias_time_constant, and velocity is zeroed.
+ * A gap longer than max_dt, or a stamp going backwards, restarts the
+ * integration from that sample instead of integrating across it.
+ *
+ * The yaw variance grows by gyro_noise^2 dt (gyro_noise in rad/s/sqrt(Hz)),
+ * so it says how far the yaw may have wandered since reset().
+ * */
+#ifndef IMU_PREINTEGRATOR_H
+#define IMU_PREINTEGRATOR_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_utilities
+{
+    class ImuPreintegrator
+    {
+    public:
+        struct Vector
+        {
+            double x, y, z;
+        };
+
+        struct Quaternion
+        {
+            double w, x, y, z;
+        };
+
+        struct Settings
+        {
+            double gravity;                 // m/s^2, 0 if the sensor removes it
+            double max_dt;                  // s
+            double gyro_noise;              // rad/s/sqrt(Hz)
+            double orientation_gain;        // 1/s, 0 to ignore the sensor's orientation
+            double stationary_gyro;         // rad/s
+            double stationary_acceleration; // m/s^2
+            double stationary_time;         // s
+            double bias_time_constant;      // s
+        };
+
+        struct State
+        {
+            Quaternion orientation;         // body to world
+            Vector angular_velocity;        // body, less the bias
+            Vector linear_acceleration;     // body, less gravity and the bias
+            Vector velocity;                // world
+            Vector gyro_bias;
+            Vector acceleration_bias;
+            double yaw;
+            double yaw_rate;                // about the world's z
+            double yaw_variance;
+            bool stationary;
+        };
+
+        explicit ImuPreintegrator(const Settings& s = Settings{9.80665, 0.1, 0.00087, 0.1,
+                0.02, 0.1, 0.5, 5.0}) :
+            settings(s)
+        {
+            reset(Quaternion{1, 0, 0, 0});
+        }
+
+        /*
+         * Starts over from the given orientation, keeping the biases.
+         * */
+        void reset(const Quaternion& orientation)
+        {
+            const Vector gyro_bias = started ? current.gyro_bias : Vector{0, 0, 0};
+            const Vector acceleration_bias = started ? current.acceleration_bias : Vector{0, 0, 0};
+            current = State{};
+            current.orientation = normalized(orientation);
+            current.gyro_bias = gyro_bias;
+            current.acceleration_bias = acceleration_bias;
+            current.yaw = yawOf(current.orientation);
+            have_stamp = false;
+            still_for = 0;
+            started = true;
+        }
+
+        /*
+         * Integrates one sample stamped in seconds. gyro is rad/s and
+         * specific_force m/s^2, in the sensor's frame. measured is the
+         * sensor's own orientation, or nullptr if it has none. The first
+         * sample, and one after a gap, only starts the clock (and takes the
+         * sensor's orientation, if any), and false is returned.
+         * */
+        bool update(double stamp, const Vector& gyro, const Vector& specific_force,
+                const Quaternion* measured = nullptr)
+        {
+            const double dt = stamp - last_stamp;
+            if (!have_stamp || dt <= 0 || dt > settings.max_dt)
+            {
+                if (!have_stamp && measured != nullptr)
+                    reset(*measured);
+                last_stamp = stamp;
+                have_stamp = true;
+                still_for = 0;
+                return false;
+            }
+            last_stamp = stamp;
+
+            const Vector rate = minus(gyro, current.gyro_bias);
+            // gravity as the accelerometer sees it, it reads +g sitting level
+            const Vector up = rotateInverse(current.orientation, Vector{0, 0, settings.gravity});
+            const Vector acceleration = minus(minus(specific_force, up), current.acceleration_bias);
+
+            if (norm(rate) < settings.stationary_gyro
+                    && norm(acceleration) < settings.stationary_acceleration)
+                still_for += dt;
+            else
+                still_for = 0;
+            current.stationary = still_for >= settings.stationary_time;
+
+            if (current.stationary)
+            {
+                const double alpha = dt / (settings.bias_time_constant + dt);
+                current.gyro_bias = plus(current.gyro_bias, scaled(rate, alpha));
+                current.acceleration_bias = plus(current.acceleration_bias,
+                        scaled(acceleration, alpha));
+            }
+
+            current.angular_velocity = minus(gyro, current.gyro_bias);
+            current.linear_acceleration = minus(minus(specific_force, up),
+                    current.acceleration_bias);
+
+            current.orientation = normalized(multiply(current.orientation,
+                        exponential(scaled(current.angular_velocity, dt))));
+            if (measured != nullptr && settings.orientation_gain > 0)
+                correctTilt(normalized(*measured), std::min(1.0, settings.orientation_gain * dt));
+
+            if (current.stationary)
+                current.velocity = Vector{0, 0, 0};
+            else
+                current.velocity = plus(current.velocity,
+                        scaled(rotate(current.orientation, current.linear_acceleration), dt));
+
+            current.yaw = yawOf(current.orientation);
+            current.yaw_rate = rotate(current.orientation, current.angular_velocity).z;
+            current.yaw_variance += settings.gyro_noise * settings.gyro_noise * dt;
+            return true;
+        }
+
+        const State& state() const
+        {
+            return current;
+        }
+
+        static double yawOf(const Quaternion& q)
+        {
+            return std::atan2(2 * (q.w * q.z + q.x * q.y), 1 - 2 * (q.y * q.y + q.z * q.z));
+        }
+
+    private:
+        Settings settings;
+        State current{};
+        double last_stamp = 0;
+        double still_for = 0;
+        bool have_stamp = false;
+        bool started = false;
+
+        /*
+         * Turns part of the way to the measured orientation's idea of which
+         * way is up. The axis is horizontal, so yaw is left alone.
+         * */
+        void correctTilt(const Quaternion& measured, double fraction)
+        {
+            const Vector up = rotateInverse(current.orientation, Vector{0, 0, 1});
+            const Vector measured_up = rotateInverse(measured, Vector{0, 0, 1});
+            current.orientation = normalized(multiply(current.orientation,
+                        exponential(scaled(cross(measured_up, up), fraction))));
+        }
+
+        static Vector plus(const Vector& a, const Vector& b)
+        {
+            return Vector{a.x + b.x, a.y + b.y, a.z + b.z};
+        }
+
+        static Vector minus(const Vector& a, const Vector& b)
+        {
+            return Vector{a.x - b.x, a.y - b.y, a.z - b.z};
+        }
+
+        static Vector scaled(const Vector& a, double s)
+        {
+            return Vector{a.x * s, a.y * s, a.z * s};
+        }
+
+        static Vector cross(const Vector& a, const Vector& b)
+        {
+            return Vector{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+        }
+
+        static double norm(const Vector& a)
+        {
+            return std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+        }
+
+        static Quaternion multiply(const Quaternion& a, const Quaternion& b)
+        {
+            return Quaternion{
+                a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w};
+        }
+
+        static Quaternion conjugate(const Quaternion& q)
+        {
+            return Quaternion{q.w, -q.x, -q.y, -q.z};
+        }
+
+        static Quaternion normalized(const Quaternion& q)
+        {
+            const double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+            if (n == 0)
+                return Quaternion{1, 0, 0, 0};
+            return Quaternion{q.w / n, q.x / n, q.y / n, q.z / n};
+        }
+
+        /*
+         * The rotation by the rotation vector v.
+         * */
+        static Quaternion exponential(const Vector& v)
+        {
+            const double angle = norm(v);
+            if (angle < 1e-12)
+                return Quaternion{1, v.x / 2, v.y / 2, v.z / 2};
+            const double s = std::sin(angle / 2) / angle;
+            return Quaternion{std::cos(angle / 2), v.x * s, v.y * s, v.z * s};
+        }
+
+        static Vector rotate(const Quaternion& q, const Vector& v)
+        {
+            const Quaternion p = multiply(multiply(q, Quaternion{0, v.x, v.y, v.z}), conjugate(q));
+            return Vector{p.x, p.y, p.z};
+        }
+
+        static Vector rotateInverse(const Quaternion& q, const Vector& v)
+        {
+            return rotate(conjugate(q), v);
+        }
+    };
+}
+
+#endif // IMU_PREINTEGRATOR_H
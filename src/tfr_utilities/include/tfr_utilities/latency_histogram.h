@@ -0,0 +1,136 @@
+/*
+ * Lock free histogram for recording latencies from real time threads.
+ *
+ * Values are bucketed the way HdrHistogram does it: exact below 8, and above
+ * that every power of two is split into 8 linear sub-buckets, so any recorded
+ * value is known to within 12.5%. Recording is a couple of relaxed atomic
+ * adds, so it is safe to call from several threads while another thread
+ * reads percentiles out.
+ * */
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tfr_utilities
+{
+    class LatencyHistogram
+    {
+    public:
+        static const int SUB_BUCKET_BITS = 3;
+        static const std::size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const std::size_t BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        LatencyHistogram()
+        {
+            reset();
+        }
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        /*
+         * Records one value, usually a duration in nanoseconds.
+         * */
+        void record(uint64_t value)
+        {
+            counts[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(value, std::memory_order_relaxed);
+
+            uint64_t current = maximum.load(std::memory_order_relaxed);
+            while (value > current &&
+                    !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed));
+        }
+
+        uint64_t count() const
+        {
+            return total.load(std::memory_order_relaxed);
+        }
+
+        uint64_t max() const
+        {
+            return maximum.load(std::memory_order_relaxed);
+        }
+
+        double mean() const
+        {
+            const uint64_t n = count();
+            return n == 0 ? 0.0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+        }
+
+        /*
+         * Smallest value that at least p percent of the recorded values are
+         * less than or equal to, to within the bucket resolution.
+         * */
+        uint64_t percentile(double p) const
+        {
+            const uint64_t n = count();
+            if (n == 0)
+                return 0;
+
+            uint64_t target = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+            if (target < 1)
+                target = 1;
+
+            uint64_t seen = 0;
+            for (std::size_t i = 0; i < BUCKETS; i++)
+            {
+                seen += counts[i].load(std::memory_order_relaxed);
+                if (seen >= target)
+                {
+                    const uint64_t upper = bucketUpperBound(i);
+                    return upper < max() ? upper : max();
+                }
+            }
+            return max();
+        }
+
+        /*
+         * Clears the histogram. Values recorded while this runs may be lost.
+         * */
+        void reset()
+        {
+            for (auto& bucket : counts)
+                bucket.store(0, std::memory_order_relaxed);
+            total.store(0, std::memory_order_relaxed);
+            sum.store(0, std::memory_order_relaxed);
+            maximum.store(0, std::memory_order_relaxed);
+        }
+
+        static std::size_t bucketOf(uint64_t value)
+        {
+            if (value < SUB_BUCKETS)
+                return static_cast<std::size_t>(value);
+            const int msb = 63 - __builtin_clzll(value);
+            const int shift = msb - SUB_BUCKET_BITS;
+            const std::size_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+            return (shift + 1) * SUB_BUCKETS + sub;
+        }
+
+        static uint64_t bucketLowerBound(std::size_t bucket)
+        {
+            if (bucket < SUB_BUCKETS)
+                return bucket;
+            const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+            return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        }
+
+        static uint64_t bucketUpperBound(std::size_t bucket)
+        {
+            if (bucket < SUB_BUCKETS)
+                return bucket;
+            const int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+            return bucketLowerBound(bucket) + ((static_cast<uint64_t>(1) << shift) - 1);
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> counts;
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> maximum;
+    };
+}
+#endif
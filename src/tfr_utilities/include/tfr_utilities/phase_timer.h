@@ -0,0 +1,162 @@
+/*
+ * Times the phases of a loop, for finding out where a slow cycle went.
+ *
+ * The loop calls begin() at the top of a cycle, lap(phase) as each phase
+ * finishes, and end() at the bottom. Each phase's time goes into two
+ * LatencyHistograms: one for the current window, which a reporting thread
+ * reads and resets with takeWindow(), and one for the whole run, for
+ * dump() at shutdown. The whole cycle, begin() to end(), is kept as an
+ * extra phase after the named ones.
+ *
+ * Times are from steady_clock, which on Linux reads the TSC through the
+ * vDSO without a system call, so a probe costs tens of nanoseconds and a
+ * handful of relaxed atomic adds. Build with TFR_PHASE_TIMING=0 and the
+ * TFR_PHASE_* macros compile to nothing.
+ * */
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include "latency_histogram.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+#ifndef TFR_PHASE_TIMING
+#define TFR_PHASE_TIMING 1
+#endif
+
+#if TFR_PHASE_TIMING
+#define TFR_PHASE_BEGIN(timer) (timer).begin()
+#define TFR_PHASE_LAP(timer, phase) (timer).lap(phase)
+#define TFR_PHASE_END(timer) (timer).end()
+#else
+#define TFR_PHASE_BEGIN(timer) ((void)0)
+#define TFR_PHASE_LAP(timer, phase) ((void)0)
+#define TFR_PHASE_END(timer) ((void)0)
+#endif
+
+namespace tfr_utilities
+{
+    /*
+     * One phase's histogram boiled down, times in nanoseconds.
+     * */
+    struct PhaseSummary
+    {
+        const char* name;
+        uint64_t count;
+        double mean;
+        uint64_t p50;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+    };
+
+    template <std::size_t PHASES>
+    class PhaseTimer
+    {
+    public:
+        // the index of the whole cycle, after the named phases
+        static const std::size_t CYCLE = PHASES;
+
+        /*
+         * names must outlive the timer, string literals are the idea.
+         * */
+        explicit PhaseTimer(const std::array<const char*, PHASES>& phase_names) :
+            start{0},
+            last{0}
+        {
+            for (std::size_t i = 0; i < PHASES; i++)
+                names[i] = phase_names[i];
+            names[CYCLE] = "cycle";
+        }
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+        static uint64_t now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void begin()
+        {
+            start = last = now();
+        }
+
+        /*
+         * Ends phase, which started at the last begin() or lap().
+         * */
+        void lap(std::size_t phase)
+        {
+            const uint64_t time = now();
+            record(phase, time - last);
+            last = time;
+        }
+
+        void end()
+        {
+            record(CYCLE, now() - start);
+        }
+
+        /*
+         * Summary of each phase, and the cycle last, since the last call.
+         * out needs room for PHASES + 1.
+         * */
+        void takeWindow(PhaseSummary* out)
+        {
+            for (std::size_t i = 0; i <= PHASES; i++)
+            {
+                out[i] = summarize(i, window[i]);
+                window[i].reset();
+            }
+        }
+
+        /*
+         * A table of every phase over the whole run, in microseconds.
+         * */
+        void dump(std::ostream& out) const
+        {
+            out << std::left << std::setw(16) << "phase" << std::right
+                << std::setw(10) << "count" << std::setw(10) << "mean"
+                << std::setw(10) << "p50" << std::setw(10) << "p99"
+                << std::setw(10) << "p99.9" << std::setw(10) << "max" << " (us)\n";
+            out << std::fixed << std::setprecision(1);
+            for (std::size_t i = 0; i <= PHASES; i++)
+            {
+                const PhaseSummary summary = summarize(i, total[i]);
+                out << std::left << std::setw(16) << summary.name << std::right
+                    << std::setw(10) << summary.count
+                    << std::setw(10) << summary.mean * 1e-3
+                    << std::setw(10) << summary.p50 * 1e-3
+                    << std::setw(10) << summary.p99 * 1e-3
+                    << std::setw(10) << summary.p999 * 1e-3
+                    << std::setw(10) << summary.max * 1e-3 << "\n";
+            }
+        }
+
+    private:
+        std::array<const char*, PHASES + 1> names;
+        std::array<LatencyHistogram, PHASES + 1> window;
+        std::array<LatencyHistogram, PHASES + 1> total;
+        uint64_t start;
+        uint64_t last;
+
+        void record(std::size_t phase, uint64_t duration)
+        {
+            window[phase].record(duration);
+            total[phase].record(duration);
+        }
+
+        PhaseSummary summarize(std::size_t phase, const LatencyHistogram& histogram) const
+        {
+            return PhaseSummary{names[phase], histogram.count(), histogram.mean(),
+                histogram.percentile(50), histogram.percentile(99),
+                histogram.percentile(99.9), histogram.max()};
+        }
+    };
+}
+
+#endif // PHASE_TIMER_H
@@ -0,0 +1,114 @@
+/*
+ * Single writer, many reader sharing of a small struct between threads.
+ *
+ * The writer never waits: it bumps a sequence number to odd, stores the
+ * value and bumps it back to even. A reader copies the value out and starts
+ * over if the sequence moved underneath it, so it always gets one whole
+ * write, never half of one write and half of the next. The same scheme as a
+ * CanSnapshot slot, for a whole struct instead of one sample.
+ *
+ * The value is kept in atomic words rather than as a T so that a reader
+ * overlapping a write is not a data race, which is why T has to be
+ * trivially copyable.
+ * */
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace tfr_utilities
+{
+    template <typename T>
+    class SeqLock
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock values are copied word by word");
+
+    public:
+        SeqLock() :
+            sequence{0},
+            latest{}
+        {
+            store(latest);
+        }
+        SeqLock(const SeqLock&) = delete;
+        SeqLock& operator=(const SeqLock&) = delete;
+
+        /*
+         * Publishes a new value. Only one thread may write.
+         * */
+        void write(const T& value)
+        {
+            latest = value;
+            store(latest);
+        }
+
+        /*
+         * Changes part of the value, modify is called with the writer's copy
+         * of the last value written. Only one thread may write.
+         * */
+        template <typename F>
+        void update(F modify)
+        {
+            modify(latest);
+            store(latest);
+        }
+
+        /*
+         * Copies out the latest value. Safe from any thread.
+         * */
+        T read() const
+        {
+            uint64_t copy[WORDS];
+            uint32_t before, after;
+            do
+            {
+                before = sequence.load(std::memory_order_acquire);
+                for (std::size_t i = 0; i < WORDS; i++)
+                    copy[i] = words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence.load(std::memory_order_relaxed);
+            } while (before != after || (before & 1) != 0);
+
+            T value;
+            std::memcpy(&value, copy, sizeof(T));
+            return value;
+        }
+
+        /*
+         * How many values have been written, tells a new value from one
+         * already read.
+         * */
+        uint32_t version() const
+        {
+            return sequence.load(std::memory_order_acquire) / 2;
+        }
+
+    private:
+        static const std::size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> sequence;
+        std::atomic<uint64_t> words[WORDS];
+        // only touched by the writer
+        T latest;
+
+        void store(const T& value)
+        {
+            uint64_t copy[WORDS] = {};
+            std::memcpy(copy, &value, sizeof(T));
+
+            const uint32_t current = sequence.load(std::memory_order_relaxed);
+            sequence.store(current + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (std::size_t i = 0; i < WORDS; i++)
+                words[i].store(copy[i], std::memory_order_relaxed);
+            sequence.store(current + 2, std::memory_order_release);
+        }
+    };
+}
+
+#endif // SEQLOCK_H
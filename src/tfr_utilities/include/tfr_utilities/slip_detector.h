@@ -0,0 +1,109 @@
+/*
+ * Tells the treads slipping from the yaw rate they claim against the one
+ * the IMU measures.
+ *
+ * Treads that skid turn the robot by less than, or other than, their speeds
+ * say, and in regolith they do it all the time. The gyroscope doesn't care.
+ * The difference between the two rates, tread minus IMU, is low pass
+ * filtered with a time_constant, so one noisy pair of samples doesn't count
+ * as slip, and becomes
+ *     inflation = 1 + (residual / rate_tolerance)^2
+ * up to max_inflation, a factor for the odometry's noise: 1 while they
+ * agree, growing quickly as they part. Past rate_tolerance the treads are
+ * slipping.
+ *
+ * An IMU rate older than imu_timeout says nothing, the residual then decays
+ * back towards agreement.
+ * */
+#ifndef SLIP_DETECTOR_H
+#define SLIP_DETECTOR_H
+
+#include <algorithm>
+#include <cmath>
+
+namespace tfr_utilities
+{
+    class SlipDetector
+    {
+    public:
+        struct Settings
+        {
+            double rate_tolerance;  // rad/s
+            double time_constant;   // s
+            double max_inflation;
+            double imu_timeout;     // s
+        };
+
+        explicit SlipDetector(const Settings& s) :
+            settings{s},
+            imu_rate{0},
+            imu_stamp{0},
+            has_imu{false},
+            filtered{0},
+            last_tread_rate{0}
+        {
+        }
+
+        /*
+         * The IMU's latest yaw rate, rad/s, measured at stamp seconds.
+         * */
+        void imu(double yaw_rate, double stamp)
+        {
+            imu_rate = yaw_rate;
+            imu_stamp = stamp;
+            has_imu = true;
+        }
+
+        /*
+         * The treads' yaw rate, rad/s, at stamp seconds, dt after the last
+         * update. Returns the noise inflation for the odometry step.
+         * */
+        double update(double tread_rate, double stamp, double dt)
+        {
+            last_tread_rate = tread_rate;
+            const bool fresh = has_imu && std::abs(stamp - imu_stamp) <= settings.imu_timeout;
+            const double residual = fresh ? tread_rate - imu_rate : 0.0;
+            const double alpha = settings.time_constant > 0
+                ? std::max(0.0, dt) / (settings.time_constant + std::max(0.0, dt)) : 1.0;
+            filtered += alpha * (residual - filtered);
+            return inflation();
+        }
+
+        double inflation() const
+        {
+            const double ratio = filtered / settings.rate_tolerance;
+            return std::min(settings.max_inflation, 1 + ratio * ratio);
+        }
+
+        bool slipping() const
+        {
+            return std::abs(filtered) > settings.rate_tolerance;
+        }
+
+        // filtered tread minus IMU yaw rate, rad/s
+        double residual() const
+        {
+            return filtered;
+        }
+
+        double treadRate() const
+        {
+            return last_tread_rate;
+        }
+
+        double imuRate() const
+        {
+            return imu_rate;
+        }
+
+    private:
+        Settings settings;
+        double imu_rate;
+        double imu_stamp;
+        bool has_imu;
+        double filtered;
+        double last_tread_rate;
+    };
+}
+
+#endif // SLIP_DETECTOR_H
@@ -0,0 +1,97 @@
+/*
+ * Fixed size queue between exactly one producer thread and one consumer
+ * thread, for handing records out of a real time loop.
+ *
+ * Neither side ever blocks or allocates: push() fails when the queue is full
+ * and pop() when it is empty. Each side keeps its own copy of the other's
+ * index and only reloads it when the queue looks full (or empty), so in the
+ * common case a push or pop is one copy and one release store, with the two
+ * sides' indices on separate cache lines.
+ * */
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace tfr_utilities
+{
+    template <typename T, std::size_t N>
+    class SpscRing
+    {
+        static_assert(N != 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    public:
+        SpscRing() : head{0}, tail{0} {}
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        static constexpr std::size_t capacity()
+        {
+            return N;
+        }
+
+        /*
+         * Producer only. Returns false, dropping the value, if the queue is
+         * full.
+         * */
+        bool push(const T& value)
+        {
+            const std::size_t index = head.load(std::memory_order_relaxed);
+            if (index - tail_cache == N)
+            {
+                tail_cache = tail.load(std::memory_order_acquire);
+                if (index - tail_cache == N)
+                    return false;
+            }
+            slots[index & (N - 1)] = value;
+            head.store(index + 1, std::memory_order_release);
+            return true;
+        }
+
+        /*
+         * Consumer only. Returns false, leaving value alone, if the queue is
+         * empty.
+         * */
+        bool pop(T& value)
+        {
+            const std::size_t index = tail.load(std::memory_order_relaxed);
+            if (index == head_cache)
+            {
+                head_cache = head.load(std::memory_order_acquire);
+                if (index == head_cache)
+                    return false;
+            }
+            value = slots[index & (N - 1)];
+            tail.store(index + 1, std::memory_order_release);
+            return true;
+        }
+
+        /*
+         * How many values are waiting, only exact when neither side is
+         * running.
+         * */
+        std::size_t size() const
+        {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        // Padded rather than alignas(64), which new doesn't honour before
+        // C++17: either way the two sides never share a cache line.
+        static const std::size_t CACHE_LINE = 64;
+
+        // written by the producer
+        std::atomic<std::size_t> head;
+        std::size_t tail_cache = 0;
+        char producer_padding[CACHE_LINE];
+        // written by the consumer
+        std::atomic<std::size_t> tail;
+        std::size_t head_cache = 0;
+        char consumer_padding[CACHE_LINE];
+        std::array<T, N> slots{};
+    };
+}
+
+#endif // SPSC_RING_H
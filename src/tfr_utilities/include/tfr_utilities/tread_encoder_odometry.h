@@ -0,0 +1,138 @@
+/*
+ * Drivebase odometry from the treads' absolute encoder counts.
+ *
+ * Each update moves the pose by how far the counts have come since the
+ * last one, along the arc of DiffDriveOdometry. Nothing is integrated over
+ * time, so a dropped or late reading loses nothing: the next one carries
+ * all of the distance, only the shape of the path between the two is
+ * approximated by a single arc. Counter wrap around is undone, and a step
+ * longer than any the robot could make between two readings, such as a
+ * motor controller restarting its count, is taken as a new starting point
+ * instead of a move.
+ *
+ * Nothing allocates, so it can be updated from the control loop.
+ * */
+#ifndef TREAD_ENCODER_ODOMETRY_H
+#define TREAD_ENCODER_ODOMETRY_H
+
+#include "diff_drive_odometry.h"
+#include <cmath>
+#include <cstdint>
+
+namespace tfr_utilities
+{
+    // m between the treads' centers, the robot model's 16 in between the
+    // treads plus one 6 in tread width, see tfr_description's
+    // model_constants.xacro
+    constexpr double TREAD_WHEEL_SPAN = 22 * 0.0254;
+
+    class TreadEncoderOdometry
+    {
+    public:
+        struct Settings
+        {
+            // meters of tread per count, negative where the encoder counts
+            // down going forwards
+            double left_meters_per_count;
+            double right_meters_per_count;
+            // m, between the treads' centers
+            double wheel_span;
+            // m, longest step of either tread between two readings
+            double max_step;
+            // m^2 of variance a tread picks up per meter, see
+            // DiffDriveOdometry
+            double noise_per_meter;
+        };
+
+        explicit TreadEncoderOdometry(const Settings& s) :
+            settings{s},
+            drive{s.wheel_span, s.noise_per_meter},
+            started{false},
+            last_left{0},
+            last_right{0},
+            left_step{0},
+            right_step{0}
+        {
+        }
+
+        /*
+         * Moves on to the treads' latest counts, with their noise scaled by
+         * inflation. Returns false, without moving, for the first counts and
+         * any that jump by more than max_step, which are only a new starting
+         * point.
+         * */
+        bool update(int32_t left, int32_t right, double inflation = 1.0)
+        {
+            const int32_t left_counts = difference(left, last_left);
+            const int32_t right_counts = difference(right, last_right);
+            const bool first = !started;
+            started = true;
+            last_left = left;
+            last_right = right;
+            left_step = 0;
+            right_step = 0;
+            if (first)
+                return false;
+
+            const double left_meters = settings.left_meters_per_count * left_counts;
+            const double right_meters = settings.right_meters_per_count * right_counts;
+            if (std::abs(left_meters) > settings.max_step
+                    || std::abs(right_meters) > settings.max_step)
+                return false;
+
+            left_step = left_meters;
+            right_step = right_meters;
+            drive.move(left_step, right_step, inflation);
+            return true;
+        }
+
+        /*
+         * The next counts start over, the pose stays.
+         * */
+        void restart()
+        {
+            started = false;
+        }
+
+        /*
+         * The pose, to be read or reset. Moving it by other means works too,
+         * the counts carry on from wherever it is.
+         * */
+        DiffDriveOdometry& odometry()
+        {
+            return drive;
+        }
+
+        const DiffDriveOdometry& odometry() const
+        {
+            return drive;
+        }
+
+        // meters each tread moved in the last update
+        double leftStep() const
+        {
+            return left_step;
+        }
+
+        double rightStep() const
+        {
+            return right_step;
+        }
+
+    private:
+        static int32_t difference(int32_t counts, int32_t last)
+        {
+            return static_cast<int32_t>(static_cast<uint32_t>(counts) - static_cast<uint32_t>(last));
+        }
+
+        Settings settings;
+        DiffDriveOdometry drive;
+        bool started;
+        int32_t last_left;
+        int32_t last_right;
+        double left_step;
+        double right_step;
+    };
+}
+
+#endif // TREAD_ENCODER_ODOMETRY_H
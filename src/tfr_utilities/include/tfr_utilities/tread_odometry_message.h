@@ -0,0 +1,116 @@
+/*
+ * What a tread odometry publishes, and how it goes into its messages.
+ *
+ * Both drivebase odometries, tfr_sensor's drivebase_odom_publisher and
+ * tfr_control's TreadOdometry, fill a TreadOdometryEstimate from their
+ * DiffDriveOdometry and SlipDetector and publish it through
+ * fillMessages(), so /drivebase_odom and /drivebase_odom/slip look the same
+ * whichever of the two runs.
+ *
+ * The estimate is plain data, it can be handed from the control thread to
+ * a publishing one through a SeqLock.
+ * */
+#ifndef TREAD_ODOMETRY_MESSAGE_H
+#define TREAD_ODOMETRY_MESSAGE_H
+
+#include "diff_drive_odometry.h"
+#include "slip_detector.h"
+#include <boost/array.hpp>
+#include <nav_msgs/Odometry.h>
+#include <tf/transform_datatypes.h>
+#include <tfr_msgs/SlipIndicator.h>
+
+namespace tfr_utilities
+{
+    struct TreadOdometryEstimate
+    {
+        DiffDriveOdometry::Pose pose;
+        DiffDriveOdometry::Covariance covariance;
+        double linear;      // m/s
+        double angular;     // rad/s
+        // twist variances and their covariance
+        double linear_variance;
+        double angular_variance;
+        double cross_variance;
+        double imu_yaw_rate;
+        double residual;
+        double inflation;
+        bool slipping;
+    };
+
+    /*
+     * The estimate of odometry, whose treads last went at left_speed and
+     * right_speed m/s, each with speed_variance, scaled up by the slip
+     * detector's inflation.
+     * */
+    inline TreadOdometryEstimate estimateOf(const DiffDriveOdometry& odometry,
+            const SlipDetector& slip, double left_speed, double right_speed,
+            double speed_variance, double inflation)
+    {
+        TreadOdometryEstimate estimate;
+        estimate.pose = odometry.pose();
+        estimate.covariance = odometry.covariance();
+        estimate.linear = (right_speed + left_speed) / 2;
+        estimate.angular = (right_speed - left_speed) / odometry.wheelSpan();
+        odometry.twistCovariance(inflation * speed_variance, inflation * speed_variance,
+                estimate.linear_variance, estimate.angular_variance, estimate.cross_variance);
+        estimate.imu_yaw_rate = slip.imuRate();
+        estimate.residual = slip.residual();
+        estimate.inflation = inflation;
+        estimate.slipping = slip.slipping();
+        return estimate;
+    }
+
+    /*
+     * A covariance over x, y and yaw, row major, into one over the six
+     * dimensions of a nav_msgs/Odometry, with what isn't measured at fixed.
+     * */
+    inline void fillCovariance(boost::array<double, 36>& out, const double xy_yaw[9], double fixed)
+    {
+        const int axes[3] = {0, 1, 5};
+        out.fill(0);
+        for (int i = 2; i < 5; i++)
+            out[i * 6 + i] = fixed;
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                out[axes[row] * 6 + axes[col]] = xy_yaw[row * 3 + col];
+    }
+
+    /*
+     * Fills both messages from the estimate. The odometry's header and
+     * child_frame_id are the caller's to set beforehand, the slip indicator
+     * gets the same header.
+     * */
+    inline void fillMessages(const TreadOdometryEstimate& estimate, nav_msgs::Odometry& odometry,
+            tfr_msgs::SlipIndicator& slip)
+    {
+        odometry.pose.pose.position.x = estimate.pose.x;
+        odometry.pose.pose.position.y = estimate.pose.y;
+        odometry.pose.pose.position.z = 0;
+        odometry.pose.pose.orientation = tf::createQuaternionMsgFromYaw(estimate.pose.yaw);
+        // the robot stays on the ground, what it can't measure is fixed
+        fillCovariance(odometry.pose.covariance, estimate.covariance.data(), 1e-1);
+
+        // the twist is in the child frame
+        odometry.twist.twist.linear.x = estimate.linear;
+        odometry.twist.twist.linear.y = 0;
+        odometry.twist.twist.linear.z = 0;
+        odometry.twist.twist.angular.x = 0;
+        odometry.twist.twist.angular.y = 0;
+        odometry.twist.twist.angular.z = estimate.angular;
+        // a sideways speed is slip too
+        const double twist[9] = {estimate.linear_variance, 0, estimate.cross_variance,
+            0, estimate.linear_variance, 0,
+            estimate.cross_variance, 0, estimate.angular_variance};
+        fillCovariance(odometry.twist.covariance, twist, 1e-1);
+
+        slip.header = odometry.header;
+        slip.tread_yaw_rate = estimate.angular;
+        slip.imu_yaw_rate = estimate.imu_yaw_rate;
+        slip.residual = estimate.residual;
+        slip.inflation = estimate.inflation;
+        slip.slipping = estimate.slipping;
+    }
+}
+
+#endif // TREAD_ODOMETRY_MESSAGE_H
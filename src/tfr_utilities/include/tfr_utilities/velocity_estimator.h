@@ -0,0 +1,181 @@
+/*
+ * Velocity and acceleration of an encoder from its recent readings.
+ *
+ * Differencing the last two readings puts every bit of timestamp jitter
+ * straight into the velocity. Instead this keeps the readings from the last
+ * window and fits x(t) = x0 + v t + a t^2 / 2 to them by least squares,
+ * using the stamp each reading was taken or received at, so a reading that
+ * arrives late only counts for as much as its stamp says. v and a are
+ * evaluated at the newest reading.
+ *
+ * Readings are kept in a fixed array of MAX_SAMPLES, nothing allocates
+ * after construction, so it can be used from the control loop. To have that
+ * many span the whole window however fast readings come, they are kept at
+ * least window / (MAX_SAMPLES - 2) apart: a reading that comes sooner after
+ * the one before it is replaced by the next instead of pushing out the
+ * oldest. The newest reading is always kept.
+ * */
+#ifndef VELOCITY_ESTIMATOR_H
+#define VELOCITY_ESTIMATOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace tfr_utilities
+{
+    class VelocityEstimator
+    {
+    public:
+        static const std::size_t MAX_SAMPLES = 16;
+
+        /*
+         * window is how far back readings are used, in seconds. A reading
+         * older than that is also too old to say how fast the encoder is
+         * going now, see estimate().
+         * */
+        explicit VelocityEstimator(double window = 0.1) :
+            window_ns{static_cast<uint64_t>(window * 1e9)},
+            spacing_ns{window_ns / (MAX_SAMPLES - 2)}
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            count = 0;
+            newest = 0;
+            unwrapped = 0;
+        }
+
+        /*
+         * Adds a reading of a 32 bit counter, stamped in nanoseconds. Counter
+         * wrap around is undone. Returns false, ignoring it, if the stamp is
+         * not newer than the last reading's.
+         * */
+        bool addSample(int32_t counts, uint64_t stamp)
+        {
+            if (count > 0)
+            {
+                const Sample& last = samples[newest];
+                if (stamp <= last.stamp)
+                    return false;
+                unwrapped += static_cast<int32_t>(static_cast<uint32_t>(counts) - static_cast<uint32_t>(last_counts));
+                // only the newest reading may be closer than spacing_ns to the
+                // one before it
+                const bool crowded = count >= 2
+                    && last.stamp - samples[(newest + MAX_SAMPLES - 1) % MAX_SAMPLES].stamp < spacing_ns;
+                if (!crowded)
+                {
+                    newest = (newest + 1) % MAX_SAMPLES;
+                    if (count < MAX_SAMPLES)
+                        count++;
+                }
+            }
+            else
+            {
+                unwrapped = 0;
+                count = 1;
+            }
+            samples[newest] = Sample{unwrapped, stamp};
+            last_counts = counts;
+            return true;
+        }
+
+        /*
+         * Seconds between the oldest and newest readings kept.
+         * */
+        double span() const
+        {
+            if (count == 0)
+                return 0;
+            const Sample& oldest = samples[(newest + MAX_SAMPLES - (count - 1)) % MAX_SAMPLES];
+            return (samples[newest].stamp - oldest.stamp) * 1e-9;
+        }
+
+        /*
+         * Velocity (counts/s) and acceleration (counts/s^2) as of the newest
+         * reading. Both are zero without at least two readings in the window
+         * or if the newest reading is older than the window at now.
+         * */
+        void estimate(uint64_t now, double& velocity, double& acceleration) const
+        {
+            velocity = 0;
+            acceleration = 0;
+            if (count == 0)
+                return;
+            const Sample& last = samples[newest];
+            if (now > last.stamp && now - last.stamp > window_ns)
+                return;
+
+            // Sums for the normal equations, with t and x relative to the
+            // newest reading so they stay small
+            double s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+            double sx = 0, stx = 0, st2x = 0;
+            std::size_t used = 0;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                const Sample& sample = samples[(newest + MAX_SAMPLES - i) % MAX_SAMPLES];
+                if (last.stamp - sample.stamp > window_ns)
+                    break;
+                const double t = -static_cast<double>(last.stamp - sample.stamp) * 1e-9;
+                const double x = static_cast<double>(sample.position - last.position);
+                const double q = t * t / 2;
+                s0 += 1;
+                s1 += t;
+                s2 += t * t;
+                s3 += t * q;
+                s4 += q * q;
+                sx += x;
+                stx += t * x;
+                st2x += q * x;
+                used++;
+            }
+            if (used < 2)
+                return;
+
+            // basis 1, t, t^2/2: [s0 s1 sq; s1 s2 s3; sq s3 s4] [x0 v a] = [sx stx st2x]
+            const double sq = s2 / 2;
+            if (used >= 3)
+            {
+                const double det = s0 * (s2 * s4 - s3 * s3)
+                    - s1 * (s1 * s4 - s3 * sq)
+                    + sq * (s1 * s3 - s2 * sq);
+                // the matrix is positive semidefinite, so its determinant is at
+                // most the product of its diagonal, compare against that
+                if (det > 1e-9 * s0 * s2 * s4)
+                {
+                    velocity = (s0 * (stx * s4 - s3 * st2x)
+                            - sx * (s1 * s4 - s3 * sq)
+                            + sq * (s1 * st2x - stx * sq)) / det;
+                    acceleration = (s0 * (s2 * st2x - stx * s3)
+                            - s1 * (s1 * st2x - stx * sq)
+                            + sx * (s1 * s3 - s2 * sq)) / det;
+                    return;
+                }
+            }
+
+            // too few readings, or too close together, for a curve: a line
+            const double det = s0 * s2 - s1 * s1;
+            if (det > 1e-9 * s0 * s2)
+                velocity = (s0 * stx - s1 * sx) / det;
+        }
+
+    private:
+        struct Sample
+        {
+            int64_t position;
+            uint64_t stamp;
+        };
+
+        uint64_t window_ns;
+        uint64_t spacing_ns;
+        std::array<Sample, MAX_SAMPLES> samples;
+        std::size_t count;
+        std::size_t newest;
+        int64_t unwrapped;
+        int32_t last_counts;
+    };
+}
+
+#endif // VELOCITY_ESTIMATOR_H
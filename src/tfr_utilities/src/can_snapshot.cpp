@@ -0,0 +1,131 @@
+#include "can_snapshot.h"
+
+#include <ros/ros.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace tfr_utilities
+{
+    namespace
+    {
+        const char* SHARED_MEMORY_NAME = "/tfr_can_snapshot";
+        // bump when the layout of Region changes
+        const uint32_t MAGIC = 0x7f5c0001;
+        const mode_t PERMISSIONS = 0660;
+
+        enum SlotState : uint32_t { FREE = 0, CLAIMING = 1, READY = 2 };
+    }
+
+    struct CanSnapshot::Region
+    {
+        std::atomic<uint32_t> magic;
+        CanSnapshot::Slot slots[CanSnapshot::SLOTS];
+    };
+
+    CanSnapshot::CanSnapshot() :
+        region{nullptr}
+    {
+        int fd = shm_open(SHARED_MEMORY_NAME, O_RDWR | O_CREAT, PERMISSIONS);
+        if (fd < 0)
+        {
+            ROS_ERROR_STREAM("can_snapshot: could not open " << SHARED_MEMORY_NAME
+                    << ": " << strerror(errno));
+            return;
+        }
+        // one made by an older build may be open to anybody, its owner
+        // closes it
+        fchmod(fd, PERMISSIONS);
+        // a new object is zero filled, which is a valid empty Region
+        if (ftruncate(fd, sizeof(Region)) < 0)
+        {
+            ROS_ERROR_STREAM("can_snapshot: could not size " << SHARED_MEMORY_NAME
+                    << ": " << strerror(errno));
+            close(fd);
+            return;
+        }
+        void* mapped = mmap(nullptr, sizeof(Region), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            ROS_ERROR_STREAM("can_snapshot: could not map " << SHARED_MEMORY_NAME
+                    << ": " << strerror(errno));
+            return;
+        }
+
+        Region* candidate = static_cast<Region*>(mapped);
+        uint32_t expected = 0;
+        if (!candidate->magic.compare_exchange_strong(expected, MAGIC) && expected != MAGIC)
+        {
+            ROS_ERROR_STREAM("can_snapshot: " << SHARED_MEMORY_NAME
+                    << " was made by an incompatible build, remove /dev/shm"
+                    << SHARED_MEMORY_NAME << " and restart");
+            munmap(mapped, sizeof(Region));
+            return;
+        }
+        region = candidate;
+    }
+
+    CanSnapshot::~CanSnapshot()
+    {
+        if (region != nullptr)
+            munmap(region, sizeof(Region));
+    }
+
+    bool CanSnapshot::isOpen() const
+    {
+        return region != nullptr;
+    }
+
+    void CanSnapshot::clear()
+    {
+        if (region == nullptr)
+            return;
+        for (auto& slot : region->slots)
+        {
+            if (slot.state.load(std::memory_order_acquire) == READY
+                    && slot.sequence.load(std::memory_order_relaxed) != 0)
+                write(slot, 0, 0);
+        }
+    }
+
+    CanSnapshot::Slot* CanSnapshot::slot(const std::string& name)
+    {
+        if (region == nullptr || name.empty() || name.size() >= NAME_LENGTH)
+            return nullptr;
+
+        for (auto& slot : region->slots)
+        {
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (state == FREE)
+            {
+                if (slot.state.compare_exchange_strong(state, CLAIMING,
+                            std::memory_order_acquire))
+                {
+                    std::strncpy(slot.name, name.c_str(), NAME_LENGTH - 1);
+                    slot.state.store(READY, std::memory_order_release);
+                    return &slot;
+                }
+            }
+            // somebody else is naming it, it might be our name
+            while (state == CLAIMING)
+                state = slot.state.load(std::memory_order_acquire);
+            if (name == slot.name)
+                return &slot;
+        }
+        ROS_ERROR_STREAM("can_snapshot: no room for " << name);
+        return nullptr;
+    }
+
+    uint64_t CanSnapshot::now()
+    {
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + time.tv_nsec;
+    }
+}
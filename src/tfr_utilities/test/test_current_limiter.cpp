@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "current_limiter.h"
+
+using tfr_utilities::CurrentLimiter;
+
+namespace
+{
+    // 10A continuous, 20A peak, back on at 5A, 1s at peak uses the budget of
+    // (400 - 100) A^2 s
+    const CurrentLimiter::Limits LIMITS{10.0, 20.0, 5.0, 1.0};
+    const double DT = 0.01;
+}
+
+TEST(CurrentLimiter, BelowContinuousNeverLimits)
+{
+    CurrentLimiter limiter{LIMITS};
+    for (int i = 0; i < 10000; i++)
+        ASSERT_EQ(limiter.update(9.9, DT), 1.0);
+    ASSERT_EQ(limiter.state(), CurrentLimiter::OK);
+    ASSERT_EQ(limiter.heat(), 0.0);
+}
+
+TEST(CurrentLimiter, PeakTripsAtOnceWithHysteresis)
+{
+    CurrentLimiter limiter{LIMITS};
+    ASSERT_EQ(limiter.update(-20.0, DT), 0.0);
+    ASSERT_EQ(limiter.state(), CurrentLimiter::TRIPPED);
+
+    // still tripped until the current is down to release
+    ASSERT_EQ(limiter.update(8.0, DT), 0.0);
+    ASSERT_EQ(limiter.update(6.0, DT), 0.0);
+    ASSERT_EQ(limiter.update(5.0, DT), 1.0);
+    ASSERT_EQ(limiter.state(), CurrentLimiter::OK);
+}
+
+TEST(CurrentLimiter, SustainedOverloadFoldsBackThenTrips)
+{
+    CurrentLimiter limiter{LIMITS};
+    // 15A uses (225 - 100) = 125 A^2 of the 300 A^2 s budget a second
+    double scale = 1.0;
+    double last_scale = 1.0;
+    bool folded_back = false;
+    int cycles = 0;
+    while (limiter.state() != CurrentLimiter::TRIPPED)
+    {
+        scale = limiter.update(15.0, DT);
+        if (limiter.state() == CurrentLimiter::FOLDBACK)
+        {
+            folded_back = true;
+            ASSERT_LT(scale, 1.0);
+            ASSERT_LE(scale, last_scale);
+        }
+        last_scale = scale;
+        ASSERT_LT(++cycles, 1000);
+    }
+    ASSERT_TRUE(folded_back);
+    ASSERT_EQ(scale, 0.0);
+    // 2.4s to use it all up
+    ASSERT_NEAR(cycles * DT, 2.4, 0.02);
+
+    // needs both the current down and the motor cooled to half the budget
+    int cooling = 0;
+    double released;
+    do
+    {
+        released = limiter.update(0.0, DT);
+        ASSERT_LT(++cooling, 1000);
+    } while (released == 0.0);
+    // 150 A^2 s at 100 A^2 s a second
+    ASSERT_NEAR(cooling * DT, 1.5, 0.02);
+    ASSERT_EQ(limiter.state(), CurrentLimiter::OK);
+}
+
+TEST(CurrentLimiter, NoI2tOnlyPeak)
+{
+    CurrentLimiter limiter{CurrentLimiter::Limits{10.0, 20.0, 5.0, 0.0}};
+    for (int i = 0; i < 10000; i++)
+        ASSERT_EQ(limiter.update(19.0, DT), 1.0);
+    ASSERT_EQ(limiter.update(21.0, DT), 0.0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "diff_drive_odometry.h"
+#include <cmath>
+
+using tfr_utilities::DiffDriveOdometry;
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+    const double SPAN = 0.6;
+}
+
+TEST(DiffDriveOdometry, StraightLine)
+{
+    DiffDriveOdometry odometry{SPAN};
+    odometry.reset({1.0, 2.0, PI / 2});
+    for (int i = 0; i < 10; i++)
+        odometry.move(0.1, 0.1);
+    ASSERT_NEAR(odometry.pose().x, 1.0, 1e-9);
+    ASSERT_NEAR(odometry.pose().y, 3.0, 1e-9);
+    ASSERT_NEAR(odometry.pose().yaw, PI / 2, 1e-9);
+}
+
+TEST(DiffDriveOdometry, TurnInPlaceDoesNotMove)
+{
+    DiffDriveOdometry odometry{SPAN};
+    // a quarter turn left
+    odometry.move(-SPAN * PI / 4, SPAN * PI / 4);
+    ASSERT_NEAR(odometry.pose().x, 0.0, 1e-12);
+    ASSERT_NEAR(odometry.pose().y, 0.0, 1e-12);
+    ASSERT_NEAR(odometry.pose().yaw, PI / 2, 1e-12);
+}
+
+TEST(DiffDriveOdometry, ArcDoesNotDependOnTheSampling)
+{
+    // a half circle of radius 1 m, to the left
+    const double radius = 1.0;
+    const double left = (radius - SPAN / 2) * PI;
+    const double right = (radius + SPAN / 2) * PI;
+    for (int steps : {1, 3, 100})
+    {
+        DiffDriveOdometry odometry{SPAN};
+        for (int i = 0; i < steps; i++)
+            odometry.move(left / steps, right / steps);
+        ASSERT_NEAR(odometry.pose().x, 0.0, 1e-9) << steps << " steps";
+        ASSERT_NEAR(odometry.pose().y, 2 * radius, 1e-9) << steps << " steps";
+        ASSERT_NEAR(std::abs(odometry.pose().yaw), PI, 1e-9) << steps << " steps";
+    }
+}
+
+TEST(DiffDriveOdometry, TinyTurnsMatchTheArc)
+{
+    const DiffDriveOdometry::Pose start{0, 0, 0.3};
+    const double turn = DiffDriveOdometry::SMALL_TURN / 2;
+    const DiffDriveOdometry::Pose end = DiffDriveOdometry::arc(start, 1.0, turn);
+    const DiffDriveOdometry::Pose wider = DiffDriveOdometry::arc(start, 1.0, turn * 4);
+    ASSERT_NEAR(end.x, wider.x, 1e-6);
+    ASSERT_NEAR(end.y, wider.y, 1e-6);
+}
+
+TEST(DiffDriveOdometry, YawWraps)
+{
+    DiffDriveOdometry odometry{SPAN};
+    odometry.reset({0, 0, 3 * PI / 4});
+    odometry.move(-SPAN * PI / 4, SPAN * PI / 4);
+    ASSERT_NEAR(odometry.pose().yaw, -3 * PI / 4, 1e-12);
+}
+
+TEST(DiffDriveOdometry, ApproachIsLimited)
+{
+    const DiffDriveOdometry::Pose from{0, 0, 3.0};
+    const DiffDriveOdometry::Pose near = DiffDriveOdometry::approach(from, {0.1, -0.1, 3.1}, 0.25, 0.13);
+    ASSERT_NEAR(near.x, 0.1, 1e-12);
+    ASSERT_NEAR(near.y, -0.1, 1e-12);
+    ASSERT_NEAR(near.yaw, 3.1, 1e-12);
+    // far off, and the short way to the yaw is across pi
+    const DiffDriveOdometry::Pose far = DiffDriveOdometry::approach(from, {2.0, -2.0, -3.0}, 0.25, 0.13);
+    ASSERT_NEAR(far.x, 0.25, 1e-12);
+    ASSERT_NEAR(far.y, -0.25, 1e-12);
+    ASSERT_NEAR(far.yaw, 3.13, 1e-12);
+}
+
+TEST(DiffDriveOdometry, StraightLineGrowsAlongAndAcross)
+{
+    DiffDriveOdometry odometry{SPAN, 0.01};
+    for (int i = 0; i < 100; i++)
+        odometry.move(0.01, 0.01);
+    const DiffDriveOdometry::Covariance& p = odometry.covariance();
+    // along the way only the two treads' own noise, averaged
+    ASSERT_NEAR(p[0], 0.01 * 2 * 1.0 / 4, 1e-9);
+    ASSERT_NEAR(p[8], 0.01 * 2 * 1.0 / (SPAN * SPAN), 1e-9);
+    // the yaw's uncertainty swings the end of the line sideways
+    ASSERT_GT(p[4], p[0]);
+    ASSERT_NEAR(p[5], p[7], 1e-15);
+    ASSERT_GT(p[5], 0.0);
+}
+
+TEST(DiffDriveOdometry, CovarianceFollowsTheHeading)
+{
+    DiffDriveOdometry east{SPAN, 0.01};
+    DiffDriveOdometry north{SPAN, 0.01};
+    north.reset({0, 0, PI / 2});
+    for (int i = 0; i < 50; i++)
+    {
+        east.move(0.02, 0.02);
+        north.move(0.02, 0.02);
+    }
+    ASSERT_NEAR(east.covariance()[0], north.covariance()[4], 1e-12);
+    ASSERT_NEAR(east.covariance()[4], north.covariance()[0], 1e-12);
+}
+
+TEST(DiffDriveOdometry, InflationScalesTheNoise)
+{
+    DiffDriveOdometry plain{SPAN, 0.01};
+    DiffDriveOdometry inflated{SPAN, 0.01};
+    plain.move(-0.1, 0.1);
+    inflated.move(-0.1, 0.1, 4.0);
+    for (int i = 0; i < 9; i++)
+        ASSERT_NEAR(inflated.covariance()[i], 4 * plain.covariance()[i], 1e-15);
+}
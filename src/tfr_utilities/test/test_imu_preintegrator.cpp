@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "imu_preintegrator.h"
+#include <cmath>
+
+using tfr_utilities::ImuPreintegrator;
+
+namespace
+{
+    const double G = 9.80665;
+    const ImuPreintegrator::Settings SETTINGS{G, 0.1, 0.001, 0.0, 0.02, 0.1, 0.5, 1.0};
+    const ImuPreintegrator::Vector LEVEL{0, 0, G};
+}
+
+TEST(ImuPreintegrator, FirstSampleOnlyStartsTheClock)
+{
+    ImuPreintegrator imu{SETTINGS};
+    ASSERT_FALSE(imu.update(1.0, {0, 0, 1}, LEVEL));
+    ASSERT_TRUE(imu.update(1.01, {0, 0, 1}, LEVEL));
+    ASSERT_NEAR(imu.state().yaw, 0.01, 1e-9);
+}
+
+TEST(ImuPreintegrator, YawFollowsTheStampsNotTheSampleCount)
+{
+    ImuPreintegrator imu{SETTINGS};
+    double stamp = 0;
+    imu.update(stamp, {0, 0, 0.5}, LEVEL);
+    // uneven gaps adding up to 2 seconds at 0.5 rad/s
+    const double gaps[] = {0.005, 0.02, 0.011, 0.064};
+    for (int i = 0; i < 80; i++)
+    {
+        stamp += gaps[i % 4];
+        ASSERT_TRUE(imu.update(stamp, {0, 0, 0.5}, LEVEL));
+    }
+    ASSERT_NEAR(stamp, 2.0, 1e-9);
+    ASSERT_NEAR(imu.state().yaw, 1.0, 1e-6);
+    ASSERT_NEAR(imu.state().yaw_rate, 0.5, 1e-9);
+    ASSERT_NEAR(imu.state().yaw_variance, 0.001 * 0.001 * 2.0, 1e-12);
+}
+
+TEST(ImuPreintegrator, GapsAreNotIntegratedAcross)
+{
+    ImuPreintegrator imu{SETTINGS};
+    imu.update(0.0, {0, 0, 1}, LEVEL);
+    imu.update(0.01, {0, 0, 1}, LEVEL);
+    ASSERT_FALSE(imu.update(5.0, {0, 0, 1}, LEVEL));
+    ASSERT_FALSE(imu.update(4.0, {0, 0, 1}, LEVEL));
+    ASSERT_NEAR(imu.state().yaw, 0.01, 1e-9);
+}
+
+TEST(ImuPreintegrator, GravityIsTakenOut)
+{
+    ImuPreintegrator imu{SETTINGS};
+    imu.update(0.0, {0, 0, 0}, {1.0, 0, G});
+    for (int i = 1; i <= 100; i++)
+        imu.update(i * 0.01, {0, 0, 0}, {1.0, 0, G});
+    ASSERT_NEAR(imu.state().linear_acceleration.x, 1.0, 1e-9);
+    ASSERT_NEAR(imu.state().linear_acceleration.z, 0.0, 1e-9);
+    ASSERT_NEAR(imu.state().velocity.x, 1.0, 1e-6);
+    ASSERT_NEAR(imu.state().velocity.z, 0.0, 1e-6);
+    ASSERT_FALSE(imu.state().stationary);
+}
+
+TEST(ImuPreintegrator, LearnsBiasesStandingStill)
+{
+    ImuPreintegrator imu{SETTINGS};
+    // only about z, a bias about x or y would tilt it before it is learned
+    const ImuPreintegrator::Vector gyro{0, 0, 0.01};
+    const ImuPreintegrator::Vector force{0.05, 0, G - 0.03};
+    double stamp = 0;
+    imu.update(stamp, gyro, force);
+    for (int i = 0; i < 2000; i++)
+    {
+        stamp += 0.01;
+        imu.update(stamp, gyro, force);
+    }
+    ASSERT_TRUE(imu.state().stationary);
+    ASSERT_NEAR(imu.state().gyro_bias.z, 0.01, 1e-4);
+    ASSERT_NEAR(imu.state().acceleration_bias.x, 0.05, 1e-3);
+    ASSERT_NEAR(imu.state().acceleration_bias.z, -0.03, 1e-3);
+    ASSERT_EQ(imu.state().velocity.x, 0.0);
+    // the yaw stops drifting once the bias is known
+    const double yaw = imu.state().yaw;
+    for (int i = 0; i < 100; i++)
+    {
+        stamp += 0.01;
+        imu.update(stamp, gyro, force);
+    }
+    ASSERT_NEAR(imu.state().yaw, yaw, 1e-5);
+}
+
+TEST(ImuPreintegrator, TiltIsPulledTowardsTheSensorButYawIsNot)
+{
+    ImuPreintegrator::Settings settings = SETTINGS;
+    settings.orientation_gain = 1.0;
+    ImuPreintegrator imu{settings};
+    // the sensor says 0.1 rad of roll and 1 rad of yaw
+    const double roll = 0.1;
+    const double yaw = 1.0;
+    const ImuPreintegrator::Quaternion measured{
+        std::cos(roll / 2) * std::cos(yaw / 2), std::sin(roll / 2) * std::cos(yaw / 2),
+        std::sin(roll / 2) * std::sin(yaw / 2), std::cos(roll / 2) * std::sin(yaw / 2)};
+    // start level, facing along x
+    imu.update(0.0, {0, 0, 0}, LEVEL);
+    for (int i = 1; i <= 1000; i++)
+        imu.update(i * 0.01, {0, 0, 0}, LEVEL, &measured);
+    const ImuPreintegrator::Quaternion& q = imu.state().orientation;
+    const double estimated_roll = std::atan2(2 * (q.w * q.x + q.y * q.z),
+            1 - 2 * (q.x * q.x + q.y * q.y));
+    ASSERT_NEAR(estimated_roll, roll, 1e-3);
+    ASSERT_NEAR(imu.state().yaw, 0.0, 1e-3);
+}
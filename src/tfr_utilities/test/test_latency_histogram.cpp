@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "latency_histogram.h"
+
+using tfr_utilities::LatencyHistogram;
+
+TEST(LatencyHistogram, BucketBounds)
+{
+    for (uint64_t value : {0ull, 7ull, 8ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull})
+    {
+        auto bucket = LatencyHistogram::bucketOf(value);
+        ASSERT_LE(LatencyHistogram::bucketLowerBound(bucket), value);
+        ASSERT_GE(LatencyHistogram::bucketUpperBound(bucket), value);
+    }
+    const std::size_t buckets = LatencyHistogram::BUCKETS;
+    ASSERT_LT(LatencyHistogram::bucketOf(~0ull), buckets);
+}
+
+TEST(LatencyHistogram, Percentiles)
+{
+    LatencyHistogram histogram;
+    ASSERT_EQ(histogram.percentile(50), 0u);
+
+    for (uint64_t value = 1; value <= 1000; value++)
+        histogram.record(value);
+
+    ASSERT_EQ(histogram.count(), 1000u);
+    ASSERT_EQ(histogram.max(), 1000u);
+    ASSERT_NEAR(histogram.mean(), 500.5, 1e-9);
+    // within the 12.5% bucket resolution
+    ASSERT_NEAR(histogram.percentile(50), 500, 500 * 0.125);
+    ASSERT_NEAR(histogram.percentile(99), 990, 990 * 0.125);
+    ASSERT_EQ(histogram.percentile(100), 1000u);
+
+    histogram.reset();
+    ASSERT_EQ(histogram.count(), 0u);
+    ASSERT_EQ(histogram.max(), 0u);
+}
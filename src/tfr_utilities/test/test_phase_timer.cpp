@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include "phase_timer.h"
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+using tfr_utilities::PhaseTimer;
+using tfr_utilities::PhaseSummary;
+
+namespace
+{
+    enum Phase {FIRST, SECOND, PHASES};
+}
+
+TEST(PhaseTimer, LapsSumToCycle)
+{
+    PhaseTimer<PHASES> timer{{{"first", "second"}}};
+    for (int i = 0; i < 5; i++)
+    {
+        timer.begin();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        timer.lap(FIRST);
+        timer.lap(SECOND);
+        timer.end();
+    }
+
+    PhaseSummary window[PHASES + 1];
+    timer.takeWindow(window);
+    ASSERT_STREQ(window[FIRST].name, "first");
+    ASSERT_STREQ(window[PhaseTimer<PHASES>::CYCLE].name, "cycle");
+    for (const PhaseSummary& summary : window)
+        ASSERT_EQ(summary.count, 5u);
+    ASSERT_GE(window[FIRST].mean, 2e6);
+    ASSERT_LT(window[SECOND].mean, window[FIRST].mean);
+    ASSERT_GE(window[PhaseTimer<PHASES>::CYCLE].mean, window[FIRST].mean);
+
+    // the window starts over, the run doesn't
+    timer.takeWindow(window);
+    ASSERT_EQ(window[FIRST].count, 0u);
+    std::ostringstream dump;
+    timer.dump(dump);
+    ASSERT_NE(dump.str().find("first"), std::string::npos);
+    ASSERT_NE(dump.str().find("cycle"), std::string::npos);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include "seqlock.h"
+
+#include <atomic>
+#include <thread>
+
+using tfr_utilities::SeqLock;
+
+namespace
+{
+    // odd sized, so the last word is only partly used
+    struct Reading
+    {
+        int32_t counts[5];
+        double amps;
+        uint8_t flags;
+    };
+}
+
+TEST(SeqLock, WriteAndUpdate)
+{
+    SeqLock<Reading> lock;
+    ASSERT_EQ(lock.version(), 1u);
+    ASSERT_EQ(lock.read().counts[0], 0);
+
+    Reading reading{{1, 2, 3, 4, 5}, 1.5, 7};
+    lock.write(reading);
+    lock.update([](Reading& r) { r.counts[2] = 30; });
+
+    Reading read = lock.read();
+    ASSERT_EQ(lock.version(), 3u);
+    ASSERT_EQ(read.counts[0], 1);
+    ASSERT_EQ(read.counts[2], 30);
+    ASSERT_EQ(read.counts[4], 5);
+    ASSERT_DOUBLE_EQ(read.amps, 1.5);
+    ASSERT_EQ(read.flags, 7);
+}
+
+TEST(SeqLock, ReadersNeverSeeTornWrites)
+{
+    SeqLock<Reading> lock;
+    std::atomic<bool> done{false};
+    std::thread writer([&]
+        {
+            for (int32_t i = 1; i <= 200000; i++)
+                lock.update([i](Reading& r)
+                    {
+                        for (auto& count : r.counts)
+                            count = i;
+                        r.amps = i;
+                    });
+            done = true;
+        });
+
+    int32_t last = 0;
+    while (!done)
+    {
+        Reading read = lock.read();
+        for (auto count : read.counts)
+            ASSERT_EQ(count, read.counts[0]);
+        ASSERT_EQ(read.amps, read.counts[0]);
+        ASSERT_GE(read.counts[0], last);
+        last = read.counts[0];
+    }
+    writer.join();
+    ASSERT_EQ(lock.read().counts[4], 200000);
+}
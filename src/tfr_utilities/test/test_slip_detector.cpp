@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+#include "slip_detector.h"
+
+using tfr_utilities::SlipDetector;
+
+namespace
+{
+    const SlipDetector::Settings SETTINGS{0.1, 0.2, 100.0, 0.25};
+}
+
+TEST(SlipDetector, AgreementIsNoSlip)
+{
+    SlipDetector slip{SETTINGS};
+    for (int i = 1; i <= 100; i++)
+    {
+        slip.imu(0.5, i * 0.01);
+        ASSERT_EQ(slip.update(0.5, i * 0.01, 0.01), 1.0);
+    }
+    ASSERT_FALSE(slip.slipping());
+}
+
+TEST(SlipDetector, DisagreementInflates)
+{
+    SlipDetector slip{SETTINGS};
+    // the treads think they turn, the robot doesn't
+    for (int i = 1; i <= 200; i++)
+    {
+        slip.imu(0.0, i * 0.01);
+        slip.update(0.3, i * 0.01, 0.01);
+    }
+    ASSERT_TRUE(slip.slipping());
+    ASSERT_NEAR(slip.residual(), 0.3, 1e-3);
+    ASSERT_NEAR(slip.inflation(), 10.0, 0.1);
+}
+
+TEST(SlipDetector, OneBadSampleIsFilteredOut)
+{
+    SlipDetector slip{SETTINGS};
+    slip.imu(0.0, 0.0);
+    slip.update(1.0, 0.01, 0.01);
+    ASSERT_FALSE(slip.slipping());
+}
+
+TEST(SlipDetector, InflationIsCapped)
+{
+    SlipDetector slip{SETTINGS};
+    for (int i = 1; i <= 500; i++)
+    {
+        slip.imu(-3.0, i * 0.01);
+        slip.update(3.0, i * 0.01, 0.01);
+    }
+    ASSERT_EQ(slip.inflation(), 100.0);
+}
+
+TEST(SlipDetector, StaleImuSaysNothing)
+{
+    SlipDetector slip{SETTINGS};
+    slip.imu(0.0, 0.0);
+    for (int i = 1; i <= 200; i++)
+        slip.update(0.3, 1.0 + i * 0.01, 0.01);
+    ASSERT_FALSE(slip.slipping());
+    ASSERT_NEAR(slip.residual(), 0.0, 1e-12);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "spsc_ring.h"
+
+#include <cstdint>
+#include <thread>
+
+using tfr_utilities::SpscRing;
+
+TEST(SpscRing, FillAndDrain)
+{
+    SpscRing<int, 4> ring;
+    int value = -1;
+    ASSERT_FALSE(ring.pop(value));
+    ASSERT_EQ(value, -1);
+
+    for (int i = 0; i < 4; i++)
+        ASSERT_TRUE(ring.push(i));
+    ASSERT_FALSE(ring.push(4));
+    ASSERT_EQ(ring.size(), 4u);
+
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(ring.pop(value));
+        ASSERT_EQ(value, i);
+    }
+    ASSERT_FALSE(ring.pop(value));
+    ASSERT_EQ(ring.size(), 0u);
+}
+
+TEST(SpscRing, WrapsAround)
+{
+    SpscRing<int, 4> ring;
+    int value;
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(ring.push(i));
+        ASSERT_TRUE(ring.push(-i));
+        ASSERT_TRUE(ring.pop(value));
+        ASSERT_EQ(value, i);
+        ASSERT_TRUE(ring.pop(value));
+        ASSERT_EQ(value, -i);
+    }
+}
+
+// Every value that was pushed comes out once and in order, with the producer
+// retrying whenever the consumer falls behind
+TEST(SpscRing, OneProducerOneConsumer)
+{
+    struct Record
+    {
+        uint64_t sequence;
+        uint64_t check;
+    };
+    SpscRing<Record, 64> ring;
+    const uint64_t COUNT = 200000;
+
+    std::thread producer([&]
+        {
+            for (uint64_t i = 0; i < COUNT; i++)
+            {
+                while (!ring.push(Record{i, ~i}))
+                    std::this_thread::yield();
+            }
+        });
+
+    uint64_t expected = 0;
+    Record record;
+    while (expected < COUNT)
+    {
+        if (!ring.pop(record))
+            continue;
+        ASSERT_EQ(record.sequence, expected);
+        ASSERT_EQ(record.check, ~expected);
+        expected++;
+    }
+    producer.join();
+    ASSERT_FALSE(ring.pop(record));
+}
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "tread_encoder_odometry.h"
+#include <cmath>
+#include <limits>
+
+using tfr_utilities::TreadEncoderOdometry;
+
+namespace
+{
+    const double PI = 3.14159265358979323846;
+    // a millimeter a count, the left encoder counting down going forwards
+    const TreadEncoderOdometry::Settings SETTINGS{-0.001, 0.001, 0.6, 0.5, 0.0};
+}
+
+TEST(TreadEncoderOdometry, FirstCountsOnlyStart)
+{
+    TreadEncoderOdometry odometry{SETTINGS};
+    ASSERT_FALSE(odometry.update(1000, 2000));
+    ASSERT_EQ(odometry.odometry().pose().x, 0.0);
+    ASSERT_TRUE(odometry.update(900, 2100));
+    ASSERT_NEAR(odometry.odometry().pose().x, 0.1, 1e-12);
+    ASSERT_NEAR(odometry.leftStep(), 0.1, 1e-12);
+    ASSERT_NEAR(odometry.rightStep(), 0.1, 1e-12);
+}
+
+TEST(TreadEncoderOdometry, DroppedReadingsLoseNothing)
+{
+    // a quarter turn in place then a meter straight, read every 10 counts
+    // and every 100
+    const int turn = static_cast<int>(std::round(0.6 * PI / 4 / 0.001));
+    const int straight = 1000;
+    for (int every : {10, 100})
+    {
+        TreadEncoderOdometry odometry{SETTINGS};
+        int32_t left = 0;
+        int32_t right = 0;
+        odometry.update(left, right);
+        for (int i = 0; i < turn; i += every)
+        {
+            const int counts = std::min(every, turn - i);
+            left += counts;
+            right += counts;
+            odometry.update(left, right);
+        }
+        for (int i = 0; i < straight; i += every)
+        {
+            left -= every;
+            right += every;
+            odometry.update(left, right);
+        }
+        ASSERT_NEAR(odometry.odometry().pose().x, 0.0, 1e-3) << every;
+        ASSERT_NEAR(odometry.odometry().pose().y, 1.0, 1e-3) << every;
+    }
+}
+
+TEST(TreadEncoderOdometry, CountsWrapAround)
+{
+    TreadEncoderOdometry odometry{SETTINGS};
+    const int32_t max = std::numeric_limits<int32_t>::max();
+    const int32_t min = std::numeric_limits<int32_t>::min();
+    odometry.update(min + 50, max - 50);
+    ASSERT_TRUE(odometry.update(max - 49, min + 49));
+    ASSERT_NEAR(odometry.odometry().pose().x, 0.1, 1e-12);
+}
+
+TEST(TreadEncoderOdometry, JumpsStartOver)
+{
+    TreadEncoderOdometry odometry{SETTINGS};
+    odometry.update(0, 0);
+    odometry.update(-100, 100);
+    // the controller restarted its counts
+    ASSERT_FALSE(odometry.update(123456, 0));
+    ASSERT_NEAR(odometry.odometry().pose().x, 0.1, 1e-12);
+    ASSERT_TRUE(odometry.update(123356, 100));
+    ASSERT_NEAR(odometry.odometry().pose().x, 0.2, 1e-12);
+}
+
+TEST(TreadEncoderOdometry, RestartKeepsThePose)
+{
+    TreadEncoderOdometry odometry{SETTINGS};
+    odometry.odometry().reset({1.0, 2.0, 0.0});
+    odometry.update(0, 0);
+    odometry.restart();
+    ASSERT_FALSE(odometry.update(-400, 400));
+    ASSERT_EQ(odometry.odometry().pose().x, 1.0);
+    ASSERT_EQ(odometry.odometry().pose().y, 2.0);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "velocity_estimator.h"
+
+#include <cmath>
+#include <cstdint>
+
+using tfr_utilities::VelocityEstimator;
+
+namespace
+{
+    const uint64_t MS = 1000000;
+    const uint64_t START = 1000 * MS;
+}
+
+TEST(VelocityEstimator, NeedsTwoReadings)
+{
+    VelocityEstimator estimator{0.1};
+    double velocity, acceleration;
+    estimator.estimate(START, velocity, acceleration);
+    ASSERT_EQ(velocity, 0);
+
+    estimator.addSample(100, START);
+    estimator.estimate(START, velocity, acceleration);
+    ASSERT_EQ(velocity, 0);
+
+    estimator.addSample(110, START + 10 * MS);
+    estimator.estimate(START + 10 * MS, velocity, acceleration);
+    ASSERT_NEAR(velocity, 1000, 1e-6);
+    ASSERT_EQ(acceleration, 0);
+}
+
+TEST(VelocityEstimator, ConstantAccelerationWithJitteredStamps)
+{
+    VelocityEstimator estimator{0.1};
+    // readings every 10ms give or take 3ms, x = 50 t + 200 t^2 / 2
+    const int jitter[] = {0, 3, -2, 1, -3, 2, 0, -1, 3, -2};
+    uint64_t stamp = START;
+    for (int i = 0; i < 10; i++)
+    {
+        stamp = START + i * 10 * MS + jitter[i] * MS;
+        const double t = (stamp - START) * 1e-9;
+        const double x = 1000 * (50 * t + 100 * t * t);
+        ASSERT_TRUE(estimator.addSample(static_cast<int32_t>(std::round(x)), stamp));
+    }
+    double velocity, acceleration;
+    estimator.estimate(stamp, velocity, acceleration);
+    const double t = (stamp - START) * 1e-9;
+    // within what rounding to whole counts allows
+    ASSERT_NEAR(velocity, 1000 * (50 + 200 * t), 50);
+    ASSERT_NEAR(acceleration, 1000 * 200, 2000);
+}
+
+TEST(VelocityEstimator, StaleAndOutOfOrder)
+{
+    VelocityEstimator estimator{0.1};
+    estimator.addSample(0, START);
+    estimator.addSample(100, START + 10 * MS);
+    ASSERT_FALSE(estimator.addSample(200, START + 10 * MS));
+    ASSERT_FALSE(estimator.addSample(200, START + 5 * MS));
+
+    double velocity, acceleration;
+    estimator.estimate(START + 50 * MS, velocity, acceleration);
+    ASSERT_NEAR(velocity, 10000, 1e-6);
+    // no readings for longer than the window
+    estimator.estimate(START + 200 * MS, velocity, acceleration);
+    ASSERT_EQ(velocity, 0);
+}
+
+TEST(VelocityEstimator, CounterWrapAround)
+{
+    VelocityEstimator estimator{0.1};
+    estimator.addSample(INT32_MAX - 5, START);
+    estimator.addSample(INT32_MIN + 4, START + 10 * MS);
+    double velocity, acceleration;
+    estimator.estimate(START + 10 * MS, velocity, acceleration);
+    ASSERT_NEAR(velocity, 1000, 1e-6);
+}
+
+TEST(VelocityEstimator, SpansWindowAtHighRates)
+{
+    // 200 Hz readings, many more than fit, still cover the whole window
+    VelocityEstimator estimator{0.2};
+    uint64_t stamp = START;
+    for (int i = 0; i < 200; i++)
+    {
+        stamp = START + i * 5 * MS;
+        estimator.addSample(10 * i, stamp);
+    }
+    ASSERT_GE(estimator.span(), 0.2);
+    double velocity, acceleration;
+    estimator.estimate(stamp, velocity, acceleration);
+    ASSERT_NEAR(velocity, 2000, 1e-3);
+    ASSERT_NEAR(acceleration, 0, 1e-3);
+}